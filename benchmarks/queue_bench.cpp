@@ -0,0 +1,363 @@
+// Microbenchmarks of the SectionQueue transport alone, without any hashtable
+// work behind the consumers:
+//   pingpong    round trip of one message between two threads
+//   throughput  one producer streaming to one consumer
+//   nxm         n producers sending all-to-all to m consumers
+// Every benchmark runs with the threads on the hyperthreads of one core, on
+// two cores of one socket, and across sockets, where the machine has them.
+// Section sizes follow from the placement (see pair_section_size); the
+// streaming runs sweep the queue depth. Latencies are in TSC cycles. For the
+// streaming benchmarks, they measure how long a section takes from its first
+// enqueue until a consumer reads it.
+// Comparing the streaming runs under --queue_wait=spin and park shows what
+// parking costs a loaded consumer.
+
+#include <absl/flags/flag.h>
+#include <absl/flags/parse.h>
+#include <pthread.h>
+#include <x86intrin.h>
+
+#include <barrier>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Latency.hpp"
+#include "numa.hpp"
+#include "queues/section_queues.hpp"
+
+ABSL_FLAG(uint32_t, round_trips, 50000, "Round trips per ping-pong run.");
+ABSL_FLAG(uint64_t, messages, 1ull << 24,
+          "Messages per producer/consumer pair in the streaming runs.");
+ABSL_FLAG(std::vector<std::string>, num_sections,
+          std::vector<std::string>({"2", "8", "32"}),
+          "Queue depths (in sections, powers of 2) of the streaming runs.");
+ABSL_FLAG(uint32_t, producers, 2, "Producers in the nxm runs.");
+ABSL_FLAG(uint32_t, consumers, 2, "Consumers in the nxm runs.");
+ABSL_FLAG(std::string, queue_wait, "spin",
+          "Idle consumers of the streaming runs: spin or park.");
+ABSL_FLAG(uint64_t, spin_cycles, kmercounter::QUEUE_SPIN_CYCLES,
+          "Cycles an idle consumer polls before it parks.");
+
+namespace kmercounter {
+namespace {
+
+// messages in the largest section of any pair
+constexpr uint64_t MAX_PER_SECTION = MAX_SECTION_SIZE / sizeof(data_t);
+
+enum class Placement { SameCore, SameSocket, CrossSocket };
+constexpr Placement placements[] = {Placement::SameCore, Placement::SameSocket,
+                                    Placement::CrossSocket};
+constexpr const char *placement_names[] = {"same-core", "same-socket",
+                                           "cross-socket"};
+
+struct Cpus {
+  std::vector<uint32_t> prod;
+  std::vector<uint32_t> cons;
+};
+
+/// The physical cores of every node, each with its hardware threads.
+class Topology {
+ public:
+  Topology() {
+    Numa numa;
+    for (const auto &node : numa.get_node_config()) {
+      std::map<uint32_t, std::vector<uint32_t>> cores;
+      for (auto cpu : node.cpu_list) {
+        cores[cpu_core_id(cpu)].push_back(cpu);
+      }
+      auto &n = nodes.emplace_back();
+      for (auto &[id, threads] : cores) {
+        n.push_back(threads);
+      }
+    }
+  }
+
+  /// Cpus for `nprod` producers and `ncons` consumers, or nullopt if the
+  /// machine has no room for them.
+  std::optional<Cpus> place(Placement where, uint32_t nprod,
+                            uint32_t ncons) const {
+    Cpus cpus;
+    switch (where) {
+      case Placement::SameCore:
+        // producer i shares a core with consumer i
+        if (nprod != ncons) return std::nullopt;
+        for (const auto &node : nodes) {
+          for (const auto &core : node) {
+            if (cpus.prod.size() == nprod) return cpus;
+            if (core.size() < 2) continue;
+            cpus.prod.push_back(core[0]);
+            cpus.cons.push_back(core[1]);
+          }
+        }
+        if (cpus.prod.size() == nprod) return cpus;
+        return std::nullopt;
+
+      case Placement::SameSocket:
+        for (const auto &node : nodes) {
+          if (node.size() < nprod + ncons) continue;
+          for (auto i = 0u; i < nprod; i++) cpus.prod.push_back(node[i][0]);
+          for (auto i = 0u; i < ncons; i++) {
+            cpus.cons.push_back(node[nprod + i][0]);
+          }
+          return cpus;
+        }
+        return std::nullopt;
+
+      case Placement::CrossSocket:
+        if (nodes.size() < 2 || nodes[0].size() < nprod ||
+            nodes[1].size() < ncons) {
+          return std::nullopt;
+        }
+        for (auto i = 0u; i < nprod; i++) cpus.prod.push_back(nodes[0][i][0]);
+        for (auto i = 0u; i < ncons; i++) cpus.cons.push_back(nodes[1][i][0]);
+        return cpus;
+    }
+    return std::nullopt;
+  }
+
+ private:
+  std::vector<std::vector<std::vector<uint32_t>>> nodes;
+};
+
+void pin(std::thread &t, uint32_t cpu) {
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu, &cpuset);
+  pthread_setaffinity_np(t.native_handle(), sizeof(cpu_set_t), &cpuset);
+}
+
+struct Result {
+  uint64_t section_size = 0;
+  LatencyHistogram latencies;
+  double mmsgs_per_sec = 0;
+  uint64_t num_parks = 0;
+};
+
+void report(const char *bench, Placement where, size_t num_sections,
+            Result &r) {
+  printf("%-10s %-12s sections %-3zu x %-6" PRIu64, bench,
+         placement_names[static_cast<int>(where)], num_sections,
+         r.section_size);
+  if (r.mmsgs_per_sec) printf(" %9.2f Mmsg/s", r.mmsgs_per_sec);
+  const auto &lat = r.latencies;
+  printf(" | p50 %u p99 %u p999 %u max %u cycles (%" PRIu64 " samples)",
+         lat.percentile(0.5), lat.percentile(0.99), lat.percentile(0.999),
+         lat.max(), lat.count());
+  if (r.num_parks) printf(" | %" PRIu64 " parks", r.num_parks);
+  printf("\n");
+}
+
+std::unique_ptr<collector_type> make_collector() {
+  auto collector = std::make_unique<collector_type>();
+  collector->claim();
+  return collector;
+}
+
+/// One message bounces between two threads. Consumers only see whole
+/// sections, so each message is flushed with padding.
+Result pingpong(const Cpus &cpus, uint32_t round_trips) {
+  SectionQueue there(1, 1, 2, cpus.prod, cpus.cons);
+  SectionQueue back(1, 1, 2, cpus.cons, cpus.prod);
+  auto send = [](SectionQueue &q, uint64_t key) {
+    auto pq = &q.all_pqueues[0][0];
+    q.enqueue(pq, 0, 0, data_t(key, 0));
+    q.flush(pq, 0, 0, [] {});
+  };
+  auto receive = [](SectionQueue &q) {
+    auto cq = &q.all_cqueues[0][0];
+    while (q.dequeue_bulk(cq, 0, 0, MAX_PER_SECTION).empty()) _mm_pause();
+  };
+
+  auto lat = make_collector();
+  std::barrier start(2);
+  std::thread ping([&] {
+    start.arrive_and_wait();
+    for (auto i = 1u; i <= round_trips; i++) {
+      const auto t = lat->sync_start();
+      send(there, i);
+      receive(back);
+      lat->sync_end(t);
+    }
+  });
+  std::thread pong([&] {
+    start.arrive_and_wait();
+    for (auto i = 1u; i <= round_trips; i++) {
+      receive(there);
+      send(back, i);
+    }
+  });
+  pin(ping, cpus.prod[0]);
+  pin(pong, cpus.cons[0]);
+  ping.join();
+  pong.join();
+
+  Result r;
+  r.section_size = there.pair_layout(0, 0).section_size;
+  r.latencies = lat->histogram();
+  return r;
+}
+
+/// Every producer sends `messages` to every consumer, interleaved. The first
+/// message of a section carries its enqueue time as the key.
+Result stream(const Cpus &cpus, size_t num_sections, uint64_t messages,
+              QueueWait wait, uint64_t spin_cycles) {
+  const uint32_t nprod = cpus.prod.size();
+  const uint32_t ncons = cpus.cons.size();
+  // whole sections only, so that nothing is left unpublished
+  messages =
+      (messages + MAX_PER_SECTION - 1) / MAX_PER_SECTION * MAX_PER_SECTION;
+
+  SectionQueue queue(nprod, ncons, num_sections, cpus.prod, cpus.cons);
+  queue.set_wait(wait, spin_cycles);
+  std::vector<std::unique_ptr<collector_type>> lats;
+  for (auto c = 0u; c < ncons; c++) lats.push_back(make_collector());
+  std::barrier start(nprod + ncons + 1);
+  std::vector<std::thread> threads;
+
+  for (auto p = 0u; p < nprod; p++) {
+    threads.emplace_back([&, p] {
+      std::vector<uint64_t> per_section(ncons);
+      for (auto c = 0u; c < ncons; c++) {
+        per_section[c] = queue.pair_layout(p, c).section_size / sizeof(data_t);
+      }
+      start.arrive_and_wait();
+      for (uint64_t k = 0; k < messages; k++) {
+        for (auto c = 0u; c < ncons; c++) {
+          const uint64_t key =
+              (k % per_section[c]) == 0 ? lats[c]->sync_start() : k + 1;
+          queue.enqueue(&queue.all_pqueues[p][c], p, c, data_t(key, k));
+        }
+      }
+    });
+    pin(threads.back(), cpus.prod[p]);
+  }
+
+  std::atomic_uint64_t checksum{};
+  for (auto c = 0u; c < ncons; c++) {
+    threads.emplace_back([&, c] {
+      std::vector<uint64_t> received(nprod);
+      uint64_t sum = 0;
+      uint32_t done = 0;
+      uint64_t active = (1ull << nprod) - 1;
+      uint64_t idle_since = 0;
+      start.arrive_and_wait();
+      while (done < nprod) {
+        bool got = false;
+        for (auto p = 0u; p < nprod; p++) {
+          if (received[p] == messages) continue;
+          const auto cq = &queue.all_cqueues[c][p];
+          const auto run = queue.dequeue_bulk(cq, p, c, MAX_PER_SECTION);
+          if (run.empty()) continue;
+          got = true;
+          if (((uint64_t)run.data() & cq->section_mask) == 0) {
+            lats[c]->sync_end(run[0].key);
+          }
+          for (const auto &kv : run) sum += kv.key;
+          received[p] += run.size();
+          if (received[p] == messages) {
+            active &= ~(1ull << p);
+            done++;
+          }
+        }
+        if (got) {
+          idle_since = 0;
+        } else {
+          queue.consumer_idle(c, active, &idle_since);
+        }
+      }
+      checksum += sum;
+    });
+    pin(threads.back(), cpus.cons[c]);
+  }
+
+  start.arrive_and_wait();
+  const auto t_start = std::chrono::steady_clock::now();
+  for (auto &t : threads) t.join();
+  const std::chrono::duration<double> secs =
+      std::chrono::steady_clock::now() - t_start;
+
+  Result r;
+  r.section_size = queue.pair_layout(0, 0).section_size;
+  r.mmsgs_per_sec = nprod * ncons * messages / secs.count() / 1e6;
+  for (auto &lat : lats) r.latencies.add(lat->histogram());
+  for (auto c = 0u; c < ncons; c++) r.num_parks += queue.num_parks(c);
+  return r;
+}
+
+int run() {
+  std::vector<size_t> depths;
+  for (const auto &s : absl::GetFlag(FLAGS_num_sections)) {
+    const auto n = std::stoul(s);
+    if (n < 2 || (n & (n - 1))) {
+      fprintf(stderr, "--num_sections: %s is not a power of 2 above 1\n",
+              s.c_str());
+      return 1;
+    }
+    depths.push_back(n);
+  }
+  const auto nprod = absl::GetFlag(FLAGS_producers);
+  const auto ncons = absl::GetFlag(FLAGS_consumers);
+  const auto messages = absl::GetFlag(FLAGS_messages);
+  const auto round_trips = absl::GetFlag(FLAGS_round_trips);
+  const auto spin_cycles = absl::GetFlag(FLAGS_spin_cycles);
+  QueueWait wait;
+  if (!parse_queue_wait(absl::GetFlag(FLAGS_queue_wait), &wait)) {
+    fprintf(stderr, "--queue_wait: must be spin or park\n");
+    return 1;
+  }
+
+  Topology topo;
+  auto skipped = [](const char *bench, Placement where) {
+    printf("%-10s %-12s skipped: not enough cpus\n", bench,
+           placement_names[static_cast<int>(where)]);
+  };
+
+  for (auto where : placements) {
+    const auto cpus = topo.place(where, 1, 1);
+    if (!cpus) {
+      skipped("pingpong", where);
+      continue;
+    }
+    auto r = pingpong(*cpus, round_trips);
+    report("pingpong", where, 2, r);
+  }
+
+  for (auto where : placements) {
+    const auto cpus = topo.place(where, 1, 1);
+    if (!cpus) {
+      skipped("throughput", where);
+      continue;
+    }
+    for (auto n : depths) {
+      auto r = stream(*cpus, n, messages, wait, spin_cycles);
+      report("throughput", where, n, r);
+    }
+  }
+
+  for (auto where : placements) {
+    const auto cpus = topo.place(where, nprod, ncons);
+    if (!cpus) {
+      skipped("nxm", where);
+      continue;
+    }
+    for (auto n : depths) {
+      auto r = stream(*cpus, n, messages / (nprod * ncons), wait, spin_cycles);
+      report("nxm", where, n, r);
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace kmercounter
+
+int main(int argc, char **argv) {
+  absl::ParseCommandLine(argc, argv);
+  return kmercounter::run();
+}
@@ -25,6 +25,7 @@ class Application {
   int process(int argc, char **argv);
   int spawn_shard_threads_bqueues();
   int spawn_shard_threads();
+  void run_queue_test(bool is_join);
   void shard_thread(int tid, std::barrier<std::function<void()>>* barrier);
 
   Application() {
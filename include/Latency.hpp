@@ -5,8 +5,11 @@
 #include <plog/Log.h>
 #include <x86intrin.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <fstream>
@@ -15,6 +18,7 @@
 #include <numeric>
 #include <sstream>
 #include <thread>
+#include <vector>
 
 #include "misc_lib.h"
 #include "queues/section_queues.hpp"
@@ -24,6 +28,116 @@
 namespace kmercounter {
 using timer_type = std::uint32_t;
 
+/// Log-linear (HDR-style) histogram of cycle counts. Values below
+/// `sub_count` get a bucket each; above, every power of two is split into
+/// `sub_count / 2` buckets, so a reported value is at most 1/32 above the
+/// recorded one. Its size does not depend on how many values are recorded.
+class LatencyHistogram {
+ public:
+  static constexpr unsigned sub_bits = 6;
+  static constexpr std::uint64_t sub_count = 1ull << sub_bits;
+  static constexpr std::uint64_t half_count = sub_count / 2;
+  static constexpr std::size_t num_buckets =
+      sub_count + (8 * sizeof(timer_type) - sub_bits) * half_count;
+
+  static constexpr std::size_t bucket_of(std::uint64_t value) {
+    if (value < sub_count) return value;
+    const unsigned shift = 63 - __builtin_clzll(value) - (sub_bits - 1);
+    return sub_count + (shift - 1) * half_count + (value >> shift) - half_count;
+  }
+
+  /// The largest value that falls into `bucket`.
+  static constexpr std::uint64_t highest_in(std::size_t bucket) {
+    if (bucket < sub_count) return bucket;
+    const auto i = bucket - sub_count;
+    const auto shift = i / half_count + 1;
+    return ((i % half_count + half_count + 1) << shift) - 1;
+  }
+
+  void record(timer_type value) {
+    ++counts[bucket_of(value)];
+    ++total;
+    max_value = std::max(max_value, value);
+  }
+
+  void add(const LatencyHistogram& other) {
+    for (auto i = 0u; i < num_buckets; ++i) counts[i] += other.counts[i];
+    total += other.total;
+    max_value = std::max(max_value, other.max_value);
+  }
+
+  /// The `q`-quantile (0 < q <= 1), rounded up to the end of its bucket.
+  timer_type percentile(double q) const {
+    if (!total) return 0;
+    const auto rank = std::max<std::uint64_t>(1, std::ceil(q * total));
+    std::uint64_t seen = 0;
+    for (auto i = 0u; i < num_buckets; ++i) {
+      seen += counts[i];
+      if (seen >= rank) {
+        return std::min<std::uint64_t>(highest_in(i), max_value);
+      }
+    }
+    return max_value;
+  }
+
+  std::uint64_t count() const { return total; }
+  timer_type max() const { return max_value; }
+
+ private:
+  friend class SharedLatencyHistogram;
+
+  std::array<std::uint64_t, num_buckets> counts{};
+  std::uint64_t total{};
+  timer_type max_value{};
+};
+
+/// What a collector measured, for the run summary.
+enum class LatencyOp { Insert, Find, Enqueue, Mixed, Count };
+
+constexpr const char* latency_op_names[] = {"insert", "find", "enqueue",
+                                            "mixed"};
+
+/// The histograms of all threads for one kind of operation. Threads merge
+/// into it as they finish, without taking a lock.
+class SharedLatencyHistogram {
+ public:
+  void merge(const LatencyHistogram& h) {
+    for (auto i = 0u; i < LatencyHistogram::num_buckets; ++i) {
+      if (h.counts[i]) {
+        counts[i].fetch_add(h.counts[i], std::memory_order_relaxed);
+      }
+    }
+    total.fetch_add(h.total, std::memory_order_relaxed);
+    auto max = max_value.load(std::memory_order_relaxed);
+    while (max < h.max_value &&
+           !max_value.compare_exchange_weak(max, h.max_value,
+                                            std::memory_order_relaxed))
+      ;
+  }
+
+  LatencyHistogram snapshot() const {
+    LatencyHistogram h;
+    for (auto i = 0u; i < LatencyHistogram::num_buckets; ++i) {
+      h.counts[i] = counts[i].load(std::memory_order_relaxed);
+    }
+    h.total = total.load(std::memory_order_relaxed);
+    h.max_value = max_value.load(std::memory_order_relaxed);
+    return h;
+  }
+
+ private:
+  std::array<std::atomic_uint64_t, LatencyHistogram::num_buckets> counts{};
+  std::atomic_uint64_t total{};
+  std::atomic<timer_type> max_value{};
+};
+
+extern std::array<SharedLatencyHistogram,
+                  static_cast<std::size_t>(LatencyOp::Count)>
+    latency_totals;
+
+/// Log p50/p90/p99/p99.9/max of every kind of operation that was measured.
+void print_latency_summary();
+
 template <std::size_t capacity>
 class alignas(64) LatencyCollector {
   static constexpr auto sentinel = std::numeric_limits<std::uint32_t>::max();
@@ -84,18 +198,11 @@ class alignas(64) LatencyCollector {
     push(time <= max_time ? static_cast<timer_type>(time) : max_time);
   }
 
-  void dump(const char* name, unsigned int id) {
-    if (next_log_entry) {
-      std::stringstream stream{};
-      stream << "./latencies/" << name << '_' << id << ".dat";
-      std::ofstream stats{stream.str().c_str()};
-      stats.exceptions(stats.badbit | stats.failbit);
-      for (auto i = 0u; i <= next_log_entry && i < log.size(); ++i) {
-        const auto length = i < next_log_entry ? log.front().size() : next_slot;
-        for (auto j = 0u; j < length; ++j)
-          stats << static_cast<unsigned int>(log[i][j]) << "\n";
-      }
-    }
+  const LatencyHistogram& histogram() const { return hist; }
+
+  /// Merge what this thread measured into the run summary.
+  void publish(LatencyOp op) {
+    latency_totals[static_cast<std::size_t>(op)].merge(hist);
   }
 
  private:
@@ -107,9 +214,7 @@ class alignas(64) LatencyCollector {
   std::array<std::uint64_t, capacity> timers{};
   std::array<std::uint64_t, capacity / 64> bitmap{};
 
-  std::array<std::array<timer_type, 64 / sizeof(timer_type)>, 4096> log{};
-  std::uint8_t next_slot{};
-  std::uint64_t next_log_entry{};
+  LatencyHistogram hist{};
 
   std::shared_ptr<std::mutex> claim_lock{std::make_shared<std::mutex>()};
 
@@ -161,16 +266,7 @@ class alignas(64) LatencyCollector {
     return skipped * 64 + rightmost_zero;
   }
 
-  void push(timer_type time) {
-    if (next_slot == log.front().size()) {
-      if (next_log_entry == log.size() - 1) return;
-
-      next_slot = 0;
-      ++next_log_entry;
-    }
-
-    log[next_log_entry][next_slot++] = time;
-  }
+  void push(timer_type time) { hist.record(time); }
 };
 
 constexpr auto pool_size = 2048;
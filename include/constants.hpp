@@ -4,6 +4,9 @@
 #include <cstdint>
 
 namespace kmercounter {
+// Defaults of the prefetch engine knobs; all of them can be changed at
+// runtime (--ins-flush-threshold, --find-flush-threshold, --pf-queue-len,
+// --pf-find-queue-len) or picked by the tuner (--pf-tune).
 constexpr int FLUSH_THRESHOLD = 32;
 constexpr int INS_FLUSH_THRESHOLD = 32;
 constexpr int KV_SIZE = 16;  // 8-byte key + 8-byte value
@@ -11,14 +14,56 @@ constexpr int KV_SIZE = 16;  // 8-byte key + 8-byte value
 constexpr uint32_t PREFETCH_QUEUE_SIZE = 64;
 constexpr uint32_t PREFETCH_FIND_QUEUE_SIZE = 64;
 
-#if defined(DIRECT_INDEX)
-constexpr uint32_t HT_TESTS_BATCH_LENGTH = 256;
-constexpr uint32_t HT_TESTS_FIND_BATCH_LENGTH = 256;
-#else
+// prefetch depth tuner: smallest depth tried, batches timed per depth and
+// number of passes over all depths
+constexpr uint32_t PREFETCH_TUNE_MIN_DEPTH = 8;
+constexpr uint32_t PREFETCH_TUNE_WINDOW = 64;
+constexpr uint32_t PREFETCH_TUNE_ROUNDS = 2;
+
+// skew-aware bqueue routing (--hot-replicas): 1 in HOT_KEY_SAMPLE_RATE keys
+// is sampled into a sketch of HOT_KEY_COUNTERS counters, which is turned into
+// at most HOT_KEY_SLOTS hot keys every HOT_KEY_REFRESH samples
+constexpr uint32_t HOT_KEY_SAMPLE_RATE = 16;
+constexpr uint32_t HOT_KEY_COUNTERS = 32;
+constexpr uint32_t HOT_KEY_SLOTS = 64;
+constexpr uint32_t HOT_KEY_REFRESH = 4096;
+constexpr uint32_t HOT_KEY_SHARE_DIV = 2;
+// slots of a consumer's table of partial counts of split keys; the keys come
+// from the producers' sketches, so a few times HOT_KEY_COUNTERS is plenty
+constexpr uint32_t HOT_PARTIAL_SLOTS = 4 * HOT_KEY_COUNTERS;
+
+// --elastic-owners: how often the owners' load is checked
+constexpr uint32_t ELASTIC_SCALE_PERIOD_US = 1000;
+// --queue-finds: a producer looks up the key it inserted this many inserts
+// earlier, while the later ones are still in flight
+constexpr uint32_t QUEUED_FIND_LAG = 256;
+
 constexpr uint32_t HT_TESTS_BATCH_LENGTH = 16;
 constexpr uint32_t HT_TESTS_FIND_BATCH_LENGTH = 16;
-#endif
+// default --batch-len with --hasher direct_index
+constexpr uint32_t DIRECT_INDEX_BATCH_LENGTH = 256;
+// upper bound of --batch-len; sizes the HTBatchRunner buffers
+constexpr uint32_t HT_TESTS_MAX_BATCH_LENGTH = 256;
 constexpr uint32_t HT_TESTS_MAX_STRIDE = 2;
+// keys of a batch are hashed in chunks of this many before being queued
+constexpr uint32_t HASH_BATCH_LENGTH = 16;
+// messages a bqueue producer stages per consumer before a bulk enqueue
+constexpr uint32_t BQ_BULK_RUN = 16;
+// --queue-wait park: default idle time of a consumer before it sleeps, and the
+// length of one back-off while it spins (both in TSC cycles)
+constexpr uint64_t QUEUE_SPIN_CYCLES = 100'000;
+constexpr uint64_t QUEUE_RELAX_CYCLES = 500;
+// --calibrate-bw: memory measured on every node, far beyond any LLC
+constexpr size_t MEMORY_CALIBRATION_BYTES = 512ull << 20;
+// CACHE_MISS: most independent chains of a cpu on its MLP curve
+constexpr uint32_t MLP_CALIBRATION_MAX_STREAMS = 64;
+// PREFETCH sweep: prefetch queue lengths tried, each with every distance that
+// fits
+constexpr uint32_t PREFETCH_SWEEP_QUEUE_LENS[] = {32, 64, 128, 256, 512};
+// --trace-file: phases each thread keeps, the last ones if it has more
+constexpr uint64_t TRACE_RING_EVENTS = 1 << 16;
+// PROBE_STATS: probe lengths counted one by one, longer ones in the last
+constexpr uint32_t PROBE_HISTOGRAM_BUCKETS = 64;
 } // namespace kmercounter
 
 #endif /* CONSTANTS_HPP */
@@ -2,6 +2,7 @@
 #define _HASHER_HPP
 
 #include <cstdint>
+#include <type_traits>
 #include <x86intrin.h>
 
 #include "fnv/fnv.h"
@@ -10,51 +11,246 @@
 #include "cityhash/src/city.h"
 #include "cityhash/src/citycrc.h"
 
+#include "fastrange.h"
+#include "hashtables/simd_helpers.hpp"
+#include "types.hpp"
+
 
 namespace kmercounter {
 
-#if (KEY_LEN == 4)
-using key_type = std::uint32_t;
-#elif (KEY_LEN == 8)
-using key_type = std::uint64_t;
-#endif
+extern Configuration config;
 
-class Hasher {
-public:
+// murmur3 fmix64 finalizer; cheap enough to be computed 8 keys at a time
+inline uint64_t mulxor_hash(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
 
-  uint64_t operator()(const void* buff, uint64_t len) {
-    uint64_t hash_val;
-#if defined(CITY_HASH)
+template <HasherType type>
+inline uint64_t hash_key(const void *buff, uint64_t len) {
+  uint64_t hash_val = 0;
+  if constexpr (type == HasherType::city) {
     hash_val = CityHash64((const char *)buff, len);
-#elif defined(FNV_HASH)
-    hash_val = state_ = fnv_64_buf(buff, len, state_);
-#elif defined(XX_HASH)
+  } else if constexpr (type == HasherType::fnv) {
+    hash_val = fnv_64_buf(const_cast<void *>(buff), len, FNV1_64_INIT);
+  } else if constexpr (type == HasherType::xxhash) {
     hash_val = XXH64(buff, len, 0);
-#elif defined(XX_HASH_3)
+  } else if constexpr (type == HasherType::xxhash3) {
     hash_val = XXH3_64bits(buff, len);
-#elif defined(CRC_HASH)
-    assert(len == sizeof(std::uint64_t));
+  } else if constexpr (type == HasherType::crc) {
     if (len == sizeof(std::uint32_t)) {
       hash_val = _mm_crc32_u32(0xffffffff, *static_cast<const std::uint32_t *>(buff));
     } else if (len == sizeof(std::uint64_t)) {
       hash_val = _mm_crc32_u64(0xffffffff, *static_cast<const std::uint64_t *>(buff));
     }
-#elif defined(CITY_CRC_HASH)
-    hash_val = CityHashCrc128((const char *)buff, len);
-#elif defined(WYHASH)
+  } else if constexpr (type == HasherType::citycrc) {
+    hash_val = Uint128Low64(CityHashCrc128((const char *)buff, len));
+  } else if constexpr (type == HasherType::wyhash) {
     hash_val = wyhash((const char *)buff, len, 0, _wyp);
-#elif defined(DIRECT_INDEX)
+  } else if constexpr (type == HasherType::direct_index) {
     hash_val = *((key_type*) buff);
-#else
-    static_assert(false, "Hasher is not specified.");
+  } else if constexpr (type == HasherType::mulxor) {
+    hash_val = mulxor_hash(*((key_type*) buff));
+  }
+  return hash_val;
+}
+
+#ifdef AVX_SUPPORT
+/// mulxor over 8 keys at a time. `args` is any array of structs with a 64-bit
+/// `key` member. Returns the number of hashes computed (a multiple of 8).
+template <typename Arg>
+SIMD_TARGET_AVX512 size_t mulxor_batch_avx512(const Arg *args, size_t n,
+                                              uint64_t *hashes) {
+  static_assert(sizeof(args->key) == sizeof(uint64_t));
+  const __m512i offsets =
+      _mm512_mullo_epi64(_mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0),
+                         _mm512_set1_epi64(sizeof(Arg)));
+  const __m512i m1 = _mm512_set1_epi64(0xff51afd7ed558ccdULL);
+  const __m512i m2 = _mm512_set1_epi64(0xc4ceb9fe1a85ec53ULL);
+
+  // The zero-masked forms of the intrinsics: the plain ones start from an
+  // undefined vector, which gcc warns about
+  const __m512i zero = _mm512_setzero_si512();
+  const __mmask8 all = 0xff;
+
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m512i k =
+        _mm512_mask_i64gather_epi64(zero, all, offsets, &args[i].key, 1);
+    k = _mm512_xor_si512(k, _mm512_maskz_srli_epi64(all, k, 33));
+    k = _mm512_mullo_epi64(k, m1);
+    k = _mm512_xor_si512(k, _mm512_maskz_srli_epi64(all, k, 33));
+    k = _mm512_mullo_epi64(k, m2);
+    k = _mm512_xor_si512(k, _mm512_maskz_srli_epi64(all, k, 33));
+    _mm512_storeu_si512(&hashes[i], k);
+  }
+  return i;
+}
+
+/// fastrange32 over 8 hashes at a time. Returns the number of indices computed.
+SIMD_TARGET_AVX512 inline size_t fastrange32_batch_avx512(
+    const uint64_t *hashes, size_t n, uint32_t p, uint32_t *idxs) {
+  const __m512i range = _mm512_set1_epi64(p);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    // _mm512_mul_epu32 only looks at the low 32 bits of every lane
+    // zero-masked, as in mulxor_batch_avx512
+    __m512i h = _mm512_loadu_si512(&hashes[i]);
+    __m512i idx = _mm512_maskz_srli_epi64(
+        0xff, _mm512_maskz_mul_epu32(0xff, h, range), 32);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(&idxs[i]),
+                        _mm512_maskz_cvtepi64_epi32(0xff, idx));
+  }
+  return i;
+}
+
+/// Low 64 bits of `a * b` for every lane; AVX2 only multiplies 32-bit halves.
+/// `b_hi` holds the upper halves of `b`.
+SIMD_TARGET_AVX2 inline __m256i mullo_epi64_avx2(__m256i a, __m256i b,
+                                                 __m256i b_hi) {
+  const __m256i lo = _mm256_mul_epu32(a, b);
+  const __m256i cross = _mm256_add_epi64(
+      _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), _mm256_mul_epu32(a, b_hi));
+  return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+/// mulxor over 4 keys at a time, for hosts without AVX-512. Returns the
+/// number of hashes computed (a multiple of 4).
+template <typename Arg>
+SIMD_TARGET_AVX2 size_t mulxor_batch_avx2(const Arg *args, size_t n,
+                                          uint64_t *hashes) {
+  static_assert(sizeof(args->key) == sizeof(uint64_t));
+  const __m256i m1 = _mm256_set1_epi64x(0xff51afd7ed558ccdULL);
+  const __m256i m1_hi = _mm256_srli_epi64(m1, 32);
+  const __m256i m2 = _mm256_set1_epi64x(0xc4ceb9fe1a85ec53ULL);
+  const __m256i m2_hi = _mm256_srli_epi64(m2, 32);
+
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    // four scalar loads beat a gather on AVX2 hosts
+    __m256i k = _mm256_set_epi64x(args[i + 3].key, args[i + 2].key,
+                                  args[i + 1].key, args[i].key);
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+    k = mullo_epi64_avx2(k, m1, m1_hi);
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+    k = mullo_epi64_avx2(k, m2, m2_hi);
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(&hashes[i]), k);
+  }
+  return i;
+}
+
+/// fastrange32 over 4 hashes at a time. Returns the number of indices computed.
+SIMD_TARGET_AVX2 inline size_t fastrange32_batch_avx2(const uint64_t *hashes,
+                                                      size_t n, uint32_t p,
+                                                      uint32_t *idxs) {
+  const __m256i range = _mm256_set1_epi64x(p);
+  // the low halves of the four 64-bit lanes
+  const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256i h =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&hashes[i]));
+    const __m256i idx = _mm256_srli_epi64(_mm256_mul_epu32(h, range), 32);
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(&idxs[i]),
+        _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(idx, pack)));
+  }
+  return i;
+}
 #endif
-    return hash_val;
+
+/// Hash the keys of `n` arguments in one pass.
+template <HasherType type, typename Arg>
+inline void hash_batch_kernel(const Arg *args, size_t n, uint64_t *hashes) {
+  size_t i = 0;
+#ifdef AVX_SUPPORT
+  if constexpr (type == HasherType::mulxor && sizeof(key_type) == 8) {
+    if (simd_kind == SIMDKIND::Avx512) {
+      i = mulxor_batch_avx512(args, n, hashes);
+    } else if (simd_kind == SIMDKIND::Avx2) {
+      i = mulxor_batch_avx2(args, n, hashes);
+    }
   }
+#endif
+  for (; i < n; i++) {
+    hashes[i] = hash_key<type>(&args[i].key, sizeof(args[i].key));
+  }
+}
 
-private:
-#if defined(FNV_HASH)
-  uint64_t state_ = FNV1_64_INIT;
+/// `fastrange32(hashes[i], p)` for a batch of hashes.
+inline void fastrange32_batch(const uint64_t *hashes, size_t n, uint32_t p,
+                              uint32_t *idxs) {
+  size_t i = 0;
+#ifdef AVX_SUPPORT
+  if (simd_kind == SIMDKIND::Avx512) {
+    i = fastrange32_batch_avx512(hashes, n, p, idxs);
+  } else if (simd_kind == SIMDKIND::Avx2) {
+    i = fastrange32_batch_avx2(hashes, n, p, idxs);
+  }
 #endif
+  for (; i < n; i++) {
+    idxs[i] = fastrange32(hashes[i], p);
+  }
+}
+
+/// The hash function is picked at runtime (--hasher). Single keys pay a
+/// (well predicted) switch per call; batch callers should use `hash_batch`,
+/// which dispatches once per batch.
+class Hasher {
+public:
+  Hasher() : type_(config.hasher) {}
+  explicit Hasher(HasherType type) : type_(type) {}
+
+  /// Call `f` with the hasher type as a `std::integral_constant`, so that `f`
+  /// can instantiate a kernel for it.
+  template <typename F>
+  decltype(auto) dispatch(F &&f) const {
+    switch (type_) {
+      case HasherType::city:
+        return f(std::integral_constant<HasherType, HasherType::city>{});
+      case HasherType::xxhash:
+        return f(std::integral_constant<HasherType, HasherType::xxhash>{});
+      case HasherType::wyhash:
+        return f(std::integral_constant<HasherType, HasherType::wyhash>{});
+      case HasherType::citycrc:
+        return f(std::integral_constant<HasherType, HasherType::citycrc>{});
+      case HasherType::xxhash3:
+        return f(std::integral_constant<HasherType, HasherType::xxhash3>{});
+      case HasherType::fnv:
+        return f(std::integral_constant<HasherType, HasherType::fnv>{});
+      case HasherType::direct_index:
+        return f(
+            std::integral_constant<HasherType, HasherType::direct_index>{});
+      case HasherType::mulxor:
+        return f(std::integral_constant<HasherType, HasherType::mulxor>{});
+      case HasherType::crc:
+      default:
+        return f(std::integral_constant<HasherType, HasherType::crc>{});
+    }
+  }
+
+  uint64_t operator()(const void* buff, uint64_t len) const {
+    return dispatch([buff, len](auto type) {
+      return hash_key<decltype(type)::value>(buff, len);
+    });
+  }
+
+  template <typename Arg>
+  void hash_batch(const Arg *args, size_t n, uint64_t *hashes) const {
+    dispatch([args, n, hashes](auto type) {
+      hash_batch_kernel<decltype(type)::value>(args, n, hashes);
+    });
+  }
+
+  HasherType type() const { return type_; }
+
+private:
+  HasherType type_;
 };
 
 } // namespace kmercounter
@@ -42,7 +42,15 @@ class ArrayHashTable : public BaseHashTable {
   const static uint64_t KEYS_IN_CACHELINE_MASK = (CACHELINE_SIZE / sizeof(KV)) - 1;
 
   ArrayHashTable(uint64_t c)
-      : fd(-1), id(1), find_head(0), find_tail(0), ins_head(0), ins_tail(0) {
+      : fd(-1),
+        id(1),
+        find_head(0),
+        find_tail(0),
+        ins_head(0),
+        ins_tail(0),
+        ins_queue_sz(config.pf_queue_len),
+        find_queue_sz(config.pf_find_queue_len),
+        pf_write(config.pf_write) {
     this->capacity = kmercounter::utils::next_pow2(c);
     {
       const std::lock_guard<std::mutex> lock(ht_init_mutex);
@@ -58,9 +66,9 @@ class ArrayHashTable : public BaseHashTable {
 
     PLOGV << "Empty item: " << this->empty_item;
     this->insert_queue =
-        (KVQ *)(aligned_alloc(64, PREFETCH_QUEUE_SIZE * sizeof(KVQ)));
+        (KVQ *)(aligned_alloc(64, this->ins_queue_sz * sizeof(KVQ)));
     this->find_queue =
-        (KVQ *)(aligned_alloc(64, PREFETCH_FIND_QUEUE_SIZE * sizeof(KVQ)));
+        (KVQ *)(aligned_alloc(64, this->find_queue_sz * sizeof(KVQ)));
 
     PLOGV.printf("[INFO] Hashtable size: %lu\n", this->capacity);
     PLOGV.printf("%s, data_length %lu\n", __func__, this->data_length);
@@ -96,8 +104,17 @@ class ArrayHashTable : public BaseHashTable {
     if (curr->is_empty()) {
       PLOGV.printf("inserting key %llu at idx %llu", elem->key, idx);
       bool cas_res = curr->insert(elem);
+#ifdef CALC_STATS
+      this->num_insert_misses++;
+#endif
+#ifdef PROBE_STATS
+      record_probes(ProbeOutcome::InsertMiss, idx);
+#endif
     } else {
       curr->update(elem);
+#ifdef PROBE_STATS
+      record_probes(ProbeOutcome::InsertHit, idx);
+#endif
     }
 
 #ifdef LATENCY_COLLECTION
@@ -136,30 +153,30 @@ class ArrayHashTable : public BaseHashTable {
 
   void flush_find_queue(ValuePairs &vp, collector_type* collector) override {
     size_t curr_queue_sz =
-        (this->find_head - this->find_tail) & (PREFETCH_FIND_QUEUE_SIZE - 1);
+        (this->find_head - this->find_tail) & (this->find_queue_sz - 1);
 
-    while ((curr_queue_sz != 0) && (vp.first < HT_TESTS_BATCH_LENGTH)) {
+    while ((curr_queue_sz != 0) && (vp.first < config.batch_len)) {
       __find_one(&this->find_queue[this->find_tail], vp, collector);
-      if (++this->find_tail >= PREFETCH_FIND_QUEUE_SIZE) this->find_tail = 0;
+      if (++this->find_tail >= this->find_queue_sz) this->find_tail = 0;
       curr_queue_sz =
-          (this->find_head - this->find_tail) & (PREFETCH_FIND_QUEUE_SIZE - 1);
+          (this->find_head - this->find_tail) & (this->find_queue_sz - 1);
     }
   }
 
   void flush_if_needed(ValuePairs &vp, collector_type* collector) {
     size_t curr_queue_sz =
-        (this->find_head - this->find_tail) & (PREFETCH_FIND_QUEUE_SIZE - 1);
+        (this->find_head - this->find_tail) & (this->find_queue_sz - 1);
     // make sure you return at most batch_sz (but can possibly return lesser
     // number of elements)
-    while ((curr_queue_sz > FLUSH_THRESHOLD) &&
-           (vp.first < HT_TESTS_FIND_BATCH_LENGTH)) {
+    while ((curr_queue_sz > config.find_flush_threshold) &&
+           (vp.first < config.batch_len)) {
       // cout << "Finding value for key " <<
       // this->find_queue[this->find_tail].key << " at tail : " <<
       // this->find_tail << endl;
       __find_one(&this->find_queue[this->find_tail], vp, collector);
-      if (++this->find_tail >= PREFETCH_FIND_QUEUE_SIZE) this->find_tail = 0;
+      if (++this->find_tail >= this->find_queue_sz) this->find_tail = 0;
       curr_queue_sz =
-          (this->find_head - this->find_tail) & (PREFETCH_FIND_QUEUE_SIZE - 1);
+          (this->find_head - this->find_tail) & (this->find_queue_sz - 1);
     }
     return;
   }
@@ -235,6 +252,9 @@ class ArrayHashTable : public BaseHashTable {
 #ifdef LATENCY_COLLECTION
     collector->sync_end(timer_start);
 #endif
+#ifdef PROBE_STATS
+    record_probes(found ? ProbeOutcome::FindHit : ProbeOutcome::FindMiss, idx);
+#endif
 
 
     // return empty_element if nothing is found
@@ -303,18 +323,35 @@ class ArrayHashTable : public BaseHashTable {
   uint32_t find_tail;
   uint32_t ins_head;
   uint32_t ins_tail;
+  // ring sizes of the prefetch queues (powers of two)
+  uint32_t ins_queue_sz;
+  uint32_t find_queue_sz;
+  // prefetch the slots of inserts for write, or for read
+  bool pf_write;
   Hasher hasher_;
 
   uint64_t hash(const void *k) {
     return hasher_(k, this->key_length);
   }
 
+#ifdef PROBE_STATS
+  /// Count an op on slot `idx`; keys have a slot of their own, so nothing
+  /// is ever reprobed.
+  void record_probes(ProbeOutcome outcome, size_t idx) {
+    this->probe_histograms.record_home(idx, this->capacity);
+    this->probe_histograms.record(outcome, 0);
+  }
+#endif
+
   void prefetch(uint64_t i) {
 #if defined(PREFETCH_WITH_PREFETCH_INSTR)
+    if (!this->pf_write) {
+      this->prefetch_read(i);
+      return;
+    }
     prefetch_object<true /* write */>(
         &this->hashtable[i & (this->capacity - 1)],
         sizeof(this->hashtable[i & (this->capacity - 1)]));
-    // true /*write*/);
 #endif
 
 #if defined(PREFETCH_WITH_WRITE)
@@ -340,6 +377,9 @@ class ArrayHashTable : public BaseHashTable {
 #ifdef LATENCY_COLLECTION
     collector->end(q->timer_id);
 #endif
+#ifdef PROBE_STATS
+    record_probes(found ? ProbeOutcome::FindHit : ProbeOutcome::FindMiss, idx);
+#endif
 
     return found;
   }
@@ -386,6 +426,12 @@ class ArrayHashTable : public BaseHashTable {
 #ifdef LATENCY_COLLECTION
         collector->end(q->timer_id);
 #endif
+#ifdef CALC_STATS
+        this->num_insert_misses++;
+#endif
+#ifdef PROBE_STATS
+        record_probes(ProbeOutcome::InsertMiss, idx);
+#endif
 
         return;
       }
@@ -415,6 +461,9 @@ class ArrayHashTable : public BaseHashTable {
 
 #ifdef LATENCY_COLLECTION
       collector->end(q->timer_id);
+#endif
+#ifdef PROBE_STATS
+      record_probes(ProbeOutcome::InsertHit, idx);
 #endif
     }
 
@@ -478,7 +527,7 @@ class ArrayHashTable : public BaseHashTable {
 #endif
 
     this->ins_head++;
-    if (this->ins_head >= PREFETCH_QUEUE_SIZE) this->ins_head = 0;
+    if (this->ins_head >= this->ins_queue_sz) this->ins_head = 0;
   }
 
   void add_to_find_queue(void *data, collector_type* collector) {
@@ -513,7 +562,7 @@ class ArrayHashTable : public BaseHashTable {
 #endif
 
     this->find_head++;
-    if (this->find_head >= PREFETCH_FIND_QUEUE_SIZE) this->find_head = 0;
+    if (this->find_head >= this->find_queue_sz) this->find_head = 0;
   }
 };
 
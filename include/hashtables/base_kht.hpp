@@ -3,9 +3,13 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <array>
+#include <span>
 #include <string>
 
 #include "Latency.hpp"
+#include "constants.hpp"
 #include "types.hpp"
 
 using namespace std;
@@ -18,6 +22,24 @@ class BaseHashTable {
   // Your inserts will be ignored if you do (we use these as empty markers)
   virtual void insert_batch(const InsertFindArguments &kp, collector_type* collector = nullptr) = 0;
 
+  /// Insert `(key, value)` pairs as they come out of a queue, with the key as
+  /// id. Pairs with key 0 (queue padding) are skipped. Tables that can read
+  /// the pairs in place override this to avoid the copy below.
+  virtual void insert_kv_batch(std::span<const KeyValuePair> kvs,
+                               collector_type* collector = nullptr) {
+    std::array<InsertFindArgument, HASH_BATCH_LENGTH> args;
+    size_t n = 0;
+    for (const auto &kv : kvs) {
+      if (kv.key == 0) continue;
+      args[n++] = {kv.key, kv.value, static_cast<uint32_t>(kv.key)};
+      if (n == args.size()) {
+        insert_batch(InsertFindArguments(args.data(), n), collector);
+        n = 0;
+      }
+    }
+    if (n) insert_batch(InsertFindArguments(args.data(), n), collector);
+  }
+
   virtual void insert_noprefetch(const void *data, collector_type* collector = nullptr) = 0;
 
   virtual void flush_insert_queue(collector_type* collector = nullptr) = 0;
@@ -47,6 +69,8 @@ class BaseHashTable {
   virtual ~BaseHashTable() {}
 
   uint64_t num_reprobes = 0;
+  // inserts that put a new key into an empty slot
+  uint64_t num_insert_misses = 0;
   uint64_t num_soft_reprobes = 0;
   uint64_t num_memcmps = 0;
   uint64_t num_memcpys = 0;
@@ -55,6 +79,9 @@ class BaseHashTable {
   uint64_t sum_distance_from_bucket = 0;
   uint64_t max_distance_from_bucket = 0;
   uint64_t num_swaps = 0;
+#ifdef PROBE_STATS
+  ProbeHistograms probe_histograms;
+#endif
 };
 
 }  // namespace kmercounter
@@ -3,6 +3,8 @@
 
 #include <plog/Log.h>
 
+#include <algorithm>
+#include <cassert>
 #include <functional>
 #include <span>
 
@@ -11,18 +13,24 @@
 #include "types.hpp"
 
 namespace kmercounter {
-template <size_t N = HT_TESTS_BATCH_LENGTH>
+/// `N` is the capacity of the buffers; the batch length can be picked at
+/// runtime up to that.
+template <size_t N = HT_TESTS_MAX_BATCH_LENGTH>
 class HTBatchFinder {
  public:
   using FindCallback = std::function<void(const FindResult&)>;
 
   HTBatchFinder() : HTBatchFinder(nullptr) {}
   HTBatchFinder(BaseHashTable* ht) : HTBatchFinder(ht, nullptr) {}
-  HTBatchFinder(BaseHashTable* ht, FindCallback callback_fn)
+  HTBatchFinder(BaseHashTable* ht, FindCallback callback_fn,
+                size_t batch_len = N)
       : ht_(ht),
         buffer_size_(0),
+        batch_len_(std::min(batch_len, N)),
         results_(0, result_buffer_),
-        callback_fn_(callback_fn) {}
+        callback_fn_(callback_fn) {
+    assert(batch_len_ > 0);
+  }
   ~HTBatchFinder() {
     if (ht_ != nullptr) {
       flush();
@@ -41,7 +49,7 @@ class HTBatchFinder {
     buffer_size_++;
 
     // Flush if `buffer_` is full.
-    if (buffer_size_ >= N) {
+    if (buffer_size_ >= batch_len_) {
       flush_buffer();
     }
   }
@@ -61,6 +69,9 @@ class HTBatchFinder {
   // Returns the number of elements flushed.
   size_t num_flushed() { return num_flushed_; }
 
+  // Number of elements handed to the hashtable at once.
+  size_t batch_len() const { return batch_len_; }
+
   // Set the callback function.
   void set_callback(FindCallback callback_fn) { callback_fn_ = callback_fn; }
 
@@ -95,6 +106,8 @@ class HTBatchFinder {
   __attribute__((aligned(64))) InsertFindArgument buffer_[N] = {};
   // Current size of the buffer.
   size_t buffer_size_ = 0;
+  // Flush the buffer when it holds this many elements.
+  size_t batch_len_ = N;
   // Total number of elements flushed.
   size_t num_flushed_ = 0;
   // The buffer for storing the results.
@@ -1,16 +1,27 @@
 #ifndef HASHTABLES_BATCH_INSERTER_HPP
 #define HASHTABLES_BATCH_INSERTER_HPP
 
+#include <algorithm>
+#include <cassert>
+
 #include "constants.hpp"
 #include "hashtables/base_kht.hpp"
 #include "types.hpp"
 
 namespace kmercounter {
-template <size_t N = HT_TESTS_BATCH_LENGTH>
+/// `N` is the capacity of the buffer; the batch length can be picked at
+/// runtime up to that.
+template <size_t N = HT_TESTS_MAX_BATCH_LENGTH>
 class HTBatchInserter {
  public:
   HTBatchInserter() : HTBatchInserter(nullptr) {}
-  HTBatchInserter(BaseHashTable* ht) : ht_(ht), buffer_(), buffer_size_(0) {}
+  HTBatchInserter(BaseHashTable* ht, size_t batch_len = N)
+      : ht_(ht),
+        buffer_(),
+        buffer_size_(0),
+        batch_len_(std::min(batch_len, N)) {
+    assert(batch_len_ > 0);
+  }
   ~HTBatchInserter() { flush(); }
 
   // Insert one kv pair.
@@ -21,7 +32,7 @@ class HTBatchInserter {
     buffer_size_++;
 
     // Flush if `buffer_` is full.
-    if (buffer_size_ >= N) {
+    if (buffer_size_ >= batch_len_) {
       flush_buffer();
     }
   }
@@ -41,6 +52,9 @@ class HTBatchInserter {
   // Returns the number of elements flushed.
   size_t num_flushed() { return num_flushed_; }
 
+  // Number of elements handed to the hashtable at once.
+  size_t batch_len() const { return batch_len_; }
+
  private:
   // Flush the insertion buffer without checking `buffer_size_`.
   void flush_buffer() {
@@ -58,6 +72,8 @@ class HTBatchInserter {
   __attribute__((aligned(64))) InsertFindArgument buffer_[N] = {};
   // Current size of the buffer.
   size_t buffer_size_ = 0;
+  // Flush the buffer when it holds this many elements.
+  size_t batch_len_ = N;
   // Total number of elements flushed.
   size_t num_flushed_ = 0;
 
@@ -7,8 +7,9 @@
 
 namespace kmercounter {
 extern Configuration config;
-/// A wrapper around `HTBatchInserter` and `HTBatchFinder`.
-template <size_t N = HT_TESTS_BATCH_LENGTH>
+/// A wrapper around `HTBatchInserter` and `HTBatchFinder`. Both flush every
+/// `config.batch_len` elements (at most `N`).
+template <size_t N = HT_TESTS_MAX_BATCH_LENGTH>
 class HTBatchRunner : public HTBatchInserter<N>, public HTBatchFinder<N> {
  public:
   using FindCallback = HTBatchFinder<N>::FindCallback;
@@ -16,7 +17,8 @@ class HTBatchRunner : public HTBatchInserter<N>, public HTBatchFinder<N> {
   HTBatchRunner() : HTBatchRunner(nullptr) {}
   HTBatchRunner(BaseHashTable* ht) : HTBatchRunner(ht, nullptr) {}
   HTBatchRunner(BaseHashTable* ht, FindCallback find_callback)
-      : HTBatchInserter<N>(ht), HTBatchFinder<N>(ht, find_callback) {}
+      : HTBatchInserter<N>(ht, config.batch_len),
+        HTBatchFinder<N>(ht, find_callback, config.batch_len) {}
   ~HTBatchRunner() { flush(); }
 
   /// Insert one kv pair.
@@ -11,6 +11,7 @@
 #ifndef HASHTABLES_CAS_KHT_HPP
 #define HASHTABLES_CAS_KHT_HPP
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <iostream>
@@ -21,11 +22,15 @@
 #include "plog/Log.h"
 #include "helper.hpp"
 #include "ht_helper.hpp"
+#include "prefetch_tuner.hpp"
+#include "simd_helpers.hpp"
 #include "sync.h"
 #include "hasher.hpp"
 
 namespace kmercounter {
-template <typename KV, typename KVQ>
+/// `branching` picks the probe kernels; every kind is instantiated so that
+/// it can be selected at runtime (see init_ht).
+template <typename KV, typename KVQ, BRANCHKIND branching = default_branching>
 class CASHashTable : public BaseHashTable {
  public:
   /// The global instance is shared by all threads.
@@ -42,7 +47,19 @@ class CASHashTable : public BaseHashTable {
   const static uint64_t KEYS_IN_CACHELINE_MASK = (CACHELINE_SIZE / sizeof(KV)) - 1;
 
   CASHashTable(uint64_t c)
-      : fd(-1), id(1), find_head(0), find_tail(0), ins_head(0), ins_tail(0) {
+      : fd(-1),
+        id(1),
+        find_head(0),
+        find_tail(0),
+        ins_head(0),
+        ins_tail(0),
+        ins_queue_sz(config.pf_queue_len),
+        find_queue_sz(config.pf_find_queue_len),
+        pf_write(config.pf_write),
+        ins_tuner("insert", this->id, config.ins_flush_threshold,
+                  this->ins_queue_sz, config.batch_len, config.pf_tune),
+        find_tuner("find", this->id, config.find_flush_threshold,
+                   this->find_queue_sz, config.batch_len, config.pf_tune) {
     this->capacity = kmercounter::utils::next_pow2(c);
     {
       const std::lock_guard<std::mutex> lock(ht_init_mutex);
@@ -59,9 +76,9 @@ class CASHashTable : public BaseHashTable {
 
     PLOGV << "Empty item: " << this->empty_item;
     this->insert_queue =
-        (KVQ *)(aligned_alloc(64, PREFETCH_QUEUE_SIZE * sizeof(KVQ)));
+        (KVQ *)(aligned_alloc(64, this->ins_queue_sz * sizeof(KVQ)));
     this->find_queue =
-        (KVQ *)(aligned_alloc(64, PREFETCH_FIND_QUEUE_SIZE * sizeof(KVQ)));
+        (KVQ *)(aligned_alloc(64, this->find_queue_sz * sizeof(KVQ)));
 
     PLOGV.printf("%s, data_length %lu\n", __func__, this->data_length);
   }
@@ -92,6 +109,9 @@ class CASHashTable : public BaseHashTable {
     //size_t idx = fastrange32(hash, this->capacity);  // modulo
 
     KVQ *elem = const_cast<KVQ *>(reinterpret_cast<const KVQ *>(data));
+#ifdef PROBE_STATS
+    const size_t home = idx;
+#endif
 
     for (auto i = 0u; i < this->capacity; i++) {
       KV *curr = &this->hashtable[idx];
@@ -99,12 +119,21 @@ class CASHashTable : public BaseHashTable {
       if (curr->is_empty()) {
         bool cas_res = curr->insert_cas(elem);
         if (cas_res) {
+#ifdef CALC_STATS
+          this->num_insert_misses++;
+#endif
+#ifdef PROBE_STATS
+          record_probes(ProbeOutcome::InsertMiss, home, idx);
+#endif
           break;
         } else {
           goto retry;
         }
       } else if (curr->compare_key(data)) {
         curr->update_cas(elem);
+#ifdef PROBE_STATS
+        record_probes(ProbeOutcome::InsertHit, home, idx);
+#endif
         break;
       } else {
         idx++;
@@ -127,64 +156,87 @@ class CASHashTable : public BaseHashTable {
   void insert_batch(const InsertFindArguments &kp, collector_type* collector) override {
     this->flush_if_needed(collector);
 
-    for (auto &data : kp) {
-      add_to_insert_queue(&data, collector);
+    for (size_t i = 0; i < kp.size(); i += HASH_BATCH_LENGTH) {
+      const size_t n = std::min<size_t>(HASH_BATCH_LENGTH, kp.size() - i);
+      this->hasher_.hash_batch(&kp[i], n, this->batch_hashes);
+      for (size_t j = 0; j < n; j++) {
+        add_to_insert_queue(&kp[i + j], this->batch_hashes[j], collector);
+      }
     }
 
     this->flush_if_needed(collector);
+    this->ins_tuner.record(kp.size());
+  }
+
+  // insert queued pairs in place; the ring is drained before every chunk, so
+  // `kvs` may be longer than the prefetch queue
+  void insert_kv_batch(std::span<const KeyValuePair> kvs,
+                       collector_type *collector) override {
+    for (size_t i = 0; i < kvs.size(); i += HASH_BATCH_LENGTH) {
+      this->flush_if_needed(collector);
+      const size_t n = std::min<size_t>(HASH_BATCH_LENGTH, kvs.size() - i);
+      this->hasher_.hash_batch(&kvs[i], n, this->batch_hashes);
+      for (size_t j = 0; j < n; j++) {
+        if (kvs[i + j].key == 0) continue;
+        add_to_insert_queue(&kvs[i + j], this->batch_hashes[j], collector);
+      }
+    }
+
+    this->flush_if_needed(collector);
+    this->ins_tuner.record(kvs.size());
   }
 
   // overridden function for insertion
   void flush_if_needed(collector_type* collector) {
     size_t curr_queue_sz =
-        (this->ins_head - this->ins_tail) & (PREFETCH_QUEUE_SIZE - 1);
-    while (curr_queue_sz >= INS_FLUSH_THRESHOLD) {
+        (this->ins_head - this->ins_tail) & (this->ins_queue_sz - 1);
+    while (curr_queue_sz >= this->ins_tuner.depth()) {
       __insert_one(&this->insert_queue[this->ins_tail], collector);
-      if (++this->ins_tail >= PREFETCH_QUEUE_SIZE) this->ins_tail = 0;
+      if (++this->ins_tail >= this->ins_queue_sz) this->ins_tail = 0;
       curr_queue_sz =
-          (this->ins_head - this->ins_tail) & (PREFETCH_QUEUE_SIZE - 1);
+          (this->ins_head - this->ins_tail) & (this->ins_queue_sz - 1);
     }
     return;
   }
 
   void flush_insert_queue(collector_type* collector) override {
     size_t curr_queue_sz =
-        (this->ins_head - this->ins_tail) & (PREFETCH_QUEUE_SIZE - 1);
+        (this->ins_head - this->ins_tail) & (this->ins_queue_sz - 1);
 
     while (curr_queue_sz != 0) {
       __insert_one(&this->insert_queue[this->ins_tail], collector);
-      if (++this->ins_tail >= PREFETCH_QUEUE_SIZE) this->ins_tail = 0;
+      if (++this->ins_tail >= this->ins_queue_sz) this->ins_tail = 0;
       curr_queue_sz =
-          (this->ins_head - this->ins_tail) & (PREFETCH_QUEUE_SIZE - 1);
+          (this->ins_head - this->ins_tail) & (this->ins_queue_sz - 1);
     }
   }
 
   void flush_find_queue(ValuePairs &vp, collector_type* collector) override {
     size_t curr_queue_sz =
-        (this->find_head - this->find_tail) & (PREFETCH_FIND_QUEUE_SIZE - 1);
+        (this->find_head - this->find_tail) & (this->find_queue_sz - 1);
 
     while ((curr_queue_sz != 0) && (vp.first < config.batch_len)) {
       __find_one(&this->find_queue[this->find_tail], vp, collector);
-      if (++this->find_tail >= PREFETCH_FIND_QUEUE_SIZE) this->find_tail = 0;
+      if (++this->find_tail >= this->find_queue_sz) this->find_tail = 0;
       curr_queue_sz =
-          (this->find_head - this->find_tail) & (PREFETCH_FIND_QUEUE_SIZE - 1);
+          (this->find_head - this->find_tail) & (this->find_queue_sz - 1);
     }
   }
 
   void flush_if_needed(ValuePairs &vp, collector_type* collector) {
     size_t curr_queue_sz =
-        (this->find_head - this->find_tail) & (PREFETCH_FIND_QUEUE_SIZE - 1);
+        (this->find_head - this->find_tail) & (this->find_queue_sz - 1);
     // make sure you return at most batch_sz (but can possibly return lesser
     // number of elements)
-    while ((curr_queue_sz > FLUSH_THRESHOLD) &&
+    while ((curr_queue_sz > this->find_tuner.depth()) &&
            (vp.first < config.batch_len)) {
       // cout << "Finding value for key " <<
       // this->find_queue[this->find_tail].key << " at tail : " <<
       // this->find_tail << endl;
       __find_one(&this->find_queue[this->find_tail], vp, collector);
-      if (++this->find_tail >= PREFETCH_FIND_QUEUE_SIZE) this->find_tail = 0;
+      if (++this->find_tail >= this->find_queue_sz) this->find_tail = 0;
       curr_queue_sz =
-          (this->find_head - this->find_tail) & (PREFETCH_FIND_QUEUE_SIZE - 1);
+          (this->find_head - this->find_tail) & (this->find_queue_sz - 1);
     }
     return;
   }
@@ -192,11 +244,16 @@ class CASHashTable : public BaseHashTable {
   void find_batch(const InsertFindArguments &kp, ValuePairs &values, collector_type* collector) override {
     this->flush_if_needed(values, collector);
 
-    for (auto &data : kp) {
-      add_to_find_queue(&data, collector);
+    for (size_t i = 0; i < kp.size(); i += HASH_BATCH_LENGTH) {
+      const size_t n = std::min<size_t>(HASH_BATCH_LENGTH, kp.size() - i);
+      this->hasher_.hash_batch(&kp[i], n, this->batch_hashes);
+      for (size_t j = 0; j < n; j++) {
+        add_to_find_queue(&kp[i + j], this->batch_hashes[j], collector);
+      }
     }
 
     this->flush_if_needed(values, collector);
+    this->find_tuner.record(kp.size());
   }
 
   void *find_noprefetch(const void *data, collector_type* collector) override {
@@ -242,6 +299,10 @@ class CASHashTable : public BaseHashTable {
 #ifdef LATENCY_COLLECTION
     collector->sync_end(timer_start);
 #endif
+#ifdef PROBE_STATS
+    record_probes(found ? ProbeOutcome::FindHit : ProbeOutcome::FindMiss,
+                  hash & (this->capacity - 1), idx);
+#endif
 
 
     // return empty_element if nothing is found
@@ -310,18 +371,41 @@ class CASHashTable : public BaseHashTable {
   uint32_t find_tail;
   uint32_t ins_head;
   uint32_t ins_tail;
+  // ring sizes of the prefetch queues (powers of two)
+  uint32_t ins_queue_sz;
+  uint32_t find_queue_sz;
+  // prefetch the slots of inserts for write, or for read
+  bool pf_write;
+  // flush thresholds of the prefetch queues, fixed or tuned during warmup
+  PrefetchTuner ins_tuner;
+  PrefetchTuner find_tuner;
   Hasher hasher_;
+  // hashes of the current chunk of a batch
+  alignas(64) uint64_t batch_hashes[HASH_BATCH_LENGTH];
 
   uint64_t hash(const void *k) {
     return hasher_(k, this->key_length);
   }
 
+#ifdef PROBE_STATS
+  /// Count an op that went slot by slot from `home` to `idx`.
+  void record_probes(ProbeOutcome outcome, size_t home, size_t idx) {
+    this->probe_histograms.record_home(home, this->capacity);
+    this->probe_histograms.record(
+        outcome, ProbeHistograms::probe_length(home, idx, this->capacity,
+                                               KEYS_IN_CACHELINE_MASK + 1));
+  }
+#endif
+
   void prefetch(uint64_t i) {
 #if defined(PREFETCH_WITH_PREFETCH_INSTR)
+    if (!this->pf_write) {
+      this->prefetch_read(i);
+      return;
+    }
     prefetch_object<true /* write */>(
         &this->hashtable[i & (this->capacity - 1)],
         sizeof(this->hashtable[i & (this->capacity - 1)]));
-    // true /*write*/);
 #endif
 
 #if defined(PREFETCH_WITH_WRITE)
@@ -368,25 +452,104 @@ class CASHashTable : public BaseHashTable {
 #ifdef LATENCY_COLLECTION
       this->find_queue[this->find_head].timer_id = q->timer_id;
 #endif
+#ifdef PROBE_STATS
+      this->find_queue[this->find_head].probes = q->probes + 1;
+#endif
 
       this->find_head += 1;
-      this->find_head &= (PREFETCH_FIND_QUEUE_SIZE - 1);
+      this->find_head &= (this->find_queue_sz - 1);
 #ifdef CALC_STATS
       this->sum_distance_from_bucket++;
 #endif
     } else {
 #ifdef LATENCY_COLLECTION
         collector->end(q->timer_id);
+#endif
+#ifdef PROBE_STATS
+      this->probe_histograms.record(
+          found ? ProbeOutcome::FindHit : ProbeOutcome::FindMiss, q->probes);
 #endif
     }
 
     return found;
   }
 
+#ifdef AVX_SUPPORT
+  /// Probe all the (relevant) slots of the prefetched cacheline at once.
+  /// Same semantics as `__find_branched`: a match anywhere in the line is a
+  /// hit, an empty slot without a match is a miss, otherwise the next
+  /// cacheline is prefetched and the request goes back into the queue.
+  template <SIMDKIND kind>
+  uint64_t __find_branchless_simd(KVQ *q, ValuePairs &vp,
+                                  collector_type *collector) {
+    static_assert(sizeof(KV) == KV_SIZE);
+
+    // hashtable idx at which data is to be found
+    size_t idx = q->idx;
+    // index within the cacheline
+    const size_t cidx = idx & KEYS_IN_CACHELINE_MASK;
+    // pointer to current cacheline
+    KV *cptr = &this->hashtable[idx & ~KEYS_IN_CACHELINE_MASK];
+
+    const auto [eq_cmp, empty_cmp] = cacheline_cmp<kind>(cptr, q->key, cidx);
+
+    if (eq_cmp) {
+      vp.second[vp.first].value = cptr[first_kv_idx(eq_cmp)].get_value();
+      vp.second[vp.first].id = q->key_id;
+      vp.first++;
+    }
+
+    if (!(eq_cmp | empty_cmp)) {
+      // index at which reprobe must begin
+      idx = (idx - cidx + KV_PER_CACHE_LINE) & (this->capacity - 1);
+
+      this->prefetch_read(idx);
+
+      this->find_queue[this->find_head].key = q->key;
+      this->find_queue[this->find_head].key_id = q->key_id;
+      this->find_queue[this->find_head].idx = idx;
+#ifdef LATENCY_COLLECTION
+      this->find_queue[this->find_head].timer_id = q->timer_id;
+#endif
+#ifdef PROBE_STATS
+      this->find_queue[this->find_head].probes = q->probes + 1;
+#endif
+
+      this->find_head += 1;
+      this->find_head &= (this->find_queue_sz - 1);
+#ifdef CALC_STATS
+      this->sum_distance_from_bucket++;
+#endif
+    } else {
+#ifdef LATENCY_COLLECTION
+      collector->end(q->timer_id);
+#endif
+#ifdef PROBE_STATS
+      this->probe_histograms.record(
+          eq_cmp ? ProbeOutcome::FindHit : ProbeOutcome::FindMiss, q->probes);
+#endif
+    }
+
+    return eq_cmp != 0;
+  }
+#endif
+
   auto __find_one(KVQ *q, ValuePairs &vp, collector_type* collector) { 
     if (q->key == this->empty_item.get_key()) {
       __find_empty(q, vp);
     } else {
+#ifdef AVX_SUPPORT
+      if constexpr (branching == BRANCHKIND::NoBranch_Simd &&
+                    sizeof(KV) == KV_SIZE) {
+        if (simd_kind == SIMDKIND::Avx512) {
+          __find_branchless_simd<SIMDKIND::Avx512>(q, vp, collector);
+          return;
+        } else if (simd_kind == SIMDKIND::Avx2) {
+          __find_branchless_simd<SIMDKIND::Avx2>(q, vp, collector);
+          return;
+        }
+      }
+#endif
       __find_branched(q, vp, collector);
     }
   }
@@ -416,6 +579,7 @@ class CASHashTable : public BaseHashTable {
       if (cas_res) {
 #ifdef CALC_STATS
         this->num_memcpys++;
+        this->num_insert_misses++;
 #endif
 
 #ifdef COMPARE_HASH
@@ -425,6 +589,9 @@ class CASHashTable : public BaseHashTable {
 #ifdef LATENCY_COLLECTION
         collector->end(q->timer_id);
 #endif
+#ifdef PROBE_STATS
+        this->probe_histograms.record(ProbeOutcome::InsertMiss, q->probes);
+#endif
 
         return;
       }
@@ -455,6 +622,9 @@ class CASHashTable : public BaseHashTable {
 
 #ifdef LATENCY_COLLECTION
         collector->end(q->timer_id);
+#endif
+#ifdef PROBE_STATS
+        this->probe_histograms.record(ProbeOutcome::InsertHit, q->probes);
 #endif
         return;
       }
@@ -487,9 +657,12 @@ class CASHashTable : public BaseHashTable {
 #ifdef LATENCY_COLLECTION
     this->insert_queue[this->ins_head].timer_id = q->timer_id;
 #endif
+#ifdef PROBE_STATS
+    this->insert_queue[this->ins_head].probes = q->probes + 1;
+#endif
 
     ++this->ins_head;
-    this->ins_head &= (PREFETCH_QUEUE_SIZE - 1);
+    this->ins_head &= (this->ins_queue_sz - 1);
 
 #ifdef CALC_STATS
     this->num_reprobes++;
@@ -497,10 +670,98 @@ class CASHashTable : public BaseHashTable {
     return;
   }
 
+#ifdef AVX_SUPPORT
+  /// Compare the key against all the (relevant) slots of the prefetched
+  /// cacheline at once. On a match the count is updated in place, otherwise
+  /// the key is CAS'ed into the first empty slot. A lost CAS re-reads the line
+  /// as the winner may have inserted the same key.
+  template <SIMDKIND kind>
+  void __insert_branchless_simd(KVQ *q, collector_type *collector) {
+    static_assert(sizeof(KV) == KV_SIZE);
+
+    // hashtable idx at which data is to be inserted
+    size_t idx = q->idx;
+    // index within the cacheline
+    const size_t cidx = idx & KEYS_IN_CACHELINE_MASK;
+    // pointer to current cacheline
+    KV *cptr = &this->hashtable[idx & ~KEYS_IN_CACHELINE_MASK];
+
+    while (true) {
+      const auto [eq_cmp, empty_cmp] = cacheline_cmp<kind>(cptr, q->key, cidx);
+#ifdef CALC_STATS
+      this->num_hashcmps++;
+#endif
+
+      if (eq_cmp) {
+        cptr[first_kv_idx(eq_cmp)].update_cas(q);
+#ifdef PROBE_STATS
+        this->probe_histograms.record(ProbeOutcome::InsertHit, q->probes);
+#endif
+        break;
+      }
+
+      if (!empty_cmp) {
+        // no match and no free slot in this cacheline; reprobe the next one
+        idx = (idx - cidx + KV_PER_CACHE_LINE) & (this->capacity - 1);
+
+        prefetch(idx);
+
+        this->insert_queue[this->ins_head].key = q->key;
+        this->insert_queue[this->ins_head].key_id = q->key_id;
+        this->insert_queue[this->ins_head].value = q->value;
+        this->insert_queue[this->ins_head].idx = idx;
+#ifdef LATENCY_COLLECTION
+        this->insert_queue[this->ins_head].timer_id = q->timer_id;
+#endif
+#ifdef PROBE_STATS
+        this->insert_queue[this->ins_head].probes = q->probes + 1;
+#endif
+
+        ++this->ins_head;
+        this->ins_head &= (this->ins_queue_sz - 1);
+#ifdef CALC_STATS
+        this->num_reprobes++;
+#endif
+        return;
+      }
+
+      if (cptr[first_kv_idx(empty_cmp)].insert_cas(q)) {
+#ifdef CALC_STATS
+        this->num_memcpys++;
+        this->num_insert_misses++;
+#endif
+#ifdef PROBE_STATS
+        this->probe_histograms.record(ProbeOutcome::InsertMiss, q->probes);
+#endif
+        break;
+      }
+#ifdef CALC_STATS
+      ++this->num_soft_reprobes;
+#endif
+    }
+
+#ifdef LATENCY_COLLECTION
+    collector->end(q->timer_id);
+#endif
+  }
+#endif
+
   void __insert_one(KVQ *q, collector_type* collector) {
     if (q->key == this->empty_item.get_key()) {
       __insert_empty(q);
     } else {
+#ifdef AVX_SUPPORT
+      if constexpr (branching == BRANCHKIND::NoBranch_Simd &&
+                    sizeof(KV) == KV_SIZE) {
+        if (simd_kind == SIMDKIND::Avx512) {
+          __insert_branchless_simd<SIMDKIND::Avx512>(q, collector);
+          return;
+        } else if (simd_kind == SIMDKIND::Avx2) {
+          __insert_branchless_simd<SIMDKIND::Avx2>(q, collector);
+          return;
+        }
+      }
+#endif
       __insert_branched(q, collector);
     }
   }
@@ -523,14 +784,13 @@ class CASHashTable : public BaseHashTable {
     return -1;
   }
 
-  void add_to_insert_queue(void *data, collector_type* collector) {
-    InsertFindArgument *key_data = reinterpret_cast<InsertFindArgument *>(data);
-
+  template <typename Arg>
+  void add_to_insert_queue(const Arg *key_data, uint64_t hash,
+                           collector_type* collector) {
 #ifdef LATENCY_COLLECTION
     const auto timer = collector->start();
 #endif
 
-    uint64_t hash = this->hash((const char *)&key_data->key);
     // Since we use fastrange for partitioned HT, use it
     // for this HT too for a fair comparison
     //size_t idx = fastrange32(hash, this->capacity);  // modulo
@@ -542,28 +802,30 @@ class CASHashTable : public BaseHashTable {
     this->insert_queue[this->ins_head].idx = idx;
     this->insert_queue[this->ins_head].key = key_data->key;
     this->insert_queue[this->ins_head].value = key_data->value;
-    this->insert_queue[this->ins_head].key_id = key_data->id;
+    this->insert_queue[this->ins_head].key_id = insert_id(*key_data);
 
 #ifdef LATENCY_COLLECTION
     this->insert_queue[this->ins_head].timer_id = timer;
 #endif
+#ifdef PROBE_STATS
+    this->insert_queue[this->ins_head].probes = 0;
+    this->probe_histograms.record_home(idx, this->capacity);
+#endif
 
 #ifdef COMPARE_HASH
     this->insert_queue[this->ins_head].key_hash = hash;
 #endif
 
     this->ins_head++;
-    if (this->ins_head >= PREFETCH_QUEUE_SIZE) this->ins_head = 0;
+    if (this->ins_head >= this->ins_queue_sz) this->ins_head = 0;
   }
 
-  void add_to_find_queue(void *data, collector_type* collector) {
-    InsertFindArgument *key_data = reinterpret_cast<InsertFindArgument *>(data);
-
+  void add_to_find_queue(const InsertFindArgument *key_data, uint64_t hash,
+                         collector_type* collector) {
 #ifdef LATENCY_COLLECTION
     const auto timer = collector->start();
 #endif
 
-    uint64_t hash = this->hash((const char *)&key_data->key);
     // Since we use fastrange for partitioned HT, use it
     // for this HT too for a fair comparison
     //size_t idx = fastrange32(hash, this->capacity);  // modulo
@@ -581,30 +843,34 @@ class CASHashTable : public BaseHashTable {
 #ifdef LATENCY_COLLECTION
     this->find_queue[this->find_head].timer_id = timer;
 #endif
+#ifdef PROBE_STATS
+    this->find_queue[this->find_head].probes = 0;
+    this->probe_histograms.record_home(idx, this->capacity);
+#endif
 
 #ifdef COMPARE_HASH
     this->queue[this->find_head].key_hash = hash;
 #endif
 
     this->find_head++;
-    if (this->find_head >= PREFETCH_FIND_QUEUE_SIZE) this->find_head = 0;
+    if (this->find_head >= this->find_queue_sz) this->find_head = 0;
   }
 };
 
 /// Static variables
-template <class KV, class KVQ>
-KV *CASHashTable<KV, KVQ>::hashtable = nullptr;
+template <class KV, class KVQ, BRANCHKIND branching>
+KV *CASHashTable<KV, KVQ, branching>::hashtable = nullptr;
 
-template <class KV, class KVQ>
-uint64_t CASHashTable<KV, KVQ>::empty_slot_ = 0;
+template <class KV, class KVQ, BRANCHKIND branching>
+uint64_t CASHashTable<KV, KVQ, branching>::empty_slot_ = 0;
 
-template <class KV, class KVQ>
-bool CASHashTable<KV, KVQ>::empty_slot_exists_ = false;
+template <class KV, class KVQ, BRANCHKIND branching>
+bool CASHashTable<KV, KVQ, branching>::empty_slot_exists_ = false;
 
-template <class KV, class KVQ>
-std::mutex CASHashTable<KV, KVQ>::ht_init_mutex;
+template <class KV, class KVQ, BRANCHKIND branching>
+std::mutex CASHashTable<KV, KVQ, branching>::ht_init_mutex;
 
-template <class KV, class KVQ>
-uint32_t CASHashTable<KV, KVQ>::ref_cnt = 0;
+template <class KV, class KVQ, BRANCHKIND branching>
+uint32_t CASHashTable<KV, KVQ, branching>::ref_cnt = 0;
 }  // namespace kmercounter
 #endif // HASHTABLES_CAS_KHT_HPP
@@ -0,0 +1,722 @@
+/// Delegation-based hashtable service.
+///
+/// This packages the producer/consumer ("bqueue") pipeline of QueueTest as a
+/// library component. The keyspace is split into partitions, each owned by a
+/// dedicated owner thread that is the only one touching its hashtable. Any
+/// number of client threads submit inserts and finds through a `Client`:
+/// requests are routed to the owner of the key over a SectionQueue, the owner
+/// batches them into `insert_batch`/`find_batch`, and find results travel back
+/// over a reverse SectionQueue (owner -> client).
+///
+/// Requests of one client are applied in program order, so a find observes
+/// every earlier insert of the same client.
+///
+/// The service is elastic: there is one partition per owner thread, but only
+/// the first `n` owners of a `resize(n)` own partitions. A resize publishes a
+/// new routing table under the next epoch. Clients pick it up at their next
+/// call (a quiescent point for them): everything they queued before is routed
+/// by the old table, and an epoch marker to every owner separates the two.
+/// An owner that saw the markers of all clients applies what it holds and
+/// publishes the epoch; partitions change hands once every owner did.
+
+#ifndef HASHTABLES_DELEGATED_KHT_HPP
+#define HASHTABLES_DELEGATED_KHT_HPP
+
+#include <pthread.h>
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "fastrange.h"
+#include "hasher.hpp"
+#include "hashtables/base_kht.hpp"
+#include "plog/Log.h"
+#include "queues/section_queues.hpp"
+#include "sync.h"
+#include "types.hpp"
+
+namespace kmercounter {
+
+extern Configuration config;
+
+class DelegatedHashTable {
+ public:
+  /// Creates the hashtable of one partition. Called on the owner thread so
+  /// that the table is allocated on its node.
+  using TableFactory = std::function<BaseHashTable *(uint64_t size, uint32_t id)>;
+  /// Called for every key found by a find of the client.
+  using FindCallback = std::function<void(const FindResult &)>;
+
+  static_assert(std::is_same_v<data_t, KeyValuePair>,
+                "delegation needs key/value queue elements");
+
+  // Elements with key 0 are control messages: a value of 0 pads a section,
+  // the others switch the kind of request that follows on this client ->
+  // owner queue. In find mode the value of an element is the id of the find.
+  static constexpr uint64_t CTRL_INSERT_MODE = 1;
+  static constexpr uint64_t CTRL_FIND_MODE = 2;
+  // The client goes quiet (see Client::park)
+  static constexpr uint64_t CTRL_PARK = 3;
+  // Key 0 is a valid key of the tables: a request for it is sent as this
+  // marker followed by the request with its key replaced by ZERO_KEY_ALIAS.
+  // Nothing is flushed in between, so no padding can get between the two.
+  static constexpr uint64_t CTRL_ZERO_KEY = 4;
+  static constexpr uint64_t ZERO_KEY_ALIAS = 1;
+  // The client routes by the table of epoch `value & ~CTRL_EPOCH` from here on
+  static constexpr uint64_t CTRL_EPOCH = 1ull << 62;
+
+  // Replies: key = REPLY_TAG | found << 32 | id, value = value found
+  static constexpr uint64_t REPLY_TAG = 1ull << 63;
+  static constexpr uint64_t REPLY_FOUND = 1ull << 32;
+
+  /// Partition -> owner map of one epoch. Every routing stays alive until the
+  /// service is destroyed; `next` links them in epoch order.
+  struct Routing {
+    uint64_t epoch;
+    std::vector<uint32_t> owner;
+    std::atomic<const Routing *> next{nullptr};
+  };
+
+  /// The submission side of one application thread. A client must only be
+  /// used by one thread at a time, and must keep calling into the service
+  /// (`poll()` at least) while it has finds in flight: owners wait for room
+  /// in its reply queue.
+  class Client {
+   public:
+    /// Insert a kv pair; applied asynchronously by the owner of the key.
+    void insert(uint64_t key, uint64_t value) {
+      this->check_epoch();
+      const auto owner = this->route(key);
+      this->switch_mode(owner, CTRL_INSERT_MODE);
+      this->send_request(owner, key, value);
+    }
+
+    /// Look up `key`. If found, the find callback is called with `id` from a
+    /// later `poll()`, `flush()` or `drain()` of this client.
+    void find(uint64_t key, uint32_t id) {
+      this->check_epoch();
+      while (this->pending_finds >= this->dht->max_pending_finds) {
+        this->flush();
+        this->poll();
+        this->check_epoch();
+        _mm_pause();
+      }
+
+      const auto owner = this->route(key);
+      this->switch_mode(owner, CTRL_FIND_MODE);
+      this->send_request(owner, key, id);
+      this->pending_finds++;
+    }
+
+    void set_find_callback(FindCallback callback) {
+      this->find_callback = std::move(callback);
+    }
+
+    /// Deliver the find results that arrived so far. Returns the number of
+    /// finds that completed (found or not).
+    uint64_t poll() {
+      uint64_t completed = 0;
+      data_t reply;
+      for (auto o = 0u; o < this->dht->num_owners; o++) {
+        auto cq = &this->dht->replies->all_cqueues[this->id][o];
+        while (this->dht->replies->dequeue(cq, o, this->id, &reply) ==
+               SUCCESS) {
+          if (reply.key == 0) continue;  // padding
+          if ((reply.key & REPLY_FOUND) && this->find_callback) {
+            FindResult result;
+            result.id = static_cast<uint32_t>(reply.key);
+            result.value = reply.value;
+            this->find_callback(result);
+          }
+          completed++;
+        }
+      }
+      this->pending_finds -= completed;
+      return completed;
+    }
+
+    /// Hand every buffered request to the owners.
+    void flush() {
+      for (auto o = 0u; o < this->dht->num_owners; o++) {
+        this->dht->requests->flush(
+            &this->dht->requests->all_pqueues[this->id][o], this->id, o,
+            [this] { this->poll(); });
+      }
+    }
+
+    /// Flush and wait until every find of this client completed.
+    void drain() {
+      this->flush();
+      while (this->pending_finds > 0) {
+        this->poll();
+        // owners may be waiting for our marker to hand partitions over
+        this->check_epoch();
+        _mm_pause();
+      }
+    }
+
+    uint64_t num_pending_finds() const { return this->pending_finds; }
+
+    /// Tell the owners this client goes quiet. A resize waits for every
+    /// client to reach a quiescent point, i.e. to call in; parked clients
+    /// do not hold it back. The next insert or find unparks the client.
+    void park() {
+      if (this->parked) return;
+      for (auto o = 0u; o < this->dht->num_owners; o++) {
+        this->send(o, data_t(0, CTRL_PARK));
+      }
+      this->flush();
+      this->parked = true;
+    }
+
+   private:
+    friend class DelegatedHashTable;
+
+    uint32_t route(uint64_t key) const {
+      return this->routing->owner[this->dht->partition_of(key)];
+    }
+
+    /// Adopt the latest routing table, if there is a new one or we were
+    /// parked.
+    void check_epoch() {
+      const auto latest = this->dht->latest_routing.load(std::memory_order_acquire);
+      if (latest == this->routing && !this->parked) [[likely]] return;
+
+      // Everything queued so far was routed by the old table
+      for (auto o = 0u; o < this->dht->num_owners; o++) {
+        this->send(o, data_t(0, CTRL_EPOCH | latest->epoch));
+      }
+      this->flush();
+      this->routing = latest;
+      this->parked = false;
+    }
+
+    void switch_mode(uint32_t owner, uint64_t mode) {
+      if (this->mode[owner] != mode) {
+        this->send(owner, data_t(0, mode));
+        this->mode[owner] = mode;
+      }
+    }
+
+    void send_request(uint32_t owner, uint64_t key, uint64_t value) {
+      if (key == 0) [[unlikely]] {
+        this->send(owner, data_t(0, CTRL_ZERO_KEY));
+        key = ZERO_KEY_ALIAS;
+      }
+      this->send(owner, data_t(key, value));
+    }
+
+    void send(uint32_t owner, data_t msg) {
+      // replies are drained while waiting, otherwise an owner that waits on
+      // our reply queue could never free space in our request queue
+      this->dht->requests->enqueue(
+          &this->dht->requests->all_pqueues[this->id][owner], this->id, owner,
+          msg, [this] { this->poll(); });
+    }
+
+    DelegatedHashTable *dht = nullptr;
+    uint32_t id = 0;
+    uint64_t pending_finds = 0;
+    const Routing *routing = nullptr;
+    bool parked = false;
+    std::vector<uint64_t> mode;
+    FindCallback find_callback;
+  };
+
+  /// `client_cpus[c]` and `owner_cpus[o]` are the cpus client `c` is expected
+  /// to run on and owner `o` is pinned to; they decide where the queues are
+  /// placed. Every owner gets a table of `ht_size` buckets with id
+  /// `first_id + o`.
+  DelegatedHashTable(const std::vector<uint32_t> &client_cpus,
+                     const std::vector<uint32_t> &owner_cpus, uint64_t ht_size,
+                     TableFactory factory, uint32_t first_id = 0,
+                     uint64_t max_pending_finds = 1024,
+                     size_t num_sections = 4)
+      : DelegatedHashTable(client_cpus, owner_cpus, ht_size, std::move(factory),
+                           first_id, max_pending_finds, num_sections, true) {}
+
+  /// Serve existing tables: owner `o` takes over `tables[o]`, the partition
+  /// with id `first_id + o`. The tables stay owned by the caller.
+  DelegatedHashTable(const std::vector<uint32_t> &client_cpus,
+                     const std::vector<uint32_t> &owner_cpus,
+                     const std::vector<BaseHashTable *> &tables,
+                     uint32_t first_id = 0, uint64_t max_pending_finds = 1024,
+                     size_t num_sections = 4)
+      : DelegatedHashTable(
+            client_cpus, owner_cpus, 0,
+            [&tables, first_id](uint64_t, uint32_t id) {
+              return tables.at(id - first_id);
+            },
+            first_id, max_pending_finds, num_sections, false) {}
+
+  ~DelegatedHashTable() {
+    this->shutdown();
+    if (!this->owns_tables) return;
+    for (auto table : this->tables) {
+      delete table;
+    }
+  }
+
+  Client &client(uint32_t c) { return this->clients.at(c); }
+
+  /// Stop the owners once they applied every request. All clients must have
+  /// been flushed (or drained) and stopped submitting before.
+  void shutdown() {
+    if (this->stop.exchange(true)) return;
+    for (auto &owner : this->owners) {
+      owner.join();
+    }
+  }
+
+  /// Hashtable of partition `p`, e.g. for stats. Only safe to use after
+  /// `shutdown()`.
+  BaseHashTable *table(uint32_t p) const { return this->tables.at(p); }
+
+  /// Requests applied by owner `o`.
+  uint64_t num_inserted(uint32_t o) const { return this->inserted.at(o); }
+
+  uint32_t partition_of(uint64_t key) const {
+    const auto hash = this->hasher(&key, sizeof(key));
+    return fastrange32(_mm_crc32_u32(0xffffffff, hash), this->num_owners);
+  }
+
+  /// Owner of `key` under the latest routing table.
+  uint32_t owner_of(uint64_t key) const {
+    return this->latest_routing.load(std::memory_order_acquire)
+        ->owner[this->partition_of(key)];
+  }
+
+  /// Spread the partitions over the first `n` owners (partition `p` goes to
+  /// owner `p % n`); the others go idle. Returns the epoch of the new
+  /// routing. The handoff completes as the clients call in.
+  uint64_t resize(uint32_t n) {
+    assert(n > 0 && n <= this->num_owners);
+    std::lock_guard<std::mutex> lock(this->resize_mutex);
+
+    const auto prev = this->routings.back().get();
+    auto next = std::make_unique<Routing>();
+    next->epoch = prev->epoch + 1;
+    next->owner.resize(this->num_owners);
+    for (auto p = 0u; p < this->num_owners; p++) {
+      next->owner[p] = p % n;
+    }
+
+    const auto routing = next.get();
+    this->routings.push_back(std::move(next));
+    this->active.store(n, std::memory_order_relaxed);
+    prev->next.store(routing, std::memory_order_release);
+    this->latest_routing.store(routing, std::memory_order_release);
+    PLOGV.printf("delegated hashtable: epoch %lu, %u active owners",
+                 routing->epoch, n);
+    return routing->epoch;
+  }
+
+  uint32_t num_active_owners() const {
+    return this->active.load(std::memory_order_relaxed);
+  }
+
+  /// Oldest epoch some owner still routes by.
+  uint64_t settled_epoch() const {
+    uint64_t epoch = UINT64_MAX;
+    for (auto o = 0u; o < this->num_owners; o++) {
+      epoch = std::min<uint64_t>(
+          epoch, this->owner_state[o].epoch.load(std::memory_order_acquire));
+    }
+    return epoch;
+  }
+
+  /// One step of a load-driven policy, to be called periodically: add an
+  /// owner when the active ones spent more than `grow_at` of the cycles since
+  /// the last step on requests, drop one below `shrink_at`. Returns the
+  /// number of active owners.
+  uint32_t autoscale(double grow_at = 0.9, double shrink_at = 0.3) {
+    const auto now = RDTSC_START();
+    const auto active = this->num_active_owners();
+    uint64_t busy = 0;
+    for (auto o = 0u; o < this->num_owners; o++) {
+      const auto b = this->owner_state[o].busy_cycles.load(std::memory_order_relaxed);
+      if (o < active) busy += b - this->last_busy[o];
+      this->last_busy[o] = b;
+    }
+    const auto elapsed = now - this->last_autoscale;
+    this->last_autoscale = now;
+    // a handoff is still in flight; it would skew the measurement
+    const auto latest =
+        this->latest_routing.load(std::memory_order_acquire)->epoch;
+    if (this->settled_epoch() != latest) return active;
+
+    const double load = (double)busy / ((double)elapsed * active);
+    if (load > grow_at && active < this->num_owners) {
+      this->resize(active + 1);
+    } else if (load < shrink_at && active > 1) {
+      this->resize(active - 1);
+    }
+    return this->num_active_owners();
+  }
+
+  const uint32_t num_clients;
+  const uint32_t num_owners;
+
+ private:
+  DelegatedHashTable(const std::vector<uint32_t> &client_cpus,
+                     const std::vector<uint32_t> &owner_cpus, uint64_t ht_size,
+                     TableFactory factory, uint32_t first_id,
+                     uint64_t max_pending_finds, size_t num_sections,
+                     bool owns_tables)
+      : num_clients(client_cpus.size()),
+        num_owners(owner_cpus.size()),
+        max_pending_finds(max_pending_finds),
+        owns_tables(owns_tables),
+        clients(client_cpus.size()),
+        tables(owner_cpus.size(), nullptr) {
+    assert(num_clients > 0 && num_owners > 0);
+    assert(max_pending_finds > 0);
+
+    this->requests = std::make_unique<SectionQueue>(
+        num_clients, num_owners, num_sections, client_cpus, owner_cpus);
+    this->replies = std::make_unique<SectionQueue>(
+        num_owners, num_clients, num_sections, owner_cpus, client_cpus);
+
+    // epoch 0: owner `o` owns partition `o`
+    auto routing = std::make_unique<Routing>();
+    routing->epoch = 0;
+    routing->owner.resize(num_owners);
+    for (auto p = 0u; p < num_owners; p++) routing->owner[p] = p;
+    this->latest_routing.store(routing.get(), std::memory_order_release);
+    this->first_routing = routing.get();
+    this->routings.push_back(std::move(routing));
+    this->last_autoscale = RDTSC_START();
+
+    for (auto c = 0u; c < num_clients; c++) {
+      auto &client = this->clients[c];
+      client.dht = this;
+      client.id = c;
+      client.routing = this->first_routing;
+      client.mode.assign(num_owners, CTRL_INSERT_MODE);
+    }
+
+    for (auto o = 0u; o < num_owners; o++) {
+      const auto cpu = owner_cpus[o];
+      this->owners.emplace_back(
+          [this, o, cpu, ht_size, first_id, &factory] {
+            // pin before the table is allocated, its pages land on our node
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(cpu, &cpuset);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+
+            this->tables[o] = factory(ht_size, first_id + o);
+            // an owner may come to serve any partition; all tables must be
+            // there before it looks them up
+            this->tables_ready++;
+            while (this->tables_ready.load() != this->num_owners) _mm_pause();
+            this->owner_thread(o, first_id);
+          });
+    }
+
+    // `factory` lives on this stack
+    while (this->tables_ready.load() != num_owners) _mm_pause();
+    PLOGI.printf("delegated hashtable: %u clients, %u owners", num_clients,
+                 num_owners);
+  }
+
+  // Requests an owner collected for one partition, applied in batches
+  struct PartitionBatch {
+    BaseHashTable *ht = nullptr;
+    uint32_t part_id = 0;
+    std::vector<InsertFindArgument> ins_items;
+    std::vector<InsertFindArgument> find_items;
+    std::vector<uint32_t> find_client;
+    std::vector<uint32_t> find_id;
+    std::vector<uint8_t> find_found;
+    uint32_t num_ins = 0;
+    uint32_t num_finds = 0;
+  };
+
+  void owner_thread(uint32_t o, uint32_t first_id) {
+    const uint32_t batch_len = config.batch_len;
+    std::vector<PartitionBatch> parts(this->num_owners);
+    for (auto p = 0u; p < this->num_owners; p++) {
+      auto &part = parts[p];
+      part.ht = this->tables[p];
+      part.part_id = first_id + p;
+      part.ins_items.resize(batch_len);
+      part.find_items.resize(batch_len);
+      part.find_client.resize(batch_len);
+      part.find_id.resize(batch_len);
+      part.find_found.resize(batch_len);
+    }
+    std::vector<FindResult> results(batch_len);
+    std::vector<uint64_t> mode(this->num_clients, CTRL_INSERT_MODE);
+    std::vector<uint64_t> client_epoch(this->num_clients, 0);
+    std::vector<uint8_t> parked(this->num_clients, 0);
+    std::vector<uint8_t> replied(this->num_clients, 0);
+    // the next request of the client is for key 0
+    std::vector<uint8_t> zero_key(this->num_clients, 0);
+    uint64_t inserted = 0;
+    auto &state = this->owner_state[o];
+
+    // partitions this owner holds under `routing`
+    const Routing *routing = this->first_routing;
+    std::vector<uint32_t> owned;
+    auto adopt = [&](const Routing *r) {
+      routing = r;
+      owned.clear();
+      for (auto p = 0u; p < this->num_owners; p++) {
+        if (r->owner[p] == o) owned.push_back(p);
+      }
+    };
+    adopt(routing);
+
+    // with a single partition there is no need to hash the key again
+    auto part_of = [&](uint64_t key) -> PartitionBatch & {
+      if (owned.size() == 1) return parts[owned[0]];
+      const auto p = this->partition_of(key);
+      assert(routing->owner[p] == o);
+      return parts[p];
+    };
+
+    auto submit_inserts = [&](PartitionBatch &part) {
+      if (part.num_ins == 0) return;
+      part.ht->insert_batch(InsertFindArguments(part.ins_items.data(), part.num_ins));
+      inserted += part.num_ins;
+      part.num_ins = 0;
+    };
+
+    auto reply = [&](uint32_t c, data_t msg) {
+      this->replies->enqueue(&this->replies->all_pqueues[o][c], o, c, msg);
+      replied[c] = 1;
+    };
+
+    auto flush_replies = [&] {
+      for (auto c = 0u; c < this->num_clients; c++) {
+        if (!replied[c]) continue;
+        this->replies->flush(&this->replies->all_pqueues[o][c], o, c, [] {});
+        replied[c] = 0;
+      }
+    };
+
+    // Every find of a run is resolved before the next one starts; results
+    // only carry the ids of found keys, so the table queue is drained to
+    // tell the rest apart.
+    auto run_finds = [&](PartitionBatch &part) {
+      if (part.num_finds == 0) return;
+      ValuePairs vp{0, results.data()};
+      auto collect = [&] {
+        for (auto i = 0u; i < vp.first; i++) {
+          const auto slot = results[i].id;
+          part.find_found[slot] = 1;
+          part.find_items[slot].value = results[i].value;
+        }
+        vp.first = 0;
+      };
+
+      part.ht->find_batch(InsertFindArguments(part.find_items.data(), part.num_finds), vp);
+      collect();
+      do {
+        part.ht->flush_find_queue(vp);
+        const auto full = vp.first == batch_len;
+        collect();
+        if (!full) break;
+      } while (true);
+
+      for (auto i = 0u; i < part.num_finds; i++) {
+        uint64_t tag = REPLY_TAG | part.find_id[i];
+        if (part.find_found[i]) tag |= REPLY_FOUND;
+        reply(part.find_client[i],
+              data_t(tag, part.find_found[i] ? part.find_items[i].value : 0));
+      }
+      part.num_finds = 0;
+    };
+
+    // Make everything queued so far visible, in order
+    auto apply_all = [&] {
+      for (auto p : owned) {
+        submit_inserts(parts[p]);
+        parts[p].ht->flush_insert_queue();
+      }
+      for (auto p : owned) run_finds(parts[p]);
+    };
+
+    uint32_t idle_after_stop = 0;
+    while (true) {
+      const bool stopping = this->stop.load(std::memory_order_acquire);
+      const auto round_start = RDTSC_START();
+      bool idle = true;
+
+      for (auto c = 0u; c < this->num_clients; c++) {
+        // c already routes by a newer table; wait for the others
+        if (client_epoch[c] > routing->epoch) continue;
+
+        auto cq = &this->requests->all_cqueues[o][c];
+        data_t msg;
+        for (auto i = 0u; i < batch_len; i++) {
+          if (this->requests->dequeue(cq, c, o, &msg) != SUCCESS) break;
+          idle = false;
+
+          if (msg.key == 0) {
+            if (msg.value & CTRL_EPOCH) {
+              client_epoch[c] = msg.value & ~CTRL_EPOCH;
+              parked[c] = 0;
+              // c may be waiting on finds it sent before the marker
+              apply_all();
+              flush_replies();
+              break;
+            }
+            if (msg.value == CTRL_ZERO_KEY) {
+              zero_key[c] = 1;
+              continue;
+            }
+            if (msg.value == CTRL_PARK) {
+              parked[c] = 1;
+              apply_all();
+              flush_replies();
+              continue;
+            }
+            if (msg.value != 0 && msg.value != mode[c]) {
+              apply_all();
+              mode[c] = msg.value;
+            }
+            continue;
+          }
+          if (zero_key[c]) [[unlikely]] {
+            assert(msg.key == ZERO_KEY_ALIAS);
+            msg.key = 0;
+            zero_key[c] = 0;
+          }
+
+          auto &part = part_of(msg.key);
+          if (mode[c] == CTRL_INSERT_MODE) {
+            auto &item = part.ins_items[part.num_ins];
+            item.key = msg.key;
+            item.value = msg.value;
+            item.id = msg.key;
+            item.part_id = part.part_id;
+            if (++part.num_ins == batch_len) submit_inserts(part);
+          } else {
+            const auto slot = part.num_finds;
+            auto &item = part.find_items[slot];
+            item.key = msg.key;
+            item.value = 0;
+            item.id = slot;
+            item.part_id = part.part_id;
+            part.find_client[slot] = c;
+            part.find_id[slot] = static_cast<uint32_t>(msg.value);
+            part.find_found[slot] = 0;
+            if (++part.num_finds == batch_len) run_finds(part);
+          }
+        }
+      }
+
+      for (auto p : owned) {
+        submit_inserts(parts[p]);
+        run_finds(parts[p]);
+      }
+
+      if (!idle) {
+        state.busy_cycles.store(
+            state.busy_cycles.load(std::memory_order_relaxed) +
+                (RDTSCP() - round_start),
+            std::memory_order_relaxed);
+        idle_after_stop = 0;
+      } else {
+        // Nothing to do: finish the queued inserts and publish the replies
+        for (auto p : owned) parts[p].ht->flush_insert_queue();
+        flush_replies();
+        // A dequeue may report an empty queue while it picks up a new
+        // section, so trust two idle rounds that started after `stop` was set
+        if (stopping) idle_after_stop++;
+      }
+
+      // Move to the epoch every client reached. Parked clients hold nothing
+      // back, and neither does anyone on shutdown: the clients are done.
+      const auto latest =
+          this->latest_routing.load(std::memory_order_acquire)->epoch;
+      auto target = latest;
+      if (idle_after_stop < 2) {
+        for (auto c = 0u; c < this->num_clients; c++) {
+          if (!parked[c]) target = std::min(target, client_epoch[c]);
+        }
+      }
+      if (target > routing->epoch) {
+        apply_all();
+        for (auto p : owned) parts[p].ht->flush_insert_queue();
+        flush_replies();
+        state.epoch.store(target, std::memory_order_release);
+
+        // the partitions we gain are released by their old owners
+        for (auto q = 0u; q < this->num_owners; q++) {
+          while (this->owner_state[q].epoch.load(std::memory_order_acquire) <
+                 target) {
+            _mm_pause();
+          }
+        }
+        auto r = routing;
+        while (r->epoch < target) r = r->next.load(std::memory_order_acquire);
+        adopt(r);
+        for (auto &e : client_epoch) e = std::max(e, target);
+        idle_after_stop = 0;
+        continue;
+      }
+
+      if (idle_after_stop >= 2) break;
+      if (idle) {
+        if (owned.empty()) {
+          // scaled down: stay responsive to markers without burning a core
+          std::this_thread::sleep_for(std::chrono::microseconds(50));
+        } else {
+          _mm_pause();
+        }
+      }
+    }
+
+    this->inserted[o] = inserted;
+    PLOGV.printf("delegated owner %u: inserted %lu", o, inserted);
+  }
+
+  const uint64_t max_pending_finds;
+  const bool owns_tables;
+  Hasher hasher;
+  std::unique_ptr<SectionQueue> requests;
+  std::unique_ptr<SectionQueue> replies;
+  std::vector<Client> clients;
+  std::vector<BaseHashTable *> tables;
+  std::vector<uint64_t> inserted = std::vector<uint64_t>(num_owners, 0);
+  std::vector<std::thread> owners;
+  // owners that created their table
+  std::atomic_uint32_t tables_ready{0};
+  std::atomic_bool stop{false};
+
+  // Per-owner state the controller reads
+  struct alignas(64) OwnerState {
+    // epoch of the routing the owner works by
+    std::atomic_uint64_t epoch{0};
+    std::atomic_uint64_t busy_cycles{0};
+  };
+  std::unique_ptr<OwnerState[]> owner_state =
+      std::make_unique<OwnerState[]>(num_owners);
+
+  std::mutex resize_mutex;
+  std::vector<std::unique_ptr<Routing>> routings;
+  // epoch 0; `routings` may grow while the owners start up
+  const Routing *first_routing = nullptr;
+  std::atomic<const Routing *> latest_routing{nullptr};
+  // set under resize_mutex; read by the controller without it
+  std::atomic_uint32_t active{num_owners};
+  // autoscale() bookkeeping
+  uint64_t last_autoscale = 0;
+  std::vector<uint64_t> last_busy = std::vector<uint64_t>(num_owners, 0);
+};
+
+}  // namespace kmercounter
+
+#endif  // HASHTABLES_DELEGATED_KHT_HPP
@@ -0,0 +1,49 @@
+#ifndef HASHTABLES_HT_DISPATCH_HPP
+#define HASHTABLES_HT_DISPATCH_HPP
+
+#include <type_traits>
+
+#include "hashtables/kvtypes.hpp"
+#include "types.hpp"
+
+namespace kmercounter {
+
+extern Configuration config;
+
+/// Call `f` with `std::type_identity<Table<KV, ItemQueue, branching>>` for the
+/// KV type (--aggr) and branch kind (--branching) picked at runtime.
+/// Every combination is instantiated, but the choice is made once per
+/// hashtable: the batch loops of each instantiation are the same code a
+/// build with only that combination would produce.
+template <template <typename, typename, BRANCHKIND> class Table, typename F>
+decltype(auto) dispatch_ht_kind(F &&f) {
+  auto with_kv = [&f](auto kv) -> decltype(auto) {
+    using KV = typename decltype(kv)::type;
+#ifdef LATENCY_COLLECTION
+    // Latency collection is only implemented by the branched kernels
+    return f(std::type_identity<Table<KV, ItemQueue, BRANCHKIND::WithBranch>>{});
+#else
+    switch (config.branching) {
+      case BRANCHKIND::NoBranch_Cmove:
+        return f(std::type_identity<
+                 Table<KV, ItemQueue, BRANCHKIND::NoBranch_Cmove>>{});
+      case BRANCHKIND::NoBranch_Simd:
+        return f(std::type_identity<
+                 Table<KV, ItemQueue, BRANCHKIND::NoBranch_Simd>>{});
+      case BRANCHKIND::WithBranch:
+      default:
+        return f(
+            std::type_identity<Table<KV, ItemQueue, BRANCHKIND::WithBranch>>{});
+    }
+#endif
+  };
+
+  if (config.aggr) {
+    return with_kv(std::type_identity<Aggr_KV>{});
+  }
+  return with_kv(std::type_identity<Item>{});
+}
+
+}  // namespace kmercounter
+
+#endif  // HASHTABLES_HT_DISPATCH_HPP
@@ -99,9 +99,22 @@ struct ItemQueue {
 #ifdef COMPARE_HASH
   uint64_t key_hash;  // 8 bytes
 #endif
+#ifdef PROBE_STATS
+  // cachelines probed so far after the first
+  uint32_t probes;
+#endif
 } PACKED;
 std::ostream& operator<<(std::ostream& os, const ItemQueue& q);
 
+/// When set, an Aggr_KV insert adds the queued value to the count instead of
+/// one: producers that combine duplicate keys (--combine-window) enqueue
+/// `(key, n)` for n occurrences. Set once at startup, before any insert.
+inline bool aggr_add_values = false;
+
+inline value_type aggr_increment(const ItemQueue *elem) {
+  return aggr_add_values ? elem->value : 1;
+}
+
 // FIXME: @David paritioned gets the insert count wrong somehow
 struct Aggr_KV {
   using queue = ItemQueue;
@@ -116,10 +129,10 @@ struct Aggr_KV {
   inline bool insert(queue *elem) {
     if (this->is_empty()) {
       this->key = elem->key;
-      this->count += 1;
+      this->count += aggr_increment(elem);
       return false;
     } else if (this->key == elem->key) {
-      this->count += 1;
+      this->count += aggr_increment(elem);
       return false;
     }
 
@@ -140,10 +153,11 @@ struct Aggr_KV {
   inline bool update_cas(queue *elem) {
     auto ret = false;
     uint64_t old_val;
+    const auto inc = aggr_increment(elem);
 
     while (!ret) {
       old_val = this->count;
-      ret = __sync_bool_compare_and_swap(&this->count, old_val, old_val + 1);
+      ret = __sync_bool_compare_and_swap(&this->count, old_val, old_val + inc);
     }
     return ret;
   }
@@ -439,7 +453,7 @@ struct Aggr_KV {
     int ret = 0;
     asm volatile(
         "movq %[count], %%r13\n\t"
-        "inc %%r13\n\t"  // inc count to use later
+        "add %[inc], %%r13\n\t"  // inc count to use later
         "movq %%r13, %%mm0\n\t"
         "movq %[key_in], %%mm1\n\t"
         "movq %[key], %%mm2\n\t"
@@ -456,7 +470,8 @@ struct Aggr_KV {
         "pmovmskb %%mm3, %[ret]\n\t"
         : [ret] "=r"(ret)
         : [key] "r"(this->key), [count] "r"(this->count),
-          [empty_key] "r"(empty.key), [key_in] "r"(elem->key), [_this] "r"(this)
+          [empty_key] "r"(empty.key), [key_in] "r"(elem->key), [_this] "r"(this),
+          [inc] "r"(aggr_increment(elem))
         : "mm0", "mm1", "mm2", "mm3", "rdi", "r13", "cc", "memory");
     return ret;
 #endif
@@ -0,0 +1,118 @@
+#ifndef HASHTABLES_PREFETCH_TUNER_HPP
+#define HASHTABLES_PREFETCH_TUNER_HPP
+
+#include <plog/Log.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+
+#include "constants.hpp"
+#include "sync.h"
+
+namespace kmercounter {
+
+/// Owns the prefetch depth (flush threshold) of one prefetch queue.
+///
+/// With tuning disabled the depth is fixed. Otherwise the first batches
+/// are a warmup: every power-of-two depth from `PREFETCH_TUNE_MIN_DEPTH` up
+/// to what fits in the queue next to a full batch is used for
+/// `PREFETCH_TUNE_WINDOW` batches, `PREFETCH_TUNE_ROUNDS` times, and timed
+/// with the TSC. The depth with the fewest cycles/op is then locked in.
+/// Once locked, `record()` is a single predictable branch.
+class PrefetchTuner {
+ public:
+  PrefetchTuner() = default;
+
+  PrefetchTuner(const char *name, int id, uint32_t depth, uint32_t queue_sz,
+                uint32_t batch_len, bool tune)
+      : name_(name), id_(id), depth_(depth), locked_(!tune) {
+    if (!tune) return;
+
+    // a full batch is queued on top of `depth` pending requests; the ring
+    // must not wrap around
+    const uint32_t max_depth =
+        queue_sz > batch_len + 1 ? queue_sz - batch_len - 1 : 0;
+    for (auto d = PREFETCH_TUNE_MIN_DEPTH;
+         d <= max_depth && num_candidates_ < candidates_.size(); d *= 2) {
+      candidates_[num_candidates_++] = d;
+    }
+
+    if (num_candidates_ < 2) {
+      locked_ = true;
+      return;
+    }
+    best_cycles_.fill(std::numeric_limits<double>::max());
+    depth_ = candidates_[0];
+  }
+
+  /// Current flush threshold of the queue.
+  inline uint32_t depth() const { return depth_; }
+
+  inline bool locked() const { return locked_; }
+
+  /// Account a batch of `ops` operations that was just queued.
+  inline void record(uint64_t ops) {
+    if (locked_) return;
+    record_warmup(ops);
+  }
+
+ private:
+  void record_warmup(uint64_t ops) {
+    if (window_batches_ == 0) {
+      // The first batch of a window only starts the clock
+      window_start_ = RDTSC_START();
+      window_ops_ = 0;
+      window_batches_++;
+      return;
+    }
+
+    window_ops_ += ops;
+    if (++window_batches_ <= PREFETCH_TUNE_WINDOW) return;
+
+    const auto cycles = RDTSCP() - window_start_;
+    const double cycles_per_op = (double)cycles / std::max<uint64_t>(window_ops_, 1);
+    best_cycles_[cur_] = std::min(best_cycles_[cur_], cycles_per_op);
+    window_batches_ = 0;
+
+    if (++cur_ < num_candidates_) {
+      depth_ = candidates_[cur_];
+      return;
+    }
+
+    if (++round_ < PREFETCH_TUNE_ROUNDS) {
+      cur_ = 0;
+      depth_ = candidates_[cur_];
+      return;
+    }
+
+    const auto best =
+        std::min_element(best_cycles_.begin(),
+                         best_cycles_.begin() + num_candidates_) -
+        best_cycles_.begin();
+    depth_ = candidates_[best];
+    locked_ = true;
+    PLOGI.printf("[%d] %s prefetch depth locked at %u (%.1f cycles/op)", id_,
+                 name_, depth_, best_cycles_[best]);
+  }
+
+  const char *name_ = "";
+  int id_ = 0;
+  uint32_t depth_ = 0;
+  bool locked_ = true;
+
+  // warmup state
+  std::array<uint32_t, 8> candidates_{};
+  std::array<double, 8> best_cycles_{};
+  uint32_t num_candidates_ = 0;
+  uint32_t cur_ = 0;
+  uint32_t round_ = 0;
+  uint32_t window_batches_ = 0;
+  uint64_t window_start_ = 0;
+  uint64_t window_ops_ = 0;
+};
+
+}  // namespace kmercounter
+
+#endif  // HASHTABLES_PREFETCH_TUNER_HPP
@@ -0,0 +1,165 @@
+/// SIMD helpers shared by the hashtables that probe a full cacheline of
+/// 16-byte KV pairs at once (PartitionedHashStore and CASHashTable).
+/// Kernels are compiled for both AVX-512 and AVX2 through function target
+/// attributes; `simd_kind` picks one at startup from CPUID so the same binary
+/// runs on hosts without AVX-512.
+
+#ifndef HASHTABLES_SIMD_HELPERS_HPP
+#define HASHTABLES_SIMD_HELPERS_HPP
+
+#include <immintrin.h>
+
+#include <array>
+#include <cstdint>
+
+#include "constants.hpp"
+#include "types.hpp"
+
+namespace kmercounter {
+
+enum class SIMDKIND { None, Avx2, Avx512 };
+
+#define SIMD_TARGET_AVX512 \
+  __attribute__((target("avx512f,avx512dq,avx512bw,avx512vl")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,bmi")))
+
+inline SIMDKIND detect_simd_kind() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") &&
+      __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl"))
+    return SIMDKIND::Avx512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi"))
+    return SIMDKIND::Avx2;
+  return SIMDKIND::None;
+}
+
+/// SIMD instruction set used by the probe kernels on this host.
+inline const SIMDKIND simd_kind = detect_simd_kind();
+
+inline const char *simd_kind_string(SIMDKIND kind) {
+  switch (kind) {
+    case SIMDKIND::Avx512:
+      return "avx512";
+    case SIMDKIND::Avx2:
+      return "avx2";
+    default:
+      return "none";
+  }
+}
+
+namespace {
+// utility constants and lambdas for SIMD operations
+constexpr size_t KV_PER_CACHE_LINE = CACHE_LINE_SIZE / KV_SIZE;
+
+#ifdef AVX_SUPPORT
+// cacheline
+//       <------------------------ cacheline ------------------------->
+//       || val3 | key3 || val2 | key2 || val1 | key1 || val0 | key0 ||
+// bits: ||  7      6       5      4       3      2       1      0   ||
+// masks for AVX512 instructions
+constexpr __mmask8 KEY0 = 0b00000001;
+constexpr __mmask8 KEY1 = 0b00000100;
+constexpr __mmask8 KEY2 = 0b00010000;
+constexpr __mmask8 KEY3 = 0b01000000;
+constexpr __mmask8 VAL0 = 0b00000010;
+constexpr __mmask8 VAL1 = 0b00001000;
+constexpr __mmask8 VAL2 = 0b00100000;
+constexpr __mmask8 VAL3 = 0b10000000;
+constexpr __mmask8 KVP0 = KEY0 | VAL0;
+constexpr __mmask8 KVP1 = KEY1 | VAL1;
+constexpr __mmask8 KVP2 = KEY2 | VAL2;
+constexpr __mmask8 KVP3 = KEY3 | VAL3;
+
+// key_cmp_masks are indexed by cidx, the index of an entry in a cacheline
+// the masks are used to mask irrelevant bits of the result of 4-way SIMD
+// key comparisons
+constexpr std::array<__mmask8, KV_PER_CACHE_LINE> key_cmp_masks = {
+    KEY3 | KEY2 | KEY1 | KEY0,  // cidx: 0; all key comparisons valid
+    KEY3 | KEY2 | KEY1,         // cidx: 1; only last three comparisons valid
+    KEY3 | KEY2,                // cidx: 2; only last two comparisons valid
+    KEY3,                       // cidx: 3; only last comparison valid
+};
+
+auto load_cacheline = [](void const *cptr) SIMD_TARGET_AVX512 {
+  return _mm512_load_epi64(cptr);
+};
+
+auto store_cacheline = [](void *cptr, __mmask8 kv_mask,
+                          __m512i cacheline) SIMD_TARGET_AVX512 {
+  _mm512_mask_store_epi64(cptr, kv_mask, cacheline);
+};
+
+auto key_cmp = [](__m512i cacheline, __m512i key_vector,
+                  size_t cidx) SIMD_TARGET_AVX512 {
+  __mmask8 cmp = _mm512_cmpeq_epu64_mask(cacheline, key_vector);
+  // zmm registers are compared as 8 uint64_t
+  // mask irrelevant results before returning
+  return static_cast<__mmask8>(cmp & key_cmp_masks[cidx]);
+};
+
+auto empty_key_cmp = [](__m512i cacheline, size_t cidx) SIMD_TARGET_AVX512 {
+  return key_cmp(cacheline, _mm512_setzero_si512(), cidx);
+};
+
+// broadcast a 64-bit key into all four key positions of a zmm register
+auto broadcast_key = [](uint64_t key) SIMD_TARGET_AVX512 {
+  return _mm512_maskz_set1_epi64(KEY3 | KEY2 | KEY1 | KEY0, key);
+};
+
+// index (within the cacheline) of the first KV pair selected by a non-zero
+// comparison mask
+auto first_kv_idx = [](__mmask8 cmp) {
+  return static_cast<size_t>(__builtin_ctz(cmp) >> 1);
+};
+
+// result of comparing a key against the (relevant) slots of a cacheline. Both
+// masks use the AVX-512 layout above: one bit per 64-bit word, key bits only.
+struct CachelineCmp {
+  __mmask8 eq;
+  __mmask8 empty;
+};
+
+SIMD_TARGET_AVX512 inline CachelineCmp cacheline_cmp_avx512(const void *cptr,
+                                                           uint64_t key,
+                                                           size_t cidx) {
+  __m512i cacheline = load_cacheline(cptr);
+  return {key_cmp(cacheline, broadcast_key(key), cidx),
+          empty_key_cmp(cacheline, cidx)};
+}
+
+// AVX2 has no mask registers; a cacheline is two ymm registers and the
+// per-word comparison results are packed with movemask into the same layout
+SIMD_TARGET_AVX2 inline CachelineCmp cacheline_cmp_avx2(const void *cptr,
+                                                       uint64_t key,
+                                                       size_t cidx) {
+  const __m256i *line = reinterpret_cast<const __m256i *>(cptr);
+  const __m256i lo = _mm256_load_si256(line);
+  const __m256i hi = _mm256_load_si256(line + 1);
+
+  auto cmp = [lo, hi, cidx](__m256i vec) SIMD_TARGET_AVX2 {
+    uint32_t cmp_lo =
+        _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(lo, vec)));
+    uint32_t cmp_hi =
+        _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(hi, vec)));
+    return static_cast<__mmask8>((cmp_lo | (cmp_hi << 4)) & key_cmp_masks[cidx]);
+  };
+
+  return {cmp(_mm256_set1_epi64x(key)), cmp(_mm256_setzero_si256())};
+}
+
+template <SIMDKIND kind>
+inline CachelineCmp cacheline_cmp(const void *cptr, uint64_t key, size_t cidx) {
+  static_assert(kind != SIMDKIND::None);
+  if constexpr (kind == SIMDKIND::Avx512) {
+    return cacheline_cmp_avx512(cptr, key, cidx);
+  } else {
+    return cacheline_cmp_avx2(cptr, key, cidx);
+  }
+}
+#endif
+
+}  // unnamed namespace
+
+}  // namespace kmercounter
+
+#endif  // HASHTABLES_SIMD_HELPERS_HPP
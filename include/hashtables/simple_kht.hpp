@@ -15,6 +15,7 @@
 #include <x86intrin.h>  // _bit_scan_forward
 
 //#include <linux/getcpu.h>
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <fstream>
@@ -30,66 +31,15 @@
 #include "helper.hpp"
 #include "ht_helper.hpp"
 #include "misc_lib.h"
+#include "prefetch_tuner.hpp"
 #include "plog/Log.h"
+#include "simd_helpers.hpp"
 #include "sync.h"
 
 namespace kmercounter {
 
 namespace {
-// utility constants and lambdas for SIMD operations
-constexpr size_t KV_PER_CACHE_LINE = CACHE_LINE_SIZE / KV_SIZE;
-
 const size_t MAX_PARTITIONS = 64;
-
-#ifdef AVX_SUPPORT
-// cacheline
-//       <------------------------ cacheline ------------------------->
-//       || val3 | key3 || val2 | key2 || val1 | key1 || val0 | key0 ||
-// bits: ||  7      6       5      4       3      2       1      0   ||
-// masks for AVX512 instructions
-constexpr __mmask8 KEY0 = 0b00000001;
-constexpr __mmask8 KEY1 = 0b00000100;
-constexpr __mmask8 KEY2 = 0b00010000;
-constexpr __mmask8 KEY3 = 0b01000000;
-constexpr __mmask8 VAL0 = 0b00000010;
-constexpr __mmask8 VAL1 = 0b00001000;
-constexpr __mmask8 VAL2 = 0b00100000;
-constexpr __mmask8 VAL3 = 0b10000000;
-constexpr __mmask8 KVP0 = KEY0 | VAL0;
-constexpr __mmask8 KVP1 = KEY1 | VAL1;
-constexpr __mmask8 KVP2 = KEY2 | VAL2;
-constexpr __mmask8 KVP3 = KEY3 | VAL3;
-
-// key_cmp_masks are indexed by cidx, the index of an entry in a cacheline
-// the masks are used to mask irrelevant bits of the result of 4-way SIMD
-// key comparisons
-constexpr std::array<__mmask8, KV_PER_CACHE_LINE> key_cmp_masks = {
-    KEY3 | KEY2 | KEY1 | KEY0,  // cidx: 0; all key comparisons valid
-    KEY3 | KEY2 | KEY1,         // cidx: 1; only last three comparisons valid
-    KEY3 | KEY2,                // cidx: 2; only last two comparisons valid
-    KEY3,                       // cidx: 3; only last comparison valid
-};
-
-auto load_cacheline = [](void const *cptr) { return _mm512_load_epi64(cptr); };
-
-auto store_cacheline = [](void *cptr, __mmask8 kv_mask, __m512i cacheline) {
-  _mm512_mask_store_epi64(cptr, kv_mask, cacheline);
-};
-
-auto key_cmp = [](__m512i cacheline, __m512i key_vector, size_t cidx) {
-  __mmask8 cmp = _mm512_cmpeq_epu64_mask(cacheline, key_vector);
-  // zmm registers are compared as 8 uint64_t
-  // mask irrelevant results before returning
-  return cmp & key_cmp_masks[cidx];
-};
-
-const __m512i empty_key_vector = _mm512_setzero_si512();
-
-auto empty_key_cmp = [](__m512i cacheline, size_t cidx) {
-  return key_cmp(cacheline, empty_key_vector, cidx);
-};
-#endif
-
 }  // unnamed namespace
 
 // TODO use char and bit manipulation instead of bit fields in Kmer_KV:
@@ -97,12 +47,9 @@ auto empty_key_cmp = [](__m512i cacheline, size_t cidx) {
 // TODO how long should be the count variable?
 // TODO should we pack the struct?
 
-constexpr auto histogram_bits = 6;
-constexpr std::uint32_t histogram_buckets{1 << histogram_bits};
-constexpr std::uint32_t histogram_mask{histogram_buckets - 1};
-extern thread_local std::vector<unsigned int> hash_histogram;
-
-template <typename KV, typename KVQ>
+/// `branching` picks the probe kernels; every kind is instantiated so that
+/// it can be selected at runtime (see init_ht).
+template <typename KV, typename KVQ, BRANCHKIND branching = default_branching>
 class alignas(64) PartitionedHashStore : public BaseHashTable {
  public:
   static KV **hashtable;
@@ -140,9 +87,7 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
       std::terminate();
     }
 #if defined(PREFETCH_WITH_PREFETCH_INSTR)
-    prefetch_object<true /* write */>(&this->hashtable[this->id][i],
-                                      sizeof(this->hashtable[this->id][i]));
-    // true /* write */);
+    this->prefetch_partition(i, this->id, this->pf_write);
 #endif
 
 #if defined(PREFETCH_WITH_WRITE)
@@ -190,7 +135,18 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
   };
 
   PartitionedHashStore(uint64_t c, uint8_t id)
-      : id(id), find_head(0), find_tail(0), ins_head(0), ins_tail(0) {
+      : id(id),
+        find_head(0),
+        find_tail(0),
+        ins_head(0),
+        ins_tail(0),
+        ins_queue_sz(config.pf_queue_len),
+        find_queue_sz(config.pf_find_queue_len),
+        pf_write(config.pf_write),
+        ins_tuner("insert", this->id, config.ins_flush_threshold,
+                  this->ins_queue_sz, config.batch_len, config.pf_tune),
+        find_tuner("find", this->id, config.find_flush_threshold,
+                   this->find_queue_sz, config.batch_len, config.pf_tune) {
     this->capacity = c;
 
     {
@@ -226,13 +182,13 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
 
     PLOGV << "Empty item: " << this->empty_item;
     this->insert_queue =
-        (KVQ *)(aligned_alloc(64, PREFETCH_QUEUE_SIZE * sizeof(KVQ)));
+        (KVQ *)(aligned_alloc(64, this->ins_queue_sz * sizeof(KVQ)));
     this->find_queue =
-        (KVQ *)(aligned_alloc(64, PREFETCH_FIND_QUEUE_SIZE * sizeof(KVQ)));
+        (KVQ *)(aligned_alloc(64, this->find_queue_sz * sizeof(KVQ)));
 
-    memset(this->insert_queue, 0x0, PREFETCH_QUEUE_SIZE * sizeof(KVQ));
+    memset(this->insert_queue, 0x0, this->ins_queue_sz * sizeof(KVQ));
 
-    memset(this->find_queue, 0x0, PREFETCH_FIND_QUEUE_SIZE * sizeof(KVQ));
+    memset(this->find_queue, 0x0, this->find_queue_sz * sizeof(KVQ));
 
     PLOG_DEBUG.printf("id: %d insert_queue %p | find_queue %p", id,
                       this->insert_queue, this->find_queue);
@@ -251,15 +207,16 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
 
 #ifdef AVX_SUPPORT
   // FIXME: shares a lot of code with __insert_branchless_simd
-  void __insert_noprefetch_simd(const void *data) {
+  SIMD_TARGET_AVX512 void __insert_noprefetch_simd(const void *data) {
     KVQ *q = const_cast<KVQ *>(reinterpret_cast<const KVQ *>(data));
     uint64_t hash = 0;
-    uint64_t key = 0;
 
     hash = this->hash((const char *)&q->key);
-    key = q->key;
 
     size_t idx = fastrange32(hash, this->capacity);
+#ifdef PROBE_STATS
+    const size_t home = idx;
+#endif
 
     KV *cur_ht = this->hashtable[this->id];
 
@@ -282,13 +239,9 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
       constexpr __mmask8 KVP2 = KEY2 | VAL2;
       constexpr __mmask8 KVP3 = KEY3 | VAL3;
 
-      // a vector of 1s that is used for incrementing a value
-      constexpr __m512i INCREMENT_VECTOR = {
-          0ULL, 1ULL,  // KVP0
-          0ULL, 1ULL,  // KVP1
-          0ULL, 1ULL,  // KVP2
-          0ULL, 1ULL,  // KVP3
-      };
+      // the amount added to a value (1, or n for combined keys); the add is
+      // masked to the value lanes
+      const __m512i increment_vector = _mm512_set1_epi64(aggr_increment(q));
 
       // cacheline_masks is indexed by q->idx % KV_PER_CACHE_LINE
       constexpr std::array<__mmask8, KV_PER_CACHE_LINE> cacheline_masks = {
@@ -324,7 +277,7 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
           0,
       };
 
-      auto load_key_vector = [q]() {
+      auto load_key_vector = [q]() SIMD_TARGET_AVX512 {
         // we want to load only the keys into a ZMM register, as two 32-bit
         // integers. 0b0011 matches the first 64 bits of a KV pair -- the key
         __mmask16 mask{0b0011001100110011};
@@ -333,35 +286,37 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
         return _mm512_maskz_broadcast_i32x2(mask, kv);
       };
 
-      auto load_kv_vector = [q]() {
-        // we want to load only the key value pair into a ZMM register, as four
-        // 4-byte integers. 0b1111 matches the entire KV pair
-        __mmask16 mask{0b1111111111111111};
+      auto load_kv_vector = [q]() SIMD_TARGET_AVX512 {
+        // we want the key value pair (key and value are adjacent in the queue
+        // entry) in all four KV positions of a ZMM register
         __m128i kv =
-            _mm_loadl_epi64(reinterpret_cast<const __m128i *>(&q->key));
-        return _mm512_maskz_broadcast_i32x2(mask, kv);
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(&q->key));
+        return _mm512_maskz_broadcast_i64x2(0xff, kv);
       };
 
-      auto load_cacheline = [this, cur_ht, idx, &cacheline_masks](size_t cidx) {
+      auto load_cacheline = [this, cur_ht, idx, &cacheline_masks](size_t cidx)
+          SIMD_TARGET_AVX512 {
         const KV *cptr = &cur_ht[idx & ~(KV_PER_CACHE_LINE - 1)];
         return _mm512_maskz_load_epi64(cacheline_masks[cidx], cptr);
       };
 
       auto store_cacheline = [this, cur_ht, idx](__m512i cacheline,
-                                                 __mmask8 kv_mask) {
+                                                 __mmask8 kv_mask)
+          SIMD_TARGET_AVX512 {
         KV *cptr = &cur_ht[idx & ~(KV_PER_CACHE_LINE - 1)];
         _mm512_mask_store_epi64(cptr, kv_mask, cacheline);
       };
 
       auto key_cmp = [&key_cmp_masks](__m512i cacheline, __m512i key_vector,
-                                      size_t cidx) {
+                                      size_t cidx) SIMD_TARGET_AVX512 {
         __mmask8 cmp = _mm512_cmpeq_epu64_mask(cacheline, key_vector);
         // zmm registers are compared as 8 uint64_t
         // mask irrelevant results before returning
         return cmp & key_cmp_masks[cidx];
       };
 
-      auto empty_cmp = [&key_cmp_masks](__m512i cacheline, size_t cidx) {
+      auto empty_cmp = [&key_cmp_masks](__m512i cacheline, size_t cidx)
+          SIMD_TARGET_AVX512 {
         const __m512i empty_key_vector = _mm512_setzero_si512();
         __mmask8 cmp = _mm512_cmpeq_epu64_mask(cacheline, empty_key_vector);
         // zmm registers are compared as 8 uint64_t
@@ -371,7 +326,8 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
 
       auto key_copy_mask = [&empty_cmp, &key_copy_masks](__m512i cacheline,
                                                          uint32_t eq_cmp,
-                                                         size_t cidx) {
+                                                         size_t cidx)
+          SIMD_TARGET_AVX512 {
         uint32_t locations = empty_cmp(cacheline, cidx);
         __mmask16 copy_mask = 1 << _bit_scan_forward(locations);
         // if locations == 0, _bit_scan_forward(locations) is undefined
@@ -386,14 +342,16 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
         return static_cast<__mmask8>(copy_mask);
       };
 
-      auto blend = [](__m512i &cacheline, __m512i kv_vector, __mmask8 mask) {
+      auto blend = [](__m512i &cacheline, __m512i kv_vector, __mmask8 mask)
+          SIMD_TARGET_AVX512 {
         cacheline = _mm512_mask_blend_epi64(mask, cacheline, kv_vector);
       };
 
-      auto increment_count = [INCREMENT_VECTOR](__m512i &cacheline,
-                                                __mmask8 val_mask) {
+      auto increment_count = [increment_vector](__m512i &cacheline,
+                                                __mmask8 val_mask)
+          SIMD_TARGET_AVX512 {
         cacheline = _mm512_mask_add_epi64(cacheline, val_mask, cacheline,
-                                          INCREMENT_VECTOR);
+                                          increment_vector);
       };
 
       // compute index within the cacheline
@@ -442,11 +400,68 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
         } else {
           store_cacheline(kv_vector, kv_mask);
         }
+#ifdef CALC_STATS
+        this->num_insert_misses += !eq_cmp;
+#endif
+#ifdef PROBE_STATS
+        record_probes(eq_cmp ? ProbeOutcome::InsertHit
+                             : ProbeOutcome::InsertMiss,
+                      home, idx);
+#endif
         break;
       }
     }
     return;
   }
+
+  /// Insert `q` into the cacheline at `cptr` if the key is already there or
+  /// there is a free slot. Same result as a scalar `KV::insert` on the first
+  /// matching or empty slot. Returns false if the cacheline must be reprobed;
+  /// `hit` tells if the key was there.
+  bool __insert_cacheline_avx2(KV *cptr, size_t cidx, KVQ *q, bool &hit) {
+    static_assert(sizeof(KV) == KV_SIZE);
+    const auto [eq_cmp, empty_cmp] =
+        cacheline_cmp<SIMDKIND::Avx2>(cptr, q->key, cidx);
+    const __mmask8 key_mask = eq_cmp ? eq_cmp : empty_cmp;
+    hit = eq_cmp != 0;
+    if (!key_mask) {
+      return false;
+    }
+    cptr[first_kv_idx(key_mask)].insert(q);
+    return true;
+  }
+
+  void __insert_noprefetch_avx2(const void *data) {
+    KVQ *q = const_cast<KVQ *>(reinterpret_cast<const KVQ *>(data));
+    uint64_t hash = this->hash((const char *)&q->key);
+    size_t idx = fastrange32(hash, this->capacity);
+    KV *cur_ht = this->hashtable[this->id];
+#ifdef PROBE_STATS
+    const size_t home = idx;
+#endif
+
+    for (auto i = 0u; i < this->capacity;) {
+      const size_t cidx = idx & (KV_PER_CACHE_LINE - 1);
+      bool hit;
+      if (__insert_cacheline_avx2(&cur_ht[idx - cidx], cidx, q, hit)) {
+#ifdef CALC_STATS
+        this->num_insert_misses += !hit;
+#endif
+#ifdef PROBE_STATS
+        record_probes(hit ? ProbeOutcome::InsertHit : ProbeOutcome::InsertMiss,
+                      home, idx);
+#endif
+        break;
+      }
+      auto inc_idx = KV_PER_CACHE_LINE - cidx;
+      auto nidx = idx + inc_idx;
+      idx = nidx >= this->capacity ? (nidx - this->capacity) : nidx;  // modulo
+      i += inc_idx;
+#ifdef CALC_STATS
+      this->num_reprobes++;
+#endif
+    }
+  }
 #endif 
 
   void __insert_noprefetch_branched(const void *data, collector_type* collector) {
@@ -467,11 +482,17 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
 #endif
 
     KV *cur_ht = this->hashtable[this->id];
+#ifdef PROBE_STATS
+    const size_t home = idx;
+#endif
 
     //PLOGV.printf("hash %lu | key %lu | idx %lu", hash, key_data->key, idx);
     for (auto i = 0u; i < this->capacity; i++) {
       KV *curr = &cur_ht[idx];
       auto retry = false;
+#if defined(PROBE_STATS) || defined(CALC_STATS)
+      const bool was_empty = curr->is_empty();
+#endif
 
       retry = curr->insert(key_data);
 
@@ -485,6 +506,14 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
 #ifdef LATENCY_COLLECTION
         collector->sync_end(start_time);
 #endif
+#ifdef CALC_STATS
+        this->num_insert_misses += was_empty;
+#endif
+#ifdef PROBE_STATS
+        record_probes(
+            was_empty ? ProbeOutcome::InsertMiss : ProbeOutcome::InsertHit,
+            home, idx);
+#endif
 
         if (0) {
           printf("inserted key %" PRIu64 " at idx %zu | hash %" PRIu64 "\n", key_data->key,
@@ -504,7 +533,13 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
       __insert_noprefetch_branched(data, collector);
     } else if constexpr (branching == BRANCHKIND::NoBranch_Simd) {
       #ifdef AVX_SUPPORT
-        __insert_noprefetch_simd(data);
+        if (simd_kind == SIMDKIND::Avx512) {
+          __insert_noprefetch_simd(data);
+        } else if (simd_kind == SIMDKIND::Avx2) {
+          __insert_noprefetch_avx2(data);
+        } else {
+          __insert_noprefetch_branched(data, collector);
+        }
       #else
         __insert_noprefetch_branched(data, collector);
       #endif 
@@ -515,11 +550,36 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
   void insert_batch(const InsertFindArguments &kp, collector_type* collector) override {
     this->flush_if_needed(collector);
 
-    for (auto &data : kp) {
-      add_to_insert_queue(&data, collector);
+    for (size_t i = 0; i < kp.size(); i += HASH_BATCH_LENGTH) {
+      const size_t n = std::min<size_t>(HASH_BATCH_LENGTH, kp.size() - i);
+      this->hash_keys(&kp[i], n);
+      for (size_t j = 0; j < n; j++) {
+        add_to_insert_queue(&kp[i + j], this->batch_hashes[j],
+                            this->batch_idxs[j], collector);
+      }
+    }
+
+    this->flush_if_needed(collector);
+    this->ins_tuner.record(kp.size());
+  }
+
+  // insert queued pairs in place; the ring is drained before every chunk, so
+  // `kvs` may be longer than the prefetch queue
+  void insert_kv_batch(std::span<const KeyValuePair> kvs,
+                       collector_type *collector) override {
+    for (size_t i = 0; i < kvs.size(); i += HASH_BATCH_LENGTH) {
+      this->flush_if_needed(collector);
+      const size_t n = std::min<size_t>(HASH_BATCH_LENGTH, kvs.size() - i);
+      this->hash_keys(&kvs[i], n);
+      for (size_t j = 0; j < n; j++) {
+        if (kvs[i + j].key == 0) continue;
+        add_to_insert_queue(&kvs[i + j], this->batch_hashes[j],
+                            this->batch_idxs[j], collector);
+      }
     }
 
     this->flush_if_needed(collector);
+    this->ins_tuner.record(kvs.size());
   }
 
   bool insert(const void *data) { return false; }
@@ -529,54 +589,54 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
   // overridden function for insertion
   void flush_if_needed(collector_type* collector) {
     size_t curr_queue_sz =
-        (this->ins_head - this->ins_tail) & (PREFETCH_QUEUE_SIZE - 1);
-    while (curr_queue_sz >= INS_FLUSH_THRESHOLD) {
+        (this->ins_head - this->ins_tail) & (this->ins_queue_sz - 1);
+    while (curr_queue_sz >= this->ins_tuner.depth()) {
       __insert_one(&this->insert_queue[this->ins_tail], collector);
-      this->ins_tail = (this->ins_tail + 1) & (PREFETCH_QUEUE_SIZE - 1);
+      this->ins_tail = (this->ins_tail + 1) & (this->ins_queue_sz - 1);
       curr_queue_sz =
-          (this->ins_head - this->ins_tail) & (PREFETCH_QUEUE_SIZE - 1);
+          (this->ins_head - this->ins_tail) & (this->ins_queue_sz - 1);
     }
     return;
   }
 
   void flush_insert_queue(collector_type* collector) override {
     size_t curr_queue_sz =
-        (this->ins_head - this->ins_tail) & (PREFETCH_QUEUE_SIZE - 1);
+        (this->ins_head - this->ins_tail) & (this->ins_queue_sz - 1);
 
     while (curr_queue_sz != 0) {
       __insert_one(&this->insert_queue[this->ins_tail], collector);
-      this->ins_tail = (this->ins_tail + 1) & (PREFETCH_QUEUE_SIZE - 1);
+      this->ins_tail = (this->ins_tail + 1) & (this->ins_queue_sz - 1);
       curr_queue_sz =
-          (this->ins_head - this->ins_tail) & (PREFETCH_QUEUE_SIZE - 1);
+          (this->ins_head - this->ins_tail) & (this->ins_queue_sz - 1);
     }
   }
 
   void flush_find_queue(ValuePairs &vp, collector_type* collector) override {
     size_t curr_queue_sz =
-        (this->find_head - this->find_tail) & (PREFETCH_FIND_QUEUE_SIZE - 1);
+        (this->find_head - this->find_tail) & (this->find_queue_sz - 1);
 
     while ((curr_queue_sz != 0) && (vp.first < config.batch_len)) {
       __find_one(&this->find_queue[this->find_tail], vp, collector);
-      if (++this->find_tail >= PREFETCH_FIND_QUEUE_SIZE) this->find_tail = 0;
+      if (++this->find_tail >= this->find_queue_sz) this->find_tail = 0;
       curr_queue_sz =
-          (this->find_head - this->find_tail) & (PREFETCH_FIND_QUEUE_SIZE - 1);
+          (this->find_head - this->find_tail) & (this->find_queue_sz - 1);
     }
   }
 
   void flush_if_needed(ValuePairs &vp, collector_type* collector) {
     size_t curr_queue_sz =
-        (this->find_head - this->find_tail) & (PREFETCH_FIND_QUEUE_SIZE - 1);
+        (this->find_head - this->find_tail) & (this->find_queue_sz - 1);
     // make sure you return at most batch_sz (but can possibly return lesser
     // number of elements)
-    while ((curr_queue_sz > FLUSH_THRESHOLD) &&
+    while ((curr_queue_sz > this->find_tuner.depth()) &&
            (vp.first < config.batch_len)) {
       // cout << "Finding value for key " <<
       // this->find_queue[this->find_tail].key << " at tail : " <<
       // this->find_tail << endl;
       __find_one(&this->find_queue[this->find_tail], vp, collector);
-      if (++this->find_tail >= PREFETCH_FIND_QUEUE_SIZE) this->find_tail = 0;
+      if (++this->find_tail >= this->find_queue_sz) this->find_tail = 0;
       curr_queue_sz =
-          (this->find_head - this->find_tail) & (PREFETCH_FIND_QUEUE_SIZE - 1);
+          (this->find_head - this->find_tail) & (this->find_queue_sz - 1);
     }
     return;
   }
@@ -598,8 +658,13 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     // cout << "== > post flush_before head: " << this->find_head << " tail: "
     // << this->find_tail << endl;
 
-    for (auto &data : kp) {
-      add_to_find_queue(&data, collector);
+    for (size_t i = 0; i < kp.size(); i += HASH_BATCH_LENGTH) {
+      const size_t n = std::min<size_t>(HASH_BATCH_LENGTH, kp.size() - i);
+      this->hash_keys(&kp[i], n);
+      for (size_t j = 0; j < n; j++) {
+        add_to_find_queue(&kp[i + j], this->batch_hashes[j],
+                          this->batch_idxs[j], collector);
+      }
     }
 
     // cout << "-> flush_after head: " << this->find_head << " tail: " <<
@@ -607,6 +672,7 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     this->flush_if_needed(values, collector);
     // cout << "== > post flush_after head: " << this->find_head << " tail: " <<
     // this->find_tail << endl;
+    this->find_tuner.record(kp.size());
   }
 
   void *find_noprefetch(const void *data, collector_type* collector) override {
@@ -631,6 +697,9 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
 
     KV *cur_ht = this->hashtable[item->part_id];
     KV *curr;
+#ifdef PROBE_STATS
+    const size_t home = idx;
+#endif
 
     bool found = false;
 
@@ -662,6 +731,10 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
 #endif
 
   exit:
+#ifdef PROBE_STATS
+    record_probes(found ? ProbeOutcome::FindHit : ProbeOutcome::FindMiss, home,
+                  idx);
+#endif
     // return empty_element if nothing is found
     if (!found) {
       printf("key %" PRIu64 " not found at idx %" PRIu32 " | hash %" PRIu64 "\n", item->key, idx,
@@ -732,10 +805,51 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
   uint32_t find_tail;
   uint32_t ins_head;
   uint32_t ins_tail;
+  // ring sizes of the prefetch queues (powers of two)
+  uint32_t ins_queue_sz;
+  uint32_t find_queue_sz;
+  // prefetch the slots of inserts for write, or for read
+  bool pf_write;
+  // flush thresholds of the prefetch queues, fixed or tuned during warmup
+  PrefetchTuner ins_tuner;
+  PrefetchTuner find_tuner;
   Hasher hasher_;
+  // hashes and table indices of the current chunk of a batch
+  alignas(64) uint64_t batch_hashes[HASH_BATCH_LENGTH];
+  alignas(64) uint32_t batch_idxs[HASH_BATCH_LENGTH];
 
   uint64_t hash(const void *k) { return hasher_(k, this->key_length); }
 
+#ifdef PROBE_STATS
+  /// Count an op that went slot by slot from `home` to `idx`.
+  void record_probes(ProbeOutcome outcome, size_t home, size_t idx) {
+    this->probe_histograms.record_home(home, this->capacity);
+    this->probe_histograms.record(
+        outcome, ProbeHistograms::probe_length(home, idx, this->capacity,
+                                               CACHE_LINE_SIZE / sizeof(KV)));
+  }
+#endif
+
+  /// Hash `n` keys and compute their fastrange32 indices in one pass, before
+  /// any of them is queued.
+  template <typename Arg>
+  void hash_keys(const Arg *args, size_t n) {
+#if defined(BQ_KEY_UPPER_BITS_HAS_HASH)
+    if (bq_load == BQUEUE_LOAD::HtInsert) {
+      for (size_t i = 0; i < n; i++) {
+        this->batch_hashes[i] = args[i].key >> 32;
+      }
+    } else
+#endif
+    {
+      this->hasher_.hash_batch(args, n, this->batch_hashes);
+    }
+
+    // The hashes have little to no upper-bit entropy _because of how they are
+    // assigned to the queues_
+    fastrange32_batch(this->batch_hashes, n, this->capacity, this->batch_idxs);
+  }
+
   uint64_t __find_branched(KVQ *q, ValuePairs &vp, collector_type* collector) {
     // hashtable idx where the data should be found
     size_t idx = q->idx;
@@ -776,9 +890,12 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
 #ifdef LATENCY_COLLECTION
       this->find_queue[this->find_head].timer_id = q->timer_id;
 #endif
+#ifdef PROBE_STATS
+      this->find_queue[this->find_head].probes = q->probes + 1;
+#endif
 
       this->find_head += 1;
-      this->find_head &= (PREFETCH_FIND_QUEUE_SIZE - 1);
+      this->find_head &= (this->find_queue_sz - 1);
 
 #ifdef CALC_STATS
       this->sum_distance_from_bucket++;
@@ -786,6 +903,10 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     } else {
 #ifdef LATENCY_COLLECTION
       collector->end(q->timer_id);
+#endif
+#ifdef PROBE_STATS
+      this->probe_histograms.record(
+          found ? ProbeOutcome::FindHit : ProbeOutcome::FindMiss, q->probes);
 #endif
     }
 
@@ -810,6 +931,15 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     this->find_queue[this->find_head].key_id = q->key_id;
     this->find_queue[this->find_head].idx = idx;
     this->prefetch_read(idx);
+#ifdef PROBE_STATS
+    // slot by slot; a probe is a new cacheline
+    this->find_queue[this->find_head].probes =
+        q->probes + (idx % (CACHE_LINE_SIZE / sizeof(KV)) == 0);
+    if (retry != 0x1) {
+      this->probe_histograms.record(
+          found ? ProbeOutcome::FindHit : ProbeOutcome::FindMiss, q->probes);
+    }
+#endif
 
     // this->find_head should not be incremented if either
     // the desired key is empty or it is found.
@@ -817,12 +947,12 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     inc = (retry == 0x1) ? inc : 0;
 
     this->find_head += inc;
-    this->find_head &= (PREFETCH_FIND_QUEUE_SIZE - 1);
+    this->find_head &= (this->find_queue_sz - 1);
 
     return found;
   }
 #ifdef AVX_SUPPORT
-  uint64_t __find_branchless_simd(KVQ *q, ValuePairs &vp) {
+  SIMD_TARGET_AVX512 uint64_t __find_branchless_simd(KVQ *q, ValuePairs &vp) {
     static_assert(sizeof(KV) == KV_SIZE);
 
     // hashtable idx at which data is to be found
@@ -834,7 +964,7 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     // pointer to current cacheline
     KV *cptr = &this->hashtable[q->part_id][idx & ~(KV_PER_CACHE_LINE - 1)];
 
-    auto load_key_vector = [q]() {
+    auto load_key_vector = [q]() SIMD_TARGET_AVX512 {
       // we want to load only the keys into a ZMM register, as two 32-bit
       // integers. 0b0011 matches the first 64 bits of a KV pair -- the key
       __mmask16 mask{0b0011001100110011};
@@ -854,8 +984,7 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     __mmask8 empty_cmp = empty_key_cmp(cacheline, cidx);
 
     // compute index at which there is a key match
-    //size_t midx = _bit_scan_forward(eq_cmp) >> 1;
-    const KV *match = &this->hashtable[q->part_id][idx];
+    const KV *match = &cptr[eq_cmp ? first_kv_idx(eq_cmp) : 0];
 
     //PLOGV.printf("match found? key %lu | key_id %lu | value %lu", q->key, q->key_id, match->get_value());
 
@@ -899,12 +1028,74 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
       this->find_queue[this->find_head].key_id = q->key_id;
       this->find_queue[this->find_head].idx = ridx;
       this->find_queue[this->find_head].part_id = q->part_id;
+#ifdef PROBE_STATS
+      this->find_queue[this->find_head].probes = q->probes + 1;
+#endif
 
       this->find_head += reprobe;
-      this->find_head &= (PREFETCH_FIND_QUEUE_SIZE - 1);
+      this->find_head &= (this->find_queue_sz - 1);
+    }
+#ifdef PROBE_STATS
+    if (!reprobe) {
+      this->probe_histograms.record(
+          found ? ProbeOutcome::FindHit : ProbeOutcome::FindMiss, q->probes);
     }
+#endif
     return found;
   }
+
+  uint64_t __find_branchless_avx2(KVQ *q, ValuePairs &vp) {
+    static_assert(sizeof(KV) == KV_SIZE);
+
+    // hashtable idx at which data is to be found
+    size_t idx = q->idx;
+    // index within the cacheline
+    const size_t cidx = idx & (KV_PER_CACHE_LINE - 1);
+    // index at which current cacheline starts
+    const size_t ccidx = idx - cidx;
+    // pointer to current cacheline
+    const KV *cptr = &this->hashtable[q->part_id][ccidx];
+
+    const auto [eq_cmp, empty_cmp] =
+        cacheline_cmp<SIMDKIND::Avx2>(cptr, q->key, cidx);
+
+    if (eq_cmp) {
+      vp.second[vp.first].value = cptr[first_kv_idx(eq_cmp)].get_value();
+      vp.second[vp.first].id = q->key_id;
+      vp.first++;
+    }
+
+    // if key is not found, and we have not encountered any empty "slots"
+    // reprobe is necessary
+    if (!(eq_cmp | empty_cmp)) {
+#ifdef CALC_STATS
+      this->max_distance_from_bucket++;
+#endif
+      // index at which reprobe must begin
+      size_t ridx = ccidx + KV_PER_CACHE_LINE;
+      ridx = (ridx >= this->capacity) ? (ridx - this->capacity) : ridx;  // modulo
+
+      this->prefetch_partition(ridx, q->part_id, false);
+
+      this->find_queue[this->find_head].key = q->key;
+      this->find_queue[this->find_head].key_id = q->key_id;
+      this->find_queue[this->find_head].idx = ridx;
+      this->find_queue[this->find_head].part_id = q->part_id;
+#ifdef PROBE_STATS
+      this->find_queue[this->find_head].probes = q->probes + 1;
+#endif
+
+      this->find_head += 1;
+      this->find_head &= (this->find_queue_sz - 1);
+    }
+#ifdef PROBE_STATS
+    else {
+      this->probe_histograms.record(
+          eq_cmp ? ProbeOutcome::FindHit : ProbeOutcome::FindMiss, q->probes);
+    }
+#endif
+    return eq_cmp != 0;
+  }
 #endif
 
 
@@ -920,7 +1111,12 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     } else if constexpr (branching == BRANCHKIND::NoBranch_Simd) {
 
       #ifdef AVX_SUPPORT
-        return __find_branchless_simd(q, vp);
+        if (simd_kind == SIMDKIND::Avx512) {
+          return __find_branchless_simd(q, vp);
+        } else if (simd_kind == SIMDKIND::Avx2) {
+          return __find_branchless_avx2(q, vp);
+        }
+        return __find_branchless_cmov(q, vp);
       #else
         return __find_branchless_cmov(q, vp);
       #endif
@@ -945,6 +1141,9 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
   try_insert:
     KV *curr = &cur_ht[idx];
     auto retry = false;
+#if defined(PROBE_STATS) || defined(CALC_STATS)
+    const bool was_empty = curr->is_empty();
+#endif
     // if constexpr (experiment_inactive(experiment_type::insert_dry_run,
     //                                   experiment_type::aggr_kv_write_key_only))
     //PLOGV.printf("Inserting key %lu", q->key);
@@ -982,12 +1181,24 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
 #ifdef LATENCY_COLLECTION
       this->insert_queue[this->ins_head].timer_id = q->timer_id;
 #endif
+#ifdef PROBE_STATS
+      this->insert_queue[this->ins_head].probes = q->probes + 1;
+#endif
 
       ++this->ins_head;
-      this->ins_head &= (PREFETCH_QUEUE_SIZE - 1);
+      this->ins_head &= (this->ins_queue_sz - 1);
 
 #ifdef CALC_STATS
       this->num_reprobes++;
+#endif
+    } else {
+#ifdef CALC_STATS
+      this->num_insert_misses += was_empty;
+#endif
+#ifdef PROBE_STATS
+      this->probe_histograms.record(
+          was_empty ? ProbeOutcome::InsertMiss : ProbeOutcome::InsertHit,
+          q->probes);
 #endif
     }
   }
@@ -996,6 +1207,9 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     // hashtable idx at which data is to be inserted
     size_t idx = q->idx;
     KV *curr = &this->hashtable[this->id][idx];
+#if defined(PROBE_STATS) || defined(CALC_STATS)
+    const bool was_empty = curr->is_empty();
+#endif
     // returns 1 succeeded
     uint8_t cmp = curr->insert_or_update_v2(q);
 
@@ -1005,19 +1219,33 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
 
     prefetch(idx);
     this->insert_queue[this->ins_head].key = q->key;
+    this->insert_queue[this->ins_head].value = q->value;
     this->insert_queue[this->ins_head].key_id = q->key_id;
     this->insert_queue[this->ins_head].idx = idx;
+#ifdef CALC_STATS
+    this->num_insert_misses += (cmp == 0xff) & was_empty;
+#endif
+#ifdef PROBE_STATS
+    // slot by slot; a probe is a new cacheline
+    this->insert_queue[this->ins_head].probes =
+        q->probes + (idx % (CACHE_LINE_SIZE / sizeof(KV)) == 0);
+    if (cmp == 0xff) {
+      this->probe_histograms.record(
+          was_empty ? ProbeOutcome::InsertMiss : ProbeOutcome::InsertHit,
+          q->probes);
+    }
+#endif
 
     // this->queue_idx should not be incremented if either
     // of the try_inserts succeeded
     int inc{1};
     inc = (cmp == 0xff) ? 0 : inc;
     this->ins_head += inc;
-    this->ins_head &= (PREFETCH_QUEUE_SIZE - 1);
+    this->ins_head &= (this->ins_queue_sz - 1);
   }
 
 #ifdef AVX_SUPPORT
-  void __insert_branchless_simd(KVQ *q) {
+  SIMD_TARGET_AVX512 void __insert_branchless_simd(KVQ *q) {
     // hashtable idx at which data is to be inserted
     size_t idx = q->idx;
     KV *cur_ht = this->hashtable[this->id];
@@ -1040,13 +1268,9 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     constexpr __mmask8 KVP2 = KEY2 | VAL2;
     constexpr __mmask8 KVP3 = KEY3 | VAL3;
 
-    // a vector of 1s that is used for incrementing a value
-    constexpr __m512i INCREMENT_VECTOR = {
-        0ULL, 1ULL,  // KVP0
-        0ULL, 1ULL,  // KVP1
-        0ULL, 1ULL,  // KVP2
-        0ULL, 1ULL,  // KVP3
-    };
+    // the amount added to a value (1, or n for combined keys); the add is
+    // masked to the value lanes
+    const __m512i increment_vector = _mm512_set1_epi64(aggr_increment(q));
 
     // cacheline_masks is indexed by q->idx % KV_PER_CACHE_LINE
     constexpr std::array<__mmask8, KV_PER_CACHE_LINE> cacheline_masks = {
@@ -1082,7 +1306,7 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
         0,
     };
 
-    auto load_key_vector = [q]() {
+    auto load_key_vector = [q]() SIMD_TARGET_AVX512 {
       // we want to load only the keys into a ZMM register, as two 32-bit
       // integers. 0b0011 matches the first 64 bits of a KV pair -- the key
       __mmask16 mask{0b0011001100110011};
@@ -1090,34 +1314,36 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
       return _mm512_maskz_broadcast_i32x2(mask, kv);
     };
 
-    auto load_kv_vector = [q]() {
-      // we want to load only the key value pair into a ZMM register, as four
-      // 4-byte integers. 0b1111 matches the entire KV pair
-      __mmask16 mask{0b1111111111111111};
-      __m128i kv = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(&q->key));
-      return _mm512_maskz_broadcast_i32x2(mask, kv);
+    auto load_kv_vector = [q]() SIMD_TARGET_AVX512 {
+      // we want the key value pair (key and value are adjacent in the queue
+      // entry) in all four KV positions of a ZMM register
+      __m128i kv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&q->key));
+      return _mm512_maskz_broadcast_i64x2(0xff, kv);
     };
 
-    auto load_cacheline = [this, cur_ht, idx, &cacheline_masks](size_t cidx) {
+    auto load_cacheline = [this, cur_ht, idx, &cacheline_masks](size_t cidx)
+        SIMD_TARGET_AVX512 {
       const KV *cptr = &cur_ht[idx & ~(KV_PER_CACHE_LINE - 1)];
       return _mm512_maskz_load_epi64(cacheline_masks[cidx], cptr);
     };
 
     auto store_cacheline = [this, cur_ht, idx](__m512i cacheline,
-                                               __mmask8 kv_mask) {
+                                               __mmask8 kv_mask)
+        SIMD_TARGET_AVX512 {
       KV *cptr = &cur_ht[idx & ~(KV_PER_CACHE_LINE - 1)];
       _mm512_mask_store_epi64(cptr, kv_mask, cacheline);
     };
 
     auto key_cmp = [&key_cmp_masks](__m512i cacheline, __m512i key_vector,
-                                    size_t cidx) {
+                                    size_t cidx) SIMD_TARGET_AVX512 {
       __mmask8 cmp = _mm512_cmpeq_epu64_mask(cacheline, key_vector);
       // zmm registers are compared as 8 uint64_t
       // mask irrelevant results before returning
       return cmp & key_cmp_masks[cidx];
     };
 
-    auto empty_cmp = [&key_cmp_masks](__m512i cacheline, size_t cidx) {
+    auto empty_cmp = [&key_cmp_masks](__m512i cacheline, size_t cidx)
+        SIMD_TARGET_AVX512 {
       const __m512i empty_key_vector = _mm512_setzero_si512();
       __mmask8 cmp = _mm512_cmpeq_epu64_mask(cacheline, empty_key_vector);
       // zmm registers are compared as 8 uint64_t
@@ -1126,7 +1352,8 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     };
 
     auto key_copy_mask = [&empty_cmp, &key_copy_masks](
-                             __m512i cacheline, uint32_t eq_cmp, size_t cidx) {
+                             __m512i cacheline, uint32_t eq_cmp, size_t cidx)
+        SIMD_TARGET_AVX512 {
       uint32_t locations = empty_cmp(cacheline, cidx);
       __mmask16 copy_mask = 1 << _bit_scan_forward(locations);
       // if locations == 0, _bit_scan_forward(locations) is undefined
@@ -1141,14 +1368,16 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
       return static_cast<__mmask8>(copy_mask);
     };
 
-    auto blend = [](__m512i &cacheline, __m512i kv_vector, __mmask8 mask) {
+    auto blend = [](__m512i &cacheline, __m512i kv_vector, __mmask8 mask)
+        SIMD_TARGET_AVX512 {
       cacheline = _mm512_mask_blend_epi64(mask, cacheline, kv_vector);
     };
 
-    auto increment_count = [INCREMENT_VECTOR](__m512i &cacheline,
-                                              __mmask8 val_mask) {
+    auto increment_count = [increment_vector](__m512i &cacheline,
+                                              __mmask8 val_mask)
+        SIMD_TARGET_AVX512 {
       cacheline = _mm512_mask_add_epi64(cacheline, val_mask, cacheline,
-                                        INCREMENT_VECTOR);
+                                        increment_vector);
     };
 
     // compute index within the cacheline
@@ -1178,6 +1407,17 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     __mmask8 val_mask = key_mask << 1;
     __mmask8 kv_mask = key_mask | val_mask;
 
+#ifdef CALC_STATS
+    this->num_insert_misses += copy_mask != 0;
+#endif
+#ifdef PROBE_STATS
+    if (kv_mask) {
+      this->probe_histograms.record(
+          eq_cmp ? ProbeOutcome::InsertHit : ProbeOutcome::InsertMiss,
+          q->probes);
+    }
+#endif
+
 #ifdef PURE_BRANCHLESS
     if constexpr (std::is_same_v<KV, Aggr_KV>) {
       blend(cacheline, kv_vector, copy_mask);
@@ -1193,8 +1433,12 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     auto nidx = idx + KV_PER_CACHE_LINE - cidx;
     nidx = nidx >= this->capacity ? (nidx - this->capacity) : nidx;  // modulo
     this->insert_queue[this->ins_head].key = q->key;
+    this->insert_queue[this->ins_head].value = q->value;
     this->insert_queue[this->ins_head].key_id = q->key_id;
     this->insert_queue[this->ins_head].idx = nidx;
+#ifdef PROBE_STATS
+    this->insert_queue[this->ins_head].probes = q->probes + 1;
+#endif
     auto queue_idx_inc = 1;
     // if kv_mask != 0, insert succeeded; reprobe unnecessary
     asm volatile(
@@ -1211,7 +1455,7 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     // issue prefetch
     prefetch(nidx);
     this->ins_head += queue_idx_inc;
-    this->ins_head &= (PREFETCH_QUEUE_SIZE - 1);
+    this->ins_head &= (this->ins_queue_sz - 1);
 #else
     if (!kv_mask) {
       auto nidx = idx + KV_PER_CACHE_LINE - cidx;
@@ -1221,8 +1465,11 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
       this->insert_queue[this->ins_head].key_id = q->key_id;
       this->insert_queue[this->ins_head].value = q->value;
       this->insert_queue[this->ins_head].idx = nidx;
+#ifdef PROBE_STATS
+      this->insert_queue[this->ins_head].probes = q->probes + 1;
+#endif
       this->ins_head++;  // += queue_idx_inc;
-      this->ins_head &= (PREFETCH_QUEUE_SIZE - 1);
+      this->ins_head &= (this->ins_queue_sz - 1);
     } else {
       if constexpr (std::is_same_v<KV, Aggr_KV>) {
         blend(cacheline, kv_vector, copy_mask);
@@ -1236,6 +1483,37 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
 #endif
     return;
   }
+
+  void __insert_branchless_avx2(KVQ *q) {
+    // hashtable idx at which data is to be inserted
+    size_t idx = q->idx;
+    const size_t cidx = idx & (KV_PER_CACHE_LINE - 1);
+    KV *cptr = &this->hashtable[this->id][idx - cidx];
+
+    bool hit;
+    if (!__insert_cacheline_avx2(cptr, cidx, q, hit)) {
+      auto nidx = idx + KV_PER_CACHE_LINE - cidx;
+      nidx = nidx >= this->capacity ? (nidx - this->capacity) : nidx;  // modulo
+      prefetch(nidx);
+      this->insert_queue[this->ins_head].key = q->key;
+      this->insert_queue[this->ins_head].key_id = q->key_id;
+      this->insert_queue[this->ins_head].value = q->value;
+      this->insert_queue[this->ins_head].idx = nidx;
+#ifdef PROBE_STATS
+      this->insert_queue[this->ins_head].probes = q->probes + 1;
+#endif
+      this->ins_head++;
+      this->ins_head &= (this->ins_queue_sz - 1);
+    } else {
+#ifdef CALC_STATS
+      this->num_insert_misses += !hit;
+#endif
+#ifdef PROBE_STATS
+      this->probe_histograms.record(
+          hit ? ProbeOutcome::InsertHit : ProbeOutcome::InsertMiss, q->probes);
+#endif
+    }
+  }
 #endif
 
   void __insert_one(KVQ *q, collector_type* collector) {
@@ -1254,7 +1532,13 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
         __insert_branchless_cmov(q);
       } else if constexpr (branching == BRANCHKIND::NoBranch_Simd) {
         #ifdef AVX_SUPPORT
-          __insert_branchless_simd(q); 
+          if (simd_kind == SIMDKIND::Avx512) {
+            __insert_branchless_simd(q);
+          } else if (simd_kind == SIMDKIND::Avx2) {
+            __insert_branchless_avx2(q);
+          } else {
+            __insert_branchless_cmov(q);
+          }
         #else 
           __insert_branchless_cmov(q);
         #endif
@@ -1297,28 +1581,16 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     }
   }
 
-  void add_to_insert_queue(void *data, collector_type* collector) {
-    InsertFindArgument *key_data = reinterpret_cast<InsertFindArgument *>(data);
-    uint64_t hash = 0;
-    uint64_t key = 0;
-
-    if (bq_load == BQUEUE_LOAD::HtInsert) [[likely]] {
+  template <typename Arg>
+  void add_to_insert_queue(const Arg *key_data,
+                           [[maybe_unused]] uint64_t hash, size_t idx,
+                           collector_type* collector) {
+    uint64_t key = key_data->key;
 #if defined(BQ_KEY_UPPER_BITS_HAS_HASH)
-      hash = key_data->key >> 32;
-      key = key_data->key & 0xFFFFFFFF;
-#else
-      hash = this->hash((const char *)&key_data->key);
-      key = key_data->key;
-#endif
-    } else {
-      hash = this->hash((const char *)&key_data->key);
-      key = key_data->key;
+    if (bq_load == BQUEUE_LOAD::HtInsert) {
+      key &= 0xFFFFFFFF;
     }
-
-    // The hashes have little to no upper-bit entropy _because of how they are
-    // assigned to the queues_
-    size_t idx;
-    idx = fastrange32(hash, this->capacity);  // modulo
+#endif
 
     //PLOGD.printf("Getting idx %zu", idx);
     if (idx > this->capacity) [[unlikely]] {
@@ -1326,8 +1598,8 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
       std::terminate();
     }
 
-#if defined(HASH_HISTOGRAM)
-    ++hash_histogram.at(idx & histogram_mask);
+#ifdef PROBE_STATS
+    this->probe_histograms.record_home(idx, this->capacity);
 #endif
     this->prefetch(idx);
 
@@ -1335,40 +1607,33 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     this->insert_queue[this->ins_head].idx = idx;
     this->insert_queue[this->ins_head].key = key;
     this->insert_queue[this->ins_head].value = key_data->value;
-    this->insert_queue[this->ins_head].key_id = key_data->id;
+    this->insert_queue[this->ins_head].key_id = insert_id(*key_data);
 
 #ifdef COMPARE_HASH
     this->insert_queue[this->ins_head].key_hash = hash;
 #endif
+#ifdef PROBE_STATS
+    this->insert_queue[this->ins_head].probes = 0;
+#endif
 
-    this->ins_head = (this->ins_head + 1) & (PREFETCH_QUEUE_SIZE - 1);
+    this->ins_head = (this->ins_head + 1) & (this->ins_queue_sz - 1);
     //}
   }
 
-  void add_to_find_queue(void *data, collector_type* collector) {
-    InsertFindArgument *key_data = reinterpret_cast<InsertFindArgument *>(data);
-    uint64_t hash = 0;
-    uint64_t key = 0;
+  void add_to_find_queue(const InsertFindArgument *key_data,
+                         [[maybe_unused]] uint64_t hash, size_t idx,
+                         collector_type* collector) {
+    uint64_t key = key_data->key;
 
 #ifdef LATENCY_COLLECTION
     const auto time = collector->start();
 #endif
 
-    if (bq_load == BQUEUE_LOAD::HtInsert) {
 #if defined(BQ_KEY_UPPER_BITS_HAS_HASH)
-      hash = key_data->key >> 32;
-      key = key_data->key & 0xFFFFFFFF;
-#else
-      hash = this->hash((const char *)&key_data->key);
-      key = key_data->key;
-#endif
-    } else {
-      hash = this->hash((const char *)&key_data->key);
-      key = key_data->key;
+    if (bq_load == BQUEUE_LOAD::HtInsert) {
+      key &= 0xFFFFFFFF;
     }
-
-    size_t idx;
-    idx = fastrange32(hash, this->capacity);  // modulo
+#endif
 
     this->prefetch_partition(idx, key_data->part_id, false);
 
@@ -1379,24 +1644,28 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
 #ifdef LATENCY_COLLECTION
     this->find_queue[this->find_head].timer_id = time;
 #endif
+#ifdef PROBE_STATS
+    this->find_queue[this->find_head].probes = 0;
+    this->probe_histograms.record_home(idx, this->capacity);
+#endif
 
 #ifdef COMPARE_HASH
     this->queue[this->find_head].key_hash = hash;
 #endif
 
     this->find_head++;
-    if (this->find_head >= PREFETCH_FIND_QUEUE_SIZE) this->find_head = 0;
+    if (this->find_head >= this->find_queue_sz) this->find_head = 0;
   }
 };
 
-template <class KV, class KVQ>
-KV **PartitionedHashStore<KV, KVQ>::hashtable;
+template <class KV, class KVQ, BRANCHKIND branching>
+KV **PartitionedHashStore<KV, KVQ, branching>::hashtable;
 
-template <class KV, class KVQ>
-std::mutex PartitionedHashStore<KV, KVQ>::ht_init_mutex;
+template <class KV, class KVQ, BRANCHKIND branching>
+std::mutex PartitionedHashStore<KV, KVQ, branching>::ht_init_mutex;
 
-template <class KV, class KVQ>
-int *PartitionedHashStore<KV, KVQ>::fds;
+template <class KV, class KVQ, BRANCHKIND branching>
+int *PartitionedHashStore<KV, KVQ, branching>::fds;
 
 // std::vector<std::mutex> PartitionedArrayHashTable:: hashtable_mutexes;
 
@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "PapiEvent.hpp"
+#include "utils/tsc.hpp"
 
 namespace kmercounter {
 
@@ -15,7 +16,6 @@ class MemoryBwCounters {
   // XXX: I don't know how to get this from an API
   const std::uint64_t NUM_MEMORY_CHANNELS = 6;
 
-  static constexpr double CYCLES_PER_SEC = (2.6 * 1000 * 1000 * 1000);
   static constexpr double MB_IN_BYTES = (1 << 20);
 
   // TODO: get this from NUMA API
@@ -71,7 +71,7 @@ class MemoryBwCounters {
 
   void compute_mem_bw() {
     double bw_duration = stop_ts - start_ts;
-    double bw_duration_secs = bw_duration / CYCLES_PER_SEC;
+    double bw_duration_secs = bw_duration / tsc_hz();
 
     PLOGI.printf("BW duration %f (secs %f)", bw_duration, bw_duration_secs);
     PLOGI.printf("Total read BW %f MiB/s",
@@ -7,9 +7,11 @@
 #include <cassert>
 #include <cstdint>
 #include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 #include "plog/Log.h"
 
@@ -18,6 +20,16 @@ using namespace std;
 namespace kmercounter {
 constexpr long long RESET_MASK(int x) { return ~(1LL << (x)); }
 
+/// Physical core of `cpu` within its package, or `cpu` itself if the kernel
+/// does not tell. Hyperthreads of one core share it.
+inline uint32_t cpu_core_id(uint32_t cpu) {
+  std::ifstream f("/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                  "/topology/core_id");
+  uint32_t id = cpu;
+  f >> id;
+  return id;
+}
+
 typedef struct numa_node {
   unsigned int id;
   unsigned long cpu_bitmask;
@@ -1,12 +1,23 @@
 #ifndef _PRINT_STATS_H
 #define _PRINT_STATS_H
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
 #include "hashtables/base_kht.hpp"
+#include "utils/control.hpp"
+#include "utils/memory_calibration.hpp"
+#include "utils/sampler.hpp"
+#include "utils/tsc.hpp"
 
 namespace kmercounter {
-/*From /proc/cpuinfo*/
-#define CPUFREQ_MHZ (2200.0)
-static const float one_cycle_ns = ((float)1000 / CPUFREQ_MHZ);
 
 inline void get_ht_stats(Shard *sh, BaseHashTable *kmer_ht) {
   sh->stats->ht_fill = kmer_ht->get_fill();
@@ -24,168 +35,637 @@ inline void get_ht_stats(Shard *sh, BaseHashTable *kmer_ht) {
       (double)(kmer_ht->sum_distance_from_bucket / sh->stats->ht_fill);
   sh->stats->max_distance_from_bucket = kmer_ht->max_distance_from_bucket;
 #endif
+#ifdef PROBE_STATS
+  sh->stats->probes = kmer_ht->probe_histograms;
+#endif
+}
+
+inline uint64_t cycles_per_op_or_zero(const OpTimings &ops) {
+  return ops.op_count ? cycles_per_op(ops) : 0;
+}
+
+/// Hardware events per op, NaN for the events that were not counted.
+inline double events_per_op(const OpTimings &ops, PerfEvent event) {
+  const auto count = ops.events[static_cast<std::size_t>(event)];
+  if (!ops.op_count || count == PERF_NOT_COUNTED) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  return static_cast<double>(count) / ops.op_count;
+}
+
+/// `<op>_<event>_per_op` for every PerfEvent.
+inline auto event_column_names(std::string_view op) {
+  std::array<std::string, static_cast<std::size_t>(PerfEvent::Count)> names;
+  for (auto e = 0u; e < names.size(); e++) {
+    names[e] = std::string(op) + '_' + perf_event_strings[e] + "_per_op";
+  }
+  return names;
 }
 
-inline void print_stats(Shard *all_sh, Configuration &config) {
-  uint64_t all_total_cycles = 0;
-  double all_total_time_ns = 0;
-  uint64_t all_total_num_inserts = 0;
-  uint64_t total_find_cycles = 0;
-  uint64_t total_finds = 0;
+/// `<outcome>_ops`, `<outcome>_mean_probes` and `<outcome>_p99_probes` for
+/// every ProbeOutcome.
+inline auto probe_column_names() {
+  std::array<std::array<std::string, 3>,
+             static_cast<std::size_t>(ProbeOutcome::Count)>
+      names;
+  for (auto o = 0u; o < names.size(); o++) {
+    const std::string outcome = probe_outcome_strings[o];
+    names[o] = {outcome + "_ops", outcome + "_mean_probes",
+                outcome + "_p99_probes"};
+  }
+  return names;
+}
 
+/// One row of a report: a thread, or the whole run. Times are TSC cycles.
+struct ReportRow {
+  OpTimings insertions{};
+  OpTimings finds{};
+  OpTimings enqueues{};
+  uint64_t fill = 0;
+  uint64_t capacity = 0;
+  double insert_mops = 0;
+  double find_mops = 0;
 #ifdef CALC_STATS
-  uint64_t all_total_avg_read_length = 0;
-  uint64_t all_total_num_sequences = 0;
-  uint64_t all_total_reprobes = 0;
-  uint64_t all_total_find_cycles = 0;
-  [[maybe_unused]] double all_total_find_time_ns = 0;
+  uint64_t num_reprobes = 0;
+  uint64_t num_memcmps = 0;
+  uint64_t num_memcpys = 0;
+  uint64_t num_queue_flushes = 0;
+  uint64_t num_hashcmps = 0;
+  uint64_t max_distance_from_bucket = 0;
+  double avg_distance_from_bucket = 0;
+  uint64_t avg_read_length = 0;
+  uint64_t num_sequences = 0;
+#endif
+#ifdef PROBE_STATS
+  ProbeHistograms probes{};
 #endif
 
-  size_t k = 0;
-  // if (config.mode == BQ_TESTS_YES_BQ) {
-  //  k = producer_count;
-  //}
-
-  printf("===============================================================\n");
-  for (; k < config.num_threads; k++) {
-    printf(
-        "Thread %2d: "
-        "%" PRIu64 " cycles (%f ms) for %" PRIu64 " insertions (%" PRIu64 " cycles/insert) | (%" PRIu64 " cycles/enqueue) "
-        "{ fill: %" PRIu64 " of %" PRIu64 " (%f %%) }"
+  /// Call `v(name, value)` for every column.
+  template <typename V>
+  void visit(V &&v) const {
+    v("insertions", insertions.op_count);
+    v("insert_cycles", insertions.duration);
+    v("cycles_per_insert", cycles_per_op_or_zero(insertions));
+    v("insert_mops", insert_mops);
+    static const auto insert_events = event_column_names("insert");
+    for (auto e = 0u; e < insert_events.size(); e++) {
+      v(insert_events[e].c_str(),
+        events_per_op(insertions, static_cast<PerfEvent>(e)));
+    }
+    v("finds", finds.op_count);
+    v("find_cycles", finds.duration);
+    v("cycles_per_find", cycles_per_op_or_zero(finds));
+    v("find_mops", find_mops);
+    static const auto find_events = event_column_names("find");
+    for (auto e = 0u; e < find_events.size(); e++) {
+      v(find_events[e].c_str(),
+        events_per_op(finds, static_cast<PerfEvent>(e)));
+    }
+    v("enqueues", enqueues.op_count);
+    v("enqueue_cycles", enqueues.duration);
+    v("cycles_per_enqueue", cycles_per_op_or_zero(enqueues));
+    v("fill", fill);
+    v("capacity", capacity);
+    v("fill_pct", capacity ? 100.0 * fill / capacity : 0.0);
 #ifdef CALC_STATS
-        "["
-        "num_reprobes: %" PRIu64 ", "
-        "num_memcmps: %" PRIu64 ", "
-        "num_memcpys: %" PRIu64 ", "
-        "num_queue_flushes: %" PRIu64 ", "
-        "num_hashcmps: %" PRIu64 ", "
-        "max_distance_from_bucket: %" PRIu64 ", "
-        "avg_distance_from_bucket: %f,"
-        "avg_distance_from_bucket (adjusted): %f,"
-        "avg_read_length: %" PRIu64 ","
-        "num_sequences :%" PRIu64 ""
-        "]"
-#endif  // CALC_STATS
-        "\n",
-        all_sh[k].shard_idx, all_sh[k].stats->insertions.duration,
-        (double)all_sh[k].stats->insertions.duration * one_cycle_ns / 1000000.0,
-        all_sh[k].stats->insertions.op_count,
-        all_sh[k].stats->insertions.op_count == 0
-            ? 0
-            : all_sh[k].stats->insertions.duration /
-                  all_sh[k].stats->insertions.op_count,
-        all_sh[k].stats->enqueues.op_count == 0
-            ? 0
-            : all_sh[k].stats->enqueues.duration /
-                  all_sh[k].stats->enqueues.op_count,
-        all_sh[k].stats->ht_fill, all_sh[k].stats->ht_capacity,
-        all_sh[k].stats->ht_capacity == 0
-            ? 0
-            : (double)all_sh[k].stats->ht_fill / all_sh[k].stats->ht_capacity *
-                  100
+    v("reprobes", num_reprobes);
+    v("memcmps", num_memcmps);
+    v("memcpys", num_memcpys);
+    v("queue_flushes", num_queue_flushes);
+    v("hashcmps", num_hashcmps);
+    v("max_distance_from_bucket", max_distance_from_bucket);
+    v("avg_distance_from_bucket", avg_distance_from_bucket);
+    v("avg_read_length", avg_read_length);
+    v("sequences", num_sequences);
+#endif
+#ifdef PROBE_STATS
+    static const auto probe_columns = probe_column_names();
+    for (auto o = 0u; o < probe_columns.size(); o++) {
+      const auto outcome = static_cast<ProbeOutcome>(o);
+      v(probe_columns[o][0].c_str(), probes.ops(outcome));
+      v(probe_columns[o][1].c_str(), probes.mean(outcome));
+      v(probe_columns[o][2].c_str(), probes.percentile(outcome, 99));
+    }
+#endif
+  }
+};
+
+/// Bytes that the memory controllers moved during the run, NaN if they
+/// could not be counted (utils/perf_counters.hpp).
+struct DramTraffic {
+  double read_bytes = std::numeric_limits<double>::quiet_NaN();
+  double write_bytes = std::numeric_limits<double>::quiet_NaN();
+};
+
+/// A phase of the run against the calibrated memory peaks (--calibrate-bw):
+/// the lines it took from memory per second (its LLC misses, or one line per
+/// op if they were not counted), the percentage of the nodes' random and
+/// sequential peaks, and by Little's law with the idle latency, the misses
+/// each of its threads kept in flight. NaN without a calibration.
+struct PhaseBandwidth {
+  double lines_per_sec = std::numeric_limits<double>::quiet_NaN();
+  double random_peak_pct = std::numeric_limits<double>::quiet_NaN();
+  double seq_peak_pct = std::numeric_limits<double>::quiet_NaN();
+  double mlp_per_thread = std::numeric_limits<double>::quiet_NaN();
+
+  /// Near the random peak, more parallelism per thread will not help.
+  bool bandwidth_bound() const { return random_peak_pct >= 80; }
+};
+
+/// The stats of all threads of a run, and their totals.
+struct RunReport {
+  double tsc_hz = 0;
+  DramTraffic dram;
+  PhaseBandwidth insert_bw;
+  PhaseBandwidth find_bw;
+  std::vector<ReportRow> threads;
+  ReportRow total;
+  // --sample-ms, over the run
+  std::vector<ThroughputSample> samples;
+  // --calibrate-bw, before the run
+  LatencyCalibration latency;
+  // cut short by a stop request; the counts are of the part that ran
+  bool stopped_early = false;
+
+  /// Call `v(name, value)` for every value of the run as a whole.
+  template <typename V>
+  void visit(V &&v) const {
+    v("tsc_hz", tsc_hz);
+    v("stopped_early", stopped_early);
+    v("dram_read_bytes", dram.read_bytes);
+    v("dram_write_bytes", dram.write_bytes);
+    v("insert_lines_per_sec", insert_bw.lines_per_sec);
+    v("insert_random_peak_pct", insert_bw.random_peak_pct);
+    v("insert_seq_peak_pct", insert_bw.seq_peak_pct);
+    v("insert_mlp_per_thread", insert_bw.mlp_per_thread);
+    v("find_lines_per_sec", find_bw.lines_per_sec);
+    v("find_random_peak_pct", find_bw.random_peak_pct);
+    v("find_seq_peak_pct", find_bw.seq_peak_pct);
+    v("find_mlp_per_thread", find_bw.mlp_per_thread);
+    latency.visit(v);
+  }
+};
+
+/// `ops` of `threads` threads, at `mops` for the run, against `peaks`.
+inline PhaseBandwidth phase_bandwidth(const OpTimings &ops, double mops,
+                                      uint64_t threads,
+                                      const std::vector<MemoryPeak> &peaks) {
+  PhaseBandwidth bw;
+  if (peaks.empty() || !ops.op_count) return bw;
+
+  double seq_peak = 0, random_peak = 0, latency_ns = 0;
+  for (const auto &p : peaks) {
+    seq_peak += p.seq_lines_per_sec;
+    random_peak += p.random_lines_per_sec;
+    latency_ns += p.latency_ns / peaks.size();
+  }
+  auto lines_per_op = events_per_op(ops, PerfEvent::LlcMisses);
+  if (!std::isfinite(lines_per_op)) lines_per_op = 1;
+
+  bw.lines_per_sec = mops * 1e6 * lines_per_op;
+  bw.random_peak_pct = 100 * bw.lines_per_sec / random_peak;
+  bw.seq_peak_pct = 100 * bw.lines_per_sec / seq_peak;
+  bw.mlp_per_thread = bw.lines_per_sec * latency_ns / 1e9 / threads;
+  return bw;
+}
+
+inline RunReport make_report(const Shard *all_sh, const Configuration &config,
+                             const DramTraffic &dram = {},
+                             const std::vector<MemoryPeak> &peaks = {},
+                             const std::vector<ThroughputSample> &samples = {},
+                             const LatencyCalibration &latency = {}) {
+  RunReport r;
+  r.tsc_hz = tsc_hz();
+  r.dram = dram;
+  r.stopped_early = stop_requested();
+  const double tsc_mhz = r.tsc_hz / 1e6;
+  auto mops = [tsc_mhz](const OpTimings &ops) {
+    return ops.op_count ? tsc_mhz / cycles_per_op(ops) : 0.0;
+  };
+
+  // The partitions of a partitioned HT add up; every thread of a shared HT
+  // sees all of it
+  const bool partitioned = config.ht_type == PARTITIONED_HT;
+  auto &t = r.total;
+  // events are summed over the threads that counted them all
+  t.insertions.events.fill(0);
+  t.finds.events.fill(0);
+  t.enqueues.events.fill(0);
+  for (size_t k = 0; k < config.num_threads; k++) {
+    const auto &st = *all_sh[k].stats;
+    auto &row = r.threads.emplace_back();
+    row.insertions = st.insertions;
+    row.finds = st.finds;
+    row.enqueues = st.enqueues;
+    row.fill = st.ht_fill;
+    row.capacity = st.ht_capacity;
+    row.insert_mops = mops(st.insertions);
+    row.find_mops = mops(st.finds);
 #ifdef CALC_STATS
-        ,
-        all_sh[k].stats->num_reprobes, all_sh[k].stats->num_memcmps,
-        all_sh[k].stats->num_memcpys, all_sh[k].stats->num_queue_flushes,
-        all_sh[k].stats->num_hashcmps,
-        all_sh[k].stats->max_distance_from_bucket,
-        all_sh[k].stats->avg_distance_from_bucket,
-        all_sh[k].stats->avg_distance_from_bucket / config.insert_factor,
-        all_sh[k].stats->avg_read_length, all_sh[k].stats->num_sequences
-#endif  // CALC_STATS
-    );
-    all_total_cycles += all_sh[k].stats->insertions.duration;
-    all_total_time_ns +=
-        (double)all_sh[k].stats->insertions.duration * one_cycle_ns;
-    all_total_num_inserts += all_sh[k].stats->insertions.op_count;
-    total_finds += all_sh[k].stats->finds.op_count;
-    total_find_cycles += all_sh[k].stats->finds.duration;
+    row.num_reprobes = st.num_reprobes;
+    row.num_memcmps = st.num_memcmps;
+    row.num_memcpys = st.num_memcpys;
+    row.num_queue_flushes = st.num_queue_flushes;
+    row.num_hashcmps = st.num_hashcmps;
+    row.max_distance_from_bucket = st.max_distance_from_bucket;
+    row.avg_distance_from_bucket = st.avg_distance_from_bucket;
+    row.avg_read_length = st.avg_read_length;
+    row.num_sequences = st.num_sequences;
+    t.num_reprobes += st.num_reprobes;
+    t.num_memcmps += st.num_memcmps;
+    t.num_memcpys += st.num_memcpys;
+    t.num_queue_flushes += st.num_queue_flushes;
+    t.num_hashcmps += st.num_hashcmps;
+    t.avg_read_length += st.avg_read_length;
+    t.num_sequences += st.num_sequences;
+    t.max_distance_from_bucket =
+        std::max(t.max_distance_from_bucket, st.max_distance_from_bucket);
+    t.avg_distance_from_bucket +=
+        st.avg_distance_from_bucket * st.ht_fill;
+#endif
+#ifdef PROBE_STATS
+    row.probes = st.probes;
+    t.probes += st.probes;
+#endif
 
+    t.insertions += st.insertions;
+    t.finds += st.finds;
+    t.enqueues += st.enqueues;
+    t.fill = partitioned ? t.fill + st.ht_fill : std::max(t.fill, st.ht_fill);
+    t.capacity = partitioned ? t.capacity + st.ht_capacity
+                             : std::max(t.capacity, st.ht_capacity);
+  }
 #ifdef CALC_STATS
-    all_total_num_sequences += all_sh[k].stats->num_sequences;
-    all_total_avg_read_length += all_sh[k].stats->avg_read_length;
-    all_total_reprobes += all_sh[k].stats->num_reprobes;
-    //all_total_find_time_ns =
-        //(double)all_sh[k].finds.duration * one_cycle_ns;
-#endif  // CALC_STATS
+  if (t.fill) t.avg_distance_from_bucket /= t.fill;
+  t.avg_read_length /= config.num_threads;
+#endif
+
+  // Every thread runs for about as long, so the run does the average
+  // thread's rate times the threads doing that kind of op: for bqueue
+  // inserts, the consumers; for R/W queues, the producers
+  uint64_t insert_threads = config.num_threads;
+  uint64_t find_threads = config.num_threads;
+  if (config.mode == BQ_TESTS_YES_BQ) {
+    insert_threads = config.n_cons;
+    find_threads = config.n_cons + config.n_prod;
   }
+  if (config.rw_queues) find_threads = config.n_prod;
+  t.insert_mops = mops(t.insertions) * insert_threads;
+  t.find_mops = mops(t.finds) * find_threads;
+  r.insert_bw =
+      phase_bandwidth(t.insertions, t.insert_mops, insert_threads, peaks);
+  r.find_bw = phase_bandwidth(t.finds, t.find_mops, find_threads, peaks);
 
-  const volatile auto a = config.num_threads;
-  const volatile auto b = all_total_num_inserts;
-  printf("%u %" PRIu64 "\n", config.num_threads, all_total_num_inserts);
-  printf("===============================================================\n");
-  printf(
-      "Average  : %" PRIu64 " cycles (%f ms) for %" PRIu64 " insertions (%" PRIu64 " cycles/insert) "
-      "(fill = %u %%)\n",
-      all_total_cycles / config.num_threads,
-      (double)all_total_time_ns / 1000000.0 / config.num_threads,
-      all_total_num_inserts / config.num_threads,
-      all_total_cycles / all_total_num_inserts, config.ht_fill);
-  // printf(
-  //     "Average (find): %" PRIu64 " cycles (%f ms) for %" PRIu64 " finds (%" PRIu64 " cycles per "
-  //     "find)\n",
-  //     all_total_find_cycles / config.num_threads,
-  //     (double)all_total_find_time_ns * one_cycle_ns / 1000,
-  //     kmer_big_pool_size_per_shard,
-  //     all_total_find_cycles / config.num_threads /
-  //         kmer_big_pool_size_per_shard);
-  printf("===============================================================\n");
-  printf("Total  : %" PRIu64 " cycles (%f ms) for %" PRIu64 " insertions\n", all_total_cycles,
-         (double)all_total_time_ns / 1000000.0, all_total_num_inserts);
-  double find_mops = 0.0, insert_mops = 0.0;
-
-  {
-    uint64_t cycles_per_insert = all_total_cycles / all_total_num_inserts;
-
-    uint64_t cycles_per_find = 0;
-
-    if (total_finds > 0) {
-      cycles_per_find = total_find_cycles / total_finds;
-      printf(
-          "===============================================================\n");
-      if (config.rw_queues) {
-        printf("Average  : %" PRIu64 " cycles for %" PRIu64 " combined R/W (%" PRIu64 " cycles/op)\n",
-              total_find_cycles / config.n_prod,
-              total_finds / config.n_prod, cycles_per_find);
+  r.samples = samples;
+  r.latency = latency;
+  for (auto &s : r.samples) {
+    if (s.fill && t.capacity) s.fill_pct = 100.0 * *s.fill / t.capacity;
+  }
+  return r;
+}
+
+/// A value in a JSON document or CSV cell. Non-finite numbers are left out.
+template <typename T>
+void put_report_value(FILE *out, const T &v, bool json) {
+  if constexpr (std::is_same_v<T, bool>) {
+    fputs(v ? "true" : "false", out);
+  } else if constexpr (std::is_floating_point_v<T>) {
+    if (std::isfinite(v)) {
+      fprintf(out, "%.10g", static_cast<double>(v));
+    } else if (json) {
+      fputs("null", out);
+    }
+  } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+    fprintf(out, "%" PRId64, static_cast<int64_t>(v));
+  } else if constexpr (std::is_integral_v<T>) {
+    fprintf(out, "%" PRIu64, static_cast<uint64_t>(v));
+  } else {
+    fputc('"', out);
+    for (const char c : std::string_view(v)) {
+      if (!json) {
+        if (c == '"') fputc('"', out);
+        fputc(c, out);
+      } else if (c == '"' || c == '\\') {
+        fprintf(out, "\\%c", c);
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        fprintf(out, "\\u%04x", c);
       } else {
-        printf("Average  : %" PRIu64 " cycles for %" PRIu64 " finds (%" PRIu64 " cycles/find)\n",
-              total_find_cycles / config.num_threads,
-              total_finds, cycles_per_find);
+        fputc(c, out);
       }
-      printf(
+    }
+    fputc('"', out);
+  }
+}
+
+/// `{ "tsc_hz", ..., "config": {...}, "threads": [{...}], "total": {...},
+/// "samples": [{...}], "latency_numa": [{...}], "mlp": [{...}] }`
+inline void print_json_report(FILE *out, const RunReport &r,
+                              const Configuration &config) {
+  bool first = true;
+  const char *indent = "  ";
+  auto field = [out, &first, &indent](const char *name, const auto &value) {
+    fprintf(out, "%s\n%s\"%s\": ", first ? "" : ",", indent, name);
+    put_report_value(out, value, true);
+    first = false;
+  };
+
+  fputc('{', out);
+  r.visit(field);
+  indent = "    ";
+  fprintf(out, ",\n  \"config\": {");
+  first = true;
+  config.visit_fields(field);
+  fprintf(out, "\n  },\n  \"threads\": [");
+  for (size_t k = 0; k < r.threads.size(); k++) {
+    fprintf(out, "%s{", k ? ", " : "");
+    first = true;
+    field("thread", k);
+    r.threads[k].visit(field);
+    fprintf(out, "\n  }");
+  }
+  fprintf(out, "],\n  \"total\": {");
+  first = true;
+  r.total.visit(field);
+#ifdef PROBE_STATS
+  // the histograms of the run: counts by probe length, and of home slots
+  // by the part of the table they fall in
+  auto histogram = [out](const char *name, const ProbeHistograms::Histogram &h,
+                         bool last) {
+    fprintf(out, "\n    \"%s\": [", name);
+    for (auto i = 0u; i < h.size(); i++) {
+      fprintf(out, "%s%" PRIu64, i ? ", " : "", h[i]);
+    }
+    fprintf(out, "]%s", last ? "" : ",");
+  };
+  fprintf(out, "\n  },\n  \"probe_histograms\": {");
+  for (auto o = 0u; o < r.total.probes.counts.size(); o++) {
+    histogram(probe_outcome_strings[o], r.total.probes.counts[o], false);
+  }
+  histogram("homes", r.total.probes.homes, true);
+#endif
+  fprintf(out, "\n  }");
+  auto rows = [out, &first, &field](const char *name, const auto &list) {
+    fprintf(out, ",\n  \"%s\": [", name);
+    for (size_t k = 0; k < list.size(); k++) {
+      fprintf(out, "%s{", k ? ", " : "");
+      first = true;
+      list[k].visit(field);
+      fprintf(out, "\n  }");
+    }
+    fputc(']', out);
+  };
+  rows("samples", r.samples);
+  rows("latency_numa", r.latency.numa);
+  rows("mlp", r.latency.mlp);
+  fprintf(out, "\n}\n");
+}
+
+/// A header, then a row per thread and a row "all" for the whole run. Every
+/// row repeats the values of the run and the configuration, so that the
+/// reports of several runs can be concatenated. The samples of --sample-ms
+/// have no place in it; they are in the other formats.
+inline void print_csv_report(FILE *out, const RunReport &r,
+                             const Configuration &config) {
+  auto name = [out](const char *name, const auto &) {
+    fprintf(out, ",%s", name);
+  };
+  auto cell = [out](const char *, const auto &value) {
+    fputc(',', out);
+    put_report_value(out, value, false);
+  };
+  auto row = [&](const char *thread, const ReportRow &row) {
+    fputs(thread, out);
+    row.visit(cell);
+    r.visit(cell);
+    config.visit_fields(cell);
+    fputc('\n', out);
+  };
+
+  fputs("thread", out);
+  r.total.visit(name);
+  r.visit(name);
+  config.visit_fields(name);
+  fputc('\n', out);
+  for (size_t k = 0; k < r.threads.size(); k++) {
+    row(std::to_string(k).c_str(), r.threads[k]);
+  }
+  row("all", r.total);
+}
+
+#ifdef PROBE_STATS
+/// Per outcome, the share of ops by probe length, e.g.
+/// `Probe lengths of insert_miss: 1000 ops, mean 0.04, p99 1 | 0: 96.1 % ...`,
+/// and how evenly the home slots spread over the table.
+inline void print_probe_histograms(FILE *out, const ProbeHistograms &probes) {
+  for (auto o = 0u; o < probes.counts.size(); o++) {
+    const auto outcome = static_cast<ProbeOutcome>(o);
+    const auto ops = probes.ops(outcome);
+    if (!ops) continue;
+    fprintf(out,
+            "Probe lengths of %s: %" PRIu64 " ops, mean %.3f, p99 %u |",
+            probe_outcome_strings[o], ops, probes.mean(outcome),
+            probes.percentile(outcome, 99));
+    const auto &h = probes[outcome];
+    for (auto i = 0u; i < h.size(); i++) {
+      if (!h[i]) continue;
+      fprintf(out, " %u%s: %.2f %%", i, i == h.size() - 1 ? "+" : "",
+              100.0 * h[i] / ops);
+    }
+    fputc('\n', out);
+  }
+  const auto [min, max] =
+      std::minmax_element(probes.homes.begin(), probes.homes.end());
+  if (*max) {
+    fprintf(out,
+            "Home slots over %u parts of the table: %" PRIu64 " to %" PRIu64
+            " ops a part\n",
+            PROBE_HISTOGRAM_BUCKETS, *min, *max);
+  }
+}
+#endif
+
+/// The human-readable summary; scripts/graph parses some of its lines.
+inline void print_text_report(FILE *out, const RunReport &r,
+                              const Configuration &config) {
+  const double tsc_mhz = r.tsc_hz / 1e6;
+  const double one_cycle_ns = 1000 / tsc_mhz;
+
+  fprintf(out,
           "===============================================================\n");
+  if (r.stopped_early) {
+    fprintf(out, "Stopped early on request: these counts are partial\n");
+  }
+  for (size_t k = 0; k < r.threads.size(); k++) {
+    const auto &row = r.threads[k];
+    fprintf(out,
+            "Thread %2zu: "
+            "%" PRIu64 " cycles (%f ms) for %" PRIu64 " insertions (%" PRIu64
+            " cycles/insert) | (%" PRIu64 " cycles/enqueue) "
+            "{ fill: %" PRIu64 " of %" PRIu64 " (%f %%) }",
+            k, row.insertions.duration,
+            row.insertions.duration * one_cycle_ns / 1000000.0,
+            row.insertions.op_count, cycles_per_op_or_zero(row.insertions),
+            cycles_per_op_or_zero(row.enqueues), row.fill, row.capacity,
+            row.capacity == 0 ? 0 : (double)row.fill / row.capacity * 100);
+#ifdef CALC_STATS
+    fprintf(out,
+            "["
+            "num_reprobes: %" PRIu64 ", "
+            "num_memcmps: %" PRIu64 ", "
+            "num_memcpys: %" PRIu64 ", "
+            "num_queue_flushes: %" PRIu64 ", "
+            "num_hashcmps: %" PRIu64 ", "
+            "max_distance_from_bucket: %" PRIu64 ", "
+            "avg_distance_from_bucket: %f,"
+            "avg_distance_from_bucket (adjusted): %f,"
+            "avg_read_length: %" PRIu64 ","
+            "num_sequences :%" PRIu64 ""
+            "]",
+            row.num_reprobes, row.num_memcmps, row.num_memcpys,
+            row.num_queue_flushes, row.num_hashcmps,
+            row.max_distance_from_bucket, row.avg_distance_from_bucket,
+            row.avg_distance_from_bucket / config.insert_factor,
+            row.avg_read_length, row.num_sequences);
+#endif  // CALC_STATS
+    fputc('\n', out);
+  }
+
+  const auto &t = r.total;
+  const auto cycles_per_insert = cycles_per_op_or_zero(t.insertions);
+  const auto cycles_per_find = cycles_per_op_or_zero(t.finds);
+  fprintf(out, "%u %" PRIu64 "\n", config.num_threads, t.insertions.op_count);
+  fprintf(out,
+          "===============================================================\n");
+  fprintf(out,
+          "Average  : %" PRIu64 " cycles (%f ms) for %" PRIu64
+          " insertions (%" PRIu64 " cycles/insert) (fill = %u %%)\n",
+          t.insertions.duration / config.num_threads,
+          t.insertions.duration * one_cycle_ns / 1000000.0 / config.num_threads,
+          t.insertions.op_count / config.num_threads, cycles_per_insert,
+          config.ht_fill);
+  fprintf(out,
+          "===============================================================\n");
+  fprintf(out,
+          "Total  : %" PRIu64 " cycles (%f ms) for %" PRIu64 " insertions\n",
+          t.insertions.duration,
+          t.insertions.duration * one_cycle_ns / 1000000.0,
+          t.insertions.op_count);
+
+  if (t.finds.op_count > 0) {
+    fprintf(out,
+            "===============================================================\n");
+    if (config.rw_queues) {
+      fprintf(out,
+              "Average  : %" PRIu64 " cycles for %" PRIu64
+              " combined R/W (%" PRIu64 " cycles/op)\n",
+              t.finds.duration / config.n_prod,
+              t.finds.op_count / config.n_prod, cycles_per_find);
+    } else {
+      fprintf(out,
+              "Average  : %" PRIu64 " cycles for %" PRIu64
+              " finds (%" PRIu64 " cycles/find)\n",
+              t.finds.duration / config.num_threads, t.finds.op_count,
+              cycles_per_find);
     }
+    fprintf(out,
+            "===============================================================\n");
+  }
 
-    uint64_t num_threads = config.num_threads;
-    // for inserts, we only use n_cons
-    if (config.mode == BQ_TESTS_YES_BQ) {
-      num_threads = config.n_cons;
+  fprintf(out, "Number of insertions per sec (Mops/s): %.3f\n", t.insert_mops);
+  fprintf(out, "Number of finds per sec (Mops/s): %.3f\n", t.find_mops);
+  fprintf(out, "{ set_cycles : %" PRIu64 ", get_cycles : %" PRIu64 ",",
+          cycles_per_insert, cycles_per_find);
+  fprintf(out, " set_mops : %.3f, get_mops : %.3f }\n", t.insert_mops,
+          t.find_mops);
+  fprintf(out, "(TSC %.3f MHz)\n", tsc_mhz);
+
+  // { cycles: 812.000, instructions: 403.500, ... } per op, if counted
+  auto print_events = [out](const char *op, const OpTimings &ops) {
+    bool any = false;
+    for (auto e = 0u; e < static_cast<std::size_t>(PerfEvent::Count); e++) {
+      const auto per_op = events_per_op(ops, static_cast<PerfEvent>(e));
+      if (!std::isfinite(per_op)) continue;
+      fprintf(out, "%s%s: %.3f", any ? ", " : "", perf_event_strings[e],
+              per_op);
+      any = true;
     }
-    insert_mops = ((double)2600 / cycles_per_insert) * num_threads;
-    printf("Number of insertions per sec (Mops/s): %.3f\n", insert_mops);
+    if (any) fprintf(out, " per %s\n", op);
+  };
+  print_events("insert", t.insertions);
+  print_events("find", t.finds);
+  if (std::isfinite(r.dram.read_bytes)) {
+    fprintf(out, "DRAM: %.3f GB read, %.3f GB written\n",
+            r.dram.read_bytes / 1e9, r.dram.write_bytes / 1e9);
+  }
+  auto print_bandwidth = [out](const char *phase, const PhaseBandwidth &bw) {
+    if (!std::isfinite(bw.lines_per_sec)) return;
+    fprintf(out,
+            "Memory, %s: %.1f M lines/s, %.1f %% of random peak, %.1f %% of "
+            "sequential peak, %.2f misses in flight per thread (%s)\n",
+            phase, bw.lines_per_sec / 1e6, bw.random_peak_pct,
+            bw.seq_peak_pct, bw.mlp_per_thread,
+            bw.bandwidth_bound() ? "bandwidth-bound" : "latency-bound");
+  };
+  print_bandwidth("inserts", r.insert_bw);
+  print_bandwidth("finds", r.find_bw);
+  if (r.latency.suggested_queue_len) {
+    fprintf(out,
+            "Calibrated load latency: %.1f ns (4K pages), %.1f ns (2M), %.1f "
+            "ns (1G); suggested prefetch queue length %u\n",
+            r.latency.latency_4k_ns, r.latency.latency_2m_ns,
+            r.latency.latency_1g_ns, r.latency.suggested_queue_len);
+  }
+#ifdef PROBE_STATS
+  print_probe_histograms(out, r.total.probes);
+#endif
+  for (const auto &s : r.samples) {
+    fprintf(out, "Sample at %.3f s: %.3f insert Mops/s, %.3f find Mops/s, ",
+            s.secs, s.insert_mops, s.find_mops);
+    if (std::isfinite(s.fill_pct)) fprintf(out, "fill %.1f %%, ", s.fill_pct);
+    fprintf(out, "%.3f reprobes/op\n", s.reprobes_per_op);
+  }
+  fprintf(out,
+          "===============================================================\n");
+}
+
+/// Write the stats of the run to `config.stats_file` (stdout if unset) in
+/// `config.report_format`.
+inline void print_stats(Shard *all_sh, Configuration &config,
+                        const DramTraffic &dram = {}) {
+  const auto report =
+      make_report(all_sh, config, dram, memory_peaks, throughput_samples,
+                  latency_calibration);
 
-    // for find, we use all threads
-    // or for R/W, only n_prod
-    if (config.mode == BQ_TESTS_YES_BQ) {
-      num_threads = config.n_cons + config.n_prod;
+  FILE *out = stdout;
+  if (!config.stats_file.empty()) {
+    out = fopen(config.stats_file.c_str(), "w");
+    if (!out) {
+      PLOGE.printf("Cannot write the report to %s: %s",
+                   config.stats_file.c_str(), strerror(errno));
+      out = stdout;
     }
-    find_mops = ((double)2600 / cycles_per_find) * (config.rw_queues ? config.n_prod : num_threads);
-    printf("%s, num_threads %" PRIu64 "\n", __func__, num_threads);
-    printf("Number of finds per sec (Mops/s): %.3f\n", find_mops);
-
-    printf("{ set_cycles : %" PRIu64 ", get_cycles : %" PRIu64 ",", cycles_per_insert, cycles_per_find);
-    printf(" set_mops : %.3f, get_mops : %.3f }\n", insert_mops, find_mops);
-  }
-
-  // printf(
-  //     "Average (find): %" PRIu64 " cycles (%f ms) for %" PRIu64 " finds (%" PRIu64 " cycles per "
-  //     "find)\n",
-  //     all_total_find_cycles / config.num_threads,
-  //     (double)all_total_find_time_ns * one_cycle_ns / 1000,
-  //     kmer_big_pool_size_per_shard,
-  //     all_total_find_cycles / config.num_threads /
-  //         kmer_big_pool_size_per_shard);
-  printf("===============================================================\n");
+  }
+
+  switch (config.report_format) {
+    case ReportFormat::Text:
+      print_text_report(out, report, config);
+      break;
+    case ReportFormat::Json:
+      print_json_report(out, report, config);
+      break;
+    case ReportFormat::Csv:
+      print_csv_report(out, report, config);
+      break;
+  }
+
+  if (out != stdout) {
+    fclose(out);
+    PLOGI.printf("Wrote the %s report to %s",
+                 report_format_strings[static_cast<int>(config.report_format)],
+                 config.stats_file.c_str());
+  } else {
+    fflush(out);
+  }
 }
 
 }  // namespace kmercounter
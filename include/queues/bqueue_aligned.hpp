@@ -1,6 +1,8 @@
 #pragma once
 
+#include "helper.hpp"
 #include "queue.hpp"
+#include "utils/trace.hpp"
 #include <tuple>
 #include <map>
 #include <assert.h>
@@ -22,7 +24,7 @@ class BQueueAligned {
   public:
     const uint64_t CONGESTION_PENALTY = 250 / 2;
     static const uint64_t BQ_MAGIC_64BIT = 0xD221A6BE96E04673UL;
-    const data_t BQ_MAGIC_KV = data_t(BQ_MAGIC_64BIT, BQ_MAGIC_64BIT);
+    static inline const data_t BQ_MAGIC_KV{BQ_MAGIC_64BIT, BQ_MAGIC_64BIT};
 
     typedef struct {
       volatile uint32_t head;
@@ -116,7 +118,16 @@ class BQueueAligned {
     }
 
 
+    // a zeroed slot is free
+    static inline bool occupied(const data_t &slot) {
+      return !(slot == data_t{});
+    }
+
   public:
+    explicit BQueueAligned(uint32_t nprod, uint32_t ncons, size_t queue_size,
+                           NumaPolicyQueues *)
+        : BQueueAligned(nprod, ncons, queue_size) {}
+
     explicit BQueueAligned(uint32_t nprod, uint32_t ncons, size_t queue_size) {
       assert((queue_size & (queue_size - 1)) == 0);
       this->queue_size = queue_size;
@@ -137,13 +148,27 @@ class BQueueAligned {
     }
 
     int enqueue(uint32_t p, uint32_t c, data_t value) {
-      auto pq = &this->all_pqueues[p][c];
+      return enqueue(&this->all_pqueues[p][c], value);
+    }
+
+    /// Waits while the queue is full.
+    int enqueue(prod_queue_t *pq, uint32_t p, uint32_t c, data_t value) {
+      if (enqueue(pq, value) == SUCCESS) [[likely]] {
+        return SUCCESS;
+      }
+      const TraceScope stall(TraceEvent::QueueFull);
+      while (enqueue(pq, value) != SUCCESS)
+        ;
+      return SUCCESS;
+    }
+
+    int enqueue(prod_queue_t *pq, data_t value) {
       uint32_t tmp_head;
       if (pq->head == pq->batch_head) {
         tmp_head = pq->head + this->batch_size;
         if (tmp_head >= this->queue_size) tmp_head = 0;
 
-        if (pq->data[tmp_head]) {
+        if (occupied(pq->data[tmp_head])) {
           fipc_test_time_wait_ticks(CONGESTION_PENALTY);
           return RETRY;
         }
@@ -188,13 +213,13 @@ class BQueueAligned {
 
       unsigned long batch_size = this->batch_size;
 #if defined(OPTIMIZE_BACKTRACKING2)
-      if ((!q->data[tmp_tail]) && !q->backtrack_flag) {
+      if (!occupied(q->data[tmp_tail]) && !q->backtrack_flag) {
         fipc_test_time_wait_ticks(CONGESTION_PENALTY);
         return -1;
       }
 #endif
 
-      while (!(q->data[tmp_tail])) {
+      while (!occupied(q->data[tmp_tail])) {
         if (batch_size > 1) {
           batch_size = batch_size >> 1;
           tmp_tail = q->tail + batch_size - 1;
@@ -221,8 +246,10 @@ class BQueueAligned {
     }
 
     int dequeue(uint32_t p, uint32_t c, data_t *value) {
-      auto cq = &this->all_cqueues[c][p];
+      return dequeue(&this->all_cqueues[c][p], p, c, value);
+    }
 
+    int dequeue(cons_queue_t *cq, uint32_t p, uint32_t c, data_t *value) {
       if (cq->tail == cq->batch_tail) {
         if (backtracking(cq) != 0) return RETRY;
       }
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace kmercounter {
+
+/// Producer-side combining window for one destination queue.
+///
+/// A direct-mapped table of `(key, count)` slots: repeated occurrences of a
+/// key that stays resident in its slot are merged into a single `(key, n)`
+/// message. A colliding key evicts the resident pair, which is handed to
+/// `emit` and is then enqueued by the caller. Hot keys under skew stay
+/// resident and collapse into few messages; cold keys pay one extra copy.
+class KeyCombiner {
+ public:
+  KeyCombiner() = default;
+
+  /// `window` must be a power of two.
+  explicit KeyCombiner(uint32_t window) : slots_(window), mask_(window - 1) {
+    assert((window & (window - 1)) == 0);
+  }
+
+  /// Account one occurrence of `key`. `hash` picks the slot.
+  template <typename Emit>
+  inline void add(uint64_t key, uint64_t hash, Emit &&emit) {
+    auto &slot = slots_[hash & mask_];
+    if (slot.count && slot.key == key) {
+      slot.count++;
+      return;
+    }
+    if (slot.count) {
+      emit(slot.key, slot.count);
+      num_emitted_++;
+    }
+    slot.key = key;
+    slot.count = 1;
+  }
+
+  /// Emit every resident pair and empty the window.
+  template <typename Emit>
+  void flush(Emit &&emit) {
+    for (auto &slot : slots_) {
+      if (slot.count) {
+        emit(slot.key, slot.count);
+        num_emitted_++;
+        slot.count = 0;
+      }
+    }
+  }
+
+  /// Number of `(key, n)` messages emitted so far.
+  uint64_t num_emitted() const { return num_emitted_; }
+
+ private:
+  struct Slot {
+    uint64_t key;
+    uint64_t count;
+  };
+
+  std::vector<Slot> slots_;
+  uint64_t mask_ = 0;
+  uint64_t num_emitted_ = 0;
+};
+
+}  // namespace kmercounter
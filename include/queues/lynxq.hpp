@@ -37,6 +37,7 @@ https://www.repository.cam.ac.uk/handle/1810/255384
 #include <limits.h>
 #include <time.h>		/* clock_t */
 #include <pthread.h>
+#include <atomic>
 #include <set>
 #include <map>
 #include "queue.hpp"
@@ -112,15 +113,17 @@ typedef struct Queue_state
     push_index = push_index_tmp;					\
   }
 
+/* The redzone handler moves the index register past the redzone, so the
+   index is an in/out operand and the next one is computed from it */
 #define DEFINE_PUSH_OVERLOADED_1OP(TYPE, MOV)				\
   inline void push(TYPE data)						\
   {									\
     char *push_index_tmp = push_index;					\
-    asm(MOV" %0, (%1)"						\
-    	:	/* no outputs */					\
-    	: "r" (data),  "r" ((TYPE*)push_index_tmp) /* inputs */ \
+    asm volatile(MOV" %1, (%0)"						\
+    	: "+r" (push_index_tmp)						\
+    	: "r" (data) /* inputs */					\
     	: "1" );							\
-    push_index = (char *)((uint64_t)push_index + sizeof(TYPE));		\
+    push_index = push_index_tmp + sizeof(TYPE);				\
   }
 
 
@@ -129,9 +132,9 @@ typedef struct Queue_state
   {									\
     TYPE data;								\
     char *pop_index_tmp = pop_index;					\
-    asm(MOV" (%1), %0"						\
-    	: "=&r" (data)							\
-    	: "r" ((TYPE *)pop_index_tmp) 	/* inputs */ \
+    asm volatile(MOV" (%1), %0"						\
+    	: "=&r" (data), "+r" (pop_index_tmp)				\
+    	: /* no inputs */						\
     	: "1" );							\
     pop_index_tmp += sizeof(TYPE);						\
     pop_index = pop_index_tmp;                \
@@ -210,7 +213,8 @@ struct alignas(4096) lynxQ {
   CACHE_ALIGNED char *redzone1;
   CACHE_ALIGNED char *redzone2;
   CACHE_ALIGNED char *redzone_end;
-  CACHE_ALIGNED bool allow_rotate;
+  /* Set by push() once pop() may wrap around; read by the consumer */
+  CACHE_ALIGNED std::atomic<bool> allow_rotate;
   clock_t time_begin;
   clock_t time_end;
   double queue_time;
@@ -656,6 +660,8 @@ lynxQ::lynxQ(size_t qsize, struct prod_queue *pq, struct cons_queue *cq) {
 
   /* Initialize queue state */
   qstate.sstate0 = PUSH_WRITES;
+  /* push_done() may come before the first redzone */
+  last_push_state = &qstate.sstate0;
   qstate.redzone1_state = FREE;
   qstate.redzone2_state = FREE;
   qstate.num_push = 0;
@@ -756,6 +762,8 @@ lynxQ::lynxQ(size_t qsize, struct prod_queue *pq, struct cons_queue *cq) {
 
   /* Initialize queue state */
   qstate.sstate0 = PUSH_WRITES;
+  /* push_done() may come before the first redzone */
+  last_push_state = &qstate.sstate0;
   qstate.redzone1_state = FREE;
   qstate.redzone2_state = FREE;
   qstate.num_push = qstate.num_pop = 0;
@@ -1258,7 +1266,7 @@ class LynxQueue {
     cons_queue_t **all_cqueues;
 
     static const uint64_t BQ_MAGIC_64BIT = 0xD221A6BE96E04673UL;
-    const data_t BQ_MAGIC_KV = data_t(BQ_MAGIC_64BIT, BQ_MAGIC_64BIT);
+    static inline const data_t BQ_MAGIC_KV{BQ_MAGIC_64BIT, BQ_MAGIC_64BIT};
 
     void init_prod_queues() {
       // map queues and producer_metadata
@@ -1292,9 +1300,15 @@ class LynxQueue {
     }
 
 
+    explicit LynxQueue(uint32_t nprod, uint32_t ncons, size_t queue_size,
+                       NumaPolicyQueues *)
+        : LynxQueue(nprod, ncons, queue_size) {}
+
     explicit LynxQueue(uint32_t nprod, uint32_t ncons, size_t queue_size) {
 
       printf("%s, lynx queue init | queue_sz %zu\n", __func__, queue_size);
+      // the redzones trap into lynxQ_nomprotect_handler
+      setup_signal_handler();
 
       this->queue_size = queue_size;
       this->nprod = nprod;
@@ -1334,6 +1348,16 @@ class LynxQueue {
       queues[0][0]->dump();
     }
 
+    static inline bool pop_would_block(const cons_queue_t *cq,
+                                       const queue_t *q) {
+      constexpr auto ready = PUSH_READY | PUSH_EXITED;
+      if (cq->pop_index == q->redzone1) return !(q->qstate.sstate1 & ready);
+      if (cq->pop_index == q->redzone2) return !(q->qstate.sstate0 & ready);
+      // the first pop waits at the end of the queue until it may rotate
+      if (cq->pop_index == q->QUEUE + q->queue_size) return !q->allow_rotate;
+      return false;
+    }
+
     inline void prefetch(uint32_t p, uint32_t c, bool is_prod)  {
       auto q = queues[p][c];
       if (is_prod) {
@@ -1359,25 +1383,49 @@ class LynxQueue {
     }
 
     inline int enqueue(uint32_t p, uint32_t c, data_t value)  {
-      auto pq = &all_pqueues[p][c];
-      auto q = queues[p][c];
+      return enqueue(&all_pqueues[p][c], p, c, value);
+    }
 
+    /// A pair is pushed as two 8-byte words: the handler decodes a single
+    /// `movq` per access. Sections are a multiple of 16 bytes, so a pair
+    /// never straddles a redzone.
+    inline int enqueue(prod_queue_t *pq, uint32_t p, uint32_t c,
+                       data_t value) {
 #if 0
       if (!((uint64_t)pq->push_index & ((1 << 13) - 1)))
       printf("pq->push_index 0x%lx | push_reg 0x%lx | value %" PRIu64 "\n",
             pq->push_index, pq->free_push_reg, value);
 #endif
-      pq->push(value);
+      pq->push(static_cast<long>(value.key));
+#if !defined(BQUEUE_KMER_TEST)
+      pq->push(static_cast<long>(value.value));
+#endif
 
       return SUCCESS;
     }
 
     inline int dequeue(uint32_t p, uint32_t c, data_t *value) {
+      return dequeue(&all_cqueues[c][p], p, c, value);
+    }
+
+    /// Returns RETRY instead of trapping into a redzone whose next section
+    /// the producer has not released yet; the handler would spin there and
+    /// keep the consumer from serving its other queues.
+    inline int dequeue(cons_queue_t *cq, uint32_t p, uint32_t c,
+                       data_t *value) {
       int ret = SUCCESS;
-      auto cq = &all_cqueues[c][p];
       auto q = queues[p][c];
 
-      *value = {cq->pop_long(), 0};
+      if (pop_would_block(cq, q)) {
+        return RETRY;
+      }
+
+      const auto key = cq->pop_long();
+#if defined(BQUEUE_KMER_TEST)
+      *value = data_t(key, 0);
+#else
+      *value = data_t(key, cq->pop_long());
+#endif
 #if 0
       if (!((uint64_t)cq->pop_index & ((1 << 12) - 1)))
         printf("cq->pop_index 0x%lx | pop_reg 0x%lx | ea 0x%lx | value %" PRIu64 "\n",
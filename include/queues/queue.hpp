@@ -4,7 +4,10 @@
 #include <cstdint>
 #include <unistd.h>
 
-typedef uint64_t data_t;
+#include <concepts>
+
+#include "numa.hpp"
+#include "types.hpp"
 
 #define FIPC_CACHE_LINE_SIZE  64
 #define SUCCESS   0
@@ -12,14 +15,33 @@ typedef uint64_t data_t;
 
 #define CACHE_ALIGNED __attribute__((aligned(FIPC_CACHE_LINE_SIZE)))
 
-/*
-template <typename T>
-class Queue {
-  public:
-  virtual inline int enqueue(int, int, T data) = 0;
-  virtual int dequeue(int, int, T *data) = 0;
-  virtual void push_done(int, int) = 0;
-  virtual void pop_done(int, int) = 0;
-  virtual ~Queue() { }
+namespace kmercounter {
+
+// data_t represents a k,v pair (2*8B = 16B)
+#if defined(BQUEUE_KMER_TEST)
+typedef Key data_t;
+#else
+typedef KeyValuePair data_t;
+#endif
+
+/// A set of producer/consumer queues, as driven by QueueTest (--queue-type).
+/// Queues are indexed [producer][consumer]. `enqueue` waits while the queue
+/// is full; `dequeue` returns RETRY when there is nothing to read yet. After
+/// `push_done`, the consumer reads up to a `BQ_MAGIC_KV`.
+template <typename Q>
+concept BQueue = std::constructible_from<Q, uint32_t, uint32_t, size_t,
+                                         NumaPolicyQueues *> &&
+    requires(Q &q, typename Q::prod_queue_t *pq, typename Q::cons_queue_t *cq,
+             data_t v, uint32_t i) {
+  { q.all_pqueues[i][i] } -> std::same_as<typename Q::prod_queue_t &>;
+  { q.all_cqueues[i][i] } -> std::same_as<typename Q::cons_queue_t &>;
+  { q.enqueue(pq, i, i, v) } -> std::same_as<int>;
+  { q.dequeue(cq, i, i, &v) } -> std::same_as<int>;
+  { Q::BQ_MAGIC_KV } -> std::convertible_to<data_t>;
+  q.prefetch(i, i, true);
+  q.push_done(i, i);
+  q.pop_done(i, i);
+  q.dump_stats(i, i);
 };
-*/
+
+}  // namespace kmercounter
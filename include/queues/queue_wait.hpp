@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cpuid.h>
+#include <immintrin.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+namespace kmercounter {
+
+/// TPAUSE/UMWAIT are available (CPUID.7.0:ECX.WAITPKG).
+inline bool detect_waitpkg() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+  return ecx & (1u << 5);
+}
+
+inline const bool has_waitpkg = detect_waitpkg();
+
+__attribute__((target("waitpkg"))) inline void tpause_until(uint64_t tsc) {
+  // C0.1: the lighter state, which wakes up faster
+  _tpause(1, tsc);
+}
+
+/// Back off a spinning thread for about `cycles`: TPAUSE where the host has
+/// it, so that the sibling hyperthread gets the core, or a single PAUSE.
+inline void relax(uint64_t cycles) {
+  if (has_waitpkg) {
+    tpause_until(_rdtsc() + cycles);
+  } else {
+    _mm_pause();
+  }
+}
+
+/// Where a consumer sleeps once it has been idle for long enough. Producers
+/// that publish to it call `wake`, which costs a fence and a load while the
+/// consumer is awake.
+struct alignas(64) ParkingSpot {
+  std::atomic_uint32_t seq{0};
+  std::atomic_uint32_t parked{0};
+  uint64_t num_parks = 0;
+
+  /// Sleep until `wake`, unless `has_work()` finds something to do after
+  /// the producers can see that we are parked. The timeout bounds the sleep
+  /// should a wake-up ever be missed.
+  template <typename HasWork>
+  void park(HasWork &&has_work, long timeout_ns = 1'000'000) {
+    const auto s = seq.load(std::memory_order_acquire);
+    parked.store(1, std::memory_order_relaxed);
+    // pairs with the fence in `wake`: either we see the new data or the
+    // producer sees `parked`
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!has_work()) {
+      const timespec timeout{0, timeout_ns};
+      syscall(SYS_futex, &seq, FUTEX_WAIT_PRIVATE, s, &timeout, nullptr, 0);
+      num_parks++;
+    }
+    parked.store(0, std::memory_order_relaxed);
+  }
+
+  /// Called after publishing data to the consumer.
+  void wake() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked.load(std::memory_order_relaxed)) [[unlikely]] {
+      seq.fetch_add(1, std::memory_order_release);
+      syscall(SYS_futex, &seq, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+  }
+};
+
+}  // namespace kmercounter
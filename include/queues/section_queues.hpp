@@ -3,12 +3,20 @@
 #include <assert.h>
 #include <numaif.h>
 
+#include <algorithm>
+#include <bit>
+#include <cstring>
 #include <map>
 #include <numa.hpp>
+#include <span>
 #include <tuple>
+#include <vector>
 
+#include "hashtables/simd_helpers.hpp"
 #include "helper.hpp"
 #include "queue.hpp"
+#include "queue_wait.hpp"
+#include "utils/trace.hpp"
 
 #include "../types.hpp"
 
@@ -16,20 +24,62 @@ namespace kmercounter {
 
 extern Configuration config;
 
-// data_t represents a k,v pair (2*8B = 16B)
-#if defined(BQUEUE_KMER_TEST)
-typedef Key data_t;
-#else
-typedef KeyValuePair data_t;
-#endif
-
 class SectionQueue;
 
 extern const uint64_t CACHELINE_SIZE;
 extern const uint64_t CACHELINE_MASK;
 extern const uint64_t PAGESIZE;
 
+// Section size of a pair on one node; see `pair_section_size`
 static const uint64_t SECTION_SIZE = 4096 * 1;
+static const uint64_t MIN_SECTION_SIZE = 1024;
+static const uint64_t MAX_SECTION_SIZE = 64 * 1024;
+// numa_distance() of a node to itself
+static const int LOCAL_DISTANCE = 10;
+
+/// Section size of the queue from a producer on `prod_cpu` to a consumer on
+/// `cons_cpu`. Sections are the unit of handover: the hyperthreads of one
+/// core share their caches and hand over smaller ones, while across nodes
+/// sections grow with the NUMA distance, so that every remote round trip on
+/// the shared pointers carries more messages.
+inline uint64_t pair_section_size(uint32_t prod_cpu, uint32_t cons_cpu) {
+  const auto prod_node = numa_node_of_cpu(prod_cpu);
+  const auto cons_node = numa_node_of_cpu(cons_cpu);
+  if (prod_node == cons_node) {
+    return cpu_core_id(prod_cpu) == cpu_core_id(cons_cpu) ? MIN_SECTION_SIZE
+                                                          : SECTION_SIZE;
+  }
+  const auto distance = numa_distance(prod_node, cons_node);
+  const auto hops = std::max(distance, LOCAL_DISTANCE) / LOCAL_DISTANCE;
+  return std::min(SECTION_SIZE * std::bit_floor<uint64_t>(hops),
+                  MAX_SECTION_SIZE);
+}
+
+#ifdef AVX_SUPPORT
+/// Copy `n` bytes into a queue section in full cachelines. With
+/// BQ_NT_STORES, aligned lines bypass the cache: the consumer runs on another
+/// core, so the producer gains nothing from owning them.
+SIMD_TARGET_AVX512 inline void copy_run_avx512(void *dst, const void *src,
+                                               size_t n) {
+  auto d = static_cast<char *>(dst);
+  auto s = static_cast<const char *>(src);
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    const __m512i line = _mm512_loadu_si512(s + i);
+#ifdef BQ_NT_STORES
+    if (((uint64_t)(d + i) & 63) == 0) {
+      _mm512_stream_si512(reinterpret_cast<__m512i *>(d + i), line);
+      continue;
+    }
+#endif
+    _mm512_storeu_si512(d + i, line);
+  }
+  if (i < n) {
+    const __mmask64 tail = ~0ull >> (64 - (n - i));
+    _mm512_mask_storeu_epi8(d + i, tail, _mm512_maskz_loadu_epi8(tail, s + i));
+  }
+}
+#endif
 
 struct SectionQueueInner {
   struct prod_queue {
@@ -37,6 +87,7 @@ struct SectionQueueInner {
     data_t *volatile deqLocalPtr;
     data_t *data;
     data_t *queue_end;
+    uint64_t section_mask;
   };
 
   struct cons_queue {
@@ -44,6 +95,7 @@ struct SectionQueueInner {
     data_t *volatile enqLocalPtr;
     data_t *data;
     data_t *queue_end;
+    uint64_t section_mask;
   };
 
   struct prod_cons_shared {
@@ -82,13 +134,15 @@ struct SectionQueueInner {
       PLOGD.printf("QUEUE_SECTION_SIZE:  0x%lx", section_size);
     }
 
-    explicit SectionQueueInner(size_t queue_size, struct prod_queue *pq, struct
-        cons_queue *cq, struct prod_cons_shared *pcq) {
+    explicit SectionQueueInner(size_t queue_size, size_t section_size,
+                               struct prod_queue *pq, struct cons_queue *cq,
+                               struct prod_cons_shared *pcq) {
       this->queue_size = queue_size;
       this->QUEUE = pq->data;
       this->QUEUE_END = pq->data + queue_size / sizeof(data_t);
       cq->queue_end = pq->queue_end = this->QUEUE_END;
-      this->section_size = kmercounter::SECTION_SIZE;
+      cq->section_mask = pq->section_mask = section_size - 1;
+      this->section_size = section_size;
       this->num_sections = this->queue_size / this->section_size;
       this->pq = pq;
       this->cq = cq;
@@ -108,13 +162,19 @@ class SectionQueue {
   pc_queue_t **all_pc_queues;
   static const uint64_t BQ_MAGIC_64BIT = 0xD221A6BE96E04673UL;
   static const data_t BQ_MAGIC_KV;
-  static const uint64_t SECTION_MASK = SECTION_SIZE - 1;
 
-  size_t queue_size;
+  /// Where the queue of a producer/consumer pair lives.
+  struct PairLayout {
+    uint32_t prod_cpu;
+    uint32_t cons_cpu;  // unknown (== prod_cpu) without consumer cpus
+    int node;
+    int distance;
+    uint64_t section_size;
+    uint64_t offset;  // into the node's queue data
+  };
 
  private:
   size_t num_sections;
-  size_t section_size;
   uint32_t nprod;
   uint32_t ncons;
 
@@ -122,6 +182,15 @@ class SectionQueue {
   std::map<std::tuple<int, int>, cons_queue_t *> cqueue_map;
   std::map<std::tuple<int, int>, pc_queue_t *> pc_queue_map;
 
+  // per-node queue data, freed on teardown
+  std::vector<void *> data_allocs;
+  std::vector<std::vector<PairLayout>> layout;
+
+  QueueWait wait = QueueWait::Spin;
+  uint64_t spin_cycles = QUEUE_SPIN_CYCLES;
+  // one per consumer, woken by the producers under QueueWait::Park
+  ParkingSpot *parking_spots;
+
   queue_t ***queues;
 
   void init_prod_queues() {
@@ -164,36 +233,39 @@ class SectionQueue {
     }
   }
 
-  void init_data(NumaPolicyQueues *npq) {
-    auto qdata_sz = nprod * ncons * this->queue_size;
-    std::map<uint32_t, std::vector<uint32_t>> node_map;
-
-    auto get_current_node = [](uint32_t cpu) { return numa_node_of_cpu(cpu); };
-
-    for (auto cpu : npq->get_assigned_cpu_list_producers()) {
-      auto cpu_node = get_current_node(cpu);
-      if (node_map.find(cpu_node) != node_map.end()) {
-        node_map[cpu_node].push_back(cpu);
-      } else {
-        node_map[cpu_node] = std::vector<uint32_t>();
-        node_map[cpu_node].push_back(cpu);
-      }
-    }
-    std::ostringstream os;
-    for (auto nodes : node_map) {
-      os << "node " << nodes.first << "\n\t{ ";
-      for (auto cpu : nodes.second) {
-        os << cpu << ", ";
+  /// Size the queue of every pair from the NUMA distance of its cpus, see
+  /// `pair_section_size`. The data of a pair is placed on the consumer's
+  /// node, which reads all of it; for a pair within one node that is also
+  /// the producer's. Without `cons_cpus`, every pair gets SECTION_SIZE
+  /// sections on the producer's node.
+  void init_data(const std::vector<uint32_t> &prod_cpus,
+                 const std::vector<uint32_t> &cons_cpus) {
+    std::map<int, uint64_t> node_bytes;
+    layout.assign(nprod, std::vector<PairLayout>(ncons));
+    for (auto p = 0u; p < nprod; p++) {
+      for (auto c = 0u; c < ncons; c++) {
+        auto &l = layout[p][c];
+        l.prod_cpu = prod_cpus[p];
+        l.cons_cpu = cons_cpus.empty() ? prod_cpus[p] : cons_cpus[c];
+        const auto prod_node = numa_node_of_cpu(l.prod_cpu);
+        l.node = numa_node_of_cpu(l.cons_cpu);
+        l.distance = numa_distance(prod_node, l.node);
+        l.section_size = cons_cpus.empty()
+                             ? SECTION_SIZE
+                             : pair_section_size(l.prod_cpu, l.cons_cpu);
+
+        // masks are applied to addresses: keep the queue section aligned
+        auto &bytes = node_bytes[l.node];
+        bytes = (bytes + l.section_size - 1) & ~(l.section_size - 1);
+        l.offset = bytes;
+        bytes += l.section_size * this->num_sections;
       }
-      os << " }\n";
     }
-    PLOGI << os.str();
-    std::map<uint32_t, char *> node_memmap;
 
-    auto mbind_buffer_local = [](void *buf, ssize_t sz, uint32_t node) {
+    auto mbind_buffer_local = [](void *buf, ssize_t sz, int node) {
       unsigned long nodemask[4096] = {0};
       ssize_t page_size = PAGESIZE;
-      nodemask[0] = 1 << node;
+      nodemask[0] = 1ul << node;
       PLOGV.printf("nodemask %x", nodemask[0]);
       long ret = mbind(buf, std::max(sz, page_size), MPOL_BIND, nodemask, 4096,
                        MPOL_MF_MOVE | MPOL_MF_STRICT);
@@ -203,23 +275,20 @@ class SectionQueue {
       return ret;
     };
 
-    for (auto nodes : node_map) {
-      auto num_queues_in_node = nodes.second.size() * ncons;
-      char *data = (char *)utils::zero_aligned_alloc(
-          1 << 21, this->queue_size * num_queues_in_node);
-      node_memmap[nodes.first] = data;
-      mbind_buffer_local(data, this->queue_size * num_queues_in_node,
-                         nodes.first);
+    std::map<int, char *> node_memmap;
+    for (auto &[node, bytes] : node_bytes) {
+      char *data = (char *)utils::zero_aligned_alloc(1 << 21, bytes);
+      node_memmap[node] = data;
+      data_allocs.push_back(data);
+      if (node >= 0) {
+        mbind_buffer_local(data, bytes, node);
+      }
     }
 
     for (auto p = 0u; p < nprod; p++) {
-      uint32_t node_for_prod =
-          get_current_node(npq->get_assigned_cpu_list_producers()[p]);
-      char *qdata = node_memmap[node_for_prod];
-      node_memmap[node_for_prod] = qdata + ncons * this->queue_size;
-
       for (auto c = 0u; c < ncons; c++) {
-        data_t *data = (data_t *)(qdata + c * this->queue_size);
+        const auto &l = layout[p][c];
+        data_t *data = (data_t *)(node_memmap[l.node] + l.offset);
         auto it = pqueue_map.find(std::make_tuple(p, c));
         if (it != pqueue_map.end()) {
           prod_queue_t *pq = pqueue_map.at(std::make_tuple(p, c));
@@ -235,8 +304,8 @@ class SectionQueue {
           pcq->enqSharedPtr = data;
           pcq->deqSharedPtr = data;
 
-          PLOGV.printf("enqPtr %p | deqPtr %p | data %p | section_mask %lx",
-                       pq->enqPtr, cq->deqPtr, cq->data, SECTION_MASK);
+          PLOGV.printf("enqPtr %p | deqPtr %p | data %p | section_size %lu",
+                       pq->enqPtr, cq->deqPtr, cq->data, l.section_size);
         } else {
           for (auto &e : pqueue_map) {
             auto &[p, c] = e.first;
@@ -255,8 +324,70 @@ class SectionQueue {
   }
   void teardown_cons_queues() {
     for (auto c = 0u; c < ncons; c++) {
-      auto cq = this->all_cqueues[c];
-      free(cq->data);
+      free(this->all_cqueues[c]);
+    }
+  }
+
+  void teardown_data() {
+    for (auto data : this->data_allocs) {
+      free(data);
+    }
+    for (auto p = 0u; p < nprod; p++) {
+      free(this->all_pc_queues[p]);
+      for (auto c = 0u; c < ncons; c++) {
+        delete this->queues[p][c];
+      }
+      free(this->queues[p]);
+    }
+    free(this->queues);
+    free(this->all_pqueues);
+    free(this->all_cqueues);
+    free(this->all_pc_queues);
+    delete[] this->parking_spots;
+  }
+
+  static inline void copy_run(data_t *dst, const data_t *src, size_t n) {
+#ifdef AVX_SUPPORT
+    if (simd_kind == SIMDKIND::Avx512) {
+      copy_run_avx512(dst, src, n * sizeof(data_t));
+      return;
+    }
+#endif
+    std::memcpy(dst, src, n * sizeof(data_t));
+  }
+
+  /// The producer filled the section before `pq->enqPtr`: wait until the
+  /// next one is free and hand the filled one to the consumer.
+  template <typename OnFull>
+  inline void publish_section(prod_queue_t *pq, uint32_t p, uint32_t c,
+                              OnFull &&on_full) {
+    if (pq->enqPtr == pq->queue_end) {
+      pq->enqPtr = pq->data;
+    }
+
+    pc_queue_t *pcq = &all_pc_queues[p][c];
+    if (pq->enqPtr == pq->deqLocalPtr) [[unlikely]] {
+      const TraceScope stall(TraceEvent::QueueFull);
+      do {
+        pq->deqLocalPtr = pcq->deqSharedPtr;
+#ifdef CALC_STATS
+        pcq->numEnqueueSpins++;
+#endif
+        on_full();
+        if (wait == QueueWait::Park) {
+          relax(QUEUE_RELAX_CYCLES);
+        } else {
+          asm volatile("pause");
+        }
+      } while (pq->enqPtr == pq->deqLocalPtr);
+    }
+#ifdef BQ_NT_STORES
+    // streaming stores are weakly ordered
+    _mm_sfence();
+#endif
+    pcq->enqSharedPtr = pq->enqPtr;
+    if (wait == QueueWait::Park) {
+      parking_spots[c].wake();
     }
   }
 
@@ -276,13 +407,20 @@ class SectionQueue {
   }
 
   explicit SectionQueue(uint32_t nprod, uint32_t ncons, size_t num_sections,
-                        NumaPolicyQueues *npq) {
+                        NumaPolicyQueues *npq)
+      : SectionQueue(nprod, ncons, num_sections,
+                     npq->get_assigned_cpu_list_producers(),
+                     npq->get_assigned_cpu_list_consumers()) {}
+
+  /// `prod_cpus[p]` and `cons_cpus[c]` are the cpus producer `p` and consumer
+  /// `c` run on, which size and place the queue of each pair (see
+  /// `init_data`). `cons_cpus` may be left empty.
+  explicit SectionQueue(uint32_t nprod, uint32_t ncons, size_t num_sections,
+                        const std::vector<uint32_t> &prod_cpus,
+                        const std::vector<uint32_t> &cons_cpus = {}) {
     printf("%s, numsections %zu\n", __func__, num_sections);
     assert((num_sections & (num_sections - 1)) == 0);
     this->num_sections = num_sections;
-
-    this->queue_size = SECTION_SIZE * this->num_sections;
-    this->section_size = this->queue_size / this->num_sections;
     this->nprod = nprod;
     this->ncons = ncons;
 
@@ -298,7 +436,10 @@ class SectionQueue {
     this->init_prod_queues();
     this->init_cons_queues();
     this->init_pc_shared_queues();
-    this->init_data(npq);
+    this->parking_spots = new ParkingSpot[ncons];
+    assert(prod_cpus.size() >= nprod);
+    assert(cons_cpus.empty() || cons_cpus.size() >= ncons);
+    this->init_data(prod_cpus, cons_cpus);
 
     this->queues = (queue_t ***)calloc(1, nprod * sizeof(queue_t *));
     for (auto p = 0u; p < nprod; p++) {
@@ -310,12 +451,80 @@ class SectionQueue {
         prod_queue_t *pq = pqueue_map.at(std::make_tuple(p, c));
         cons_queue_t *cq = cqueue_map.at(std::make_tuple(p, c));
         pc_queue_t *pcq = pc_queue_map.at(std::make_tuple(p, c));
-        queues[p][c] = new queue_t(queue_size, pq, cq, pcq);
+        const auto section_size = layout[p][c].section_size;
+        queues[p][c] = new queue_t(section_size * this->num_sections,
+                                   section_size, pq, cq, pcq);
       }
     }
     queues[0][0]->dump();
+    dump_layout();
   }
 
+  const PairLayout &pair_layout(uint32_t p, uint32_t c) const {
+    return layout[p][c];
+  }
+
+  /// Report the section size and placement chosen for the pairs: grouped at
+  /// info level, one line per pair at verbose.
+  void dump_layout() const {
+    std::map<std::tuple<int, uint64_t, int>, uint32_t> groups;
+    for (auto p = 0u; p < nprod; p++) {
+      for (auto c = 0u; c < ncons; c++) {
+        const auto &l = layout[p][c];
+        groups[std::make_tuple(l.distance, l.section_size, l.node)]++;
+        PLOGV.printf(
+            "p %u (cpu %u) -> c %u (cpu %u) | distance %d | section %lu B | "
+            "node %d",
+            p, l.prod_cpu, c, l.cons_cpu, l.distance, l.section_size, l.node);
+      }
+    }
+    PLOGI.printf("Section queue layout (%zu sections per queue):",
+                 num_sections);
+    for (const auto &[group, n] : groups) {
+      const auto &[distance, section_size, node] = group;
+      PLOGI.printf(
+          "  %4u pairs | distance %3d | section %6lu B | queue %8lu B | "
+          "node %d",
+          n, distance, section_size, section_size * num_sections, node);
+    }
+  }
+
+  /// How consumers wait for data and producers for room (--queue-wait).
+  void set_wait(QueueWait wait, uint64_t spin_cycles) {
+    this->wait = wait;
+    this->spin_cycles = spin_cycles;
+  }
+
+  /// Consumer `c` polled all its queues from the producers in the `active`
+  /// bitmask and found them empty. Under QueueWait::Park, it backs off, and
+  /// sleeps once it has been idle for `spin_cycles`. `*idle_since` is kept
+  /// by the consumer and reset to 0 whenever it gets a message.
+  inline void consumer_idle(uint32_t c, uint64_t active,
+                            uint64_t *idle_since) {
+    if (wait == QueueWait::Spin) return;
+
+    const auto now = _rdtsc();
+    if (*idle_since == 0) *idle_since = now;
+    if (now - *idle_since < spin_cycles) {
+      relax(QUEUE_RELAX_CYCLES);
+      return;
+    }
+
+    parking_spots[c].park([&] {
+      for (auto p = 0u; p < nprod; p++) {
+        if ((active & (1ull << p)) &&
+            all_pc_queues[p][c].enqSharedPtr != all_cqueues[c][p].deqPtr) {
+          return true;
+        }
+      }
+      return false;
+    });
+    *idle_since = 0;
+  }
+
+  /// Times consumer `c` went to sleep.
+  uint64_t num_parks(uint32_t c) const { return parking_spots[c].num_parks; }
+
 #ifdef CALC_STATS
   inline auto timestamp(uint32_t p) const {
     auto total = 0ull;
@@ -327,31 +536,61 @@ class SectionQueue {
 #endif
 
   inline int enqueue(prod_queue_t *pq, uint32_t p, uint32_t c, data_t value) {
+    return enqueue(pq, p, c, value, [] {});
+  }
+
+  /// Like `enqueue`, but calls `on_full()` while waiting for the consumer to
+  /// free a section, e.g. to drain a queue in the other direction.
+  template <typename OnFull>
+  inline int enqueue(prod_queue_t *pq, uint32_t p, uint32_t c, data_t value,
+                     OnFull &&on_full) {
     *pq->enqPtr = value;
     pq->enqPtr += 1;
 
-    if (((uint64_t)pq->enqPtr & SECTION_MASK) == 0) {
-      if (pq->enqPtr == pq->queue_end) {
-        pq->enqPtr = pq->data;
-      }
+    if (((uint64_t)pq->enqPtr & pq->section_mask) == 0) {
+      publish_section(pq, p, c, on_full);
+    }
+    return SUCCESS;
+  }
 
-      {
-        pc_queue_t *pcq = &all_pc_queues[p][c];
-        while (pq->enqPtr == pq->deqLocalPtr) {
-          pq->deqLocalPtr = pcq->deqSharedPtr;
-#ifdef CALC_STATS
-          pcq->numEnqueueSpins++;
-#endif
-          asm volatile("pause");
-        }
-        pcq->enqSharedPtr = pq->enqPtr;
+  inline int enqueue_bulk(prod_queue_t *pq, uint32_t p, uint32_t c,
+                          std::span<const data_t> values) {
+    return enqueue_bulk(pq, p, c, values, [] {});
+  }
+
+  /// Enqueue `values` in order. Each run up to the end of a section is copied
+  /// at once and the shared pointer is touched once per filled section.
+  template <typename OnFull>
+  inline int enqueue_bulk(prod_queue_t *pq, uint32_t p, uint32_t c,
+                          std::span<const data_t> values, OnFull &&on_full) {
+    while (!values.empty()) {
+      const auto room =
+          (pq->section_mask + 1 - ((uint64_t)pq->enqPtr & pq->section_mask)) /
+          sizeof(data_t);
+      const auto n = std::min<size_t>(room, values.size());
+      copy_run(pq->enqPtr, values.data(), n);
+      pq->enqPtr += n;
+      values = values.subspan(n);
+
+      if (((uint64_t)pq->enqPtr & pq->section_mask) == 0) {
+        publish_section(pq, p, c, on_full);
       }
     }
     return SUCCESS;
   }
 
+  /// Consumers only see whole sections. Publish a partially filled section
+  /// by padding it with empty (key 0) elements, which consumers skip.
+  template <typename OnFull>
+  inline void flush(prod_queue_t *pq, uint32_t p, uint32_t c,
+                    OnFull &&on_full) {
+    while (((uint64_t)pq->enqPtr & pq->section_mask) != 0) {
+      enqueue(pq, p, c, data_t{}, on_full);
+    }
+  }
+
   inline int dequeue(cons_queue_t *cq, uint32_t p, uint32_t c, data_t *value) {
-    if (((uint64_t)cq->deqPtr & SECTION_MASK) == 0) {
+    if (((uint64_t)cq->deqPtr & cq->section_mask) == 0) {
       if (cq->deqPtr == cq->queue_end) {
         cq->deqPtr = cq->data;
       }
@@ -375,6 +614,38 @@ class SectionQueue {
     return SUCCESS;
   }
 
+  /// Dequeue up to `max` elements, without copying them. Returns a view into
+  /// the current section, which stays valid until the next dequeue from this
+  /// queue; an empty view means RETRY. The view never crosses a section, and
+  /// may run past a BQ_MAGIC_KV: callers stop at the first one.
+  inline std::span<const data_t> dequeue_bulk(cons_queue_t *cq, uint32_t p,
+                                              uint32_t c, size_t max) {
+    if (((uint64_t)cq->deqPtr & cq->section_mask) == 0) {
+      if (cq->deqPtr == cq->queue_end) {
+        cq->deqPtr = cq->data;
+      }
+
+      pc_queue_t *pcq = &all_pc_queues[p][c];
+      pcq->deqSharedPtr = cq->deqPtr;
+      if (cq->deqPtr == cq->enqLocalPtr) {
+        cq->enqLocalPtr = pcq->enqSharedPtr;
+        if (cq->deqPtr == cq->enqLocalPtr) {
+#ifdef CALC_STATS
+          pcq->numDequeueSpins++;
+#endif
+          return {};
+        }
+      }
+    }
+    const auto left =
+        (cq->section_mask + 1 - ((uint64_t)cq->deqPtr & cq->section_mask)) /
+        sizeof(data_t);
+    const auto n = std::min<size_t>(left, max);
+    const std::span<const data_t> run(cq->deqPtr, n);
+    cq->deqPtr += n;
+    return run;
+  }
+
   void dump_stats(uint32_t p, uint32_t c) {
     auto cq = &all_cqueues[c][p];
     auto pcq = &all_pc_queues[p][c];
@@ -420,6 +691,9 @@ class SectionQueue {
     auto pq = &this->all_pqueues[p][c];
     enqueue(pq, p, c, BQ_MAGIC_KV);
     pcq->enqSharedPtr = (data_t *)0xdeadbeef;
+    if (wait == QueueWait::Park) {
+      parking_spots[c].wake();
+    }
   }
 
   void pop_done(uint32_t p, uint32_t c) {
@@ -430,6 +704,7 @@ class SectionQueue {
   ~SectionQueue() {
     teardown_prod_queues();
     teardown_cons_queues();
+    teardown_data();
   }
 };
 }  // namespace kmercounter
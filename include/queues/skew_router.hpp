@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "constants.hpp"
+#include "hasher.hpp"
+
+namespace kmercounter {
+
+/// Set in the value of a message that carries a replica's share of a split hot
+/// key. The consumer keeps it aside and it is merged into the home partition
+/// after the inserts.
+constexpr uint64_t HOT_REPLICA_TAG = 1ull << 63;
+
+/// Space-saving heavy hitter sketch over `HOT_KEY_COUNTERS` counters. The
+/// estimated count of a key overshoots by at most its `error`.
+class SpaceSavingSketch {
+ public:
+  struct Counter {
+    uint64_t key;
+    uint64_t count;
+    uint64_t error;
+  };
+
+  void add(uint64_t key) {
+    for (auto i = 0u; i < size_; i++) {
+      if (counters_[i].key == key) {
+        counters_[i].count++;
+        return;
+      }
+    }
+    if (size_ < counters_.size()) {
+      counters_[size_++] = {key, 1, 0};
+      return;
+    }
+    // evict the smallest counter; the new key inherits its count as error
+    auto &min = *std::min_element(
+        counters_.begin(), counters_.end(),
+        [](const Counter &a, const Counter &b) { return a.count < b.count; });
+    min = {key, min.count + 1, min.count};
+  }
+
+  /// Halve every count, so that keys that cooled down get evicted.
+  void decay() {
+    for (auto i = 0u; i < size_; i++) {
+      counters_[i].count /= 2;
+      counters_[i].error /= 2;
+    }
+  }
+
+  const Counter *begin() const { return counters_.data(); }
+  const Counter *end() const { return counters_.data() + size_; }
+
+ private:
+  std::array<Counter, HOT_KEY_COUNTERS> counters_{};
+  uint32_t size_ = 0;
+};
+
+/// Producer-side routing of bqueue messages (--hot-replicas).
+///
+/// Cold keys go to their home consumer. About one in `HOT_KEY_SAMPLE_RATE`
+/// keys is fed to a space-saving sketch; every `HOT_KEY_REFRESH` samples, the keys
+/// with more than 1/(HOT_KEY_SHARE_DIV * n_cons) of the samples become hot.
+/// Occurrences of a hot key are sprayed round-robin over `replicas`
+/// consecutive consumers starting at its home.
+class SkewRouter {
+ public:
+  SkewRouter() = default;
+
+  SkewRouter(uint32_t n_cons, uint32_t replicas)
+      : n_cons_(n_cons), replicas_(std::min(replicas, n_cons)) {}
+
+  /// Consumer for `key`. `*replica` is set when that is not `home`.
+  inline uint32_t route(uint64_t key, uint64_t hash, uint32_t home,
+                        bool *replica) {
+    if (++seen_ == next_sample_) [[unlikely]] {
+      sample(key);
+    }
+
+    *replica = false;
+    if (hot_keys_[hot_slot(hash)] != key) [[likely]] {
+      return home;
+    }
+
+    const auto r = next_replica_;
+    if (++next_replica_ == replicas_) next_replica_ = 0;
+    *replica = r != 0;
+    auto cons = home + r;
+    return cons >= n_cons_ ? cons - n_cons_ : cons;
+  }
+
+  /// Number of keys currently split.
+  uint32_t num_hot() const {
+    return std::count_if(hot_keys_.begin(), hot_keys_.end(),
+                         [](uint64_t k) { return k != 0; });
+  }
+
+ private:
+  // some hashers (crc) only fill the lower 32 bits; mix them all in
+  static inline uint32_t hot_slot(uint64_t hash) {
+    return ((hash * 0x9e3779b97f4a7c15ULL) >> 32) & (HOT_KEY_SLOTS - 1);
+  }
+
+  void sample(uint64_t key) {
+    // random gaps with a mean of HOT_KEY_SAMPLE_RATE, so that periodic
+    // streams are not sampled at the same phase
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 7;
+    rng_ ^= rng_ << 17;
+    next_sample_ += 1 + rng_ % (2 * HOT_KEY_SAMPLE_RATE - 1);
+
+    sketch_.add(key);
+    if (++num_samples_ < HOT_KEY_REFRESH) return;
+
+    hot_keys_.fill(0);
+    for (const auto &c : sketch_) {
+      if ((c.count - c.error) * HOT_KEY_SHARE_DIV * n_cons_ > num_samples_) {
+        // Only the key is stored: the slot is picked by the hash, which is
+        // not kept. Hot keys are rare, so hashing them here is cheap.
+        hot_keys_[hot_slot(hasher_(&c.key, sizeof(c.key)))] = c.key;
+      }
+    }
+    sketch_.decay();
+    num_samples_ /= 2;
+  }
+
+  Hasher hasher_;
+  uint32_t n_cons_ = 1;
+  uint32_t replicas_ = 1;
+  uint32_t next_replica_ = 0;
+  uint64_t seen_ = 0;
+  uint64_t next_sample_ = HOT_KEY_SAMPLE_RATE;
+  uint64_t rng_ = 0x9e3779b97f4a7c15ULL;
+  uint64_t num_samples_ = 0;
+  SpaceSavingSketch sketch_;
+  // 0 is never a key
+  std::array<uint64_t, HOT_KEY_SLOTS> hot_keys_{};
+};
+
+/// Partial counts of split hot keys that a consumer holds for their home
+/// partitions (--hot-replicas). Only keys the producers' sketches picked as hot
+/// get here, so they fit an open-addressed table of `HOT_PARTIAL_SLOTS`. Keys
+/// past 3/4 of it go to a spill list as they come; merging adds them up.
+class alignas(64) HotPartials {
+ public:
+  struct Entry {
+    uint64_t key;
+    uint64_t count;  // 0: empty slot
+  };
+
+  inline void add(uint64_t key, uint64_t n) {
+    if (n == 0) [[unlikely]] return;
+    for (auto i = slot(key);; i = (i + 1) & (HOT_PARTIAL_SLOTS - 1)) {
+      auto &e = entries_[i];
+      if (e.count == 0) {
+        if (size_ == MAX_SIZE) [[unlikely]] break;
+        e = {key, n};
+        size_++;
+        return;
+      }
+      if (e.key == key) {
+        e.count += n;
+        return;
+      }
+    }
+    spilled_.push_back({key, n});
+  }
+
+  /// Call `f(key, count)` for every partial count held.
+  template <typename F>
+  void for_each(F &&f) const {
+    for (const auto &e : entries_) {
+      if (e.count) f(e.key, e.count);
+    }
+    for (const auto &e : spilled_) f(e.key, e.count);
+  }
+
+  uint32_t size() const { return size_; }
+  size_t num_spilled() const { return spilled_.size(); }
+
+ private:
+  static constexpr uint32_t MAX_SIZE = HOT_PARTIAL_SLOTS / 4 * 3;
+
+  static inline uint32_t slot(uint64_t key) {
+    return ((key * 0x9e3779b97f4a7c15ULL) >> 32) & (HOT_PARTIAL_SLOTS - 1);
+  }
+
+  std::array<Entry, HOT_PARTIAL_SLOTS> entries_{};
+  uint32_t size_ = 0;
+  std::vector<Entry> spilled_;
+};
+
+}  // namespace kmercounter
@@ -1,16 +1,30 @@
 #ifndef __CACHEMISS_TEST_HPP__
 #define __CACHEMISS_TEST_HPP__
 
+#include <vector>
+
 #include "hashtables/base_kht.hpp"
+#include "numa.hpp"
 #include "types.hpp"
+#include "utils/memory_calibration.hpp"
 
 namespace kmercounter {
 
 class CacheMissTest {
  public:
   void cache_miss_run(Shard *sh, BaseHashTable *kmer_ht);
+
+  /// Measure the peak bandwidth and the latency of every node's memory on
+  /// `bytes` of it, far more than the LLC.
+  static std::vector<MemoryPeak> calibrate_memory(const Numa &numa,
+                                                  size_t bytes);
+
+  /// Measure the latency of a dependent load on `bytes` of memory by page
+  /// size and by NUMA distance, and how many independent loads a cpu keeps
+  /// in flight.
+  static LatencyCalibration calibrate_latency(const Numa &numa, size_t bytes);
 };
 
 }  // namespace kmercounter
 
-#endif  // __CACHEMISS_TEST_HPP__
\ No newline at end of file
+#endif  // __CACHEMISS_TEST_HPP__
@@ -3,6 +3,13 @@
 
 #include <plog/Log.h>
 
+#include <algorithm>
+#include <barrier>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <vector>
+
 #include "hashtables/simple_kht.hpp"
 #include "types.hpp"
 
@@ -112,11 +119,104 @@ inline std::ostream &operator<<(std::ostream &strm, const Prefetch_KV &k) {
               << k.kb.count;
 }
 
+/// One setting of the prefetch engine in the PREFETCH sweep, and what it did
+/// on all threads.
+struct PrefetchSweepPoint {
+  uint32_t ht_type;
+  bool zipf;
+  bool pf_write;
+  // both prefetch queues
+  uint32_t queue_len;
+  // both flush thresholds: the requests queued behind a prefetched slot
+  // before it is probed
+  uint32_t distance;
+  OpTimings insertions{};
+  OpTimings finds{};
+};
+
+/// The settings of the sweep: both tables, uniform and (given the keys)
+/// Zipf keys, prefetch for write and for read, every queue length of
+/// PREFETCH_SWEEP_QUEUE_LENS, and every power-of-two distance that leaves
+/// room in the queue for a batch of `batch_len`.
+inline std::vector<PrefetchSweepPoint> prefetch_sweep_grid(bool with_zipf,
+                                                           uint32_t batch_len) {
+  std::vector<PrefetchSweepPoint> grid;
+  for (const uint32_t ht_type : {PARTITIONED_HT, CASHTPP}) {
+    for (const bool zipf : {false, true}) {
+      if (zipf && !with_zipf) continue;
+      for (const bool pf_write : {true, false}) {
+        for (const uint32_t len : PREFETCH_SWEEP_QUEUE_LENS) {
+          for (uint32_t d = 1; d + batch_len < len; d *= 2) {
+            grid.push_back({ht_type, zipf, pf_write, len, d});
+          }
+        }
+      }
+    }
+  }
+  return grid;
+}
+
+/// The cycles/op of every point of the sweep, and the best setting of each
+/// table and key distribution next to the one of `config`.
+inline void print_prefetch_sweep(FILE *out,
+                                 const std::vector<PrefetchSweepPoint> &points,
+                                 const Configuration &config) {
+  auto per_op = [](const OpTimings &ops) {
+    return ops.op_count ? static_cast<double>(ops.duration) / ops.op_count
+                        : 0.0;
+  };
+  fprintf(out, "%-12s %-8s %-8s %6s %9s %14s %12s\n", "ht", "keys",
+          "prefetch", "queue", "distance", "cycles/insert", "cycles/find");
+  for (const auto &p : points) {
+    fprintf(out, "%-12s %-8s %-8s %6u %9u %14.1f %12.1f\n",
+            ht_type_strings[p.ht_type], p.zipf ? "zipf" : "uniform",
+            p.pf_write ? "write" : "read", p.queue_len, p.distance,
+            per_op(p.insertions), per_op(p.finds));
+  }
+
+  for (auto first = points.begin(); first != points.end();) {
+    const auto last = std::find_if(first, points.end(), [&](const auto &p) {
+      return p.ht_type != first->ht_type || p.zipf != first->zipf;
+    });
+    auto best = [&](auto ops) {
+      return std::min_element(first, last, [&](const auto &a, const auto &b) {
+        return per_op(a.*ops) < per_op(b.*ops);
+      });
+    };
+    const auto configured = std::find_if(first, last, [&](const auto &p) {
+      return p.pf_write == config.pf_write &&
+             p.queue_len == config.pf_queue_len &&
+             p.distance == config.ins_flush_threshold;
+    });
+    const auto ins = best(&PrefetchSweepPoint::insertions);
+    const auto fnd = best(&PrefetchSweepPoint::finds);
+    fprintf(out,
+            "Best for %s, %s keys: inserts %.1f cycles (prefetch for %s, "
+            "queue %u, distance %u), finds %.1f cycles (queue %u, distance "
+            "%u)",
+            ht_type_strings[first->ht_type], first->zipf ? "zipf" : "uniform",
+            per_op(ins->insertions), ins->pf_write ? "write" : "read",
+            ins->queue_len, ins->distance, per_op(fnd->finds), fnd->queue_len,
+            fnd->distance);
+    if (configured != last) {
+      fprintf(out, "; configured: %.1f / %.1f cycles",
+              per_op(configured->insertions), per_op(configured->finds));
+    }
+    fputc('\n', out);
+    first = last;
+  }
+}
+
 class PrefetchTest {
  public:
-  void prefetch_test_run_exec(Shard *sh, Configuration &cfg, BaseHashTable *);
-  uint64_t prefetch_test_run(
-      PartitionedHashStore<Prefetch_KV, PrefetchKV_Queue> *ktable);
+  /// Insert and find the keys of the run once per point of the sweep, on all
+  /// threads at once, then print cycles/op of every point. The table and the
+  /// prefetch settings are those of the point; `config` is restored after.
+  void prefetch_sweep(Shard *sh, std::barrier<std::function<void()>> *barrier);
+
+ private:
+  std::vector<PrefetchSweepPoint> points_;
+  std::mutex points_lock_;
 };
 
 }  // namespace kmercounter
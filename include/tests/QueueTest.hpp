@@ -1,14 +1,32 @@
 #pragma once
 
 #include <barrier>
+#include <mutex>
 #include <thread>
 
 #include "hashtables/base_kht.hpp"
 #include "numa.hpp"
+#include "queues/skew_router.hpp"
 #include "types.hpp"
 
 namespace kmercounter {
 
+class DelegatedHashTable;
+
+/// Queues that can move runs of messages at once (--bq-bulk).
+template <typename T>
+concept has_bulk_ops = requires(T &q, typename T::cons_queue_t *cq) {
+  q.dequeue_bulk(cq, 0u, 0u, size_t{});
+};
+
+/// Queues whose idle consumers can sleep (--queue-wait).
+template <typename T>
+concept has_parking = requires(T &q, uint64_t *idle_since) {
+  q.set_wait(QueueWait::Spin, uint64_t{});
+  q.consumer_idle(0u, uint64_t{}, idle_since);
+  q.num_parks(0u);
+};
+
 template <typename T>
 class QueueTest {
   std::vector<std::thread> prod_threads;
@@ -25,6 +43,13 @@ class QueueTest {
 
   uint64_t QUEUE_SIZE = 0;
 
+  // --hot-replicas: keys sent to each consumer under static and skew-aware
+  // routing, and the partial counts of split keys held by each consumer
+  std::mutex load_mutex;
+  std::vector<uint64_t> static_load;
+  std::vector<uint64_t> routed_load;
+  std::vector<HotPartials> hot_partials;
+
  public:
   const unsigned LYNX_QUEUE_SIZE = (1 << 12) * 8;
   const unsigned BQ_QUEUE_SIZE = 4096;
@@ -32,8 +57,15 @@ class QueueTest {
 
   void run_find_test(Configuration *cfg, Numa *n, bool is_join, NumaPolicyQueues *npq);
 
+  void run_delegated_test(Configuration *cfg, Numa *n, bool is_join,
+                          NumaPolicyQueues *npq);
+
   void run_test(Configuration *cfg, Numa *n, bool, NumaPolicyQueues *npq);
 
+  void merge_hot_partials(Configuration *cfg);
+
+  void init_run(Configuration *cfg, Numa *n, NumaPolicyQueues *npq);
+
   void insert_with_queues(Configuration *cfg, Numa *n, bool is_join, NumaPolicyQueues *npq);
 
   void producer_thread(const uint32_t tid, const uint32_t n_prod,
@@ -50,6 +82,8 @@ class QueueTest {
   void find_thread(int tid, int n_prod, int n_cons,
                        bool is_join,
                        std::barrier<std::function<void()>>* barrier);
+  void delegated_thread(int tid, int n_prod, DelegatedHashTable *dht,
+                        std::barrier<std::function<void()>> *barrier);
 
   void init_queues(uint32_t nprod, uint32_t ncons);
 };
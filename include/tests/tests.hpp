@@ -20,9 +20,10 @@ class Tests {
  public:
   SynthTest st;
   PrefetchTest pt;
-  //QueueTest<kmercounter::BQueueAligned> qt;
-  // QueueTest<kmercounter::LynxQueue> qt;
+  // one per --queue-type
   QueueTest<kmercounter::SectionQueue> qt;
+  QueueTest<kmercounter::BQueueAligned> qt_bq;
+  QueueTest<kmercounter::LynxQueue> qt_lynx;
   CacheMissTest cmt;
   ZipfianTest zipf;
   KmerTest kmer;
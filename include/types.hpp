@@ -3,6 +3,8 @@
 
 #include <absl/hash/hash.h>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <cinttypes>
 #include <cstdint>
@@ -12,6 +14,8 @@
 #include <string>
 #include <utility>
 
+#include "constants.hpp"
+
 #define CACHE_LINE_SIZE 64
 #define PAGE_SIZE 4096
 #define ALPHA 0.15
@@ -35,16 +39,127 @@ using key_type = std::uint64_t;
 
 using value_type = key_type;
 
+// XXX: If you add/modify a branch kind, update the `branching_strings` in
+// src/types.cpp
 enum class BRANCHKIND { WithBranch, NoBranch_Cmove, NoBranch_Simd };
 
+// Probe style used unless one is picked with --branching
 #if defined(BRANCHLESS_CMOVE)
-constexpr BRANCHKIND branching = BRANCHKIND::NoBranch_Cmove;
+constexpr BRANCHKIND default_branching = BRANCHKIND::NoBranch_Cmove;
 #elif defined(BRANCHLESS_SIMD)
-constexpr BRANCHKIND branching = BRANCHKIND::NoBranch_Simd;
+constexpr BRANCHKIND default_branching = BRANCHKIND::NoBranch_Simd;
+#else
+constexpr BRANCHKIND default_branching = BRANCHKIND::WithBranch;
+#endif
+
+// Hashtable value layout used unless one is picked with --aggr
+#ifdef NOAGGR
+constexpr bool default_aggr = false;
+#else
+constexpr bool default_aggr = true;
+#endif
+
+// XXX: If you add/modify a hasher, update the `hasher_strings` in
+// src/types.cpp
+enum class HasherType {
+  city,
+  crc,
+  xxhash,
+  wyhash,
+  citycrc,
+  xxhash3,
+  fnv,
+  direct_index,
+  mulxor,
+};
+
+// Hasher used unless one is picked with --hasher
+#if defined(CITY_HASH)
+constexpr HasherType default_hasher = HasherType::city;
+#elif defined(FNV_HASH)
+constexpr HasherType default_hasher = HasherType::fnv;
+#elif defined(XX_HASH)
+constexpr HasherType default_hasher = HasherType::xxhash;
+#elif defined(XX_HASH_3)
+constexpr HasherType default_hasher = HasherType::xxhash3;
+#elif defined(CITY_CRC_HASH)
+constexpr HasherType default_hasher = HasherType::citycrc;
+#elif defined(WYHASH)
+constexpr HasherType default_hasher = HasherType::wyhash;
+#elif defined(DIRECT_INDEX)
+constexpr HasherType default_hasher = HasherType::direct_index;
+#elif defined(MULXOR_HASH)
+constexpr HasherType default_hasher = HasherType::mulxor;
 #else
-constexpr BRANCHKIND branching = BRANCHKIND::WithBranch;
+constexpr HasherType default_hasher = HasherType::crc;
 #endif
 
+extern const char* hasher_strings[];
+
+/// Look up a hasher by its name in `hasher_strings`. Returns false if there is
+/// no such hasher.
+bool parse_hasher(const std::string& name, HasherType* type);
+
+extern const char* branching_strings[];
+
+/// Look up a branch kind by its name in `branching_strings` (the names of the
+/// BRANCH CMake option). Returns false if there is no such branch kind.
+bool parse_branching(const std::string& name, BRANCHKIND* kind);
+
+// Producer/consumer queues of the bqueue tests
+enum class QueueKind { Section, BQueueAligned, Lynx };
+
+extern const char* queue_kind_strings[];
+
+/// Look up a queue kind by its name in `queue_kind_strings`. Returns false if
+/// there is no such queue kind.
+bool parse_queue_kind(const std::string& name, QueueKind* kind);
+
+// What bqueue threads do while their queues are empty (consumers) or full
+// (producers)
+enum class QueueWait { Spin, Park };
+
+extern const char* queue_wait_strings[];
+
+/// Look up a wait strategy by its name in `queue_wait_strings`. Returns false
+/// if there is no such strategy.
+bool parse_queue_wait(const std::string& name, QueueWait* wait);
+
+// How the stats of a run are written at its end
+enum class ReportFormat { Text, Json, Csv };
+
+extern const char* report_format_strings[];
+
+/// Look up a report format by its name in `report_format_strings`. Returns
+/// false if there is no such format.
+bool parse_report_format(const std::string& name, ReportFormat* format);
+
+// Hardware events counted in profiled regions (utils/perf_counters.hpp)
+enum class PerfEvent {
+  Cycles,
+  Instructions,
+  L1dMisses,
+  LlcMisses,
+  DtlbMisses,
+  BranchMisses,
+  Count,
+};
+
+extern const char* perf_event_strings[];
+
+/// Counts of a region, indexed by PerfEvent.
+using PerfCounts =
+    std::array<uint64_t, static_cast<std::size_t>(PerfEvent::Count)>;
+
+/// An event that could not be counted.
+constexpr uint64_t PERF_NOT_COUNTED = ~0ull;
+
+constexpr PerfCounts perf_not_counted() {
+  PerfCounts counts{};
+  for (auto &c : counts) c = PERF_NOT_COUNTED;
+  return counts;
+}
+
 enum class BQUEUE_LOAD { None, HtInsert };
 
 // Yes, yes, I know, global; it's midnight, ok?
@@ -142,7 +257,7 @@ struct Configuration {
   bool run_both;
 
   // queue length for batching requests
-  uint32_t batch_len;
+  uint32_t batch_len = HT_TESTS_BATCH_LENGTH;
 
   // Hashjoin specific configs.
   // Whether to materialize the join output
@@ -163,6 +278,63 @@ struct Configuration {
   bool rw_queues;
   unsigned pollute_ratio;
 
+  // hash function used by the hashtables and the queue routing
+  HasherType hasher = default_hasher;
+  // probe style of the partitioned/CAS hashtables
+  BRANCHKIND branching = default_branching;
+  // count occurrences of a key (Aggr_KV) instead of storing values (Item)
+  bool aggr = default_aggr;
+
+  // prefetch engine of the hashtables: ring sizes (powers of two) and the
+  // number of queued requests at which the rings are drained
+  uint32_t pf_queue_len = PREFETCH_QUEUE_SIZE;
+  uint32_t pf_find_queue_len = PREFETCH_FIND_QUEUE_SIZE;
+  uint32_t ins_flush_threshold = INS_FLUSH_THRESHOLD;
+  uint32_t find_flush_threshold = FLUSH_THRESHOLD;
+  // pick the flush thresholds per thread during warmup
+  bool pf_tune = false;
+  // prefetch the slot of an insert for write (false: for read)
+  bool pf_write = true;
+
+  // bqueue inserts and finds both go to the owning consumer over the queues
+  // (a DelegatedHashTable), with at most `inflight_finds` finds per producer
+  // in flight
+  bool queue_finds = false;
+  uint32_t inflight_finds = 1024;
+  // with queue_finds, start with one owner and grow/shrink with the load of
+  // the whole run, ingest included
+  bool elastic_owners = false;
+
+  // bqueue inserts: slots in each producer's per-consumer combining window;
+  // duplicate keys are sent as one (key, n) message (0 = off)
+  uint32_t combine_window = 0;
+  // bqueue inserts: spread each key the producers detect as hot over this many
+  // consumers, whose partial counts are merged after the inserts (0 = off)
+  uint32_t hot_replicas = 0;
+  // bqueue inserts: move messages through the queues in runs and insert them
+  // from the queue sections in place
+  bool bq_bulk = false;
+  // transport between bqueue producers and consumers
+  QueueKind queue_type = QueueKind::Section;
+  // idle section queue consumers keep polling (spin), or back off and then
+  // sleep until a producer publishes to them (park)
+  QueueWait queue_wait = QueueWait::Spin;
+  // park: cycles a consumer stays idle before it sleeps
+  uint64_t queue_spin_cycles = QUEUE_SPIN_CYCLES;
+  // format of the stats at the end of the run (to stats_file, or stdout)
+  ReportFormat report_format = ReportFormat::Text;
+  // count hardware events of the timed regions with perf_event_open
+  bool perf_counters = true;
+  // measure the peak bandwidth and latency of every node's memory before the
+  // run, and rate each phase against them
+  bool calibrate_bw = false;
+  // timeline of every thread's phases, in the Chrome trace format ("" = off)
+  std::string trace_file;
+  // sample every thread's throughput this often during the run (0 = off)
+  uint32_t sample_ms = 0;
+  // SIGUSR1 dumps every thread's progress, SIGUSR2 stops the run early
+  bool control = true;
+
   void dump_configuration() {
     printf("Run configuration {\n");
     printf("  num_threads %u\n", this->num_threads);
@@ -186,18 +358,118 @@ struct Configuration {
     printf("  relation_r_size %" PRIu64 "\n", relation_r_size);
     printf("  relation_s_size %" PRIu64 "\n", relation_s_size);
     printf("  delimitor %s\n", delimitor.c_str());
+    printf("  hasher %s\n", hasher_strings[static_cast<int>(hasher)]);
+    printf("  branching %s\n", branching_strings[static_cast<int>(branching)]);
+    printf("  aggr %s\n", aggr ? "enabled" : "disabled");
+    printf("  prefetch queues ins %u find %u\n", pf_queue_len,
+           pf_find_queue_len);
+    printf("  flush thresholds ins %u find %u%s\n", ins_flush_threshold,
+           find_flush_threshold, pf_tune ? " (tuned)" : "");
+    printf("  insert prefetch for %s\n", pf_write ? "write" : "read");
+    printf("  queue_finds %s (inflight %u)\n",
+           queue_finds ? "enabled" : "disabled", inflight_finds);
+    printf("  elastic_owners %s\n", elastic_owners ? "enabled" : "disabled");
+    printf("  combine_window %u\n", combine_window);
+    printf("  hot_replicas %u\n", hot_replicas);
+    printf("  bq_bulk %s\n", bq_bulk ? "enabled" : "disabled");
+    printf("  queue_type %s\n",
+           queue_kind_strings[static_cast<int>(queue_type)]);
+    printf("  queue_wait %s (spin %" PRIu64 " cycles)\n",
+           queue_wait_strings[static_cast<int>(queue_wait)], queue_spin_cycles);
+    printf("  report %s%s%s\n",
+           report_format_strings[static_cast<int>(report_format)],
+           stats_file.empty() ? "" : " to ", stats_file.c_str());
+    printf("  perf_counters %s\n", perf_counters ? "enabled" : "disabled");
+    printf("  calibrate_bw %s\n", calibrate_bw ? "enabled" : "disabled");
+    if (!trace_file.empty()) printf("  trace to %s\n", trace_file.c_str());
+    if (sample_ms) printf("  throughput sampled every %u ms\n", sample_ms);
+    printf("  control signals %s\n", control ? "enabled" : "disabled");
     printf("}\n");
   }
+
+  /// Call `v(name, value)` for every setting, as the run reports list them.
+  /// Enums are passed by name.
+  template <typename V>
+  void visit_fields(V&& v) const {
+    v("kmer_create_data_base", kmer_create_data_base);
+    v("kmer_create_data_mult", kmer_create_data_mult);
+    v("kmer_create_data_uniq", kmer_create_data_uniq);
+    v("kmer_files_dir", kmer_files_dir);
+    v("alphanum_kmers", alphanum_kmers);
+    v("stats_file", stats_file);
+    v("ht_file", ht_file);
+    v("in_file", in_file);
+    v("in_file_sz", in_file_sz);
+    v("K", K);
+    v("num_threads", num_threads);
+    v("mode", run_mode_strings[mode]);
+    v("numa_split", numa_split);
+    v("ht_type", ht_type_strings[ht_type]);
+    v("ht_fill", ht_fill);
+    v("ht_size", ht_size);
+    v("insert_factor", insert_factor);
+    v("n_prod", n_prod);
+    v("n_cons", n_cons);
+    v("num_nops", num_nops);
+    v("skew", skew);
+    v("seed", seed);
+    v("pread", pread);
+    v("drop_caches", drop_caches);
+    v("hwprefetchers", hwprefetchers);
+    v("no_prefetch", no_prefetch);
+    v("run_both", run_both);
+    v("batch_len", batch_len);
+    v("materialize", materialize);
+    v("relation_r", relation_r);
+    v("relation_s", relation_s);
+    v("relation_r_size", relation_r_size);
+    v("relation_s_size", relation_s_size);
+    v("delimitor", delimitor);
+    v("rw_queues", rw_queues);
+    v("pollute_ratio", pollute_ratio);
+    v("hasher", hasher_strings[static_cast<int>(hasher)]);
+    v("branching", branching_strings[static_cast<int>(branching)]);
+    v("aggr", aggr);
+    v("pf_queue_len", pf_queue_len);
+    v("pf_find_queue_len", pf_find_queue_len);
+    v("ins_flush_threshold", ins_flush_threshold);
+    v("find_flush_threshold", find_flush_threshold);
+    v("pf_tune", pf_tune);
+    v("pf_write", pf_write);
+    v("queue_finds", queue_finds);
+    v("inflight_finds", inflight_finds);
+    v("elastic_owners", elastic_owners);
+    v("combine_window", combine_window);
+    v("hot_replicas", hot_replicas);
+    v("bq_bulk", bq_bulk);
+    v("queue_type", queue_kind_strings[static_cast<int>(queue_type)]);
+    v("queue_wait", queue_wait_strings[static_cast<int>(queue_wait)]);
+    v("queue_spin_cycles", queue_spin_cycles);
+    v("report_format", report_format_strings[static_cast<int>(report_format)]);
+    v("perf_counters", perf_counters);
+    v("calibrate_bw", calibrate_bw);
+    v("trace_file", trace_file);
+    v("sample_ms", sample_ms);
+    v("control", control);
+  }
 };
 
 struct OpTimings {
   uint64_t duration;
   uint64_t op_count;
+  // hardware events over `duration`, if they were counted
+  PerfCounts events = perf_not_counted();
 };
 
 inline OpTimings& operator+=(OpTimings& a, const OpTimings& b) {
   a.duration += b.duration;
   a.op_count += b.op_count;
+  for (auto i = 0u; i < a.events.size(); i++) {
+    a.events[i] = a.events[i] == PERF_NOT_COUNTED ||
+                          b.events[i] == PERF_NOT_COUNTED
+                      ? PERF_NOT_COUNTED
+                      : a.events[i] + b.events[i];
+  }
   return a;
 }
 
@@ -205,7 +477,94 @@ inline auto cycles_per_op(const OpTimings& ops) {
   return ops.duration / ops.op_count;
 }
 
+/// How an insert or find ended: a hit found its key in the table, a miss
+/// took (insert) or met (find) an empty slot.
+enum class ProbeOutcome { InsertHit, InsertMiss, FindHit, FindMiss, Count };
+
+inline constexpr const char* probe_outcome_strings[] = {
+    "insert_hit", "insert_miss", "find_hit", "find_miss"};
+
+/// Ops of a table by outcome and probe length: the cachelines it probed
+/// after its own, i.e. the times it went back into the prefetch queue.
+/// Counted in PROBE_STATS builds.
+struct ProbeHistograms {
+  using Histogram = std::array<uint64_t, PROBE_HISTOGRAM_BUCKETS>;
+  std::array<Histogram, static_cast<size_t>(ProbeOutcome::Count)> counts{};
+  // home slots of the ops, by the part of the table they fall in
+  Histogram homes{};
+
+  void record(ProbeOutcome outcome, uint32_t probes) {
+    counts[static_cast<size_t>(outcome)]
+          [std::min(probes, PROBE_HISTOGRAM_BUCKETS - 1)]++;
+  }
+
+  void record_home(size_t idx, size_t capacity) {
+    homes[idx * PROBE_HISTOGRAM_BUCKETS / capacity]++;
+  }
+
+  const Histogram& operator[](ProbeOutcome outcome) const {
+    return counts[static_cast<size_t>(outcome)];
+  }
+
+  uint64_t ops(ProbeOutcome outcome) const {
+    uint64_t n = 0;
+    for (const auto c : (*this)[outcome]) n += c;
+    return n;
+  }
+
+  /// Longer probes count as the last bucket.
+  double mean(ProbeOutcome outcome) const {
+    double sum = 0;
+    const auto& h = (*this)[outcome];
+    for (auto i = 0u; i < h.size(); i++) sum += static_cast<double>(i) * h[i];
+    return sum / ops(outcome);
+  }
+
+  /// The probe length of an op that went slot by slot from `home` to `idx`
+  /// in a table of `capacity` slots, `per_line` of them to a cacheline.
+  static uint32_t probe_length(size_t home, size_t idx, size_t capacity,
+                               size_t per_line) {
+    const size_t line = home - home % per_line;
+    return ((idx + capacity - line) % capacity) / per_line;
+  }
+
+  /// The probe length that `pct` % of the ops do not exceed.
+  uint32_t percentile(ProbeOutcome outcome, double pct) const {
+    const auto& h = (*this)[outcome];
+    const double rank = ops(outcome) * pct / 100;
+    uint64_t seen = 0;
+    for (auto i = 0u; i < h.size(); i++) {
+      seen += h[i];
+      if (seen && seen >= rank) return i;
+    }
+    return 0;
+  }
+};
+
+inline ProbeHistograms& operator+=(ProbeHistograms& a,
+                                   const ProbeHistograms& b) {
+  for (auto o = 0u; o < a.counts.size(); o++) {
+    for (auto i = 0u; i < a.counts[o].size(); i++) {
+      a.counts[o][i] += b.counts[o][i];
+    }
+  }
+  for (auto i = 0u; i < a.homes.size(); i++) a.homes[i] += b.homes[i];
+  return a;
+}
+
 /* Thread stats */
+/// Ops of a running thread so far, which the sampler reads every
+/// --sample-ms (utils/sampler.hpp). Only the thread writes them, with
+/// relaxed stores.
+struct LiveProgress {
+  uint64_t insertions;
+  uint64_t finds;
+  // of its table; counted in CALC_STATS builds
+  uint64_t reprobes;
+  // new keys its inserts put into its table; counted in CALC_STATS builds
+  uint64_t fill;
+};
+
 struct thread_stats {
   OpTimings insertions;
   OpTimings finds;
@@ -226,6 +585,10 @@ struct thread_stats {
   uint64_t avg_read_length;
   uint64_t num_sequences;
 #endif /*CALC_STATS*/
+#ifdef PROBE_STATS
+  ProbeHistograms probes;
+#endif
+  LiveProgress live;
 };
 
 struct Kmer_s {
@@ -317,6 +680,11 @@ struct KeyValuePair {
   operator bool() const { return *this == decltype(*this){}; }
 };
 
+/// Id an insert is reported under; pairs read straight off a queue use their
+/// key.
+inline uint32_t insert_id(const InsertFindArgument& arg) { return arg.id; }
+inline uint32_t insert_id(const KeyValuePair& kv) { return kv.key; }
+
 enum class QueueType {
   insert_queue,
   find_queue,
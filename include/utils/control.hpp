@@ -0,0 +1,182 @@
+#pragma once
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "plog/Log.h"
+#include "types.hpp"
+#include "utils/sampler.hpp"
+
+namespace kmercounter {
+
+/// Set by a stop request. The shards poll it at their batch boundaries; once
+/// it is set they flush their queues there and go on to the report, so the
+/// table keeps everything inserted so far.
+inline std::atomic_bool stop_request{false};
+
+inline bool stop_requested() {
+  return stop_request.load(std::memory_order_relaxed);
+}
+
+/// A thread that serves requests about the run in flight: SIGUSR1 logs the
+/// progress every shard has published, SIGUSR2 asks all of them to stop. The
+/// signal handlers only post to an eventfd; the thread sleeps on it, so it
+/// takes nothing from the shard that shares its cpu.
+class ControlChannel {
+ public:
+  // What a request adds to the eventfd. Requests add up until the thread
+  // reads them, so each kind counts in its own bits.
+  static constexpr uint64_t DUMP = 1;
+  static constexpr uint64_t STOP = 1ull << 20;
+  static constexpr uint64_t QUIT = 1ull << 40;
+
+  /// `capacity` is that of all the tables of the run together.
+  ControlChannel(const Shard *shards, uint32_t num_threads, uint64_t capacity,
+                 uint32_t cpu)
+      : shards_(shards),
+        num_threads_(num_threads),
+        capacity_(capacity),
+        last_(num_threads) {
+    stop_request = false;
+    fd = eventfd(0, EFD_CLOEXEC);
+    if (fd < 0) {
+      PLOGE.printf("Cannot create the control eventfd: %s", strerror(errno));
+      return;
+    }
+
+    struct sigaction act {};
+    act.sa_handler = &ControlChannel::on_signal;
+    act.sa_flags = SA_RESTART;
+    sigemptyset(&act.sa_mask);
+    sigaction(SIGUSR1, &act, &old_usr1_);
+    sigaction(SIGUSR2, &act, &old_usr2_);
+
+    start_ = last_time_ = std::chrono::steady_clock::now();
+    thread_ = std::thread(&ControlChannel::run, this);
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    pthread_setaffinity_np(thread_.native_handle(), sizeof(cpu_set_t),
+                           &cpuset);
+    PLOGI.printf(
+        "kill -USR1 %d logs the progress of the run, kill -USR2 %d stops it "
+        "early",
+        getpid(), getpid());
+  }
+
+  ~ControlChannel() {
+    if (fd < 0) return;
+    sigaction(SIGUSR1, &old_usr1_, nullptr);
+    sigaction(SIGUSR2, &old_usr2_, nullptr);
+    send(QUIT);
+    thread_.join();
+    close(fd);
+    fd = -1;
+  }
+
+  ControlChannel(const ControlChannel &) = delete;
+  ControlChannel &operator=(const ControlChannel &) = delete;
+
+  /// Post a request, as the signals do. Async-signal-safe.
+  static void send(uint64_t request) {
+    if (fd >= 0) {
+      [[maybe_unused]] auto ret = write(fd, &request, sizeof(request));
+    }
+  }
+
+ private:
+  // of the one channel at a time, for the signal handlers
+  static inline int fd = -1;
+
+  static void on_signal(int sig) {
+    const int saved_errno = errno;
+    send(sig == SIGUSR2 ? STOP : DUMP);
+    errno = saved_errno;
+  }
+
+  void run() {
+    for (;;) {
+      uint64_t requests;
+      if (read(fd, &requests, sizeof(requests)) != sizeof(requests)) {
+        if (errno == EINTR) continue;
+        PLOGE.printf("Control channel: %s", strerror(errno));
+        return;
+      }
+      if (requests & (STOP - 1)) dump();
+      if ((requests & (QUIT - STOP)) && !stop_request.exchange(true)) {
+        PLOGW.printf(
+            "Stop requested: every thread flushes its queues at its next "
+            "batch and reports what it has done so far");
+      }
+      if (requests >= QUIT) return;
+    }
+  }
+
+  /// Log every shard's progress, and its throughput since the last dump.
+  void dump() {
+    const auto now = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> secs = now - start_;
+    const std::chrono::duration<double, std::micro> us = now - last_time_;
+    LiveProgress total{};
+    double insert_mops = 0, find_mops = 0;
+    auto reprobes_per_op = [](const LiveProgress &p) {
+      const auto ops = p.insertions + p.finds;
+      return ops ? static_cast<double>(p.reprobes) / ops : 0;
+    };
+
+    PLOGI.printf("Progress at %.3f s:", secs.count());
+    for (uint32_t i = 0; i < num_threads_; i++) {
+      const auto cur = read_progress(shards_[i].stats->live);
+      auto &last = last_[i];
+      const double ins = (cur.insertions - last.insertions) / us.count();
+      const double fnd = (cur.finds - last.finds) / us.count();
+      PLOGI.printf("  thread %u: %" PRIu64 " inserts, %" PRIu64
+                   " finds, %.3f reprobes/op; %.3f insert Mops/s, %.3f find "
+                   "Mops/s",
+                   i, cur.insertions, cur.finds, reprobes_per_op(cur), ins,
+                   fnd);
+      total.insertions += cur.insertions;
+      total.finds += cur.finds;
+      total.reprobes += cur.reprobes;
+      total.fill += cur.fill;
+      insert_mops += ins;
+      find_mops += fnd;
+      last = cur;
+    }
+    PLOGI.printf("  all: %" PRIu64 " inserts, %" PRIu64
+                 " finds, %.3f reprobes/op; %.3f insert Mops/s, %.3f find "
+                 "Mops/s",
+                 total.insertions, total.finds, reprobes_per_op(total),
+                 insert_mops, find_mops);
+#ifdef CALC_STATS
+    if (capacity_) {
+      PLOGI.printf("  fill: %" PRIu64 " keys, %.1f %%", total.fill,
+                   100.0 * total.fill / capacity_);
+    }
+#endif
+    last_time_ = now;
+  }
+
+  const Shard *shards_;
+  uint32_t num_threads_;
+  uint64_t capacity_;
+  // what every shard had published at the last dump
+  std::vector<LiveProgress> last_;
+  std::chrono::steady_clock::time_point start_, last_time_;
+  struct sigaction old_usr1_ {};
+  struct sigaction old_usr2_ {};
+  std::thread thread_;
+};
+
+}  // namespace kmercounter
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace kmercounter {
+
+/// What the memory of one NUMA node serves at most, measured from all cpus
+/// of the node.
+struct MemoryPeak {
+  unsigned int node;
+  // 64 B lines per second, every cpu streaming through its own slice
+  double seq_lines_per_sec;
+  // 64 B lines per second, every cpu chasing many independent random chains
+  double random_lines_per_sec;
+  // one dependent random load on an otherwise idle node
+  double latency_ns;
+};
+
+/// Calibrated by Application with --calibrate-bw, before the run; empty
+/// otherwise.
+inline std::vector<MemoryPeak> memory_peaks;
+
+/// One cpu chasing `streams` independent random chains at once.
+struct MlpPoint {
+  uint32_t streams;
+  double lines_per_sec;
+  // of one load, with the others in flight
+  double latency_ns;
+
+  template <typename V>
+  void visit(V &&v) const {
+    v("streams", streams);
+    v("lines_per_sec", lines_per_sec);
+    v("latency_ns", latency_ns);
+  }
+};
+
+/// A dependent random load from the cpus of one node to the memory of
+/// another.
+struct NodeLatency {
+  unsigned int cpu_node;
+  unsigned int mem_node;
+  // as the ACPI SLIT has it, 10 for local
+  int distance;
+  double latency_ns;
+
+  template <typename V>
+  void visit(V &&v) const {
+    v("cpu_node", cpu_node);
+    v("mem_node", mem_node);
+    v("distance", distance);
+    v("latency_ns", latency_ns);
+  }
+};
+
+/// What CACHE_MISS and --calibrate-bw measure of the memory system before
+/// the run.
+struct LatencyCalibration {
+  // a dependent random load on the first node, by page size; NaN where no
+  // pages of that size could be had
+  double latency_4k_ns = std::numeric_limits<double>::quiet_NaN();
+  double latency_2m_ns = std::numeric_limits<double>::quiet_NaN();
+  double latency_1g_ns = std::numeric_limits<double>::quiet_NaN();
+  std::vector<NodeLatency> numa;
+  // on the first node
+  std::vector<MlpPoint> mlp;
+  // for --pf-queue-len and --pf-find-queue-len; 0 without an MLP curve
+  uint32_t suggested_queue_len = 0;
+
+  /// Call `v(name, value)` for every value but the curves.
+  template <typename V>
+  void visit(V &&v) const {
+    v("latency_4k_ns", latency_4k_ns);
+    v("latency_2m_ns", latency_2m_ns);
+    v("latency_1g_ns", latency_1g_ns);
+    v("suggested_queue_len", suggested_queue_len);
+  }
+};
+
+/// Calibrated by Application with --calibrate-bw or in CACHE_MISS mode,
+/// before the run; empty otherwise.
+inline LatencyCalibration latency_calibration;
+
+/// The fewest streams that get within 10 % of the best throughput of the
+/// curve.
+inline uint32_t mlp_knee(const std::vector<MlpPoint> &mlp) {
+  double best = 0;
+  for (const auto &p : mlp) best = std::max(best, p.lines_per_sec);
+  for (const auto &p : mlp) {
+    if (p.lines_per_sec >= 0.9 * best) return p.streams;
+  }
+  return 1;
+}
+
+/// A prefetch queue that keeps the knee of the curve in flight: the tables
+/// drain it at half its length (the default flush threshold), so twice the
+/// knee, as a power of two.
+inline uint32_t suggest_prefetch_queue_len(const std::vector<MlpPoint> &mlp) {
+  return std::bit_ceil(std::max(2 * mlp_knee(mlp), 2u));
+}
+
+/// The suggested queue length, raised until a batch of `batch_len` still
+/// fits on top of the half of it that is queued when the queue is drained.
+inline uint32_t fit_prefetch_queue_len(uint32_t suggested,
+                                       uint32_t batch_len) {
+  return std::max(suggested, std::bit_ceil(2 * batch_len + 1));
+}
+
+}  // namespace kmercounter
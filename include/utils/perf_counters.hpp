@@ -0,0 +1,248 @@
+#pragma once
+
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+namespace kmercounter {
+
+/// Set by Application from --perf-counters.
+inline bool perf_counters_enabled = false;
+
+/// Hardware counters of the calling thread, through perf_event_open. They
+/// count user space only, which needs no privileges up to
+/// perf_event_paranoid 2. Events that the kernel or the PMU refuse (e.g. in
+/// a VM) read as PERF_NOT_COUNTED.
+class PerfCounters {
+ public:
+  PerfCounters() {
+    for (auto e = 0u; e < fds_.size(); e++) {
+      fds_[e] = open_event(static_cast<PerfEvent>(e));
+    }
+  }
+
+  ~PerfCounters() {
+    for (const auto fd : fds_) {
+      if (fd >= 0) close(fd);
+    }
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  /// The counters of the calling thread, opened on first use.
+  static PerfCounters &this_thread() {
+    thread_local PerfCounters counters;
+    return counters;
+  }
+
+  bool counted(PerfEvent event) const {
+    return fds_[static_cast<std::size_t>(event)] >= 0;
+  }
+
+  /// Counts so far, scaled up for the time an event was multiplexed out.
+  PerfCounts read() const {
+    PerfCounts counts;
+    for (auto e = 0u; e < fds_.size(); e++) {
+      // value, time enabled, time running
+      uint64_t v[3];
+      if (fds_[e] < 0 || ::read(fds_[e], v, sizeof(v)) != sizeof(v)) {
+        counts[e] = PERF_NOT_COUNTED;
+      } else {
+        counts[e] = v[2] ? static_cast<double>(v[0]) * v[1] / v[2] : 0;
+      }
+    }
+    return counts;
+  }
+
+ private:
+  static int open_event(PerfEvent event) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    auto cache_miss = [&attr](uint64_t cache) {
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    };
+    attr.type = PERF_TYPE_HARDWARE;
+    switch (event) {
+      case PerfEvent::Cycles:
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+      case PerfEvent::Instructions:
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+      case PerfEvent::L1dMisses:
+        cache_miss(PERF_COUNT_HW_CACHE_L1D);
+        break;
+      case PerfEvent::LlcMisses:
+        cache_miss(PERF_COUNT_HW_CACHE_LL);
+        break;
+      case PerfEvent::DtlbMisses:
+        cache_miss(PERF_COUNT_HW_CACHE_DTLB);
+        break;
+      case PerfEvent::BranchMisses:
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+      case PerfEvent::Count:
+        return -1;
+    }
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  std::array<int, static_cast<std::size_t>(PerfEvent::Count)> fds_;
+};
+
+/// Events of the calling thread between construction and `end`, or
+/// PERF_NOT_COUNTED throughout without --perf-counters.
+class PerfRegion {
+ public:
+  PerfRegion() {
+    if (perf_counters_enabled) start_ = PerfCounters::this_thread().read();
+  }
+
+  PerfCounts end() const {
+    auto counts = perf_not_counted();
+    if (!perf_counters_enabled) return counts;
+
+    const auto now = PerfCounters::this_thread().read();
+    for (auto e = 0u; e < counts.size(); e++) {
+      if (now[e] != PERF_NOT_COUNTED && start_[e] != PERF_NOT_COUNTED) {
+        counts[e] = now[e] - start_[e];
+      }
+    }
+    return counts;
+  }
+
+ private:
+  PerfCounts start_;
+};
+
+/// DRAM traffic, from the CAS counts of the uncore memory controller PMUs
+/// that the kernel lists as /sys/bus/event_source/devices/uncore_imc_*.
+/// These count system wide, which needs perf_event_paranoid <= 0 or
+/// CAP_PERFMON; without that, on machines that do not expose the PMUs, or
+/// without --perf-counters, nothing is counted.
+class ImcCounters {
+ public:
+  ImcCounters() {
+    if (!perf_counters_enabled) return;
+    static constexpr auto devices = "/sys/bus/event_source/devices/";
+    DIR *dir = opendir(devices);
+    if (!dir) return;
+    while (const auto entry = readdir(dir)) {
+      const std::string name = entry->d_name;
+      if (name.rfind("uncore_imc_", 0) != 0) continue;
+      const auto pmu = devices + name + '/';
+      open_pmu(pmu, "cas_count_read", &read_fds_);
+      open_pmu(pmu, "cas_count_write", &write_fds_);
+    }
+    closedir(dir);
+  }
+
+  ~ImcCounters() {
+    for (const auto fd : read_fds_) close(fd);
+    for (const auto fd : write_fds_) close(fd);
+  }
+
+  ImcCounters(const ImcCounters &) = delete;
+  ImcCounters &operator=(const ImcCounters &) = delete;
+
+  bool counted() const { return !read_fds_.empty(); }
+
+  void start() {
+    read_start_ = sum(read_fds_);
+    write_start_ = sum(write_fds_);
+  }
+
+  /// Bytes read from and written to DRAM since `start`.
+  uint64_t read_bytes() const { return (sum(read_fds_) - read_start_) * 64; }
+  uint64_t write_bytes() const {
+    return (sum(write_fds_) - write_start_) * 64;
+  }
+
+ private:
+  static std::string read_line(const std::string &path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+  }
+
+  /// `event=0x04,umask=0x03` into a perf config, placing every term at the
+  /// bits its `format/<term>` file (`config:8-15`) gives.
+  static bool parse_config(const std::string &pmu, const std::string &terms,
+                           __u64 *config) {
+    *config = 0;
+    size_t pos = 0;
+    while (pos < terms.size()) {
+      auto comma = terms.find(',', pos);
+      if (comma == std::string::npos) comma = terms.size();
+      const auto term = terms.substr(pos, comma - pos);
+      pos = comma + 1;
+
+      const auto eq = term.find('=');
+      const auto value =
+          eq == std::string::npos ? 1 : std::stoull(term.substr(eq + 1), 0, 0);
+      unsigned lo;
+      const auto format = read_line(pmu + "format/" + term.substr(0, eq));
+      if (sscanf(format.c_str(), "config:%u", &lo) != 1) return false;
+      *config |= value << lo;
+    }
+    return true;
+  }
+
+  static void open_pmu(const std::string &pmu, const std::string &event,
+                       std::vector<int> *fds) {
+    const auto terms = read_line(pmu + "events/" + event);
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    const auto type = read_line(pmu + "type");
+    if (terms.empty() || type.empty() ||
+        !parse_config(pmu, terms, &attr.config)) {
+      return;
+    }
+    attr.type = std::stoul(type);
+
+    // one cpu of every socket
+    const auto cpumask = read_line(pmu + "cpumask");
+    size_t pos = 0;
+    while (pos < cpumask.size()) {
+      const int cpu = std::stoi(cpumask.substr(pos));
+      const int fd = syscall(SYS_perf_event_open, &attr, -1, cpu, -1, 0);
+      if (fd >= 0) fds->push_back(fd);
+      pos = cpumask.find(',', pos);
+      if (pos == std::string::npos) break;
+      pos++;
+    }
+  }
+
+  static uint64_t sum(const std::vector<int> &fds) {
+    uint64_t total = 0;
+    for (const auto fd : fds) {
+      uint64_t count;
+      if (::read(fd, &count, sizeof(count)) == sizeof(count)) total += count;
+    }
+    return total;
+  }
+
+  std::vector<int> read_fds_;
+  std::vector<int> write_fds_;
+  uint64_t read_start_ = 0;
+  uint64_t write_start_ = 0;
+};
+
+}  // namespace kmercounter
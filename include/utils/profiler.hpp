@@ -2,11 +2,14 @@
 #define UTILS_PROFILER_HPP
 
 
+#include <optional>
 #include <string>
 #include <string_view>
 
 #include "sync.h"
 #include "plog/Log.h"
+#include "utils/perf_counters.hpp"
+#include "utils/trace.hpp"
 
 
 #ifdef ENABLE_HIGH_LEVEL_PAPI
@@ -19,23 +22,31 @@
 
 namespace kmercounter {
 
+/// A timed region of one thread. Besides the TSC, it is reported to VTune
+/// and PAPI when they are built in, and its hardware events are counted with
+/// perf_event_open (--perf-counters). Given a trace event, the region also
+/// goes on the timeline of --trace-file.
 class Profiler {
  public:
-  Profiler(std::string_view name) : name_(name) {
+  Profiler(std::string_view name, std::optional<TraceEvent> trace = {})
+      : name_(name), trace_(trace) {
 #ifdef WITH_VTUNE_LIB
     event_ = __itt_event_create(name_.c_str(), name_.length());
     __itt_event_start(event_);
 #endif
 
 #ifdef ENABLE_HIGH_LEVEL_PAPI
-    papi_check(PAPI_hl_region_begin(name));
+    papi_check(PAPI_hl_region_begin(name_.c_str()));
 #endif
 
     rdtsc_start_ = RDTSC_START();
   }
 
   uint64_t end() {
-    const auto duration = RDTSCP() - rdtsc_start_;
+    const auto rdtsc_end = RDTSCP();
+    const auto duration = rdtsc_end - rdtsc_start_;
+    events_ = perf_.end();
+    if (trace_) trace_phase(*trace_, rdtsc_start_, rdtsc_end);
 
 #ifdef WITH_VTUNE_LIB
     __itt_event_end(event_);
@@ -48,18 +59,27 @@ class Profiler {
     return duration;
   }
 
+  /// Hardware events of the region, once it has ended.
+  const PerfCounts &events() const { return events_; }
+
  private:
+#ifdef ENABLE_HIGH_LEVEL_PAPI
   void papi_check(int code) {
     if (code != PAPI_OK) {
       PLOG_ERROR << "PAPI call failed with code " << code;
       std::terminate();
     }
   }
+#endif
 
   // Name of the region.
   std::string name_;
+  std::optional<TraceEvent> trace_;
   // RDTSC at the start of the duration.
   uint64_t rdtsc_start_;
+  // started before the VTune/PAPI regions
+  PerfRegion perf_;
+  PerfCounts events_;
 #ifdef WITH_VTUNE_LIB
   __itt_event event_;
 #endif
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <pthread.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "types.hpp"
+
+namespace kmercounter {
+
+/// Where the calling thread publishes its progress (the `live` of its
+/// thread_stats), or null if nobody samples it.
+inline thread_local LiveProgress *live_progress = nullptr;
+
+/// Publish that the calling thread has done `count` ops of a kind so far,
+/// e.g. `publish_progress(&LiveProgress::insertions, n)`. A plain store.
+inline void publish_progress(uint64_t LiveProgress::*ops, uint64_t count) {
+  if (live_progress) {
+    std::atomic_ref(live_progress->*ops).store(count,
+                                               std::memory_order_relaxed);
+  }
+}
+
+/// What a thread has published so far; safe to call while it publishes.
+inline LiveProgress read_progress(const LiveProgress &live) {
+  auto read = [](const uint64_t &ops) {
+    return std::atomic_ref(const_cast<uint64_t &>(ops))
+        .load(std::memory_order_relaxed);
+  };
+  return {read(live.insertions), read(live.finds), read(live.reprobes),
+          read(live.fill)};
+}
+
+/// The throughput of all threads over one interval of the run.
+struct ThroughputSample {
+  // since the sampler started, at the end of the interval
+  double secs;
+  double insert_mops;
+  double find_mops;
+  double reprobes_per_op;
+  // inserts of all threads so far
+  uint64_t insertions;
+  // keys in the table(s) so far, if the build counts them
+  std::optional<uint64_t> fill;
+  // fill over the capacity of the table(s), filled in by the report
+  double fill_pct = std::numeric_limits<double>::quiet_NaN();
+
+  template <typename V>
+  void visit(V &&v) const {
+    v("secs", secs);
+    v("insert_mops", insert_mops);
+    v("find_mops", find_mops);
+    v("fill_pct", fill_pct);
+    v("reprobes_per_op", reprobes_per_op);
+  }
+};
+
+/// Samples of the last run with --sample-ms, for its report.
+inline std::vector<ThroughputSample> throughput_samples;
+
+/// A thread that sums up the progress the shards publish, every `interval`.
+/// It sleeps in between, so it takes next to nothing from the shard that
+/// shares its cpu.
+class ThroughputSampler {
+ public:
+  ThroughputSampler(const Shard *shards, uint32_t num_threads,
+                    std::chrono::milliseconds interval, uint32_t cpu)
+      : shards_(shards), num_threads_(num_threads), interval_(interval) {
+    thread_ = std::thread(&ThroughputSampler::run, this);
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    pthread_setaffinity_np(thread_.native_handle(), sizeof(cpu_set_t),
+                           &cpuset);
+  }
+
+  ~ThroughputSampler() { stop(); }
+
+  ThroughputSampler(const ThroughputSampler &) = delete;
+  ThroughputSampler &operator=(const ThroughputSampler &) = delete;
+
+  /// Take a last sample, of the part of an interval since the one before,
+  /// and stop.
+  const std::vector<ThroughputSample> &stop() {
+    {
+      std::lock_guard lock(lock_);
+      stop_ = true;
+    }
+    wake_.notify_one();
+    if (thread_.joinable()) thread_.join();
+    return samples_;
+  }
+
+ private:
+  LiveProgress sum() const {
+    LiveProgress total{};
+    for (uint32_t i = 0; i < num_threads_; i++) {
+      const auto live = read_progress(shards_[i].stats->live);
+      total.insertions += live.insertions;
+      total.finds += live.finds;
+      total.reprobes += live.reprobes;
+      total.fill += live.fill;
+    }
+    return total;
+  }
+
+  void run() {
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    auto last_time = start;
+    auto last = sum();
+
+    std::unique_lock lock(lock_);
+    for (bool last_sample = false; !last_sample;) {
+      last_sample = wake_.wait_for(lock, interval_, [this] { return stop_; });
+      const auto now = clock::now();
+      const auto cur = sum();
+      const std::chrono::duration<double, std::micro> us = now - last_time;
+      const std::chrono::duration<double> secs = now - start;
+      const auto ops = (cur.insertions - last.insertions) +
+                       (cur.finds - last.finds);
+
+      auto &s = samples_.emplace_back();
+      s.secs = secs.count();
+      s.insert_mops = (cur.insertions - last.insertions) / us.count();
+      s.find_mops = (cur.finds - last.finds) / us.count();
+      s.reprobes_per_op =
+          ops ? static_cast<double>(cur.reprobes - last.reprobes) / ops : 0;
+      s.insertions = cur.insertions;
+#ifdef CALC_STATS
+      s.fill = cur.fill;
+#endif
+
+      last = cur;
+      last_time = now;
+    }
+  }
+
+  const Shard *shards_;
+  uint32_t num_threads_;
+  std::chrono::milliseconds interval_;
+  std::vector<ThroughputSample> samples_;
+  std::mutex lock_;
+  std::condition_variable wake_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+}  // namespace kmercounter
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "constants.hpp"
+#include "plog/Log.h"
+#include "sync.h"
+#include "utils/tsc.hpp"
+
+namespace kmercounter {
+
+// Phases of a thread on the timeline of --trace-file
+enum class TraceEvent : uint8_t {
+  Read,
+  Build,
+  Probe,
+  Insert,
+  Find,
+  Enqueue,
+  Flush,
+  Barrier,
+  QueueFull,
+};
+
+inline constexpr const char *trace_event_names[] = {
+    "read",  "build", "probe",        "insert",    "find",
+    "enqueue", "flush", "barrier wait", "queue full",
+};
+
+/// Set by Application from --trace-file.
+inline bool trace_enabled = false;
+
+struct TraceRecord {
+  uint64_t begin;
+  uint64_t end;
+  TraceEvent event;
+};
+
+/// The last TRACE_RING_EVENTS phases of one thread. Only that thread writes
+/// to it; it is read once all threads are done.
+struct TraceRing {
+  std::string name;
+  pid_t tid = 0;
+  // phases recorded so far, of which the ring keeps the last ones
+  uint64_t head = 0;
+  std::vector<TraceRecord> records =
+      std::vector<TraceRecord>(TRACE_RING_EVENTS);
+
+  void push(TraceEvent event, uint64_t begin, uint64_t end) {
+    records[head++ & (TRACE_RING_EVENTS - 1)] = {begin, end, event};
+  }
+};
+
+static_assert((TRACE_RING_EVENTS & (TRACE_RING_EVENTS - 1)) == 0);
+
+// The rings outlive their threads, so that they can be exported at exit
+inline std::mutex trace_rings_lock;
+inline std::vector<std::unique_ptr<TraceRing>> trace_rings;
+
+/// The ring of the calling thread, registered on first use.
+inline TraceRing &this_thread_ring() {
+  thread_local TraceRing *ring = [] {
+    auto r = std::make_unique<TraceRing>();
+    r->tid = syscall(SYS_gettid);
+    r->name = "thread " + std::to_string(r->tid);
+    std::lock_guard lock(trace_rings_lock);
+    return trace_rings.emplace_back(std::move(r)).get();
+  }();
+  return *ring;
+}
+
+/// Name the calling thread on the timeline, e.g. "shard 3".
+inline void trace_thread_name(std::string name) {
+  if (trace_enabled) this_thread_ring().name = std::move(name);
+}
+
+/// A phase of the calling thread between two TSC readings taken elsewhere.
+inline void trace_phase(TraceEvent event, uint64_t begin, uint64_t end) {
+  if (trace_enabled) this_thread_ring().push(event, begin, end);
+}
+
+/// A phase of the calling thread, from construction to destruction. Costs a
+/// branch without --trace-file, and two RDTSCs and a store with it.
+class TraceScope {
+ public:
+  explicit TraceScope(TraceEvent event) : event_(event) {
+    if (trace_enabled) begin_ = RDTSC_START();
+  }
+
+  ~TraceScope() {
+    if (trace_enabled) this_thread_ring().push(event_, begin_, RDTSCP());
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+ private:
+  TraceEvent event_;
+  uint64_t begin_ = 0;
+};
+
+/// `barrier->arrive_and_wait()`, traced as a barrier wait.
+template <typename Barrier>
+inline void trace_arrive_and_wait(Barrier *barrier) {
+  const TraceScope wait(TraceEvent::Barrier);
+  barrier->arrive_and_wait();
+}
+
+/// Write the phases of all threads to `path` in the Chrome trace event
+/// format, which chrome://tracing and ui.perfetto.dev open. Call it once
+/// the traced threads are done.
+inline void write_chrome_trace(const std::string &path) {
+  std::lock_guard lock(trace_rings_lock);
+  FILE *out = fopen(path.c_str(), "w");
+  if (!out) {
+    PLOGE.printf("Cannot write the trace to %s: %s", path.c_str(),
+                 strerror(errno));
+    return;
+  }
+
+  auto kept = [](const TraceRing &ring) {
+    return std::min<uint64_t>(ring.head, TRACE_RING_EVENTS);
+  };
+  uint64_t t0 = UINT64_MAX;
+  for (const auto &ring : trace_rings) {
+    for (uint64_t i = ring->head - kept(*ring); i < ring->head; i++) {
+      t0 = std::min(t0, ring->records[i & (TRACE_RING_EVENTS - 1)].begin);
+    }
+  }
+  const double us_per_cycle = 1e6 / tsc_hz();
+
+  const int pid = getpid();
+  uint64_t num_events = 0;
+  fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+  for (const auto &ring : trace_rings) {
+    fprintf(out,
+            "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, "
+            "\"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+            num_events++ ? "," : "", pid, ring->tid, ring->name.c_str());
+    if (ring->head > TRACE_RING_EVENTS) {
+      PLOGW.printf("Trace of %s: kept the last %" PRIu64 " of %" PRIu64
+                   " phases",
+                   ring->name.c_str(), TRACE_RING_EVENTS, ring->head);
+    }
+    for (uint64_t i = ring->head - kept(*ring); i < ring->head; i++) {
+      const auto &r = ring->records[i & (TRACE_RING_EVENTS - 1)];
+      fprintf(out,
+              ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, "
+              "\"ts\": %.3f, \"dur\": %.3f}",
+              trace_event_names[static_cast<int>(r.event)], pid, ring->tid,
+              (r.begin - t0) * us_per_cycle, (r.end - r.begin) * us_per_cycle);
+      num_events++;
+    }
+  }
+  fprintf(out, "\n]}\n");
+  fclose(out);
+  PLOGI.printf("Wrote %" PRIu64 " trace events of %zu threads to %s",
+               num_events, trace_rings.size(), path.c_str());
+}
+
+}  // namespace kmercounter
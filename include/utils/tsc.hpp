@@ -0,0 +1,30 @@
+#pragma once
+
+#include <x86intrin.h>
+
+#include <chrono>
+#include <thread>
+
+namespace kmercounter {
+
+/// TSC ticks per second, timed against the monotonic clock. The TSC is
+/// invariant on every machine we run on, so one measurement holds for the
+/// whole run and for all cores.
+inline double calibrate_tsc_hz() {
+  using clock = std::chrono::steady_clock;
+  const auto t_start = clock::now();
+  const auto tsc_start = __rdtsc();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  const auto tsc_end = __rdtsc();
+  const std::chrono::duration<double> secs = clock::now() - t_start;
+  return (tsc_end - tsc_start) / secs.count();
+}
+
+/// Calibrated on first use; Application does that at startup, before any
+/// thread is timed.
+inline double tsc_hz() {
+  static const double hz = calibrate_tsc_hz();
+  return hz;
+}
+
+}  // namespace kmercounter
@@ -52,6 +52,9 @@ def get_additional_args(n: int, args: argparse.Namespace):
             extra_cmdline_args += [ '--mode=11']
     if args.no_prefetch:
         extra_cmdline_args += [ '--no-prefetch=1' ]
+    extra_cmdline_args += [ f'--branching={args.branching}' ]
+    if args.aggr:
+        extra_cmdline_args += [ '--aggr=1' ]
 
     return extra_cmdline_args
 
@@ -142,6 +145,8 @@ if __name__ == '__main__':
     parser.add_argument('--skew', nargs='?', type=float, help='Skew for zipfian')
     parser.add_argument('--bq', action='store_true', help='Enable prodcuer/consumer with partitioned HT')
     parser.add_argument('--no_prefetch', action='store_true', default=False, help='Disable prefetch engine')
+    parser.add_argument('--branching', choices=['branched', 'cmov', 'simd'], default='branched', help='Probe style of the hashtable')
+    parser.add_argument('--aggr', action='store_true', default=False, help='Use the aggregation (histogram) hashtable')
 
     args = parser.parse_args()
 
@@ -189,10 +194,10 @@ if __name__ == '__main__':
             part_home.mkdir(parents=True, exist_ok=True)
             if args.bq:
                 run_synchronous(part_home, 'cmake', [
-                                source, '-GNinja', '-DBRANCH=branched', '-DBQUEUE=ON'] + additional_build_args)
+                                source, '-GNinja', '-DBQUEUE=ON'] + additional_build_args)
             else:
                 run_synchronous(part_home, 'cmake', [
-                                source, '-GNinja', '-DBRANCH=branched'] + additional_build_args)
+                                source, '-GNinja'] + additional_build_args)
 
             run_synchronous(part_home, 'cmake', ['--build', '.'])
             if args.bq:
@@ -11,14 +11,20 @@
 #include <ctime>
 #include <fstream>
 #include <functional>
+#include <optional>
 
 #include "./hashtables/cas_kht.hpp"
 #include "./hashtables/simple_kht.hpp"
 #include "./hashtables/array_kht.hpp"
+#include "./hashtables/ht_dispatch.hpp"
 #include "misc_lib.h"
 #include "print_stats.h"
 #include "tests/PrefetchTest.hpp"
 #include "types.hpp"
+#include "utils/control.hpp"
+#include "utils/perf_counters.hpp"
+#include "utils/sampler.hpp"
+#include "utils/trace.hpp"
 
 #if defined(WITH_PAPI_LIB) || defined(ENABLE_HIGH_LEVEL_PAPI)
 #include <papi.h>
@@ -81,7 +87,31 @@ const Configuration def = {
     .relation_s_size = 128000000,
     .delimitor = "|",
     .rw_queues = false,
-    .pollute_ratio = 0
+    .pollute_ratio = 0,
+    .hasher = default_hasher,
+    .branching = default_branching,
+    .aggr = default_aggr,
+    .pf_queue_len = PREFETCH_QUEUE_SIZE,
+    .pf_find_queue_len = PREFETCH_FIND_QUEUE_SIZE,
+    .ins_flush_threshold = INS_FLUSH_THRESHOLD,
+    .find_flush_threshold = FLUSH_THRESHOLD,
+    .pf_tune = false,
+    .pf_write = true,
+    .queue_finds = false,
+    .inflight_finds = 1024,
+    .elastic_owners = false,
+    .combine_window = 0,
+    .hot_replicas = 0,
+    .bq_bulk = false,
+    .queue_type = QueueKind::Section,
+    .queue_wait = QueueWait::Spin,
+    .queue_spin_cycles = QUEUE_SPIN_CYCLES,
+    .report_format = ReportFormat::Text,
+    .perf_counters = true,
+    .calibrate_bw = false,
+    .trace_file = std::string(""),
+    .sample_ms = 0,
+    .control = true,
 };  // TODO enum
 
 // for synchronization of threads
@@ -140,13 +170,18 @@ BaseHashTable *init_ht(const uint64_t sz, uint8_t id) {
   // Create hash table
   switch (config.ht_type) {
     case PARTITIONED_HT:
-      kmer_ht = new PartitionedHashStore<KVType, ItemQueue>(sz, id);
+      kmer_ht = dispatch_ht_kind<PartitionedHashStore>(
+          [sz, id](auto table) -> BaseHashTable * {
+            return new typename decltype(table)::type(sz, id);
+          });
       break;
     case CASHTPP:
       /* For the CAS Hash table, size is the same as
           size of one partitioned ht * number of threads */
-      kmer_ht =
-          new CASHashTable<KVType, ItemQueue>(sz);  // * config.num_threads);
+      kmer_ht = dispatch_ht_kind<CASHashTable>(
+          [sz](auto table) -> BaseHashTable * {
+            return new typename decltype(table)::type(sz);  // * config.num_threads);
+          });
       break;
     case ARRAY_HT:
       kmer_ht =
@@ -168,17 +203,15 @@ void free_ht(BaseHashTable *kmer_ht) {
 void Application::shard_thread(int tid, std::barrier<std::function<void()>>* barrier) {
   Shard *sh = &this->shards[tid];
   BaseHashTable *kmer_ht = NULL;
-
-  sh->stats =
-      (thread_stats *)std::aligned_alloc(CACHE_LINE_SIZE, sizeof(thread_stats));
+  trace_thread_name("shard " + std::to_string(tid));
+  live_progress = &sh->stats->live;
 
   switch (config.mode) {
     case FASTQ_WITH_INSERT:
       kmer_ht = init_ht(config.ht_size, sh->shard_idx);
       break;
     case PREFETCH:
-      // kmer_ht = new PartitionedHashStore<Prefetch_KV, PrefetchKV_Queue>(
-      //    HT_TESTS_HT_SIZE, sh->shard_idx);
+      // the sweep builds a table per setting
       break;
     case SYNTH:
     case RW_RATIO:
@@ -213,7 +246,7 @@ void Application::shard_thread(int tid, std::barrier<std::function<void()>>* bar
       this->test.st.synth_run_exec(sh, kmer_ht);
       break;
     case PREFETCH:
-      this->test.pt.prefetch_test_run_exec(sh, config, kmer_ht);
+      this->test.pt.prefetch_sweep(sh, barrier);
       break;
     case CACHE_MISS:
       this->test.cmt.cache_miss_run(sh, kmer_ht);
@@ -313,6 +346,30 @@ int Application::spawn_shard_threads() {
   std::function<void()> on_sync_complete = sync_complete;
 
   std::barrier barrier(config.num_threads, on_sync_complete);
+
+  // before the sampler looks at them
+  for (uint32_t k = 0; k < config.num_threads; k++) {
+    this->shards[k].stats = (thread_stats *)std::aligned_alloc(
+        CACHE_LINE_SIZE, sizeof(thread_stats));
+    *this->shards[k].stats = thread_stats{};
+  }
+  // on cpu 0, next to the main thread's shard
+  std::optional<ThroughputSampler> sampler;
+  if (config.sample_ms) {
+    sampler.emplace(this->shards, config.num_threads,
+                    std::chrono::milliseconds(config.sample_ms), 0);
+  }
+  // there too; it sleeps until a signal comes
+  std::optional<ControlChannel> control;
+  if (config.control) {
+    const uint64_t capacity = config.ht_type == PARTITIONED_HT
+                                  ? config.ht_size * config.num_threads
+                                  : config.ht_size;
+    control.emplace(this->shards, config.num_threads, capacity, 0);
+  }
+
+  ImcCounters imc;
+  imc.start();
   uint32_t i = 0;
   for (uint32_t assigned_cpu : this->np->get_assigned_cpu_list()) {
     if (assigned_cpu == 0) continue;
@@ -349,8 +406,17 @@ int Application::spawn_shard_threads() {
       th.join();
     }
   }
-  if ((config.mode != CACHE_MISS) && (config.mode != HASHJOIN)) {
-    print_stats(this->shards, config);
+  if (sampler) {
+    throughput_samples = sampler->stop();
+  }
+  DramTraffic dram;
+  if (imc.counted()) {
+    dram.read_bytes = imc.read_bytes();
+    dram.write_bytes = imc.write_bytes();
+  }
+  if ((config.mode != CACHE_MISS) && (config.mode != HASHJOIN) &&
+      (config.mode != PREFETCH)) {
+    print_stats(this->shards, config, dram);
   }
 
   std::free(this->shards);
@@ -370,10 +436,31 @@ void papi_init() {
 #endif
 }
 
+void Application::run_queue_test(bool is_join) {
+  switch (config.queue_type) {
+    case QueueKind::Section:
+      this->test.qt.run_test(&config, this->n, is_join, this->npq);
+      break;
+    case QueueKind::BQueueAligned:
+      this->test.qt_bq.run_test(&config, this->n, is_join, this->npq);
+      break;
+    case QueueKind::Lynx:
+      this->test.qt_lynx.run_test(&config, this->n, is_join, this->npq);
+      break;
+  }
+}
+
 int Application::process(int argc, char *argv[]) {
+  // prefetch queues left to the latency calibration
+  bool tune_ins_queue = false, tune_find_queue = false;
   try {
     namespace po = boost::program_options;
     po::options_description desc("Program options");
+    std::string hasher_name;
+    std::string branching_name;
+    std::string queue_type_name;
+    std::string queue_wait_name;
+    std::string report_format_name;
 
     desc.add_options()("help", "produce help message")(
         "mode",
@@ -383,10 +470,11 @@ int Application::process(int argc, char *argv[]) {
         "3: write to disk (Save KMER HT to disk?)\n"
         "4: Fastq with insert (for kmer test)\n"
         "5: Fastq without insert (you don't want this)\n"
-        "6/7: Synth/Prefetch\n"
+        "6: Synth\n"
+        "7: Prefetch sweep (queue length, distance, write/read prefetch)\n"
         "8/9: Bqueue tests: with bqueues/without bequeues (can be built with "
         "zipfian)\n"
-        "10: Cache Miss test\n"
+        "10: Cache Miss test, after calibrating load latency and MLP\n"
         "11: Zipfian non-bqueue test\n"
         "12: RW-ratio test\n"
         "13: Hashjoin")(
@@ -423,7 +511,7 @@ int Application::process(int argc, char *argv[]) {
         "stats",
         po::value<std::string>(&config.stats_file)
             ->default_value(def.stats_file),
-        "Stats file name.")(
+        "File the report of the run is written to (default: stdout)")(
         "ht-type",
         po::value<uint32_t>(&config.ht_type)->default_value(def.ht_type),
         "1: Partitioned HT\n"
@@ -464,7 +552,9 @@ int Application::process(int argc, char *argv[]) {
         "run-both",
         po::value<bool>(&config.run_both)->default_value(def.run_both))(
         "batch-len",
-        po::value<uint32_t>(&config.batch_len)->default_value(def.batch_len))(
+        po::value<uint32_t>(&config.batch_len)->default_value(def.batch_len),
+        "Keys per insert/find batch (256 by default with --hasher "
+        "direct_index)")(
         "p-read",
         po::value<double>(&config.pread)->default_value(def.pread))
         ("materialize",
@@ -483,7 +573,117 @@ int Application::process(int argc, char *argv[]) {
           "rw-queues",
           po::value<bool>(&config.rw_queues)->default_value(def.rw_queues),
           "Enable R/W tests for queues tests"
-        )("pollute-ratio", po::value(&config.pollute_ratio)->default_value(def.pollute_ratio), "Ratio of pollution events to ops (>1)");
+        )("pollute-ratio", po::value(&config.pollute_ratio)->default_value(def.pollute_ratio), "Ratio of pollution events to ops (>1)")(
+        "hasher",
+        po::value<std::string>(&hasher_name)
+            ->default_value(hasher_strings[static_cast<int>(def.hasher)]),
+        "Hash function: city, crc, xxhash, wyhash, citycrc, xxhash3, fnv, "
+        "direct_index, mulxor")(
+        "branching",
+        po::value<std::string>(&branching_name)
+            ->default_value(
+                branching_strings[static_cast<int>(def.branching)]),
+        "Probe style of the partitioned/CAS hashtables: branched, cmov, simd")(
+        "aggr", po::value<bool>(&config.aggr)->default_value(def.aggr),
+        "Use the aggregation (histogram) hashtable layout")(
+        "pf-queue-len",
+        po::value<uint32_t>(&config.pf_queue_len)
+            ->default_value(def.pf_queue_len),
+        "Insert prefetch queue length (power of two)")(
+        "pf-find-queue-len",
+        po::value<uint32_t>(&config.pf_find_queue_len)
+            ->default_value(def.pf_find_queue_len),
+        "Find prefetch queue length (power of two)")(
+        "ins-flush-threshold",
+        po::value<uint32_t>(&config.ins_flush_threshold)
+            ->default_value(def.ins_flush_threshold),
+        "Queued inserts at which the insert prefetch queue is drained")(
+        "find-flush-threshold",
+        po::value<uint32_t>(&config.find_flush_threshold)
+            ->default_value(def.find_flush_threshold),
+        "Queued finds at which the find prefetch queue is drained")(
+        "pf-tune",
+        po::value<bool>(&config.pf_tune)->default_value(def.pf_tune),
+        "Pick the flush thresholds per thread during warmup")(
+        "pf-write",
+        po::value<bool>(&config.pf_write)->default_value(def.pf_write),
+        "Prefetch the slot of an insert for write (false: for read)")(
+        "queue-finds",
+        po::value<bool>(&config.queue_finds)->default_value(def.queue_finds),
+        "bqueue inserts and finds are served by the owning consumers; finds "
+        "are answered over reply queues while inserts are in flight")(
+        "inflight-finds",
+        po::value<uint32_t>(&config.inflight_finds)
+            ->default_value(def.inflight_finds),
+        "Finds a producer keeps in flight with --queue-finds")(
+        "elastic-owners",
+        po::value<bool>(&config.elastic_owners)
+            ->default_value(def.elastic_owners),
+        "With --queue-finds, scale the consumers serving inserts and finds "
+        "with the load")(
+        "combine-window",
+        po::value<uint32_t>(&config.combine_window)
+            ->default_value(def.combine_window),
+        "Per-consumer combining window of a bqueue producer, in slots (power "
+        "of two, 0 = off). Requires --aggr")(
+        "hot-replicas",
+        po::value<uint32_t>(&config.hot_replicas)
+            ->default_value(def.hot_replicas),
+        "Consumers a hot bqueue key is split over; the partial counts are "
+        "merged after the inserts (0 = static routing). Requires --aggr")(
+        "bq-bulk",
+        po::value<bool>(&config.bq_bulk)->default_value(def.bq_bulk),
+        "Enqueue bqueue messages in runs and insert them straight from the "
+        "queue sections")(
+        "queue-type",
+        po::value<std::string>(&queue_type_name)
+            ->default_value(
+                queue_kind_strings[static_cast<int>(def.queue_type)]),
+        "Transport of the bqueue tests: section, bqueue, lynx")(
+        "queue-wait",
+        po::value<std::string>(&queue_wait_name)
+            ->default_value(
+                queue_wait_strings[static_cast<int>(def.queue_wait)]),
+        "Idle section queue consumers: spin, or park (back off, then sleep "
+        "until a producer publishes)")(
+        "queue-spin-cycles",
+        po::value<uint64_t>(&config.queue_spin_cycles)
+            ->default_value(def.queue_spin_cycles),
+        "--queue-wait park: cycles a consumer stays idle before it sleeps")(
+        "report-format",
+        po::value<std::string>(&report_format_name)
+            ->default_value(
+                report_format_strings[static_cast<int>(def.report_format)]),
+        "Report of the run: text, json (threads, totals and configuration) "
+        "or csv (a row per thread and one for the run)")(
+        "perf-counters",
+        po::value<bool>(&config.perf_counters)
+            ->default_value(def.perf_counters),
+        "Count cycles, instructions, cache, TLB and branch misses of the "
+        "timed regions, and the DRAM traffic of the run, with "
+        "perf_event_open")(
+        "calibrate-bw",
+        po::value<bool>(&config.calibrate_bw)
+            ->default_value(def.calibrate_bw),
+        "Measure the peak sequential and random bandwidth and the load "
+        "latency of every NUMA node's memory first, and report each phase "
+        "against them. Prefetch queues not sized on the command line follow "
+        "the measured memory-level parallelism")(
+        "trace-file",
+        po::value<std::string>(&config.trace_file)
+            ->default_value(def.trace_file),
+        "Write a timeline of every thread's phases (read, build, probe, "
+        "flush, barrier waits, queue-full stalls) to this file, for "
+        "chrome://tracing or ui.perfetto.dev")(
+        "sample-ms",
+        po::value<uint32_t>(&config.sample_ms)->default_value(def.sample_ms),
+        "Sample the throughput, table fill and reprobe rate of the run this "
+        "often, into the report (0: off)")(
+        "control",
+        po::value<bool>(&config.control)->default_value(def.control),
+        "On SIGUSR1, log every thread's progress, the table fill and the "
+        "throughput so far; on SIGUSR2, drain the queues at the next batch "
+        "and report the partial run");
 
     papi_init();
 
@@ -498,6 +698,183 @@ int Application::process(int argc, char *argv[]) {
       return 1;
     }
 
+    if (!parse_hasher(hasher_name, &config.hasher)) {
+      PLOGE.printf("Unknown hasher %s! Specify using --hasher",
+                   hasher_name.c_str());
+      exit(-1);
+    }
+
+    // nothing to hash: longer batches keep more requests in flight
+    if (vm["batch-len"].defaulted() &&
+        config.hasher == HasherType::direct_index) {
+      config.batch_len = DIRECT_INDEX_BATCH_LENGTH;
+    }
+
+    if (!parse_branching(branching_name, &config.branching)) {
+      PLOGE.printf("Unknown branching %s! Specify using --branching",
+                   branching_name.c_str());
+      exit(-1);
+    }
+
+    if (!parse_queue_kind(queue_type_name, &config.queue_type)) {
+      PLOGE.printf("Unknown queue type %s! Specify using --queue-type",
+                   queue_type_name.c_str());
+      exit(-1);
+    }
+
+    if (!parse_queue_wait(queue_wait_name, &config.queue_wait)) {
+      PLOGE.printf("Unknown queue wait %s! Specify using --queue-wait",
+                   queue_wait_name.c_str());
+      exit(-1);
+    }
+
+    if (!parse_report_format(report_format_name, &config.report_format)) {
+      PLOGE.printf("Unknown report format %s! Specify using --report-format",
+                   report_format_name.c_str());
+      exit(-1);
+    }
+
+    // Item has no branchless insert_or_update
+    if (config.ht_type == PARTITIONED_HT &&
+        config.branching == BRANCHKIND::NoBranch_Cmove && !config.aggr) {
+      PLOGE.printf("--branching cmov on the partitioned HT requires --aggr");
+      exit(-1);
+    }
+
+    auto is_pow2 = [](uint32_t x) { return x && !(x & (x - 1)); };
+    if (!is_pow2(config.pf_queue_len) || !is_pow2(config.pf_find_queue_len)) {
+      PLOGE.printf("Prefetch queue lengths must be powers of two");
+      exit(-1);
+    }
+
+    if (config.ins_flush_threshold == 0 ||
+        config.ins_flush_threshold >= config.pf_queue_len ||
+        config.find_flush_threshold == 0 ||
+        config.find_flush_threshold >= config.pf_find_queue_len) {
+      PLOGE.printf("Flush thresholds must be in [1, prefetch queue length)");
+      exit(-1);
+    }
+
+#if defined(BQUEUE_KMER_TEST)
+    if (config.queue_finds) {
+      // find requests and replies need key/value queue elements
+      PLOGE.printf("--queue-finds is not available with BQ_KMER_TEST");
+      exit(-1);
+    }
+#endif
+
+    if (config.queue_finds && config.rw_queues) {
+      PLOGE.printf("--queue-finds and --rw-queues exclude each other");
+      exit(-1);
+    }
+
+    if (config.queue_finds && config.inflight_finds == 0) {
+      PLOGE.printf("--inflight-finds must be positive");
+      exit(-1);
+    }
+
+    if (config.elastic_owners && !config.queue_finds) {
+      PLOGE.printf("--elastic-owners needs --queue-finds");
+      exit(-1);
+    }
+
+    if (config.combine_window) {
+      if (config.combine_window & (config.combine_window - 1)) {
+        PLOGE.printf("--combine-window must be a power of two");
+        exit(-1);
+      }
+      if (!config.aggr || config.mode != BQ_TESTS_YES_BQ ||
+          config.queue_finds) {
+        PLOGE.printf(
+            "--combine-window needs --aggr and bqueue inserts (mode %d, no "
+            "--queue-finds)",
+            BQ_TESTS_YES_BQ);
+        exit(-1);
+      }
+      // combined messages carry their count in the value
+      aggr_add_values = true;
+    }
+
+    if (config.hot_replicas) {
+      if (!config.aggr || config.mode != BQ_TESTS_YES_BQ ||
+          config.queue_finds) {
+        PLOGE.printf(
+            "--hot-replicas needs --aggr and bqueue inserts (mode %d, no "
+            "--queue-finds)",
+            BQ_TESTS_YES_BQ);
+        exit(-1);
+      }
+      // a message carries its (partial) count in the value
+      aggr_add_values = true;
+    }
+
+    if (config.bq_bulk &&
+        (config.mode != BQ_TESTS_YES_BQ || config.queue_finds)) {
+      // --queue-finds inserts go through the delegation service
+      PLOGE.printf("--bq-bulk needs bqueue inserts (mode %d, no --queue-finds)",
+                   BQ_TESTS_YES_BQ);
+      exit(-1);
+    }
+
+    if (config.bq_bulk && config.queue_type != QueueKind::Section) {
+      PLOGE.printf("--bq-bulk needs --queue-type section");
+      exit(-1);
+    }
+
+    if (config.queue_wait == QueueWait::Park &&
+        config.queue_type != QueueKind::Section) {
+      PLOGE.printf("--queue-wait park needs --queue-type section");
+      exit(-1);
+    }
+
+    if (config.batch_len == 0 || config.batch_len > HT_TESTS_MAX_BATCH_LENGTH) {
+      PLOGE.printf("--batch-len must be in [1, %u]", HT_TESTS_MAX_BATCH_LENGTH);
+      exit(-1);
+    }
+
+    tune_ins_queue = vm["pf-queue-len"].defaulted() &&
+                     vm["ins-flush-threshold"].defaulted();
+    tune_find_queue = vm["pf-find-queue-len"].defaulted() &&
+                      vm["find-flush-threshold"].defaulted();
+
+    // The default rings are sized for the default batch. Ones the user did
+    // not size grow with a longer batch and are still drained at half their
+    // length.
+    if (tune_ins_queue) {
+      config.pf_queue_len =
+          fit_prefetch_queue_len(PREFETCH_QUEUE_SIZE, config.batch_len);
+      config.ins_flush_threshold = config.pf_queue_len / 2;
+    }
+    if (tune_find_queue) {
+      config.pf_find_queue_len =
+          fit_prefetch_queue_len(PREFETCH_FIND_QUEUE_SIZE, config.batch_len);
+      config.find_flush_threshold = config.pf_find_queue_len / 2;
+    }
+
+    // A batch is queued on top of up to a flush threshold of pending
+    // requests; more than the ring holds would overwrite queued ones. The
+    // array HT has no rings, and the PREFETCH sweep picks its own settings.
+    if (config.ht_type != ARRAY_HT && config.mode != PREFETCH &&
+        (config.ins_flush_threshold + config.batch_len >=
+             config.pf_queue_len ||
+         config.find_flush_threshold + config.batch_len >=
+             config.pf_find_queue_len)) {
+      PLOGE.printf(
+          "Flush threshold + --batch-len must be below the prefetch queue "
+          "length (inserts %u + %u of %u, finds %u + %u of %u)",
+          config.ins_flush_threshold, config.batch_len, config.pf_queue_len,
+          config.find_flush_threshold, config.batch_len,
+          config.pf_find_queue_len);
+      exit(-1);
+    }
+
+#ifdef LATENCY_COLLECTION
+    if (config.branching != BRANCHKIND::WithBranch) {
+      PLOGE.printf("Latency collection only supported with --branching branched");
+      exit(-1);
+    }
+#endif
+
     // Enable verbose logging
     if (vm["v"].as<bool>()) {
       plog::get()->setMaxSeverity(plog::verbose);
@@ -601,6 +978,54 @@ int Application::process(int argc, char *argv[]) {
   printf("}\n");
 
   config.dump_configuration();
+  // before any thread is timed
+  PLOGI.printf("TSC runs at %.3f MHz", tsc_hz() / 1e6);
+  perf_counters_enabled = config.perf_counters;
+  if (perf_counters_enabled) {
+    std::string events;
+    for (auto e = 0u; e < static_cast<std::size_t>(PerfEvent::Count); e++) {
+      if (!PerfCounters::this_thread().counted(static_cast<PerfEvent>(e))) {
+        continue;
+      }
+      events += events.empty() ? "" : ", ";
+      events += perf_event_strings[e];
+    }
+    PLOGI.printf("Counting hardware events: %s",
+                 events.empty() ? "none (see perf_event_paranoid)"
+                                : events.c_str());
+  }
+  trace_enabled = !config.trace_file.empty();
+  if (config.calibrate_bw) {
+    memory_peaks =
+        CacheMissTest::calibrate_memory(*this->n, MEMORY_CALIBRATION_BYTES);
+  }
+  if (config.calibrate_bw || config.mode == CACHE_MISS) {
+    latency_calibration =
+        CacheMissTest::calibrate_latency(*this->n, MEMORY_CALIBRATION_BYTES);
+    // the queues the user did not size get the suggestion, drained at half
+    // their length as by default
+    if (const auto len = latency_calibration.suggested_queue_len) {
+      const auto fitted = fit_prefetch_queue_len(len, config.batch_len);
+      if (tune_ins_queue) {
+        config.pf_queue_len = fitted;
+        config.ins_flush_threshold = fitted / 2;
+      }
+      if (tune_find_queue) {
+        config.pf_find_queue_len = fitted;
+        config.find_flush_threshold = fitted / 2;
+      }
+      if (tune_ins_queue || tune_find_queue) {
+        PLOGI.printf(
+            "Prefetch queues after the calibration: inserts %u (flush at %u), "
+            "finds %u (flush at %u)",
+            config.pf_queue_len, config.ins_flush_threshold,
+            config.pf_find_queue_len, config.find_flush_threshold);
+      }
+    }
+  }
+#ifdef AVX_SUPPORT
+  PLOGI.printf("SIMD probe kernels: %s", simd_kind_string(simd_kind));
+#endif
 
   if ((config.mode == BQ_TESTS_YES_BQ) || (config.mode == FASTQ_WITH_INSERT)) {
     bq_load = BQUEUE_LOAD::HtInsert;
@@ -642,16 +1067,24 @@ int Application::process(int argc, char *argv[]) {
   if (config.mode == BQ_TESTS_YES_BQ || config.mode == ZIPFIAN || config.mode == RW_RATIO) {
     init_zipfian_dist(config.skew, config.seed);
   }
+  if (config.mode == PREFETCH) {
+    // without the hugepages for them, the sweep leaves out Zipf keys
+    try {
+      init_zipfian_dist(config.skew, config.seed);
+    } catch (const std::bad_alloc &) {
+      PLOGW.printf("No memory for Zipf keys; sweeping uniform keys only");
+    }
+  }
 
   if ((config.mode == HASHJOIN) || (config.mode == FASTQ_WITH_INSERT)) {
     // for hashjoin, ht-type determines how we spawn threads
     if (config.ht_type == PARTITIONED_HT) {
-      this->test.qt.run_test(&config, this->n, true, this->npq);
+      this->run_queue_test(true);
     } else if ((config.ht_type == CASHTPP) || (config.ht_type == ARRAY_HT)) {
       this->spawn_shard_threads();
     }
   } else if (config.mode == BQ_TESTS_YES_BQ) {
-    this->test.qt.run_test(&config, this->n, false, this->npq);
+    this->run_queue_test(false);
   } else {
     this->spawn_shard_threads();
   }
@@ -669,6 +1102,15 @@ int Application::process(int argc, char *argv[]) {
       this->spawn_shard_threads();
     }
   }
+
+#ifdef LATENCY_COLLECTION
+  // the queue tests publish their enqueue/insert/find histograms too
+  print_latency_summary();
+#endif
+
+  if (trace_enabled) {
+    write_chrome_trace(config.trace_file);
+  }
   return 0;
 }
 }  // namespace kmercounter
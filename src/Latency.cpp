@@ -3,4 +3,18 @@
 namespace kmercounter {
 std::vector<LatencyCollector<pool_size>> collectors;
 std::mutex collector_lock;
+std::array<SharedLatencyHistogram, static_cast<std::size_t>(LatencyOp::Count)>
+    latency_totals;
+
+void print_latency_summary() {
+  for (auto op = 0u; op < latency_totals.size(); ++op) {
+    const auto h = latency_totals[op].snapshot();
+    if (!h.count()) continue;
+    PLOGI.printf(
+        "%s latency (cycles): p50 %u p90 %u p99 %u p99.9 %u max %u "
+        "(%lu samples)",
+        latency_op_names[op], h.percentile(0.5), h.percentile(0.9),
+        h.percentile(0.99), h.percentile(0.999), h.max(), h.count());
+  }
+}
 }  // namespace kmercounter
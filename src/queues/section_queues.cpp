@@ -0,0 +1,14 @@
+#include "queues/section_queues.hpp"
+
+#include <unistd.h>
+
+namespace kmercounter {
+
+const uint64_t CACHELINE_SIZE = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+const uint64_t CACHELINE_MASK = CACHELINE_SIZE - 1;
+const uint64_t PAGESIZE = sysconf(_SC_PAGESIZE);
+
+const data_t SectionQueue::BQ_MAGIC_KV =
+    data_t(SectionQueue::BQ_MAGIC_64BIT, SectionQueue::BQ_MAGIC_64BIT);
+
+}  // namespace kmercounter
@@ -1,4 +1,17 @@
+#include <numa.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <barrier>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <thread>
+
+#include "misc_lib.h"
 #include "tests/tests.hpp"
+#include "utils/tsc.hpp"
 
 namespace kmercounter {
 
@@ -35,4 +48,263 @@ void CacheMissTest::cache_miss_run(Shard *sh, BaseHashTable *k_ht) {
       "per insertion: %" PRIu64 "\n",
       sh->shard_idx, i, ((t_end - t_start) / i));
 }
+
+namespace {
+
+constexpr size_t LINE_WORDS = CACHE_LINE_SIZE / sizeof(uint64_t);
+// independent chains per cpu; more than the line fill buffers can track
+constexpr size_t CHASES = 16;
+
+// Every line of `lines` holds the index of the next one in a random cycle
+// through all of them, so that each load of a chase depends on the last.
+// Returns the lines in the order of the cycle.
+std::vector<uint64_t> link_random_cycle(uint64_t *lines, size_t n) {
+  std::vector<uint64_t> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), std::mt19937_64(n));
+  for (size_t i = 0; i < n; i++) {
+    lines[order[i] * LINE_WORDS] = order[(i + 1) % n];
+  }
+  return order;
+}
+
+// `k` lines evenly spaced along `cycle`: chains starting there walk
+// disjoint stretches of it for up to size / k steps, where chains from
+// neighbouring lines could run into each other and hit in the cache.
+std::vector<uint64_t> spaced_starts(const std::vector<uint64_t> &cycle,
+                                    size_t k) {
+  std::vector<uint64_t> starts(k);
+  for (size_t c = 0; c < k; c++) starts[c] = cycle[c * cycle.size() / k];
+  return starts;
+}
+
+// Sums the first word of lines [begin, end), a pass at a time.
+uint64_t stream_lines(const uint64_t *lines, size_t begin, size_t end,
+                      int passes) {
+  uint64_t sum = 0;
+  for (int p = 0; p < passes; p++) {
+    for (auto i = begin; i < end; i++) sum += lines[i * LINE_WORDS];
+  }
+  return sum;
+}
+
+// `steps` loads on each of `Chases` chains at once, starting at the lines
+// `first[0..Chases)`.
+template <size_t Chases>
+uint64_t chase_lines(const uint64_t *lines, const uint64_t *first,
+                     size_t steps) {
+  uint64_t at[Chases];
+  std::copy(first, first + Chases, at);
+  for (size_t s = 0; s < steps; s++) {
+    for (size_t c = 0; c < Chases; c++) at[c] = lines[at[c] * LINE_WORDS];
+  }
+  return std::accumulate(at, at + Chases, uint64_t{0});
+}
+
+uint64_t chase_one(const uint64_t *lines, size_t steps) {
+  uint64_t at = 0;
+  for (size_t s = 0; s < steps; s++) at = lines[at * LINE_WORDS];
+  return at;
+}
+
+// Runs `kernel(i)` on every cpu of `cpus` at once and returns the cycles
+// of the slowest.
+template <typename Kernel>
+uint64_t run_on_cpus(const std::vector<uint32_t> &cpus, Kernel &&kernel) {
+  std::barrier start(cpus.size());
+  std::vector<uint64_t> cycles(cpus.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < cpus.size(); i++) {
+    threads.emplace_back([&, i] {
+      start.arrive_and_wait();
+      const auto t_start = RDTSC_START();
+      volatile auto sink = kernel(i);
+      (void)sink;
+      cycles[i] = RDTSCP() - t_start;
+    });
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpus[i], &cpuset);
+    pthread_setaffinity_np(threads.back().native_handle(), sizeof(cpu_set_t),
+                           &cpuset);
+  }
+  for (auto &t : threads) t.join();
+  return *std::max_element(cycles.begin(), cycles.end());
+}
+
+// Dependent loads a latency is the average of; far more than fit any TLB
+constexpr size_t LATENCY_STEPS = 1 << 21;
+
+// ns of one dependent load along the cycle of the `n` lines, from `cpu`.
+double chase_latency_ns(const uint64_t *lines, size_t n, uint32_t cpu) {
+  const size_t steps = std::min(n, LATENCY_STEPS);
+  const auto cycles =
+      run_on_cpus({cpu}, [&](size_t) { return chase_one(lines, steps); });
+  return 1e9 * cycles / tsc_hz() / steps;
+}
+
+// The throughput of `cpu` chasing 1, 2, 4, ... chains along `cycle` at
+// once, up to MLP_CALIBRATION_MAX_STREAMS.
+template <uint32_t Streams = 1>
+void mlp_curve(const uint64_t *lines, const std::vector<uint64_t> &cycle,
+               uint32_t cpu, std::vector<MlpPoint> &mlp) {
+  const size_t steps =
+      std::max<size_t>(std::min(cycle.size(), LATENCY_STEPS) / Streams, 1);
+  const auto starts = spaced_starts(cycle, Streams);
+  const auto cycles = run_on_cpus({cpu}, [&](size_t) {
+    return chase_lines<Streams>(lines, starts.data(), steps);
+  });
+  auto &p = mlp.emplace_back();
+  p.streams = Streams;
+  p.lines_per_sec = 1.0 * steps * Streams * tsc_hz() / cycles;
+  p.latency_ns = 1e9 * Streams / p.lines_per_sec;
+  if constexpr (Streams < MLP_CALIBRATION_MAX_STREAMS) {
+    mlp_curve<Streams * 2>(lines, cycle, cpu, mlp);
+  }
+}
+
+// `len` bytes on `node` in pages of `page_size`; null if the kernel has no
+// such pages to give.
+uint64_t *map_pages(size_t len, size_t page_size, unsigned int node) {
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  if (page_size == (2ull << 20)) flags |= MAP_HUGETLB | (21 << MAP_HUGE_SHIFT);
+  if (page_size == (1ull << 30)) flags |= MAP_HUGETLB | (30 << MAP_HUGE_SHIFT);
+  void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (p == MAP_FAILED) return nullptr;
+  if (page_size == PAGE_SIZE) madvise(p, len, MADV_NOHUGEPAGE);
+  numa_tonode_memory(p, len, node);
+  return static_cast<uint64_t *>(p);
+}
+
+}  // namespace
+
+std::vector<MemoryPeak> CacheMissTest::calibrate_memory(const Numa &numa,
+                                                        size_t bytes) {
+  std::vector<MemoryPeak> peaks;
+  const size_t n = bytes / CACHE_LINE_SIZE;
+  const auto hz = tsc_hz();
+
+  for (const auto &node : numa.get_node_config()) {
+    if (node.cpu_list.empty()) continue;
+    auto lines = static_cast<uint64_t *>(numa_alloc_onnode(bytes, node.id));
+    if (!lines) {
+      PLOGE.printf("Cannot allocate %zu bytes on node %u, skipping it", bytes,
+                   node.id);
+      continue;
+    }
+    const auto cycle = link_random_cycle(lines, n);
+
+    const auto num_cpus = node.cpu_list.size();
+    const size_t slice = n / num_cpus;
+    constexpr int passes = 2;
+    const auto seq_cycles = run_on_cpus(node.cpu_list, [&](size_t i) {
+      return stream_lines(lines, i * slice, (i + 1) * slice, passes);
+    });
+
+    // all chains of all cpus together load every line about once, each
+    // its own stretch of the cycle
+    const size_t steps = std::max<size_t>(n / num_cpus / CHASES, 1);
+    const auto starts = spaced_starts(cycle, num_cpus * CHASES);
+    const auto random_cycles = run_on_cpus(node.cpu_list, [&](size_t i) {
+      return chase_lines<CHASES>(lines, &starts[i * CHASES], steps);
+    });
+
+    const auto latency_ns = chase_latency_ns(lines, n, node.cpu_list.front());
+
+    numa_free(lines, bytes);
+
+    auto &peak = peaks.emplace_back();
+    peak.node = node.id;
+    peak.seq_lines_per_sec = 1.0 * slice * num_cpus * passes * hz / seq_cycles;
+    peak.random_lines_per_sec =
+        1.0 * steps * CHASES * num_cpus * hz / random_cycles;
+    peak.latency_ns = latency_ns;
+    PLOGI.printf(
+        "Node %u memory: sequential %.1f M lines/s (%.2f GB/s), random %.1f M "
+        "lines/s (%.2f GB/s), latency %.1f ns",
+        peak.node, peak.seq_lines_per_sec / 1e6,
+        peak.seq_lines_per_sec * CACHE_LINE_SIZE / 1e9,
+        peak.random_lines_per_sec / 1e6,
+        peak.random_lines_per_sec * CACHE_LINE_SIZE / 1e9, peak.latency_ns);
+  }
+  return peaks;
+}
+
+LatencyCalibration CacheMissTest::calibrate_latency(const Numa &numa,
+                                                    size_t bytes) {
+  LatencyCalibration cal;
+  const size_t n = bytes / CACHE_LINE_SIZE;
+
+  std::vector<numa_node_t> with_cpus;
+  for (const auto &node : numa.get_node_config()) {
+    if (!node.cpu_list.empty()) with_cpus.push_back(node);
+  }
+  if (with_cpus.empty()) return cal;
+  const auto &first = with_cpus.front();
+  const uint32_t cpu = first.cpu_list.front();
+
+  // The same footprint in pages of every size: what changes is the cost of
+  // the TLB misses
+  const struct {
+    size_t page_size;
+    double *latency_ns;
+    const char *name;
+  } page_sizes[] = {{PAGE_SIZE, &cal.latency_4k_ns, "4K"},
+                    {2ull << 20, &cal.latency_2m_ns, "2M"},
+                    {1ull << 30, &cal.latency_1g_ns, "1G"}};
+  for (const auto &[page_size, latency_ns, name] : page_sizes) {
+    const size_t len = round_up(bytes, page_size);
+    auto lines = map_pages(len, page_size, first.id);
+    if (!lines) {
+      PLOGW.printf("No %s pages to be had on node %u, skipping them", name,
+                   first.id);
+      continue;
+    }
+    link_random_cycle(lines, n);
+    *latency_ns = chase_latency_ns(lines, n, cpu);
+    munmap(lines, len);
+    PLOGI.printf("Dependent load on %s pages of node %u: %.1f ns", name,
+                 first.id, *latency_ns);
+  }
+
+  // From the first cpu of every node to the memory of every node, in as
+  // large pages as transparent hugepages give
+  for (const auto &mem : numa.get_node_config()) {
+    auto lines = static_cast<uint64_t *>(numa_alloc_onnode(bytes, mem.id));
+    if (!lines) {
+      PLOGE.printf("Cannot allocate %zu bytes on node %u, skipping it", bytes,
+                   mem.id);
+      continue;
+    }
+    madvise(lines, bytes, MADV_HUGEPAGE);
+    const auto cycle = link_random_cycle(lines, n);
+    for (const auto &node : with_cpus) {
+      auto &l = cal.numa.emplace_back();
+      l.cpu_node = node.id;
+      l.mem_node = mem.id;
+      l.distance = numa_distance(node.id, mem.id);
+      l.latency_ns = chase_latency_ns(lines, n, node.cpu_list.front());
+      PLOGI.printf(
+          "Dependent load from node %u to node %u (distance %d): %.1f ns",
+          l.cpu_node, l.mem_node, l.distance, l.latency_ns);
+    }
+    if (mem.id == first.id) mlp_curve(lines, cycle, cpu, cal.mlp);
+    numa_free(lines, bytes);
+  }
+
+  for (const auto &p : cal.mlp) {
+    PLOGI.printf("%2u independent loads: %.1f M lines/s, %.1f ns a load",
+                 p.streams, p.lines_per_sec / 1e6, p.latency_ns);
+  }
+  if (!cal.mlp.empty()) {
+    cal.suggested_queue_len = suggest_prefetch_queue_len(cal.mlp);
+    PLOGI.printf(
+        "%u loads in flight get within 10 %% of the best; suggested "
+        "--pf-queue-len=%u --pf-find-queue-len=%u (flush thresholds %u)",
+        mlp_knee(cal.mlp), cal.suggested_queue_len, cal.suggested_queue_len,
+        cal.suggested_queue_len / 2);
+  }
+  return cal;
+}
+
 }  // namespace kmercounter
@@ -25,6 +25,7 @@
 #include "sync.h"
 #include "tests/HashjoinTest.hpp"
 #include "types.hpp"
+#include "utils/trace.hpp"
 #include <chrono>
 
 namespace kmercounter {
@@ -58,16 +59,20 @@ void hashjoin(Shard* sh, input_reader::SizedInputReader<KeyValuePair>* t1,
   auto [rel_r, rel_r_size] = relation_r;
   auto [rel_s, rel_s_size] = relation_s;
 
+  {
+    const TraceScope build(TraceEvent::Build);
 #ifdef ITERATOR
-  for (KeyValuePair kv; t1->next(&kv);) {
+    for (KeyValuePair kv; t1->next(&kv);) {
 #else
-  for (auto i = 0; i < rel_r_size; i++) {
-    KeyValuePair kv = rel_r[i];
+    for (auto i = 0; i < rel_r_size; i++) {
+      KeyValuePair kv = rel_r[i];
 #endif
-    PLOGV.printf("inserting k: %lu, v: %lu", kv.key, kv.value);
-    batch_runner.insert(kv);
+      PLOGV.printf("inserting k: %lu, v: %lu", kv.key, kv.value);
+      batch_runner.insert(kv);
+    }
+    const TraceScope flush(TraceEvent::Flush);
+    batch_runner.flush_insert();
   }
-  batch_runner.flush_insert();
 
   if (0)
   {
@@ -77,7 +82,7 @@ void hashjoin(Shard* sh, input_reader::SizedInputReader<KeyValuePair>* t1,
   }
 
   // Make sure insertions is finished before probing.
-  barrier->arrive_and_wait();
+  trace_arrive_and_wait(barrier);
 
   if (sh->shard_idx == 0) {
     end_build_ts = std::chrono::steady_clock::now();
@@ -98,21 +103,25 @@ void hashjoin(Shard* sh, input_reader::SizedInputReader<KeyValuePair>* t1,
 
   // Probe.
   const auto t2_start = RDTSC_START();
+  {
+    const TraceScope probe(TraceEvent::Probe);
 #ifdef ITERATOR
-  for (KeyValuePair kv; t2->next(&kv);) {
+    for (KeyValuePair kv; t2->next(&kv);) {
 #else
-  for (auto i = 0; i < rel_s_size; i++) {
-    KeyValuePair kv = rel_s[i];
+    for (auto i = 0; i < rel_s_size; i++) {
+      KeyValuePair kv = rel_s[i];
 #endif
-    value_type val = kv.value;
-    KeyValuePair *f_kv = (KeyValuePair*) batch_runner.find(kv);
-    if (f_kv)
-      PLOGV.printf("finding key %llu value1 %llu | value2 %llu", kv.key, kv.value, f_kv->value);
+      value_type val = kv.value;
+      KeyValuePair *f_kv = (KeyValuePair*) batch_runner.find(kv);
+      if (f_kv)
+        PLOGV.printf("finding key %llu value1 %llu | value2 %llu", kv.key, kv.value, f_kv->value);
+    }
+    const TraceScope flush(TraceEvent::Flush);
+    batch_runner.flush_find();
   }
-  batch_runner.flush_find();
 
   // Make sure insertions is finished before probing.
-  barrier->arrive_and_wait();
+  trace_arrive_and_wait(barrier);
 
 
   if (sh->shard_idx == 0) {
@@ -171,20 +180,23 @@ void HashjoinTest::join_relations_generated(Shard* sh,
   KeyValuePair *rel_s;
   posix_memalign((void **)&rel_s, 64, t2.size() * sizeof(KeyValuePair));
 
-  auto i = 0u;
+  {
+    const TraceScope read(TraceEvent::Read);
+    auto i = 0u;
 
-  for (KeyValuePair kv; _t2->next(&kv);) {
-    rel_s[i].key = kv.key;
-    rel_s[i].value = kv.value;
-    i++;
-  }
+    for (KeyValuePair kv; _t2->next(&kv);) {
+      rel_s[i].key = kv.key;
+      rel_s[i].value = kv.value;
+      i++;
+    }
 
-  i = 0;
+    i = 0;
 
-  for (KeyValuePair kv; _t1->next(&kv);) {
-    rel_r[i].key = kv.key;
-    rel_r[i].value = kv.value;
-    i++;
+    for (KeyValuePair kv; _t1->next(&kv);) {
+      rel_r[i].key = kv.key;
+      rel_r[i].value = kv.value;
+      i++;
+    }
   }
 
   relation_r = std::make_tuple(rel_r, t1.size());
@@ -206,7 +218,7 @@ void HashjoinTest::join_relations_generated(Shard* sh,
     mt = new MaterializeVector(t1.size());
 
   // Wait for all readers finish initializing.
-  barrier->arrive_and_wait();
+  trace_arrive_and_wait(barrier);
 
   if (sh->shard_idx == 0) {
     start = _rdtsc();
@@ -216,7 +228,7 @@ void HashjoinTest::join_relations_generated(Shard* sh,
   // Run hashjoin
   hashjoin(sh, &t1, &t2, relation_r, relation_s, ht, mt, materialize, barrier);
 
-  barrier->arrive_and_wait();
+  trace_arrive_and_wait(barrier);
 
   if (sh->shard_idx == 0) {
     end = _rdtsc();
@@ -244,7 +256,7 @@ void HashjoinTest::join_relations_from_files(Shard* sh,
             << " t1 " << t1.size() << " t2 " << t2.size();
 
   // Wait for all readers finish initializing.
-  barrier->arrive_and_wait();
+  trace_arrive_and_wait(barrier);
 
   // Run hashjoin
   hashjoin(sh, &t1, &t2,
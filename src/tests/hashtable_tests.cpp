@@ -10,7 +10,11 @@
 #include "print_stats.h"
 #include "sync.h"
 #include "tests/tests.hpp"
+#include "utils/control.hpp"
 #include "utils/hugepage_allocator.hpp"
+#include "utils/profiler.hpp"
+#include "utils/sampler.hpp"
+#include "utils/trace.hpp"
 #include "utils/vtune.hpp"
 #include "zipf.h"
 #include "zipf_distribution.hpp"
@@ -50,15 +54,9 @@ OpTimings do_zipfian_inserts(
 
   std::uint64_t duration{};
 
-  sync_barrier->arrive_and_wait();
+  trace_arrive_and_wait(sync_barrier);
   stop_sync = true;
 
-#ifdef WITH_VTUNE_LIB
-  static const auto event =
-      __itt_event_create("inserting", strlen("inserting"));
-  __itt_event_start(event);
-#endif
-
   PLOGV.printf("Starting insertion test");
   InsertFindArgument *items =
       (InsertFindArgument *) aligned_alloc(64, sizeof(InsertFindArgument) * config.batch_len);
@@ -68,9 +66,11 @@ OpTimings do_zipfian_inserts(
 
   PLOGV.printf("id: %u | key_start %" PRIu64 "", id, key_start);
 
-  const auto start = RDTSC_START();
+  Profiler profiler("inserting", TraceEvent::Insert);
   key_type key{};
   std::size_t next_pollution{};
+  // fewer if a stop request cuts the run short
+  uint64_t inserted = HT_TESTS_NUM_INSERTS * config.insert_factor;
 
   for (auto j = 0u; j < config.insert_factor; j++) {
     key_start =
@@ -98,6 +98,15 @@ OpTimings do_zipfian_inserts(
         for (auto p = 0u; p < config.pollute_ratio; ++p)
           prefetch_object<true>(
               &toxic_waste_dump[next_pollution++ & (1024 * 1024 - 1)], 64);
+        if ((n & (HT_TESTS_BATCH_LENGTH - 1)) == 0) {
+          publish_progress(&LiveProgress::insertions,
+                           j * HT_TESTS_NUM_INSERTS + n + 1);
+          publish_progress(&LiveProgress::fill, hashtable->num_insert_misses);
+          if (stop_requested()) {
+            inserted = j * HT_TESTS_NUM_INSERTS + n + 1;
+            break;
+          }
+        }
       } else {
         if (++key == config.batch_len) {
           InsertFindArguments keypairs(items, config.batch_len);
@@ -108,31 +117,36 @@ OpTimings do_zipfian_inserts(
                 &toxic_waste_dump[next_pollution++ & (1024 * 1024 - 1)], 64);
 
           key = 0;
+          publish_progress(&LiveProgress::insertions,
+                           j * HT_TESTS_NUM_INSERTS + n + 1);
+          publish_progress(&LiveProgress::reprobes, hashtable->num_reprobes);
+          publish_progress(&LiveProgress::fill, hashtable->num_insert_misses);
+          if (stop_requested()) {
+            inserted = j * HT_TESTS_NUM_INSERTS + n + 1;
+            break;
+          }
         }
       }
     }
+    if (stop_requested()) break;
   }
   if (!config.no_prefetch) {
+    const TraceScope flush(TraceEvent::Flush);
     hashtable->flush_insert_queue(collector);
   }
 
-  const auto end = RDTSCP();
-  duration += end - start;
+  duration += profiler.end();
 
   PLOG_DEBUG << "Inserts done; Reprobes: " << hashtable->num_reprobes
              << ", Soft Reprobes: " << hashtable->num_soft_reprobes;
 
-#ifdef WITH_VTUNE_LIB
-  __itt_event_end(event);
-#endif
-
-  sync_barrier->arrive_and_wait();
+  trace_arrive_and_wait(sync_barrier);
 
 #ifdef LATENCY_COLLECTION
-  collector->dump("async_insert", id);
+  collector->publish(LatencyOp::Insert);
 #endif
 
-  return {duration, HT_TESTS_NUM_INSERTS * config.insert_factor};
+  return {duration, inserted, profiler.events()};
 }
 
 OpTimings do_zipfian_gets(BaseHashTable *hashtable, unsigned int num_threads,
@@ -151,16 +165,10 @@ OpTimings do_zipfian_gets(BaseHashTable *hashtable, unsigned int num_threads,
   FindResult *results = new FindResult[config.batch_len];
   ValuePairs vp = std::make_pair(0, results);
 
-  sync_barrier->arrive_and_wait();
+  trace_arrive_and_wait(sync_barrier);
   stop_sync = true;
 
-#ifdef WITH_VTUNE_LIB
-  static const auto vtune_event_find =
-  __itt_event_create("finding", strlen("finding"));
-  __itt_event_start(vtune_event_find);
-#endif
-
-  const auto start = RDTSC_START();
+  Profiler profiler("finding", TraceEvent::Find);
   std::uint64_t key{};
   std::size_t next_pollution{};
   for (auto j = 0u; j < config.insert_factor; j++) {
@@ -187,6 +195,11 @@ OpTimings do_zipfian_gets(BaseHashTable *hashtable, unsigned int num_threads,
           found++;
         else
           not_found++;
+        if ((n & (HT_TESTS_FIND_BATCH_LENGTH - 1)) == 0) {
+          publish_progress(&LiveProgress::finds,
+                           j * HT_TESTS_NUM_INSERTS + n + 1);
+          if (stop_requested()) break;
+        }
       } else {
         items[key] = {value , n};
 
@@ -195,33 +208,35 @@ OpTimings do_zipfian_gets(BaseHashTable *hashtable, unsigned int num_threads,
           found += vp.first;
           vp.first = 0;
           key = 0;
+          publish_progress(&LiveProgress::finds,
+                           j * HT_TESTS_NUM_INSERTS + n + 1);
           for (auto p = 0u;
                p < config.pollute_ratio * HT_TESTS_FIND_BATCH_LENGTH; ++p)
             prefetch_object<true>(
                 &toxic_waste_dump[next_pollution++ & (1024 * 1024 - 1)], 64);
+          if (stop_requested()) break;
         }
       }
 
       zipf_idx++;
     }
+    if (stop_requested()) break;
   }
   if (!config.no_prefetch) {
     if (vp.first > 0) {
       vp.first = 0;
     }
 
-    hashtable->flush_find_queue(vp, collector);
+    {
+      const TraceScope flush(TraceEvent::Flush);
+      hashtable->flush_find_queue(vp, collector);
+    }
     found += vp.first;
   }
 
-  const auto end = RDTSCP();
-  duration += end - start;
-    
-#ifdef WITH_VTUNE_LIB
-  __itt_event_end(vtune_event_find);
-#endif
+  duration += profiler.end();
 
-  sync_barrier->arrive_and_wait();
+  trace_arrive_and_wait(sync_barrier);
 
   if (found >= 0) {
     PLOGV.printf(
@@ -230,10 +245,10 @@ OpTimings do_zipfian_gets(BaseHashTable *hashtable, unsigned int num_threads,
   }
 
 #ifdef LATENCY_COLLECTION
-  collector->dump("find", id);
+  collector->publish(LatencyOp::Find);
 #endif
 
-  return {duration, found};
+  return {duration, found, profiler.events()};
 }
 
 void ZipfianTest::run(Shard *shard, BaseHashTable *hashtable, double skew,
@@ -299,8 +314,7 @@ void ZipfianTest::run(Shard *shard, BaseHashTable *hashtable, double skew,
   const auto num_finds =
       do_zipfian_gets(hashtable, count, shard->shard_idx, sync_barrier);
 
-  shard->stats->finds.duration = num_finds.duration;
-  shard->stats->finds.op_count = num_finds.op_count;
+  shard->stats->finds = num_finds;
 
   if (num_finds.op_count > 0) {
     PLOG_INFO.printf("thread %u | num_finds %" PRIu64
@@ -15,6 +15,9 @@
 #include "input_reader/counter.hpp"
 #include "types.hpp"
 #include "print_stats.h"
+#include "utils/control.hpp"
+#include "utils/sampler.hpp"
+#include "utils/trace.hpp"
 
 namespace kmercounter {
 void KmerTest::count_kmer(Shard* sh,
@@ -22,11 +25,16 @@ void KmerTest::count_kmer(Shard* sh,
                               BaseHashTable* ht,
                               std::barrier<VoidFn>* barrier){
   // Be care of the `K` here; it's a compile time constant.
-  auto reader = input_reader::MakeFastqKMerPreloadReader(config.K, config.in_file, sh->shard_idx, config.num_threads);
+  std::unique_ptr<input_reader::InputReaderU64> reader;
+  {
+    const TraceScope read(TraceEvent::Read);
+    reader = input_reader::MakeFastqKMerPreloadReader(
+        config.K, config.in_file, sh->shard_idx, config.num_threads);
+  }
   HTBatchRunner batch_runner(ht);
 
   // Wait for all readers finish initializing.
-  barrier->arrive_and_wait();
+  trace_arrive_and_wait(barrier);
 
   // start timers
   std::uint64_t start {}, end {};
@@ -41,12 +49,21 @@ void KmerTest::count_kmer(Shard* sh,
   }
 
   // Inser Kmers into hashtable
-  for (uint64_t kmer; reader->next(&kmer);) {
-    batch_runner.insert(kmer, 0 /* we use the aggr tables so no value */);
-    num_kmers++;
+  {
+    const TraceScope insert(TraceEvent::Insert);
+    for (uint64_t kmer; reader->next(&kmer);) {
+      batch_runner.insert(kmer, 0 /* we use the aggr tables so no value */);
+      if ((++num_kmers & 1023) == 0) {
+        publish_progress(&LiveProgress::insertions, num_kmers);
+        publish_progress(&LiveProgress::fill, ht->num_insert_misses);
+        // the runner's buffered kmers are flushed below
+        if (stop_requested()) break;
+      }
+    }
+    const TraceScope flush(TraceEvent::Flush);
+    batch_runner.flush_insert();
   }
-  batch_runner.flush_insert();
-  barrier->arrive_and_wait();
+  trace_arrive_and_wait(barrier);
 
   sh->stats->insertions.duration = _rdtsc() - start;
   sh->stats->insertions.op_count = num_kmers;
@@ -1,127 +1,140 @@
-#include <sched.h>
+#include <plog/Log.h>
 
 #include "tests/PrefetchTest.hpp"
 #include "misc_lib.h"
 #include "print_stats.h"
 #include "types.hpp"
-#include "xorwow.hpp"
+#include "utils/hugepage_allocator.hpp"
+#include "utils/tsc.hpp"
 
 namespace kmercounter {
 
-extern void get_ht_stats(Shard *, BaseHashTable *);
-extern uint64_t HT_TESTS_HT_SIZE;
-extern uint64_t HT_TESTS_NUM_INSERTS;
+extern BaseHashTable *init_ht(uint64_t, uint8_t);
+extern std::vector<key_type, huge_page_allocator<key_type>> *zipf_values;
 
-inline uint64_t seed = 123456789;
-inline uint64_t PREFETCH_STRIDE = 64;
+namespace {
 
-__thread struct xorwow_state xw_state;
-__thread struct xorwow_state xw_state2;
-
-inline int myrand(uint64_t *seed) {
-  uint64_t m = 1 << 31;
-  *seed = (1103515245 * (*seed) + 12345) % m;
-  return *seed;
+// The i-th key of the sweep: distinct ones, or draws of the global Zipf
+// distribution. Never 0, the empty key.
+key_type sweep_key(uint64_t i, bool zipf) {
+  if (!zipf) return i + 1;
+  const auto key = (*zipf_values)[i % zipf_values->size()];
+  return key ? key : 1;
 }
 
-uint64_t PrefetchTest::prefetch_test_run(
-    PartitionedHashStore<Prefetch_KV, PrefetchKV_Queue> *ktable) {
-  auto count = 0;
-  auto sum = 0;
-  [[maybe_unused]] auto k = 0;
-
-  printf("NUM inserts %" PRIu64 "\n", HT_TESTS_NUM_INSERTS);
-
-  // seed2 = seed;
-
-#ifdef XORWOW_SCAN
-#warning "XORWOW_SCAN"
-  memcpy(&xw_state2, &xw_state, sizeof(xw_state));
-
-  for (auto i = 0u; i < PREFETCH_STRIDE; i++) {
-    // k = rand(&seed2);
-    k = xorwow(&xw_state2);
+OpTimings sweep_inserts(BaseHashTable *ht, uint64_t first, uint64_t count,
+                        bool zipf) {
+  std::vector<InsertFindArgument> items(config.batch_len);
+  size_t k = 0;
+
+  const auto t_start = RDTSC_START();
+  for (uint64_t i = first; i < first + count; i++) {
+    items[k].key = items[k].value = sweep_key(i, zipf);
+    items[k].id = i;
+    if (++k == items.size()) {
+      ht->insert_batch(InsertFindArguments(items.data(), k));
+      k = 0;
+    }
+  }
+  if (k) ht->insert_batch(InsertFindArguments(items.data(), k));
+  ht->flush_insert_queue();
+  return {RDTSCP() - t_start, count};
+}
 
-    // printf("p: %" PRIu64 "\n", k);
-    ktable->prefetch(k);
+OpTimings sweep_finds(BaseHashTable *ht, uint32_t part_id, uint64_t first,
+                      uint64_t count, bool zipf) {
+  std::vector<InsertFindArgument> items(config.batch_len);
+  std::vector<FindResult> results(config.batch_len);
+  ValuePairs vp = std::make_pair(0, results.data());
+  size_t k = 0;
+  uint64_t found = 0;
+
+  const auto t_start = RDTSC_START();
+  for (uint64_t i = first; i < first + count; i++) {
+    items[k].key = sweep_key(i, zipf);
+    items[k].id = i;
+    items[k].part_id = part_id;
+    if (++k == items.size()) {
+      ht->find_batch(InsertFindArguments(items.data(), k), vp);
+      found += vp.first;
+      vp.first = 0;
+      k = 0;
+    }
+  }
+  if (k) {
+    ht->find_batch(InsertFindArguments(items.data(), k), vp);
+    found += vp.first;
   }
-#endif  // XORWOW_SCAN
-
-  for (auto i = 0u; i < HT_TESTS_NUM_INSERTS; i++) {
-    // k = myrand(&seed);
-    // k = rand();
-
-#ifdef XORWOW_SCAN
-    /*
-     * With if-then dependency it's 99 cycles, without 30 (no prefetch)
-     *
-     * Prefetch itself doesn't help, 100 cycles with normal prefetch (with
-     * dependency).
-     *
-     * However, if I prefetch with the "write" it seems to help
-     *
-     * Prefetch test run: ht size:1073741824, insertions:67108864
-     * Prefetch stride: 0, cycles per insertion:121
-     * Prefetch stride: 1, cycles per insertion:36
-     * Prefetch stride: 2, cycles per insertion:46
-     * Prefetch stride: 3, cycles per insertion:44
-     * Prefetch stride: 4, cycles per insertion:45
-     * Prefetch stride: 5, cycles per insertion:46
-     * Prefetch stride: 6, cycles per insertion:47
-     */
-
-    k = xorwow(&xw_state);
-
-    // printf("t: %" PRIu64 "\n", k);
-    ktable->touch(k);
-#endif
-
-#ifdef SERIAL_SCAN
-    /* Fully prefethed serial scan is 14 cycles */
-    sum += ktable->touch(i);
-    // ktable->prefetch(i + 32);
-#endif
-
-#ifdef XORWOW_SCAN
-    // k = rand(&seed2);
-    k = xorwow(&xw_state2);
-    // printf("p: %" PRIu64 "\n", k);
-    ktable->prefetch(k);
-#endif
-    count++;
+  // a flush returns at most a batch
+  do {
+    vp.first = 0;
+    ht->flush_find_queue(vp);
+    found += vp.first;
+  } while (vp.first);
+  const auto cycles = RDTSCP() - t_start;
+
+  if (found != count) {
+    PLOGW.printf("Prefetch sweep: found %" PRIu64 " of %" PRIu64 " keys",
+                 found, count);
   }
-  return count;
+  return {cycles, count};
 }
 
-void PrefetchTest::prefetch_test_run_exec(Shard *sh, Configuration &cfg,
-                                          BaseHashTable *kmer_ht) {
-  uint64_t num_inserts = 0;
-  uint64_t t_start, t_end;
-
-  printf("[INFO] Prefetch test run: thread %u, ht size:%" PRIu64 ", insertions:%" PRIu64 "\n",
-         sh->shard_idx, HT_TESTS_HT_SIZE, HT_TESTS_NUM_INSERTS);
-
-#ifdef XORWOW_SCAN
-  xorwow_init(&xw_state);
-#endif
-
-  // for (auto i = 0; i < HT_TESTS_MAX_STRIDE; i++) {
-  t_start = RDTSC_START();
-  // PREFETCH_STRIDE = i;
-  num_inserts = prefetch_test_run(
-      (PartitionedHashStore<Prefetch_KV, PrefetchKV_Queue> *)kmer_ht);
-  t_end = RDTSCP();
-  printf(
-      "[INFO] Quick stats: thread %u, Prefetch stride: %" PRIu64 ", cycles per "
-      "insertion:%" PRIu64 "\n",
-      sh->shard_idx, PREFETCH_STRIDE, (t_end - t_start) / num_inserts);
-  //}
-
-  sh->stats->insertions.duration = (t_end - t_start);
-  sh->stats->insertions.op_count = num_inserts;
-#ifndef WITH_PAPI_LIB
-  get_ht_stats(sh, kmer_ht);
-#endif
+}  // namespace
+
+void PrefetchTest::prefetch_sweep(
+    Shard *sh, std::barrier<std::function<void()>> *barrier) {
+  const bool leader = sh->shard_idx == 0;
+  const auto grid =
+      prefetch_sweep_grid(zipf_values != nullptr, config.batch_len);
+  // keys of a full table; a shared table takes every thread's share of them
+  const uint64_t keys = config.ht_size * config.ht_fill / 100;
+  Configuration saved;
+
+  if (leader) {
+    saved = config;
+    points_ = grid;
+    PLOGI.printf("Prefetch sweep: %zu settings, %" PRIu64
+                 " keys a table of %" PRIu64 " slots",
+                 grid.size(), keys, config.ht_size);
+  }
+  for (size_t p = 0; p < grid.size(); p++) {
+    const auto &point = grid[p];
+    if (leader) {
+      config.ht_type = point.ht_type;
+      config.pf_write = point.pf_write;
+      config.pf_queue_len = config.pf_find_queue_len = point.queue_len;
+      config.ins_flush_threshold = point.distance;
+      config.find_flush_threshold = point.distance;
+      config.pf_tune = false;
+    }
+    barrier->arrive_and_wait();
+
+    BaseHashTable *ht = init_ht(config.ht_size, sh->shard_idx);
+    const uint64_t count =
+        point.ht_type == CASHTPP ? keys / config.num_threads : keys;
+    // distinct keys of every thread in a shared table
+    const uint64_t first =
+        point.ht_type == CASHTPP ? count * sh->shard_idx : 0;
+    barrier->arrive_and_wait();
+    const auto insertions = sweep_inserts(ht, first, count, point.zipf);
+    barrier->arrive_and_wait();
+    const auto finds =
+        sweep_finds(ht, sh->shard_idx, first, count, point.zipf);
+    // a shared table goes with the last thread's
+    delete ht;
+    {
+      std::lock_guard lock(points_lock_);
+      points_[p].insertions += insertions;
+      points_[p].finds += finds;
+    }
+    // before the leader sets up the next point
+    barrier->arrive_and_wait();
+  }
+
+  if (leader) config = saved;
+  barrier->arrive_and_wait();
+  if (leader) print_prefetch_sweep(stdout, points_, config);
 }
 
 }  // namespace kmercounter
@@ -1,10 +1,16 @@
 #include <algorithm>
 #include <cassert>
 #include <cinttypes>
+#include <numeric>
+#include <optional>
 #include <tuple>
 
 #include "fastrange.h"
 #include "hasher.hpp"
+#if !defined(BQUEUE_KMER_TEST)
+#include "hashtables/delegated_kht.hpp"
+#endif
+#include "hashtables/ht_dispatch.hpp"
 #include "hashtables/ht_helper.hpp"
 #include "hashtables/simple_kht.hpp"
 #include "helper.hpp"
@@ -14,11 +20,16 @@
 #include "misc_lib.h"
 #include "print_stats.h"
 #include "queues/bqueue_aligned.hpp"
+#include "queues/combiner.hpp"
 #include "queues/lynxq.hpp"
 #include "queues/section_queues.hpp"
+#include "queues/skew_router.hpp"
 #include "sync.h"
 #include "tests/QueueTest.hpp"
+#include "utils/control.hpp"
 #include "utils/hugepage_allocator.hpp"
+#include "utils/perf_counters.hpp"
+#include "utils/trace.hpp"
 #include "utils/vtune.hpp"
 #include "xorwow.hpp"
 #include "zipf.h"
@@ -30,10 +41,6 @@ namespace kmercounter {
 
 using namespace std;
 
-const uint64_t CACHELINE_SIZE = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
-const uint64_t CACHELINE_MASK = CACHELINE_SIZE - 1;
-const uint64_t PAGESIZE = sysconf(_SC_PAGESIZE);
-
 void setup_signal_handler(void);
 
 extern uint64_t HT_TESTS_HT_SIZE;
@@ -165,6 +172,7 @@ void QueueTest<T>::producer_thread(
   typename T::cons_queue_t *cqueues[n_cons];
 
   vtune::set_threadname("producer_thread" + std::to_string(tid));
+  trace_thread_name("producer " + std::to_string(tid));
 
   auto [ratio, num_messages, key_start] = get_params(n_prod, n_cons, tid);
   Hasher hasher;
@@ -179,6 +187,108 @@ void QueueTest<T>::producer_thread(
 #endif
   }
 
+  // With --bq-bulk, messages are staged per consumer and copied into the
+  // queue a run at a time
+  std::vector<std::array<data_t, BQ_BULK_RUN>> staged;
+  std::vector<uint32_t> num_staged;
+  if constexpr (has_bulk_ops<T>) {
+    if (config.bq_bulk) {
+      staged.resize(n_cons);
+      num_staged.assign(n_cons, 0);
+    }
+  }
+
+  auto put = [&](uint32_t c, const data_t &kv) {
+    if constexpr (has_bulk_ops<T>) {
+      if (!staged.empty()) {
+        staged[c][num_staged[c]++] = kv;
+        if (num_staged[c] == BQ_BULK_RUN) {
+          this->queues->enqueue_bulk(pqueues[c], this_prod_id, c, staged[c]);
+          num_staged[c] = 0;
+        }
+        return;
+      }
+    }
+    this->queues->enqueue(pqueues[c], this_prod_id, c, kv);
+  };
+
+  auto flush_staged = [&]() {
+    if constexpr (has_bulk_ops<T>) {
+      for (auto c = 0u; c < staged.size(); c++) {
+        this->queues->enqueue_bulk(
+            pqueues[c], this_prod_id, c,
+            std::span<const data_t>(staged[c].data(), num_staged[c]));
+        num_staged[c] = 0;
+      }
+    }
+  };
+
+#if !defined(BQUEUE_KMER_TEST)
+  // With --combine-window, occurrences of a key headed to the same consumer
+  // are merged into one (key, n) message before they hit the queue
+  std::vector<KeyCombiner> combiners;
+  if (config.combine_window) {
+    combiners.assign(n_cons, KeyCombiner(config.combine_window));
+  }
+  uint64_t num_keys{};
+#endif
+
+#if !defined(BQUEUE_KMER_TEST)
+  // With --hot-replicas, hot keys are split over several consumers
+  const bool route_hot_keys = config.hot_replicas > 0;
+  SkewRouter router(n_cons, config.hot_replicas);
+  std::vector<uint64_t> static_load(n_cons), routed_load(n_cons);
+
+  // Messages to a consumer other than the key's home carry a partial count
+  auto replica_tag = [&](uint32_t c, uint64_t key) -> uint64_t {
+    if (!route_hot_keys) return 0;
+    return hash_to_cpu(hasher(&key, sizeof(key)), n_cons) != c
+               ? HOT_REPLICA_TAG
+               : 0;
+  };
+#endif
+
+  // Enqueue `kv` to its home consumer, or to a replica if the key is hot.
+  // Goes through the consumer's combining window if enabled.
+  auto send = [&](uint32_t home, const data_t &kv, uint64_t hash_val) {
+#if !defined(BQUEUE_KMER_TEST)
+    auto c = home;
+    uint64_t tag = 0;
+    if (route_hot_keys) {
+      bool replica;
+      c = router.route(kv.key, hash_val, home, &replica);
+      tag = replica ? HOT_REPLICA_TAG : 0;
+      static_load[home]++;
+      routed_load[c]++;
+    }
+    if (!combiners.empty()) {
+      num_keys++;
+      combiners[c].add(kv.key, hash_val, [&](uint64_t key, uint64_t n) {
+        put(c, data_t(key, n | replica_tag(c, key)));
+      });
+      return;
+    }
+    if (aggr_add_values) {
+      put(c, data_t(kv.key, 1 | tag));
+      return;
+    }
+    put(c, kv);
+#else
+    put(home, kv);
+#endif
+  };
+
+  auto flush_combiners = [&]() {
+#if !defined(BQUEUE_KMER_TEST)
+    for (auto c = 0u; c < combiners.size(); c++) {
+      combiners[c].flush([&](uint64_t key, uint64_t n) {
+        put(c, data_t(key, n | replica_tag(c, key)));
+      });
+    }
+#endif
+    flush_staged();
+  };
+
   struct xorwow_state _xw_state, init_state;
   auto key_start_orig = key_start;
 
@@ -237,7 +347,7 @@ void QueueTest<T>::producer_thread(
   }
   std::size_t next_pollution{};
 
-  barrier->arrive_and_wait();
+  trace_arrive_and_wait(barrier);
 
   PLOGV.printf(
       "[prod:%u] started! Sending %lu messages to %d consumers | "
@@ -257,10 +367,10 @@ void QueueTest<T>::producer_thread(
     ++zipf_idx;
     uint64_t hash_val = hasher(&k, sizeof(k));
     cons_id = hash_to_cpu(hash_val, n_cons);
-    auto pq = pqueues[cons_id];
-    this->queues->enqueue(pq, this_prod_id, cons_id, {k, k});
+    send(cons_id, {k, k}, hash_val);
     transaction_id++;
   }
+  flush_combiners();
 
   auto ht_size = config.ht_size / n_cons;
   const auto ktable = init_ht(ht_size, sh->shard_idx);
@@ -271,7 +381,7 @@ void QueueTest<T>::producer_thread(
   std::array<bool, 1024> flips;
   for (auto &flip : flips) flip = !coin(urbg);  // do a write if true
 
-  prod_barrier->arrive_and_wait();
+  trace_arrive_and_wait(prod_barrier);
 
 #if defined(BQUEUE_KMER_TEST)
   Key kv{};
@@ -285,7 +395,9 @@ void QueueTest<T>::producer_thread(
   auto &collector = collectors.at(tid);
 #endif
 
-  for (auto j = 0u; j < config.insert_factor; j++) {
+  // messages sent before a SIGUSR2, if one came
+  std::optional<uint64_t> num_sent;
+  for (auto j = 0u; j < config.insert_factor && !num_sent; j++) {
     key_start = key_start_orig;
     auto zipf_idx = key_start == 1 ? 0 : key_start;
     std::uint64_t kmer{};
@@ -344,13 +456,12 @@ void QueueTest<T>::producer_thread(
 #endif
         // if (++cons_id >= n_cons) cons_id = 0;
 
-        auto pq = pqueues[cons_id];
         // PLOGV.printf("Queuing key = %" PRIu64 ", value = %" PRIu64, kv.key,
         // kv.value);
 #ifdef LATENCY_COLLECTION
         const auto timer = collector.sync_start();
 #endif
-        this->queues->enqueue(pq, this_prod_id, cons_id, (data_t)kv);
+        send(cons_id, (data_t)kv, hash_val);
 #ifdef LATENCY_COLLECTION
         collector.sync_end(timer);
 #endif
@@ -379,9 +490,18 @@ void QueueTest<T>::producer_thread(
             &toxic_waste_dump[next_pollution++ & (1024 * 1024 - 1)], 64);
 
       transaction_id++;
+
+      // SIGUSR2: stop producing; the consumers still get everything sent so
+      // far and the end messages below
+      if (!(transaction_id & 1023) && stop_requested()) {
+        num_sent = j * num_messages + transaction_id;
+        break;
+      }
     }
   }
 
+  flush_combiners();
+
   // enqueue halt messages and the consumer automatically knows
   // when to stop
   for (cons_id = 0; cons_id < n_cons; cons_id++) {
@@ -393,23 +513,48 @@ void QueueTest<T>::producer_thread(
   }
 
   auto t_end = RDTSCP();
+  trace_phase(TraceEvent::Enqueue, t_start, t_end);
 
-  prod_barrier->arrive_and_wait();
+  trace_arrive_and_wait(prod_barrier);
 
   if (main_thread) {
     vtune::event_end(event);
   }
 
+  const auto op_count =
+      num_sent.value_or(transaction_id * config.insert_factor);
   if (cfg->rw_queues) {
     sh->stats->finds.duration = (t_end - t_start);
-    sh->stats->finds.op_count = transaction_id * config.insert_factor;
+    sh->stats->finds.op_count = op_count;
   } else {
     sh->stats->enqueues.duration = (t_end - t_start);
-    sh->stats->enqueues.op_count = transaction_id * config.insert_factor;
+    sh->stats->enqueues.op_count = op_count;
   }
 
 #ifdef LATENCY_COLLECTION
-  collector.dump("sync_insert", tid);
+  collector.publish(LatencyOp::Enqueue);
+#endif
+
+#if !defined(BQUEUE_KMER_TEST)
+  if (!combiners.empty()) {
+    uint64_t num_sent{};
+    for (const auto &combiner : combiners) num_sent += combiner.num_emitted();
+    PLOGI.printf("[prod:%u] combined %" PRIu64 " keys into %" PRIu64
+                 " messages (%.2fx)",
+                 this_prod_id, num_keys, num_sent,
+                 (double)num_keys / std::max<uint64_t>(num_sent, 1));
+  }
+
+  if (route_hot_keys) {
+    PLOGI.printf("[prod:%u] %u hot keys split over %u consumers",
+                 this_prod_id, router.num_hot(),
+                 std::min(config.hot_replicas, n_cons));
+    std::lock_guard<std::mutex> lock(this->load_mutex);
+    for (auto c = 0u; c < n_cons; c++) {
+      this->static_load[c] += static_load[c];
+      this->routed_load[c] += routed_load[c];
+    }
+  }
 #endif
 
   PLOG_DEBUG.printf("Producer %d -> Sending end messages to all consumers",
@@ -454,6 +599,11 @@ void QueueTest<T>::consumer_thread(
 
   uint8_t this_cons_id = sh->shard_idx - n_prod;
   uint64_t inserted = 0u;
+#if !defined(BQUEUE_KMER_TEST)
+  auto *hot_partials = config.hot_replicas
+                           ? &this->hot_partials.at(this_cons_id)
+                           : nullptr;
+#endif
   typename T::cons_queue_t *cqueues[n_prod];
 
   // initialize the local queues array from queue_map
@@ -466,6 +616,7 @@ void QueueTest<T>::consumer_thread(
 #endif
   }
   vtune::set_threadname("consumer_thread" + std::to_string(tid));
+  trace_thread_name("consumer " + std::to_string(tid));
 
   auto ht_size = get_ht_size(n_cons);
 
@@ -476,7 +627,7 @@ void QueueTest<T>::consumer_thread(
     (*this->ht_vec)[tid] = kmer_ht;
   }
 
-  barrier->arrive_and_wait();
+  trace_arrive_and_wait(barrier);
 
   PLOG_DEBUG.printf("[cons:%u] starting", this_cons_id);
 
@@ -489,6 +640,7 @@ void QueueTest<T>::consumer_thread(
   static auto event = -1;
   if (tid == n_prod) event = vtune::event_start("message_deq");
 
+  const PerfRegion perf;
   auto t_start = RDTSC_START();
 
   // Round-robin between 0..n_prod
@@ -500,7 +652,23 @@ void QueueTest<T>::consumer_thread(
     active_qmask |= (1ull << i);
   }
 
+  // --bq-bulk: runs of the queue go to the hashtable without the copy into
+  // `items`
+  const bool bulk_inserts = has_bulk_ops<T> && config.bq_bulk &&
+                            bq_load == BQUEUE_LOAD::HtInsert &&
+                            !config.no_prefetch;
+
+  // --queue-wait: messages seen before the current round over the producers
+  uint64_t round_start = 0;
+  uint64_t idle_since = 0;
+
   while (finished_producers < n_prod) {
+    auto producer_done = [&]() {
+      fipc_test_FAI(finished_producers);
+      this->queues->pop_done(prod_id, this_cons_id);
+      active_qmask &= ~(1ull << prod_id);
+    };
+
     auto submit_batch = [&](auto num_elements) {
       InsertFindArguments kp(items, num_elements);
 
@@ -530,6 +698,37 @@ void QueueTest<T>::consumer_thread(
       goto pick_next_msg;
     }
 
+#if !defined(BQUEUE_KMER_TEST)
+    if constexpr (has_bulk_ops<T>) {
+      if (bulk_inserts) {
+        const auto run = this->queues->dequeue_bulk(cq, prod_id, this_cons_id,
+                                                    config.batch_len);
+        size_t start = 0, i = 0;
+        auto submit_run = [&]() {
+          if (i == start) return;
+          kmer_ht->insert_kv_batch(run.subspan(start, i - start), collector);
+          inserted += i - start;
+        };
+        for (; i < run.size(); i++) {
+          if (run[i] == T::BQ_MAGIC_KV) [[unlikely]] {
+            producer_done();
+            break;
+          }
+          if (hot_partials && (run[i].value & HOT_REPLICA_TAG))
+              [[unlikely]] {
+            submit_run();
+            hot_partials->add(run[i].key, run[i].value & ~HOT_REPLICA_TAG);
+            start = i + 1;
+          }
+        }
+        submit_run();
+        count += i;
+        transaction_id += i;
+        goto pick_next_msg;
+      }
+    }
+#endif
+
     for (auto i = 0u; i < 1 * config.batch_len; i++) {
       // dequeue one message
       auto ret =
@@ -556,10 +755,8 @@ void QueueTest<T>::consumer_thread(
       // STOP condition. On receiving this magic message, the consumers stop
       // dequeuing from the queues
       if ((data_t)kv == T::BQ_MAGIC_KV) [[unlikely]] {
-        fipc_test_FAI(finished_producers);
         // printf("Got MAGIC bit. stopping consumer\n");
-        this->queues->pop_done(prod_id, this_cons_id);
-        active_qmask &= ~(1ull << prod_id);
+        producer_done();
         /* PLOGV.printf(
             "Consumer %u, received HALT from prod_id %u. "
             "finished_producers :%u",
@@ -580,6 +777,16 @@ void QueueTest<T>::consumer_thread(
         goto pick_next_msg;
       }
 
+#if !defined(BQUEUE_KMER_TEST)
+      if (hot_partials && (kv.value & HOT_REPLICA_TAG)) [[unlikely]] {
+        // our share of a split hot key; merged into its home partition
+        // once all consumers are done
+        hot_partials->add(kv.key, kv.value & ~HOT_REPLICA_TAG);
+        transaction_id++;
+        continue;
+      }
+#endif
+
       if (bq_load == BQUEUE_LOAD::HtInsert) {
         items[data_idx].key = kv.key;
         items[data_idx].id = kv.key;
@@ -617,15 +824,23 @@ void QueueTest<T>::consumer_thread(
     k = 0;
     if (++prod_id >= n_prod) {
       prod_id = 0;
+      if constexpr (has_parking<T>) {
+        if (count == round_start) {
+          this->queues->consumer_idle(this_cons_id, active_qmask, &idle_since);
+        } else {
+          idle_since = 0;
+        }
+        round_start = count;
+      }
     }
   }
 
   auto t_end = RDTSCP();
+  trace_phase(TraceEvent::Insert, t_start, t_end);
 
   if (tid == n_prod) vtune::event_end(event);
 
-  sh->stats->insertions.duration = (t_end - t_start);
-  sh->stats->insertions.op_count = transaction_id;
+  sh->stats->insertions = {t_end - t_start, transaction_id, perf.end()};
 
   if (bq_load == BQUEUE_LOAD::HtInsert) {
     get_ht_stats(sh, kmer_ht);
@@ -643,6 +858,12 @@ void QueueTest<T>::consumer_thread(
 #endif
 
   PLOGV.printf("cons_id %d | inserted %lu elements", this_cons_id, inserted);
+  if constexpr (has_parking<T>) {
+    if (config.queue_wait == QueueWait::Park) {
+      PLOGI.printf("[cons:%u] parked %" PRIu64 " times", this_cons_id,
+                   this->queues->num_parks(this_cons_id));
+    }
+  }
   PLOGV.printf(
       "Quick Stats: Consumer %u finished, receiving %lu messages "
       "(cycles per message %lu) prod_count %u | finished %u",
@@ -658,7 +879,7 @@ void QueueTest<T>::consumer_thread(
   }
 
 #ifdef LATENCY_COLLECTION
-  collector->dump("insert", tid);
+  collector->publish(LatencyOp::Insert);
 #endif
 }
 
@@ -686,6 +907,7 @@ void QueueTest<T>::find_thread(int tid, int n_prod, int n_cons, bool is_join,
   alignas(64) uint64_t k = 0;
 
   vtune::set_threadname("find_thread" + std::to_string(tid));
+  trace_thread_name("find " + std::to_string(tid));
 
   ktable = this->ht_vec->at(tid);
 
@@ -703,9 +925,11 @@ void QueueTest<T>::find_thread(int tid, int n_prod, int n_cons, bool is_join,
     this->ht_vec->at(tid) = ktable;
   } else {
     PLOGD.printf("Dist to nodes tid %u", tid);
-    auto *part_ht = reinterpret_cast<PartitionedHashStore<KVType, ItemQueue>*>(ktable);
-    void *ht_mem = part_ht->hashtable[part_ht->id];
-    distribute_mem_to_nodes(ht_mem, part_ht->get_ht_size());
+    dispatch_ht_kind<PartitionedHashStore>([ktable](auto table) {
+      auto *part_ht = static_cast<typename decltype(table)::type *>(ktable);
+      void *ht_mem = part_ht->hashtable[part_ht->id];
+      distribute_mem_to_nodes(ht_mem, part_ht->get_ht_size());
+    });
   }
 
   FindResult *results = new FindResult[config.batch_len];
@@ -735,11 +959,12 @@ void QueueTest<T>::find_thread(int tid, int n_prod, int n_cons, bool is_join,
   int partition;
   int j = 0;
 
-  barrier->arrive_and_wait();
+  trace_arrive_and_wait(barrier);
 
   static const auto event = vtune::event_start("find_batch");
 
   std::size_t next_pollution{};
+  const PerfRegion perf;
   auto t_start = RDTSC_START();
 
   for (auto m = 0u; m < config.insert_factor; m++) {
@@ -837,8 +1062,10 @@ void QueueTest<T>::find_thread(int tid, int n_prod, int n_cons, bool is_join,
     }
   }
   auto t_end = RDTSCP();
+  const auto events = perf.end();
+  trace_phase(TraceEvent::Find, t_start, t_end);
 
-  barrier->arrive_and_wait();
+  trace_arrive_and_wait(barrier);
 
 #ifdef CALC_STATS
   PLOG_INFO.printf(
@@ -848,8 +1075,7 @@ void QueueTest<T>::find_thread(int tid, int n_prod, int n_cons, bool is_join,
 
   vtune::event_end(event);
 
-  sh->stats->finds.duration = (t_end - t_start);
-  sh->stats->finds.op_count = found;
+  sh->stats->finds = {t_end - t_start, found, events};
 
   if (found >= 0) {
     PLOGV.printf(
@@ -861,11 +1087,212 @@ void QueueTest<T>::find_thread(int tid, int n_prod, int n_cons, bool is_join,
   get_ht_stats(sh, ktable);
 
 #ifdef LATENCY_COLLECTION
-  collector->dump("find", tid);
+  collector->publish(LatencyOp::Find);
   PLOG_INFO << "Dumping find";
 #endif
 }
 
+#if !defined(BQUEUE_KMER_TEST)
+// A producer with --queue-finds is a client of the delegation service: its
+// inserts and finds are requests to the consumer owning the key, which
+// applies them to its own partition and answers finds over a reverse queue.
+// Every key is looked up QUEUED_FIND_LAG inserts after it was sent, so the
+// lookups are answered while the inserts behind them are in flight.
+template <typename T>
+void QueueTest<T>::delegated_thread(
+    int tid, int n_prod, DelegatedHashTable *dht,
+    std::barrier<std::function<void()>> *barrier) {
+  Shard *sh = &this->shards[tid];
+  sh->stats = (thread_stats *)calloc(1, sizeof(thread_stats));
+  auto &client = dht->client(tid);
+  uint64_t found = 0;
+
+#if defined(XORWOW)
+  struct xorwow_state _xw_state, init_state;
+  xorwow_init(&_xw_state);
+  init_state = _xw_state;
+#endif
+
+  client.set_find_callback([&found](const FindResult &) { found++; });
+
+  vtune::set_threadname("delegated_thread" + std::to_string(tid));
+  trace_thread_name("delegated " + std::to_string(tid));
+
+  const auto num_messages = HT_TESTS_NUM_INSERTS / n_prod;
+  uint64_t key_start =
+      std::max(static_cast<uint64_t>(num_messages) * tid, (uint64_t)1);
+  uint64_t num_inserts = 0, num_finds = 0;
+  std::array<uint64_t, QUEUED_FIND_LAG> recent{};
+
+  trace_arrive_and_wait(barrier);
+
+  const PerfRegion perf;
+  auto t_start = RDTSC_START();
+
+  for (auto m = 0u; m < config.insert_factor; m++) {
+    [[maybe_unused]] auto k = key_start;
+    [[maybe_unused]] auto zipf_idx = key_start == 1 ? 0 : key_start;
+#if defined(XORWOW)
+    _xw_state = init_state;
+#endif
+    uint64_t i = 0;
+    for (; i < num_messages; i++) {
+#if defined(XORWOW)
+      const uint64_t key = xorwow(&_xw_state);
+#elif defined(BQ_TESTS_INSERT_ZIPFIAN)
+      if (!(zipf_idx & 7) && zipf_idx + 16 < zipf_values->size())
+        prefetch_object<false>(&zipf_values->at(zipf_idx + 16), 64);
+      const uint64_t key = zipf_values->at(zipf_idx++);
+#else
+      const uint64_t key = k++;
+#endif
+      client.insert(key, key);
+      num_inserts++;
+
+      auto &slot = recent[i % QUEUED_FIND_LAG];
+      if (i >= QUEUED_FIND_LAG) {
+        client.find(slot, static_cast<uint32_t>(num_finds++));
+      }
+      slot = key;
+      // SIGUSR2: stop inserting and look up what was sent
+      if (!(i & 1023) && stop_requested()) {
+        i++;
+        break;
+      }
+    }
+    // the tail of the round
+    for (auto j = i > QUEUED_FIND_LAG ? i - QUEUED_FIND_LAG : 0; j < i; j++) {
+      client.find(recent[j % QUEUED_FIND_LAG],
+                  static_cast<uint32_t>(num_finds++));
+    }
+    if (stop_requested()) break;
+  }
+  client.drain();
+  // don't hold back a resize while waiting for the others
+  client.park();
+
+  auto t_end = RDTSCP();
+  const auto events = perf.end();
+  trace_phase(TraceEvent::Find, t_start, t_end);
+
+  trace_arrive_and_wait(barrier);
+
+  sh->stats->enqueues = {t_end - t_start, num_inserts};
+  sh->stats->finds = {t_end - t_start, found, events};
+
+  PLOGV.printf("thread %u | num_finds %lu (not_found %lu) | cycles per op: %lu",
+               sh->shard_idx, found, num_finds - found,
+               (t_end - t_start) / std::max<uint64_t>(num_inserts + num_finds, 1));
+}
+
+template <typename T>
+void QueueTest<T>::run_delegated_test(Configuration *cfg, Numa *n,
+                                      bool is_join, NumaPolicyQueues *npq) {
+  if (is_join || bq_load != BQUEUE_LOAD::HtInsert) {
+    PLOGE.printf("--queue-finds needs the consumers' hashtables");
+    exit(-1);
+  }
+  this->init_run(cfg, n, npq);
+
+  // Producers are launched on every cpu but 0 first and take the last shard
+  // on cpu 0 (see insert_with_queues)
+  std::vector<uint32_t> client_cpus;
+  for (auto cpu : this->npq->get_assigned_cpu_list_producers()) {
+    if (cpu != 0) client_cpus.push_back(cpu);
+  }
+  client_cpus.push_back(0);
+
+  // The consumers' tables have the ids of their shards: n_prod, n_prod + 1, ..
+  // and are allocated by the owner threads that serve them
+  DelegatedHashTable dht(
+      client_cpus, this->npq->get_assigned_cpu_list_consumers(),
+      get_ht_size(cfg->n_cons),
+      [](uint64_t size, uint32_t id) { return init_ht(size, id); },
+      cfg->n_prod, cfg->inflight_finds);
+
+  uint64_t g_start = 0, g_end = 0;
+  bool started = false;
+  std::function<void()> on_completion = [&]() noexcept {
+    if (!started) {
+      PLOG_INFO << "Sync completed. Starting delegated inserts and finds!";
+      started = true;
+      g_start = RDTSC_START();
+    } else {
+      g_end = RDTSCP();
+      PLOGI.printf("Inserts and finds took %lu cycles", g_end - g_start);
+    }
+  };
+
+  // --elastic-owners: start with one owner and let the load add more. The
+  // inserts are requests too, so a burst of ingest grows the owner set and
+  // owners dropped in a lull sleep instead of polling their queues.
+  std::atomic_bool clients_done{false};
+  std::thread scaler;
+  uint32_t min_active = cfg->n_cons, max_active = 1;
+  if (cfg->elastic_owners) {
+    dht.resize(1);
+    scaler = std::thread([&] {
+      auto active = dht.num_active_owners();
+      min_active = max_active = active;
+      while (!clients_done.load()) {
+        std::this_thread::sleep_for(
+            std::chrono::microseconds(ELASTIC_SCALE_PERIOD_US));
+        const auto now_active = dht.autoscale();
+        if (now_active != active) {
+          PLOGI.printf("delegated hashtable: %u -> %u owners", active,
+                       now_active);
+          active = now_active;
+          min_active = std::min(min_active, active);
+          max_active = std::max(max_active, active);
+        }
+      }
+    });
+  }
+
+  std::barrier barrier(cfg->n_prod, on_completion);
+  cpu_set_t cpuset;
+
+  for (auto i = 0u; i + 1 < cfg->n_prod; i++) {
+    this->shards[i].shard_idx = i;
+    auto _thread = std::thread(&QueueTest::delegated_thread, this, i,
+                               cfg->n_prod, &dht, &barrier);
+    CPU_ZERO(&cpuset);
+    CPU_SET(client_cpus[i], &cpuset);
+    pthread_setaffinity_np(_thread.native_handle(), sizeof(cpu_set_t), &cpuset);
+    this->prod_threads.push_back(std::move(_thread));
+  }
+
+  CPU_ZERO(&cpuset);
+  CPU_SET(0, &cpuset);
+  sched_setaffinity(0, sizeof(cpu_set_t), &cpuset);
+  this->shards[cfg->n_prod - 1].shard_idx = cfg->n_prod - 1;
+  this->delegated_thread(cfg->n_prod - 1, cfg->n_prod, &dht, &barrier);
+
+  for (auto &th : this->prod_threads) {
+    th.join();
+  }
+  this->prod_threads.clear();
+  clients_done = true;
+  if (scaler.joinable()) {
+    scaler.join();
+    PLOGI.printf("delegated hashtable: %u to %u of %u owners were active",
+                 min_active, max_active, cfg->n_cons);
+  }
+  dht.shutdown();
+
+  // The owners' work is only known in total: each gets the whole run
+  for (auto o = 0u; o < cfg->n_cons; o++) {
+    Shard *sh = &this->shards[cfg->n_prod + o];
+    sh->shard_idx = cfg->n_prod + o;
+    sh->stats = (thread_stats *)calloc(1, sizeof(thread_stats));
+    sh->stats->insertions = {g_end - g_start, dht.num_inserted(o)};
+    get_ht_stats(sh, dht.table(o));
+  }
+
+  PLOG_INFO.printf("Delegated inserts and finds done!");
+}
+#endif  // !BQUEUE_KMER_TEST
+
 template <typename T>
 void QueueTest<T>::init_queues(uint32_t nprod, uint32_t ncons) {
   PLOG_DEBUG.printf("Initializing queues");
@@ -877,6 +1304,9 @@ void QueueTest<T>::init_queues(uint32_t nprod, uint32_t ncons) {
     this->QUEUE_SIZE = 4;
   }
   this->queues = new T(nprod, ncons, this->QUEUE_SIZE, this->npq);
+  if constexpr (has_parking<T>) {
+    this->queues->set_wait(config.queue_wait, config.queue_spin_cycles);
+  }
 }
 
 template <typename T>
@@ -893,9 +1323,32 @@ void QueueTest<T>::run_test(Configuration *cfg, Numa *n, bool is_join,
   collectors.resize(thread_count);
 #endif
 
+  if (cfg->hot_replicas) {
+    this->static_load.assign(cfg->n_cons, 0);
+    this->routed_load.assign(cfg->n_cons, 0);
+    this->hot_partials.assign(cfg->n_cons, {});
+  }
+
+#if !defined(BQUEUE_KMER_TEST)
+  // --queue-finds: one set of owners serves the inserts and the finds
+  if (cfg->queue_finds) {
+    this->run_delegated_test(cfg, n, is_join, npq);
+    end_ts = std::chrono::steady_clock::now();
+    PLOG_INFO.printf(
+        "Kmer insertion took %llu us",
+        chrono::duration_cast<chrono::microseconds>(end_ts - start_ts).count());
+    print_stats(this->shards, *cfg);
+    return;
+  }
+#endif
+
   // 1) Insert using bqueues
   this->insert_with_queues(cfg, n, is_join, npq);
 
+  if (cfg->hot_replicas) {
+    this->merge_hot_partials(cfg);
+  }
+
 #ifdef LATENCY_COLLECTION
   collectors.clear();
   collectors.resize(thread_count);
@@ -915,7 +1368,9 @@ void QueueTest<T>::run_test(Configuration *cfg, Numa *n, bool is_join,
   }
 
   // 2) spawn n_prod + n_cons threads for find
-  if (!is_join || cfg->rw_queues) this->run_find_test(cfg, n, is_join, npq);
+  if (!is_join || cfg->rw_queues) {
+    this->run_find_test(cfg, n, is_join, npq);
+  }
 
   end_ts = std::chrono::steady_clock::now();
 
@@ -925,6 +1380,41 @@ void QueueTest<T>::run_test(Configuration *cfg, Numa *n, bool is_join,
   print_stats(this->shards, *cfg);
 }
 
+template <typename T>
+void QueueTest<T>::merge_hot_partials(Configuration *cfg) {
+  auto imbalance = [](const std::vector<uint64_t> &load) {
+    const auto total = std::accumulate(load.begin(), load.end(), 0ull);
+    const auto max = *std::max_element(load.begin(), load.end());
+    return total ? (double)max * load.size() / total : 0.0;
+  };
+  for (auto c = 0u; c < cfg->n_cons; c++) {
+    PLOGV.printf("[cons:%u] keys static %" PRIu64 " routed %" PRIu64, c,
+                 this->static_load[c], this->routed_load[c]);
+  }
+  PLOGI.printf("Consumer load imbalance (max/mean): static %.2f routed %.2f",
+               imbalance(this->static_load), imbalance(this->routed_load));
+
+  // Single threaded: the consumers are done with their partitions
+  Hasher hasher;
+  uint64_t num_merged{};
+  uint64_t num_spilled{};
+  for (const auto &partials : this->hot_partials) {
+    partials.for_each([&](uint64_t key, uint64_t count) {
+      const auto home = hash_to_cpu(hasher(&key, sizeof(key)), cfg->n_cons);
+      auto *ht = this->ht_vec->at(cfg->n_prod + home);
+      InsertFindArgument arg{key, count, static_cast<uint32_t>(key), home};
+      ht->insert_batch(InsertFindArguments(&arg, 1));
+      ht->flush_insert_queue();
+      num_merged++;
+    });
+    num_spilled += partials.num_spilled();
+  }
+  PLOGI.printf("Merged %" PRIu64 " partial counts of hot keys (%" PRIu64
+               " spilled)",
+               num_merged, num_spilled);
+  this->hot_partials.clear();
+}
+
 template <typename T>
 void QueueTest<T>::run_find_test(Configuration *cfg, Numa *n, bool is_join,
                                  NumaPolicyQueues *npq) {
@@ -1015,11 +1505,8 @@ void QueueTest<T>::run_find_test(Configuration *cfg, Numa *n, bool is_join,
 }
 
 template <class T>
-void QueueTest<T>::insert_with_queues(Configuration *cfg, Numa *n, bool is_join,
-                                      NumaPolicyQueues *npq) {
-  cpu_set_t cpuset;
-  uint32_t i = 0, j = 0;
-
+void QueueTest<T>::init_run(Configuration *cfg, Numa *n,
+                            NumaPolicyQueues *npq) {
   this->n = n;
   this->nodes = this->n->get_node_config();
   this->npq = npq;
@@ -1046,6 +1533,15 @@ void QueueTest<T>::insert_with_queues(Configuration *cfg, Numa *n, bool is_join,
 
   // alloc shards array
   this->shards = (Shard *)calloc(sizeof(Shard), cfg->num_threads);
+}
+
+template <class T>
+void QueueTest<T>::insert_with_queues(Configuration *cfg, Numa *n, bool is_join,
+                                      NumaPolicyQueues *npq) {
+  cpu_set_t cpuset;
+  uint32_t i = 0, j = 0;
+
+  this->init_run(cfg, n, npq);
 
   // Init queues
   this->init_queues(cfg->n_prod, cfg->n_cons);
@@ -1129,10 +1625,11 @@ void QueueTest<T>::insert_with_queues(Configuration *cfg, Numa *n, bool is_join,
   // print_stats(this->shards, *cfg);
 }
 
-template class QueueTest<SectionQueue>;
+static_assert(BQueue<SectionQueue>);
+static_assert(BQueue<BQueueAligned>);
+static_assert(BQueue<LynxQueue>);
 
-const data_t SectionQueue::BQ_MAGIC_KV = data_t(
-      SectionQueue::BQ_MAGIC_64BIT, SectionQueue::BQ_MAGIC_64BIT);
-//template class QueueTest<LynxQueue>;
-//template class QueueTest<BQueueAligned>;
+template class QueueTest<SectionQueue>;
+template class QueueTest<BQueueAligned>;
+template class QueueTest<LynxQueue>;
 }  // namespace kmercounter
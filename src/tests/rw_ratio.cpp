@@ -13,7 +13,10 @@
 
 #include "hashtables/base_kht.hpp"
 #include "hashtables/ht_helper.hpp"
+#include "utils/control.hpp"
 #include "utils/hugepage_allocator.hpp"
+#include "utils/sampler.hpp"
+#include "utils/trace.hpp"
 
 #ifdef WITH_VTUNE_LIB
 #include <ittnotify.h>
@@ -85,7 +88,7 @@ class rw_experiment {
     std::array<bool, 1024> flips{};
     for (auto& flip : flips) flip = !sampler(prng);
 
-    sync_barrier->arrive_and_wait();
+    trace_arrive_and_wait(sync_barrier);
 
     const auto start = start_time();
     if (!config.no_prefetch) {
@@ -98,6 +101,9 @@ class rw_experiment {
         if (i % 8 == 0 && i + 16 < keyrange)
           __builtin_prefetch(&values[i + 16]);
 
+        // what is buffered is still inserted or looked up below
+        if ((i & (HT_TESTS_BATCH_LENGTH - 1)) == 0 && stop_requested()) break;
+
         if (write_buffer_len == HT_TESTS_BATCH_LENGTH) time_insert(collector);
         if (read_buffer_len == HT_TESTS_FIND_BATCH_LENGTH) time_find(collector);
         if (flips[i & 1023])
@@ -126,6 +132,12 @@ class rw_experiment {
           ++timings.n_reads;
           hashtable.find_noprefetch(&kv, collector);
         }
+        if ((i & (HT_TESTS_BATCH_LENGTH - 1)) == 0) {
+          publish_progress(&LiveProgress::insertions, timings.n_writes);
+          publish_progress(&LiveProgress::finds, timings.n_reads);
+          publish_progress(&LiveProgress::fill, hashtable.num_insert_misses);
+          if (stop_requested()) break;
+        }
       }
     }
 
@@ -136,7 +148,7 @@ class rw_experiment {
     __itt_event_end(event);
 #endif
 
-    sync_barrier->arrive_and_wait();
+    trace_arrive_and_wait(sync_barrier);
 
     return timings;
   }
@@ -164,6 +176,9 @@ class rw_experiment {
     hashtable.insert_batch(
         InsertFindArguments(write_batch.data(), write_buffer_len), collector);
     // timings.insert_cycles += stop_time() - start;
+    publish_progress(&LiveProgress::insertions, timings.n_writes);
+    publish_progress(&LiveProgress::reprobes, hashtable.num_reprobes);
+    publish_progress(&LiveProgress::fill, hashtable.num_insert_misses);
 
     write_buffer_len = 0;
   }
@@ -180,6 +195,7 @@ class rw_experiment {
     timings.n_found += results.first;
     results.first = 0;
     read_buffer_len = 0;
+    publish_progress(&LiveProgress::finds, timings.n_reads);
   }
 
   void time_flush_find(collector_type* collector) {
@@ -238,6 +254,6 @@ void RWRatioTest::run(Shard& shard, BaseHashTable& hashtable,
   shard.stats->ht_capacity = hashtable.get_capacity();
   shard.stats->ht_fill = hashtable.get_fill();
 
-  collector->dump("unified", shard.shard_idx);
+  collector->publish(LatencyOp::Mixed);
 }
 }  // namespace kmercounter
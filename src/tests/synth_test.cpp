@@ -4,49 +4,21 @@
 #include <cstdint>
 
 #include "tests/SynthTest.hpp"
-#ifdef WITH_VTUNE_LIB
-#include <ittnotify.h>
-#endif
 #include "constants.hpp"
 #include "hashtables/base_kht.hpp"
 #include "hashtables/kvtypes.hpp"
 #include "print_stats.h"
 #include "sync.h"
+#include "utils/control.hpp"
+#include "utils/profiler.hpp"
+#include "utils/sampler.hpp"
 #include "xorwow.hpp"
-#ifdef ENABLE_HIGH_LEVEL_PAPI
-#include <papi.h>
-#endif
-
-#ifdef WITH_VTUNE_LIB
-#include <ittnotify.h>
-#endif
 
 namespace kmercounter {
 namespace {
 struct kmer {
   char data[KMER_DATA_LENGTH];
 };
-
-#ifdef ENABLE_HIGH_LEVEL_PAPI
-void papi_check(int code) {
-  if (code != PAPI_OK) {
-    PLOG_ERROR << "PAPI call failed with code " << code;
-    std::terminate();
-  }
-}
-#endif
-
-void papi_start_region(const char *name) {
-#ifdef ENABLE_HIGH_LEVEL_PAPI
-  papi_check(PAPI_hl_region_begin(name));
-#endif
-}
-
-void papi_end_region(const char *name) {
-#ifdef ENABLE_HIGH_LEVEL_PAPI
-  papi_check(PAPI_hl_region_end(name));
-#endif
-}
 }  // namespace
 
 extern Configuration config;
@@ -64,16 +36,9 @@ OpTimings SynthTest::synth_run(BaseHashTable *ktable, uint8_t start) {
   init_state = _xw_state;
 
   __attribute__((aligned(64))) InsertFindArgument items[HT_TESTS_FIND_BATCH_LENGTH] = {0};
-#ifdef WITH_VTUNE_LIB
-  std::string evt_name(ht_type_strings[config.ht_type]);
-  evt_name += "_insertions";
-  static const auto event =
-      __itt_event_create(evt_name.c_str(), evt_name.length());
-  __itt_event_start(event);
-#endif
-
-  papi_start_region("synthetic_insertions");
-  const auto t_start = RDTSC_START();
+  Profiler profiler(
+      std::string(ht_type_strings[config.ht_type]) + "_insertions",
+      TraceEvent::Insert);
   for (auto j = 0u; j < config.insert_factor; j++) {
     uint64_t count =
         std::max(static_cast<uint64_t>(1), HT_TESTS_NUM_INSERTS * start);
@@ -95,6 +60,12 @@ OpTimings SynthTest::synth_run(BaseHashTable *ktable, uint8_t start) {
         k = (k + 1) & (HT_TESTS_BATCH_LENGTH - 1);
         count++;
         inserted++;
+        if (k == 0) {
+          publish_progress(&LiveProgress::insertions, inserted);
+          publish_progress(&LiveProgress::reprobes, ktable->num_reprobes);
+          publish_progress(&LiveProgress::fill, ktable->num_insert_misses);
+          if (stop_requested()) break;
+        }
       } else {
         count++;
         if (++k == HT_TESTS_BATCH_LENGTH) {
@@ -103,6 +74,10 @@ OpTimings SynthTest::synth_run(BaseHashTable *ktable, uint8_t start) {
 
           k = 0;
           inserted += kp.size();
+          publish_progress(&LiveProgress::insertions, inserted);
+          publish_progress(&LiveProgress::reprobes, ktable->num_reprobes);
+          publish_progress(&LiveProgress::fill, ktable->num_insert_misses);
+          if (stop_requested()) break;
         }
       }
 #if defined(SAME_KMER)
@@ -113,21 +88,20 @@ OpTimings SynthTest::synth_run(BaseHashTable *ktable, uint8_t start) {
     // flush the last batch explicitly
     // printf("%s calling flush queue\n", __func__);
     if (!config.no_prefetch) {
+      const TraceScope flush(TraceEvent::Flush);
       ktable->flush_insert_queue();
     }
+    if (stop_requested()) break;
   }
 
-  const auto t_end = RDTSCP();
-  papi_end_region("synthetic_insertions");
-
-#ifdef WITH_VTUNE_LIB
-  __itt_event_end(event);
-#endif
-
-  duration += t_end - t_start;
+  duration += profiler.end();
   // printf("%s: %p\n", __func__, ktable->find(&kmers[k]));
 
-  return {duration, HT_TESTS_NUM_INSERTS * config.insert_factor};
+  // cut short, the run did only what it has inserted
+  const uint64_t ops = stop_requested()
+                           ? inserted
+                           : HT_TESTS_NUM_INSERTS * config.insert_factor;
+  return {duration, ops, profiler.events()};
 }
 
 OpTimings SynthTest::synth_run_get(BaseHashTable *ktable, uint8_t tid) {
@@ -143,15 +117,8 @@ OpTimings SynthTest::synth_run_get(BaseHashTable *ktable, uint8_t tid) {
 
   std::uint64_t duration{};
 
-#ifdef WITH_VTUNE_LIB
-  std::string evt_name(ht_type_strings[config.ht_type]);
-  evt_name += "_finds";
-  static const auto event =
-      __itt_event_create(evt_name.c_str(), evt_name.length());
-  __itt_event_start(event);
-#endif
-
-  const auto t_start = RDTSC_START();
+  Profiler profiler(std::string(ht_type_strings[config.ht_type]) + "_finds",
+                    TraceEvent::Find);
 
   for (auto j = 0u; j < config.insert_factor; j++) {
     uint64_t count =
@@ -176,6 +143,11 @@ OpTimings SynthTest::synth_run_get(BaseHashTable *ktable, uint8_t tid) {
         void *kv = ktable->find_noprefetch(&items[k]);
         if (kv) found += 1;
         k = (k + 1) & (HT_TESTS_BATCH_LENGTH - 1);
+        if (k == 0) {
+          publish_progress(&LiveProgress::finds,
+                           j * HT_TESTS_NUM_INSERTS + i + 1);
+          if (stop_requested()) break;
+        }
       } else {
         if (++k == HT_TESTS_FIND_BATCH_LENGTH) {
           InsertFindArguments kp(items);
@@ -184,10 +156,14 @@ OpTimings SynthTest::synth_run_get(BaseHashTable *ktable, uint8_t tid) {
           found += vp.first;
           vp.first = 0;
           k = 0;
+          publish_progress(&LiveProgress::finds,
+                           j * HT_TESTS_NUM_INSERTS + i + 1);
+          if (stop_requested()) break;
           // not_found += HT_TESTS_FIND_BATCH_LENGTH - vp.first;
         }
       }
     }
+    if (stop_requested()) break;
   }
 
   if (!config.no_prefetch) {
@@ -195,21 +171,18 @@ OpTimings SynthTest::synth_run_get(BaseHashTable *ktable, uint8_t tid) {
       vp.first = 0;
     }
 
-    ktable->flush_find_queue(vp);
+    {
+      const TraceScope flush(TraceEvent::Flush);
+      ktable->flush_find_queue(vp);
+    }
 
     found += vp.first;
   }
 
-  const auto t_end = RDTSCP();
-
-#ifdef WITH_VTUNE_LIB
-  __itt_event_end(event);
-#endif
-
-  duration = t_end - t_start;
+  duration = profiler.end();
 
   PLOGI.printf("found %" PRIu64 "", found);
-  return {duration, found};
+  return {duration, found, profiler.events()};
 }
 
 uint64_t seed2 = 123456789;
@@ -36,6 +36,93 @@ const char* ht_type_strings[] = {
     "CASHT++",
     "ARRAY_HT",
 };
+const char* hasher_strings[] = {
+    "city", "crc", "xxhash", "wyhash", "citycrc",
+    "xxhash3", "fnv", "direct_index", "mulxor",
+};
+
+bool parse_hasher(const std::string& name, HasherType* type) {
+  for (auto i = 0u; i < std::size(hasher_strings); i++) {
+    if (name == hasher_strings[i]) {
+      *type = static_cast<HasherType>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* branching_strings[] = {
+    "branched",
+    "cmov",
+    "simd",
+};
+
+bool parse_branching(const std::string& name, BRANCHKIND* kind) {
+  for (auto i = 0u; i < std::size(branching_strings); i++) {
+    if (name == branching_strings[i]) {
+      *kind = static_cast<BRANCHKIND>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* queue_kind_strings[] = {
+    "section",
+    "bqueue",
+    "lynx",
+};
+
+bool parse_queue_kind(const std::string& name, QueueKind* kind) {
+  for (auto i = 0u; i < std::size(queue_kind_strings); i++) {
+    if (name == queue_kind_strings[i]) {
+      *kind = static_cast<QueueKind>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* queue_wait_strings[] = {
+    "spin",
+    "park",
+};
+
+bool parse_queue_wait(const std::string& name, QueueWait* wait) {
+  for (auto i = 0u; i < std::size(queue_wait_strings); i++) {
+    if (name == queue_wait_strings[i]) {
+      *wait = static_cast<QueueWait>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* report_format_strings[] = {
+    "text",
+    "json",
+    "csv",
+};
+
+bool parse_report_format(const std::string& name, ReportFormat* format) {
+  for (auto i = 0u; i < std::size(report_format_strings); i++) {
+    if (name == report_format_strings[i]) {
+      *format = static_cast<ReportFormat>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* perf_event_strings[] = {
+    "cycles",
+    "instructions",
+    "l1d_misses",
+    "llc_misses",
+    "dtlb_misses",
+    "branch_misses",
+};
+
 const char* run_mode_strings[] = {
     "",
     "DRY_RUN",
@@ -193,6 +193,34 @@ TEST_P(AggregationTest, OFF_BY_ONE_TEST) {
   ASSERT_EQ(valuepairs.second[1].value, 1);
 }
 
+// With producer-side combining, an insert carries the number of occurrences
+// of its key in the value
+TEST_P(AggregationTest, ADD_VALUES_TEST) {
+  constexpr auto size = HT_TESTS_BATCH_LENGTH;
+  aggr_add_values = true;
+
+  std::array<InsertFindArgument, size> arguments{};
+  for (std::uint64_t k{1}; k <= size; ++k) {
+    arguments.at(k - 1) = {k, k, static_cast<uint32_t>(k)};
+  }
+  InsertFindArguments items(arguments);
+  ht_->insert_batch(items);
+  ht_->insert_batch(items);
+  ht_->flush_insert_queue();
+
+  std::array<FindResult, HT_TESTS_FIND_BATCH_LENGTH> values{};
+  ValuePairs found{0, values.data()};
+  ht_->find_batch(items, found);
+  ht_->flush_find_queue(found);
+  aggr_add_values = false;
+
+  ASSERT_EQ(found.first, size);
+  for (std::uint64_t i{}; i < found.first; ++i) {
+    EXPECT_EQ(found.second[i].value, 2 * found.second[i].id)
+        << "key " << found.second[i].id;
+  }
+}
+
 INSTANTIATE_TEST_CASE_P(TestAllCombinations, AggregationTest,
                         ::testing::ValuesIn(HTS));
 
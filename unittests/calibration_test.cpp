@@ -0,0 +1,37 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "utils/memory_calibration.hpp"
+
+namespace kmercounter {
+namespace {
+
+TEST(CalibrationTest, QueueLenFromKnee) {
+  // saturates at 8 streams
+  const std::vector<MlpPoint> mlp{{1, 10e6, 100},  {2, 20e6, 100},
+                                  {4, 38e6, 105},  {8, 70e6, 114},
+                                  {16, 74e6, 216}, {32, 75e6, 427}};
+  EXPECT_EQ(mlp_knee(mlp), 8u);
+  EXPECT_EQ(suggest_prefetch_queue_len(mlp), 16u);
+}
+
+TEST(CalibrationTest, QueueLenIsPowerOfTwo) {
+  const std::vector<MlpPoint> mlp{{1, 10e6, 100}, {2, 19e6, 105},
+                                  {4, 25e6, 160}, {8, 27e6, 296},
+                                  {16, 28e6, 571}};
+  // 25 is not within 10 % of 28
+  EXPECT_EQ(mlp_knee(mlp), 8u);
+  EXPECT_EQ(suggest_prefetch_queue_len({{1, 10e6, 100}}), 2u);
+  EXPECT_EQ(suggest_prefetch_queue_len({}), 2u);
+}
+
+TEST(CalibrationTest, QueueLenFitsBatch) {
+  // half of 16 queued, and a batch of 8 on top, would fill it
+  EXPECT_EQ(fit_prefetch_queue_len(16, 8), 32u);
+  EXPECT_EQ(fit_prefetch_queue_len(16, 7), 16u);
+  EXPECT_EQ(fit_prefetch_queue_len(64, 16), 64u);
+}
+
+}  // namespace
+}  // namespace kmercounter
@@ -0,0 +1,262 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "hashtables/delegated_kht.hpp"
+#include "hashtables/simple_kht.hpp"
+
+namespace kmercounter {
+namespace {
+
+constexpr uint64_t HT_SIZE = 1ull << 14;
+
+std::unique_ptr<DelegatedHashTable> make_dht(uint32_t num_clients,
+                                             uint32_t num_owners) {
+  // Pinning everything to cpu 0 keeps the test runnable on any machine.
+  return std::make_unique<DelegatedHashTable>(
+      std::vector<uint32_t>(num_clients, 0),
+      std::vector<uint32_t>(num_owners, 0), HT_SIZE,
+      [](uint64_t size, uint32_t id) -> BaseHashTable * {
+        return new PartitionedHashStore<Item, ItemQueue>(size, id);
+      });
+}
+
+TEST(DelegatedHashTable, FindSeesOwnInserts) {
+  auto dht = make_dht(1, 2);
+  auto &client = dht->client(0);
+
+  std::vector<uint64_t> values(64, 0);
+  client.set_find_callback(
+      [&values](const FindResult &result) { values[result.id] = result.value; });
+
+  // No flush in between: the finds must still see the inserts
+  for (uint64_t k = 1; k < values.size(); k++) {
+    client.insert(k, k * 3);
+  }
+  for (uint64_t k = 1; k < values.size(); k++) {
+    client.find(k, k);
+  }
+  client.find(1000, 0);  // not inserted
+  client.drain();
+
+  EXPECT_EQ(client.num_pending_finds(), 0u);
+  EXPECT_EQ(values[0], 0u);
+  for (uint64_t k = 1; k < values.size(); k++) {
+    EXPECT_EQ(values[k], k * 3) << "key " << k;
+  }
+}
+
+TEST(DelegatedHashTable, ZeroIsAPlainKey) {
+  auto dht = make_dht(1, 2);
+  auto &client = dht->client(0);
+
+  std::vector<uint64_t> values(8, 0);
+  client.set_find_callback(
+      [&values](const FindResult &result) { values[result.id] = result.value; });
+
+  // values that match the control codes must not be taken for control
+  client.insert(0, DelegatedHashTable::CTRL_PARK);
+  client.find(0, 1);
+  client.insert(0, DelegatedHashTable::CTRL_FIND_MODE);
+  client.find(0, 2);
+  // later inserts still apply
+  for (uint64_t k = 3; k < values.size(); k++) {
+    client.insert(k, k * 5);
+  }
+  for (uint64_t k = 3; k < values.size(); k++) {
+    client.find(k, k);
+  }
+  client.drain();
+  dht->shutdown();
+
+  EXPECT_EQ(values[1], DelegatedHashTable::CTRL_PARK);
+  EXPECT_EQ(values[2], DelegatedHashTable::CTRL_FIND_MODE);
+  for (uint64_t k = 3; k < values.size(); k++) {
+    EXPECT_EQ(values[k], k * 5) << "key " << k;
+  }
+  uint64_t inserted = 0;
+  for (uint32_t o = 0; o < dht->num_owners; o++) {
+    inserted += dht->num_inserted(o);
+  }
+  EXPECT_EQ(inserted, 2 + values.size() - 3);
+}
+
+TEST(DelegatedHashTable, ConcurrentClients) {
+  constexpr uint32_t num_clients = 3;
+  constexpr uint64_t keys_per_client = 2000;
+  auto dht = make_dht(num_clients, 2);
+
+  std::vector<std::thread> threads;
+  std::atomic_uint64_t num_found{};
+  for (uint32_t c = 0; c < num_clients; c++) {
+    threads.emplace_back([&dht, &num_found, c] {
+      auto &client = dht->client(c);
+      uint64_t found = 0;
+      client.set_find_callback([&found](const FindResult &result) {
+        EXPECT_EQ(result.value, result.id + 7ull);
+        found++;
+      });
+
+      const uint64_t first = 1 + c * keys_per_client;
+      for (uint64_t k = first; k < first + keys_per_client; k++) {
+        client.insert(k, k + 7);
+      }
+      for (uint64_t k = first; k < first + keys_per_client; k++) {
+        client.find(k, k);
+      }
+      client.drain();
+      num_found += found;
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  dht->shutdown();
+
+  EXPECT_EQ(num_found, num_clients * keys_per_client);
+  uint64_t fill = 0, inserted = 0;
+  for (uint32_t o = 0; o < dht->num_owners; o++) {
+    fill += dht->table(o)->get_fill();
+    inserted += dht->num_inserted(o);
+  }
+  EXPECT_EQ(fill, num_clients * keys_per_client);
+  EXPECT_EQ(inserted, num_clients * keys_per_client);
+}
+
+TEST(DelegatedHashTable, FindsDuringInserts) {
+  constexpr uint32_t num_clients = 3;
+  constexpr uint64_t keys_per_client = 4000;
+  // the id of a find of another client's key
+  constexpr uint32_t OTHER = 1u << 31;
+  auto dht = make_dht(num_clients, 2);
+
+  std::vector<std::thread> threads;
+  std::atomic_uint64_t num_own_found{}, num_own_finds{};
+  for (uint32_t c = 0; c < num_clients; c++) {
+    threads.emplace_back([&, c] {
+      auto &client = dht->client(c);
+      uint64_t own_found = 0, own_finds = 0;
+      client.set_find_callback([&own_found](const FindResult &result) {
+        // a key of another client is found or not, but never torn
+        EXPECT_EQ(result.value, (result.id & ~OTHER) + 7ull);
+        if (!(result.id & OTHER)) own_found++;
+      });
+
+      // every client looks up its own keys and its neighbour's while they
+      // are all still inserting
+      const uint64_t first = 1 + c * keys_per_client;
+      const uint64_t other = 1 + ((c + 1) % num_clients) * keys_per_client;
+      for (uint64_t i = 0; i < keys_per_client; i++) {
+        client.insert(first + i, first + i + 7);
+        if (i % 4 == 3) {
+          client.find(first + i - 2, first + i - 2);
+          own_finds++;
+          client.find(other + i, (other + i) | OTHER);
+        }
+      }
+      client.drain();
+      num_own_found += own_found;
+      num_own_finds += own_finds;
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  dht->shutdown();
+
+  EXPECT_EQ(num_own_found, num_own_finds.load());
+  uint64_t fill = 0;
+  for (uint32_t o = 0; o < dht->num_owners; o++) {
+    fill += dht->table(o)->get_fill();
+  }
+  EXPECT_EQ(fill, num_clients * keys_per_client);
+}
+
+TEST(DelegatedHashTable, ResizeHandsOffPartitions) {
+  constexpr uint32_t num_clients = 2;
+  constexpr uint64_t keys_per_phase = 1000;
+  auto dht = make_dht(num_clients, 3);
+  std::atomic_uint32_t phase{0};
+
+  std::vector<std::thread> threads;
+  std::atomic_uint64_t num_found{};
+  for (uint32_t c = 0; c < num_clients; c++) {
+    threads.emplace_back([&, c] {
+      auto &client = dht->client(c);
+      uint64_t found = 0;
+      client.set_find_callback([&found](const FindResult &result) {
+        EXPECT_EQ(result.value, result.id * 2ull);
+        found++;
+      });
+
+      // every phase runs under another routing; the finds also look up the
+      // keys of the earlier phases
+      for (uint32_t p = 0; p < 3; p++) {
+        while (phase.load() < p) client.poll();
+        const uint64_t first = 1 + (c * 3 + p) * keys_per_phase;
+        for (uint64_t k = first; k < first + keys_per_phase; k++) {
+          client.insert(k, k * 2);
+        }
+        for (uint64_t k = 1 + c * 3 * keys_per_phase;
+             k < first + keys_per_phase; k++) {
+          client.find(k, k);
+        }
+        client.drain();
+        client.park();
+      }
+      num_found += found;
+    });
+  }
+
+  dht->resize(1);
+  phase = 1;
+  dht->resize(2);
+  dht->resize(3);
+  phase = 2;
+  for (auto &t : threads) {
+    t.join();
+  }
+  dht->shutdown();
+
+  EXPECT_EQ(dht->num_active_owners(), 3u);
+  EXPECT_EQ(dht->settled_epoch(), 3u);
+  // 1 + 2 + 3 phases worth of finds per client
+  EXPECT_EQ(num_found, num_clients * 6 * keys_per_phase);
+  uint64_t fill = 0;
+  for (uint32_t p = 0; p < dht->num_owners; p++) {
+    fill += dht->table(p)->get_fill();
+  }
+  EXPECT_EQ(fill, num_clients * 3 * keys_per_phase);
+}
+
+TEST(DelegatedHashTable, ServesExistingTables) {
+  std::vector<BaseHashTable *> tables{
+      new PartitionedHashStore<Item, ItemQueue>(HT_SIZE, 5),
+      new PartitionedHashStore<Item, ItemQueue>(HT_SIZE, 6)};
+  {
+    DelegatedHashTable dht({0}, {0, 0}, tables, 5);
+    auto &client = dht.client(0);
+    uint64_t found = 0;
+    client.set_find_callback([&found](const FindResult &) { found++; });
+    for (uint64_t k = 1; k <= 100; k++) {
+      client.insert(k, k);
+    }
+    for (uint64_t k = 1; k <= 200; k++) {
+      client.find(k, k);
+    }
+    client.drain();
+    EXPECT_EQ(found, 100u);
+  }
+
+  // The tables outlive the service
+  EXPECT_EQ(tables[0]->get_fill() + tables[1]->get_fill(), 100u);
+  for (auto table : tables) {
+    delete table;
+  }
+}
+
+}  // namespace
+}  // namespace kmercounter
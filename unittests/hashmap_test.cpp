@@ -205,6 +205,54 @@ TEST_P(HashtableTest, BATCH_QUERY_TEST) {
   batch_runner_.flush_find();
 }
 
+#ifdef PROBE_STATS
+TEST_P(HashtableTest, PROBE_HISTOGRAMS_TEST) {
+  FindResultChecker checker;
+  batch_runner_.set_callback(checker.checker());
+
+  // Insert the keys twice; the second time they are there.
+  const uint64_t test_size = absl::GetFlag(FLAGS_test_size);
+  for (int round = 0; round < 2; round++) {
+    for (uint64_t i = 1; i <= test_size; i++) {
+      batch_runner_.insert(i, i);
+    }
+    batch_runner_.flush_insert();
+  }
+
+  // Find them and as many that are not there.
+  for (uint64_t i = 1; i <= 2 * test_size; i++) {
+    if (i <= test_size) checker.add(i, i);
+    batch_runner_.find({i, i});
+  }
+  batch_runner_.flush_find();
+
+  const auto& probes = ht_->probe_histograms;
+  EXPECT_EQ(probes.ops(ProbeOutcome::InsertMiss), test_size);
+  EXPECT_EQ(probes.ops(ProbeOutcome::InsertHit), test_size);
+  EXPECT_EQ(probes.ops(ProbeOutcome::FindHit), test_size);
+  EXPECT_EQ(probes.ops(ProbeOutcome::FindMiss), test_size);
+  uint64_t homes = 0;
+  for (const auto n : probes.homes) homes += n;
+  EXPECT_EQ(homes, 4 * test_size);
+}
+#endif  // PROBE_STATS
+
+#ifdef CALC_STATS
+TEST_P(HashtableTest, INSERT_MISSES_ARE_FILL_TEST) {
+  // Insert the keys twice; only the first time takes new slots.
+  const uint64_t test_size = absl::GetFlag(FLAGS_test_size);
+  for (int round = 0; round < 2; round++) {
+    for (uint64_t i = 1; i <= test_size; i++) {
+      batch_runner_.insert(i, i);
+    }
+    batch_runner_.flush_insert();
+  }
+
+  EXPECT_EQ(ht_->num_insert_misses, test_size);
+  EXPECT_EQ(ht_->num_insert_misses, ht_->get_fill());
+}
+#endif  // CALC_STATS
+
 INSTANTIATE_TEST_CASE_P(TestAllHashtables, HashtableTest,
                         ::testing::ValuesIn(HTS));
 
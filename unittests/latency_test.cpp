@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "Latency.hpp"
+
+namespace kmercounter {
+namespace {
+
+TEST(LatencyHistogram, BucketsBoundTheError) {
+  for (std::uint64_t v = 0; v <= std::numeric_limits<timer_type>::max();
+       v = v * 5 / 4 + 1) {
+    const auto bucket = LatencyHistogram::bucket_of(v);
+    ASSERT_LT(bucket, LatencyHistogram::num_buckets) << v;
+    const auto highest = LatencyHistogram::highest_in(bucket);
+    EXPECT_GE(highest, v);
+    EXPECT_LE(highest - v, v / 32) << v;
+    EXPECT_EQ(LatencyHistogram::bucket_of(highest), bucket) << v;
+    EXPECT_EQ(LatencyHistogram::bucket_of(highest + 1), bucket + 1) << v;
+  }
+  EXPECT_EQ(LatencyHistogram::bucket_of(std::numeric_limits<timer_type>::max()),
+            LatencyHistogram::num_buckets - 1);
+}
+
+TEST(LatencyHistogram, Percentiles) {
+  LatencyHistogram h;
+  EXPECT_EQ(h.percentile(0.5), 0u);
+  for (timer_type v = 1; v <= 100'000; v++) h.record(v);
+
+  EXPECT_EQ(h.count(), 100'000u);
+  EXPECT_EQ(h.max(), 100'000u);
+  EXPECT_EQ(h.percentile(1), 100'000u);
+  for (const auto q : {0.5, 0.9, 0.99, 0.999}) {
+    const auto exact = q * 100'000;
+    EXPECT_GE(h.percentile(q), exact) << q;
+    EXPECT_LE(h.percentile(q), exact * 33 / 32) << q;
+  }
+}
+
+TEST(LatencyHistogram, ThreadsMergeIntoShared) {
+  constexpr auto num_threads = 4u;
+  SharedLatencyHistogram shared;
+  std::vector<LatencyHistogram> local(num_threads);
+  std::vector<std::thread> threads;
+  for (auto t = 0u; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      for (timer_type v = 0; v < 10'000; v++) local[t].record(v * (t + 1));
+      shared.merge(local[t]);
+    });
+  }
+  for (auto &t : threads) t.join();
+
+  LatencyHistogram expected;
+  for (const auto &h : local) expected.add(h);
+  const auto merged = shared.snapshot();
+  EXPECT_EQ(merged.count(), num_threads * 10'000u);
+  EXPECT_EQ(merged.max(), 9'999u * num_threads);
+  for (const auto q : {0.5, 0.9, 0.99, 0.999}) {
+    EXPECT_EQ(merged.percentile(q), expected.percentile(q)) << q;
+  }
+}
+
+}  // namespace
+}  // namespace kmercounter
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "tests/PrefetchTest.hpp"
+
+namespace kmercounter {
+namespace {
+
+TEST(PrefetchSweepTest, GridFitsBatches) {
+  const auto uniform = prefetch_sweep_grid(false, 16);
+  const auto both = prefetch_sweep_grid(true, 16);
+  EXPECT_EQ(both.size(), 2 * uniform.size());
+  for (const auto &p : both) {
+    EXPECT_LT(p.distance + 16, p.queue_len);
+    EXPECT_TRUE(p.ht_type == PARTITIONED_HT || p.ht_type == CASHTPP);
+  }
+  // the defaults are on it
+  EXPECT_TRUE(std::any_of(uniform.begin(), uniform.end(), [](const auto &p) {
+    return p.pf_write && p.queue_len == PREFETCH_QUEUE_SIZE &&
+           p.distance == INS_FLUSH_THRESHOLD;
+  }));
+}
+
+TEST(PrefetchSweepTest, PrintsBest) {
+  std::vector<PrefetchSweepPoint> points{
+      {PARTITIONED_HT, false, true, 64, 32, {4000, 100}, {3000, 100}},
+      {PARTITIONED_HT, false, false, 64, 8, {3000, 100}, {5000, 100}},
+      {CASHTPP, false, true, 32, 4, {6000, 100}, {2000, 100}}};
+  Configuration config{};
+  config.pf_write = true;
+  config.pf_queue_len = 64;
+  config.ins_flush_threshold = 32;
+
+  char *buf = nullptr;
+  size_t len = 0;
+  FILE *out = open_memstream(&buf, &len);
+  print_prefetch_sweep(out, points, config);
+  fclose(out);
+  const std::string text(buf, len);
+  free(buf);
+
+  EXPECT_NE(text.find("inserts 30.0 cycles (prefetch for read, queue 64, "
+                      "distance 8), finds 30.0 cycles (queue 64, distance "
+                      "32); configured: 40.0 / 30.0 cycles"),
+            std::string::npos)
+      << text;
+  // not configured on the CAS table
+  EXPECT_NE(text.find("inserts 60.0 cycles (prefetch for write, queue 32, "
+                      "distance 4), finds 20.0 cycles (queue 32, distance "
+                      "4)\n"),
+            std::string::npos)
+      << text;
+}
+
+}  // namespace
+}  // namespace kmercounter
@@ -0,0 +1,228 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "hashtables/simple_kht.hpp"
+#include "queues/bqueue_aligned.hpp"
+#include "queues/lynxq.hpp"
+#include "queues/section_queues.hpp"
+
+namespace kmercounter {
+namespace {
+
+constexpr uint64_t NUM_SECTIONS = 4;
+constexpr uint64_t PER_SECTION = SECTION_SIZE / sizeof(data_t);
+
+template <typename Q>
+std::unique_ptr<Q> make_queue();
+
+template <>
+std::unique_ptr<SectionQueue> make_queue() {
+  return std::make_unique<SectionQueue>(1, 1, NUM_SECTIONS,
+                                        std::vector<uint32_t>{0});
+}
+
+template <>
+std::unique_ptr<BQueueAligned> make_queue() {
+  return std::make_unique<BQueueAligned>(1, 1, 4096);
+}
+
+// the size QueueTest gives it: two sections of three pages
+constexpr size_t LYNX_QUEUE_SIZE = (1 << 12) * 8;
+
+template <>
+std::unique_ptr<LynxQueue> make_queue() {
+  return std::make_unique<LynxQueue>(1, 1, LYNX_QUEUE_SIZE);
+}
+
+template <typename Q>
+class BQueueTest : public ::testing::Test {};
+using QueueTypes = ::testing::Types<SectionQueue, BQueueAligned, LynxQueue>;
+TYPED_TEST_SUITE(BQueueTest, QueueTypes);
+
+// The consumer reads everything up to the end marker, in order
+TYPED_TEST(BQueueTest, DeliversUntilDone) {
+  auto queue = make_queue<TypeParam>();
+  auto pq = &queue->all_pqueues[0][0];
+  auto cq = &queue->all_cqueues[0][0];
+
+  std::vector<data_t> sent;
+  for (uint64_t k = 1; k <= 300; k++) {
+    sent.emplace_back(k, k * 5);
+    ASSERT_EQ(queue->enqueue(pq, 0, 0, sent.back()), SUCCESS);
+  }
+  queue->push_done(0, 0);
+
+  std::vector<data_t> received;
+  for (auto tries = 0; tries < 10000; tries++) {
+    data_t kv;
+    if (queue->dequeue(cq, 0, 0, &kv) != SUCCESS) continue;
+    if (kv == TypeParam::BQ_MAGIC_KV) break;
+    received.push_back(kv);
+  }
+  EXPECT_EQ(received, sent);
+}
+
+// Pairs cross both redzones and wrap around the queue several times; the
+// consumer gets RETRY while the producer holds the next section
+TEST(LynxQueue, PairsCrossRedzones) {
+  auto queue = make_queue<LynxQueue>();
+  auto pq = &queue->all_pqueues[0][0];
+  auto cq = &queue->all_cqueues[0][0];
+  constexpr uint64_t n = 5 * LYNX_QUEUE_SIZE / sizeof(data_t);
+
+  uint64_t received = 0;
+  std::thread consumer([&] {
+    for (;;) {
+      data_t kv;
+      if (queue->dequeue(cq, 0, 0, &kv) != SUCCESS) continue;
+      if (kv == LynxQueue::BQ_MAGIC_KV) break;
+      ++received;
+      ASSERT_EQ(kv, data_t(received, received * 3));
+    }
+  });
+  for (uint64_t k = 1; k <= n; k++) {
+    queue->enqueue(pq, 0, 0, data_t(k, k * 3));
+  }
+  queue->push_done(0, 0);
+  consumer.join();
+  EXPECT_EQ(received, n);
+}
+
+TEST(SectionQueue, BulkRoundTrip) {
+  SectionQueue queue(1, 1, NUM_SECTIONS, std::vector<uint32_t>{0});
+  auto pq = &queue.all_pqueues[0][0];
+  auto cq = &queue.all_cqueues[0][0];
+
+  // starts mid-section and spans more than one
+  std::vector<data_t> sent;
+  for (uint64_t k = 1; k <= PER_SECTION + 44; k++) sent.emplace_back(k, 2 * k);
+  queue.enqueue(pq, 0, 0, sent[0]);
+  queue.enqueue_bulk(pq, 0, 0, std::span<const data_t>(sent).subspan(1));
+
+  // only the first section is published
+  std::vector<data_t> received;
+  for (auto run = queue.dequeue_bulk(cq, 0, 0, 100); !run.empty();
+       run = queue.dequeue_bulk(cq, 0, 0, 100)) {
+    EXPECT_LE(run.size(), 100u);
+    received.insert(received.end(), run.begin(), run.end());
+  }
+  ASSERT_EQ(received.size(), PER_SECTION);
+
+  queue.push_done(0, 0);
+  bool done = false;
+  while (!done) {
+    const auto run = queue.dequeue_bulk(cq, 0, 0, PER_SECTION);
+    ASSERT_FALSE(run.empty());
+    for (const auto &kv : run) {
+      if (kv == SectionQueue::BQ_MAGIC_KV) {
+        done = true;
+        break;
+      }
+      received.push_back(kv);
+    }
+  }
+  EXPECT_EQ(received, sent);
+}
+
+TEST(SectionQueue, InsertsRunsInPlace) {
+  SectionQueue queue(1, 1, NUM_SECTIONS, std::vector<uint32_t>{0});
+  auto pq = &queue.all_pqueues[0][0];
+  auto cq = &queue.all_cqueues[0][0];
+  std::unique_ptr<BaseHashTable> ht(
+      new PartitionedHashStore<Item, ItemQueue>(1ull << 14, 0));
+
+  // a whole section in one run: longer than the prefetch queue
+  std::vector<data_t> sent;
+  for (uint64_t k = 1; k <= PER_SECTION; k++) sent.emplace_back(k, k + 7);
+  queue.enqueue_bulk(pq, 0, 0, sent);
+
+  const auto run = queue.dequeue_bulk(cq, 0, 0, PER_SECTION);
+  ASSERT_EQ(run.size(), PER_SECTION);
+  ht->insert_kv_batch(run);
+  // padding (key 0) is skipped
+  ht->insert_kv_batch(std::vector<data_t>(8));
+  ht->flush_insert_queue();
+  EXPECT_EQ(ht->get_fill(), PER_SECTION);
+
+  std::vector<InsertFindArgument> args;
+  for (uint64_t k = 1; k <= HT_TESTS_FIND_BATCH_LENGTH; k++) {
+    args.push_back({k, 0, static_cast<uint32_t>(k)});
+  }
+  std::array<FindResult, HT_TESTS_FIND_BATCH_LENGTH> results{};
+  ValuePairs found{0, results.data()};
+  ht->find_batch(InsertFindArguments(args), found);
+  ht->flush_find_queue(found);
+  ASSERT_EQ(found.first, HT_TESTS_FIND_BATCH_LENGTH);
+  for (uint64_t i = 0; i < found.first; i++) {
+    EXPECT_EQ(found.second[i].value, found.second[i].id + 7ull);
+  }
+}
+
+TEST(SectionQueue, ParkedConsumerIsWoken) {
+  SectionQueue queue(1, 1, NUM_SECTIONS, std::vector<uint32_t>{0});
+  queue.set_wait(QueueWait::Park, 0);
+  auto pq = &queue.all_pqueues[0][0];
+  auto cq = &queue.all_cqueues[0][0];
+
+  uint64_t received = 0;
+  std::thread consumer([&] {
+    uint64_t idle_since = 0;
+    for (;;) {
+      data_t kv;
+      if (queue.dequeue(cq, 0, 0, &kv) != SUCCESS) {
+        queue.consumer_idle(0, 1, &idle_since);
+        continue;
+      }
+      idle_since = 0;
+      if (kv == SectionQueue::BQ_MAGIC_KV) break;
+      received++;
+    }
+  });
+
+  // long enough for the consumer to fall asleep
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  for (uint64_t k = 1; k <= 1000; k++) {
+    queue.enqueue(pq, 0, 0, data_t(k, k));
+  }
+  queue.push_done(0, 0);
+  consumer.join();
+
+  EXPECT_EQ(received, 1000u);
+  EXPECT_GT(queue.num_parks(0), 0u);
+}
+
+TEST(SectionQueue, SizesSectionsPerPair) {
+  // producer and consumer on the same cpu share a core: smallest sections
+  SectionQueue queue(1, 1, NUM_SECTIONS, std::vector<uint32_t>{0},
+                     std::vector<uint32_t>{0});
+  const auto &layout = queue.pair_layout(0, 0);
+  EXPECT_EQ(layout.section_size, MIN_SECTION_SIZE);
+  auto pq = &queue.all_pqueues[0][0];
+  auto cq = &queue.all_cqueues[0][0];
+  EXPECT_EQ((uint64_t)pq->data % MIN_SECTION_SIZE, 0u);
+
+  // more than a full queue of the default section size, which only fits
+  // because the consumer keeps up
+  constexpr uint64_t n = NUM_SECTIONS * SECTION_SIZE / sizeof(data_t);
+  uint64_t received = 0;
+  auto drain = [&] {
+    // the first dequeue of a section only picks up the producer's progress
+    for (auto retries = 0; retries < 2; retries++) {
+      for (data_t kv; queue.dequeue(cq, 0, 0, &kv) == SUCCESS; retries = 0) {
+        EXPECT_EQ(kv.key, ++received);
+      }
+    }
+  };
+  for (uint64_t k = 1; k <= n; k++) {
+    queue.enqueue(pq, 0, 0, data_t(k, k));
+    drain();
+  }
+  EXPECT_EQ(received, n);
+}
+
+}  // namespace
+}  // namespace kmercounter
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "print_stats.h"
+
+namespace kmercounter {
+namespace {
+
+class RunReportTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    config_.num_threads = 2;
+    config_.mode = SYNTH;
+    config_.ht_type = PARTITIONED_HT;
+    for (uint32_t i = 0; i < 2; i++) {
+      stats_[i].insertions = {1000u * (i + 1), 100};
+      stats_[i].finds = {500, 100};
+      stats_[i].ht_fill = 100;
+      stats_[i].ht_capacity = 400;
+      shards_[i].shard_idx = i;
+      shards_[i].stats = &stats_[i];
+    }
+  }
+
+  using Printer = void (*)(FILE *, const RunReport &, const Configuration &);
+
+  std::string print(Printer printer) {
+    return print(printer, make_report(shards_, config_));
+  }
+
+  std::string print(Printer printer, const RunReport &report) {
+    char *buf = nullptr;
+    size_t len = 0;
+    FILE *out = open_memstream(&buf, &len);
+    printer(out, report, config_);
+    fclose(out);
+    std::string text(buf, len);
+    free(buf);
+    return text;
+  }
+
+  Configuration config_{};
+  thread_stats stats_[2]{};
+  Shard shards_[2]{};
+};
+
+TEST_F(RunReportTest, SumsThreads) {
+  const auto report = make_report(shards_, config_);
+  ASSERT_EQ(report.threads.size(), 2u);
+  EXPECT_EQ(report.total.insertions.op_count, 200u);
+  EXPECT_EQ(report.total.insertions.duration, 3000u);
+  // the partitions add up
+  EXPECT_EQ(report.total.fill, 200u);
+  EXPECT_EQ(report.total.capacity, 800u);
+  EXPECT_GT(report.tsc_hz, 0);
+  // 15 cycles/insert on average, on 2 threads
+  EXPECT_DOUBLE_EQ(report.total.insert_mops, report.tsc_hz / 1e6 / 15 * 2);
+  EXPECT_DOUBLE_EQ(report.threads[1].insert_mops, report.tsc_hz / 1e6 / 20);
+}
+
+TEST_F(RunReportTest, EventsPerOp) {
+  for (auto &st : stats_) {
+    st.insertions.events.fill(300);
+    st.insertions.events[static_cast<size_t>(PerfEvent::LlcMisses)] =
+        PERF_NOT_COUNTED;
+  }
+  // not counted on one thread is not counted for the run
+  stats_[0].insertions.events[static_cast<size_t>(PerfEvent::DtlbMisses)] =
+      PERF_NOT_COUNTED;
+  const auto report = make_report(shards_, config_);
+  const auto &total = report.total.insertions;
+  EXPECT_DOUBLE_EQ(events_per_op(total, PerfEvent::Cycles), 3);
+  EXPECT_TRUE(std::isnan(events_per_op(total, PerfEvent::LlcMisses)));
+  EXPECT_TRUE(std::isnan(events_per_op(total, PerfEvent::DtlbMisses)));
+  EXPECT_DOUBLE_EQ(
+      events_per_op(report.threads[1].insertions, PerfEvent::DtlbMisses), 3);
+  // and no finds, no events per find
+  EXPECT_TRUE(std::isnan(events_per_op(OpTimings{}, PerfEvent::Cycles)));
+}
+
+TEST_F(RunReportTest, BandwidthAgainstPeaks) {
+  EXPECT_TRUE(std::isnan(make_report(shards_, config_).insert_bw.mlp_per_thread));
+
+  // two nodes, 100 M random lines/s, 100 ns each
+  const std::vector<MemoryPeak> peaks{{0, 400e6, 100e6, 100},
+                                      {1, 400e6, 100e6, 100}};
+  const auto report = make_report(shards_, config_, {}, peaks);
+  // one line per insert without counted misses
+  const auto &bw = report.insert_bw;
+  EXPECT_DOUBLE_EQ(bw.lines_per_sec, report.total.insert_mops * 1e6);
+  EXPECT_DOUBLE_EQ(bw.random_peak_pct, 100 * bw.lines_per_sec / 200e6);
+  EXPECT_DOUBLE_EQ(bw.seq_peak_pct, bw.random_peak_pct / 4);
+  EXPECT_DOUBLE_EQ(bw.mlp_per_thread, bw.lines_per_sec * 100e-9 / 2);
+}
+
+TEST_F(RunReportTest, SamplesFill) {
+  std::vector<ThroughputSample> samples(3);
+  samples[0].insertions = 200;
+  samples[0].fill = 200;
+  // more inserts than slots are updates
+  samples[1].insertions = 2000;
+  samples[1].fill = 800;
+  samples[2].insertions = 2000;
+  const auto report = make_report(shards_, config_, {}, {}, samples);
+  ASSERT_EQ(report.samples.size(), 3u);
+  EXPECT_DOUBLE_EQ(report.samples[0].fill_pct, 25);
+  EXPECT_DOUBLE_EQ(report.samples[1].fill_pct, 100);
+  // a build that does not count the keys has no fill to report
+  EXPECT_TRUE(std::isnan(report.samples[2].fill_pct));
+}
+
+TEST_F(RunReportTest, CsvRowsMatchHeader) {
+  std::istringstream csv(print(print_csv_report));
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(csv, line);) lines.push_back(line);
+  ASSERT_EQ(lines.size(), 4u);
+  EXPECT_EQ(lines[0].rfind("thread,insertions,", 0), 0u);
+  EXPECT_EQ(lines[3].rfind("all,200,3000,15,", 0), 0u);
+  const auto columns = std::count(lines[0].begin(), lines[0].end(), ',');
+  for (const auto &line : lines) {
+    EXPECT_EQ(std::count(line.begin(), line.end(), ','), columns) << line;
+  }
+}
+
+TEST_F(RunReportTest, JsonHasConfiguration) {
+  config_.relation_r = "a \"quoted\" path";
+  const auto json = print(print_json_report);
+  EXPECT_NE(json.find("\"num_threads\": 2"), std::string::npos);
+  EXPECT_NE(json.find("\"mode\": \"SYNTH\""), std::string::npos);
+  EXPECT_NE(json.find("\"relation_r\": \"a \\\"quoted\\\" path\""),
+            std::string::npos);
+  EXPECT_NE(json.find("\"total\": {"), std::string::npos);
+  EXPECT_NE(json.find("\"samples\": []"), std::string::npos);
+  EXPECT_NE(json.find("\"stopped_early\": false"), std::string::npos);
+  // no calibration
+  EXPECT_NE(json.find("\"latency_4k_ns\": null"), std::string::npos);
+  EXPECT_NE(json.find("\"mlp\": []"), std::string::npos);
+}
+
+TEST_F(RunReportTest, JsonHasCalibration) {
+  LatencyCalibration latency;
+  latency.latency_4k_ns = 90;
+  latency.numa = {{0, 1, 21, 140}};
+  latency.mlp = {{1, 10e6, 100}, {2, 20e6, 100}};
+  latency.suggested_queue_len = 4;
+  const auto json =
+      print(print_json_report,
+            make_report(shards_, config_, {}, {}, {}, latency));
+  EXPECT_NE(json.find("\"latency_4k_ns\": 90"), std::string::npos);
+  EXPECT_NE(json.find("\"latency_2m_ns\": null"), std::string::npos);
+  EXPECT_NE(json.find("\"suggested_queue_len\": 4"), std::string::npos);
+  EXPECT_NE(json.find("\"distance\": 21"), std::string::npos);
+  EXPECT_NE(json.find("\"streams\": 2"), std::string::npos);
+}
+
+}  // namespace
+}  // namespace kmercounter
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "hasher.hpp"
+#include "queues/combiner.hpp"
+#include "queues/skew_router.hpp"
+
+namespace kmercounter {
+namespace {
+
+constexpr uint32_t N_CONS = 4;
+
+TEST(KeyCombiner, MergesResidentKeys) {
+  KeyCombiner combiner(64);
+  std::vector<std::pair<uint64_t, uint64_t>> sent;
+  auto emit = [&sent](uint64_t key, uint64_t n) { sent.emplace_back(key, n); };
+
+  for (auto i = 0; i < 10; i++) combiner.add(7, 3, emit);
+  combiner.add(8, 4, emit);
+  EXPECT_TRUE(sent.empty());
+
+  // same slot: evicts key 7
+  combiner.add(9, 3 + 64, emit);
+  ASSERT_EQ(sent.size(), 1u);
+  EXPECT_EQ(sent[0].first, 7u);
+  EXPECT_EQ(sent[0].second, 10u);
+
+  combiner.flush(emit);
+  EXPECT_EQ(sent.size(), 3u);
+  EXPECT_EQ(combiner.num_emitted(), 3u);
+}
+
+TEST(SkewRouter, SplitsHotKeys) {
+  Hasher hasher;
+  SkewRouter router(N_CONS, N_CONS);
+  constexpr uint64_t hot_key = 42;
+  const auto hot_hash = hasher(&hot_key, sizeof(hot_key));
+
+  std::vector<uint64_t> hot_load(N_CONS);
+  uint64_t cold_key = 1000;
+  constexpr uint64_t n = 256 * HOT_KEY_REFRESH;
+  for (auto i = 0u; i < n; i++) {
+    bool replica;
+    if (i & 1) {
+      // cold keys always stay home
+      const auto hash = hasher(&cold_key, sizeof(cold_key));
+      EXPECT_EQ(router.route(cold_key, hash, 0, &replica), 0u);
+      EXPECT_FALSE(replica);
+      cold_key++;
+    } else {
+      const auto c = router.route(hot_key, hot_hash, 1, &replica);
+      EXPECT_EQ(replica, c != 1);
+      hot_load[c]++;
+    }
+  }
+
+  EXPECT_EQ(router.num_hot(), 1u);
+  // once detected, the hot key is sprayed evenly
+  for (auto c = 0u; c < N_CONS; c++) {
+    EXPECT_GT(hot_load[c], n / 2 / N_CONS * 3 / 4) << "consumer " << c;
+  }
+}
+
+TEST(HotPartials, SumsAndSpills) {
+  HotPartials partials;
+  // more keys than the table takes; key 0 is a key like any other
+  constexpr uint64_t num_keys = HOT_PARTIAL_SLOTS;
+  for (auto round = 1u; round <= 3; round++) {
+    for (uint64_t k = 0; k < num_keys; k++) {
+      partials.add(k, round);
+    }
+  }
+  EXPECT_EQ(partials.size(), HOT_PARTIAL_SLOTS / 4 * 3);
+  EXPECT_EQ(partials.num_spilled(), (num_keys - partials.size()) * 3);
+
+  std::vector<uint64_t> counts(num_keys);
+  partials.for_each([&counts](uint64_t key, uint64_t n) { counts[key] += n; });
+  for (uint64_t k = 0; k < num_keys; k++) {
+    EXPECT_EQ(counts[k], 6u) << "key " << k;
+  }
+}
+
+}  // namespace
+}  // namespace kmercounter
@@ -3,6 +3,10 @@
 #include <absl/hash/hash_testing.h>
 #include <gtest/gtest.h>
 
+#include <iterator>
+
+#include "hasher.hpp"
+
 namespace kmercounter {
 namespace {
 TEST(FindResult, Hash) {
@@ -13,5 +17,99 @@ TEST(FindResult, Hash) {
       FindResult(0, 0),
   }));
 }
+
+TEST(Hasher, Parse) {
+  for (size_t i = 0; i <= static_cast<size_t>(HasherType::mulxor); i++) {
+    HasherType type;
+    ASSERT_TRUE(parse_hasher(hasher_strings[i], &type));
+    EXPECT_EQ(static_cast<size_t>(type), i);
+  }
+  HasherType type = HasherType::crc;
+  EXPECT_FALSE(parse_hasher("md5", &type));
+  EXPECT_EQ(type, HasherType::crc);
+}
+
+TEST(Hasher, BatchMatchesScalar) {
+  InsertFindArgument args[HASH_BATCH_LENGTH + 3];
+  for (size_t i = 0; i < std::size(args); i++) {
+    args[i].key = 0x9e3779b97f4a7c15ULL * (i + 1);
+  }
+
+  for (size_t t = 0; t <= static_cast<size_t>(HasherType::mulxor); t++) {
+    Hasher hasher(static_cast<HasherType>(t));
+    uint64_t hashes[std::size(args)];
+    hasher.hash_batch(args, std::size(args), hashes);
+    for (size_t i = 0; i < std::size(args); i++) {
+      EXPECT_EQ(hashes[i], hasher(&args[i].key, sizeof(args[i].key)))
+          << hasher_strings[t] << " key " << i;
+    }
+
+    uint32_t idxs[std::size(args)];
+    fastrange32_batch(hashes, std::size(args), 1000003, idxs);
+    for (size_t i = 0; i < std::size(args); i++) {
+      EXPECT_EQ(idxs[i], fastrange32(hashes[i], 1000003));
+    }
+  }
+}
+
+#ifdef AVX_SUPPORT
+// The dispatch above picks AVX-512 where it can; check the AVX2 kernels too
+TEST(Hasher, Avx2KernelsMatchScalar) {
+  if (simd_kind == SIMDKIND::None) GTEST_SKIP() << "no AVX2";
+
+  InsertFindArgument args[HASH_BATCH_LENGTH + 3];
+  for (size_t i = 0; i < std::size(args); i++) {
+    args[i].key = 0x9e3779b97f4a7c15ULL * (i + 1);
+  }
+  uint64_t hashes[std::size(args)];
+  const auto n = mulxor_batch_avx2(args, std::size(args), hashes);
+  EXPECT_EQ(n, std::size(args) / 4 * 4);
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_EQ(hashes[i], mulxor_hash(args[i].key)) << "key " << i;
+  }
+
+  uint32_t idxs[std::size(args)];
+  EXPECT_EQ(fastrange32_batch_avx2(hashes, n, 1000003, idxs), n);
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_EQ(idxs[i], fastrange32(hashes[i], 1000003));
+  }
+}
+#endif
+
+TEST(ProbeHistograms, Summaries) {
+  ProbeHistograms probes;
+  for (int i = 0; i < 98; i++) probes.record(ProbeOutcome::InsertMiss, 0);
+  probes.record(ProbeOutcome::InsertMiss, 2);
+  // longer probes go to the last bucket
+  probes.record(ProbeOutcome::InsertMiss, 1000);
+  const auto& h = probes[ProbeOutcome::InsertMiss];
+  EXPECT_EQ(h[PROBE_HISTOGRAM_BUCKETS - 1], 1u);
+  EXPECT_EQ(probes.ops(ProbeOutcome::InsertMiss), 100u);
+  EXPECT_EQ(probes.ops(ProbeOutcome::FindHit), 0u);
+  EXPECT_DOUBLE_EQ(probes.mean(ProbeOutcome::InsertMiss),
+                   (2.0 + PROBE_HISTOGRAM_BUCKETS - 1) / 100);
+  EXPECT_EQ(probes.percentile(ProbeOutcome::InsertMiss, 50), 0u);
+  EXPECT_EQ(probes.percentile(ProbeOutcome::InsertMiss, 99), 2u);
+  EXPECT_EQ(probes.percentile(ProbeOutcome::InsertMiss, 100),
+            PROBE_HISTOGRAM_BUCKETS - 1);
+
+  ProbeHistograms sum;
+  sum += probes;
+  sum += probes;
+  EXPECT_EQ(sum.ops(ProbeOutcome::InsertMiss), 200u);
+}
+
+TEST(ProbeHistograms, ProbeLength) {
+  // 4 slots to a line: from the home line, its neighbour, and around the end
+  EXPECT_EQ(ProbeHistograms::probe_length(5, 7, 64, 4), 0u);
+  EXPECT_EQ(ProbeHistograms::probe_length(5, 8, 64, 4), 1u);
+  EXPECT_EQ(ProbeHistograms::probe_length(62, 1, 64, 4), 1u);
+
+  ProbeHistograms probes;
+  probes.record_home(0, 1000);
+  probes.record_home(999, 1000);
+  EXPECT_EQ(probes.homes[0], 1u);
+  EXPECT_EQ(probes.homes[PROBE_HISTOGRAM_BUCKETS - 1], 1u);
+}
 }  // namespace
 }  // namespace kmercounter
@@ -0,0 +1,50 @@
+#include "utils/control.hpp"
+
+#include <gtest/gtest.h>
+
+#include <csignal>
+#include <thread>
+
+namespace kmercounter {
+namespace {
+
+class ControlChannelTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    for (int i = 0; i < 2; i++) shards_[i].stats = &stats_[i];
+  }
+
+  static void wait_for_stop() {
+    while (!stop_requested()) std::this_thread::yield();
+  }
+
+  thread_stats stats_[2]{};
+  Shard shards_[2]{};
+};
+
+TEST_F(ControlChannelTest, DumpDoesNotStop) {
+  ControlChannel control(shards_, 2, 100, 0);
+  stats_[1].live.insertions = 1000;
+  ControlChannel::send(ControlChannel::DUMP);
+  ControlChannel::send(ControlChannel::DUMP);
+  // requests are served in order
+  ControlChannel::send(ControlChannel::STOP);
+  wait_for_stop();
+}
+
+TEST_F(ControlChannelTest, SignalsStop) {
+  {
+    ControlChannel control(shards_, 2, 100, 0);
+    EXPECT_FALSE(stop_requested());
+    raise(SIGUSR1);
+    EXPECT_FALSE(stop_requested());
+    raise(SIGUSR2);
+    wait_for_stop();
+  }
+  // a new run starts afresh
+  ControlChannel control(shards_, 2, 100, 0);
+  EXPECT_FALSE(stop_requested());
+}
+
+}  // namespace
+}  // namespace kmercounter
@@ -0,0 +1,56 @@
+#include "utils/sampler.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+namespace kmercounter {
+namespace {
+
+TEST(SamplerTest, NothingToPublishTo) {
+  live_progress = nullptr;
+  publish_progress(&LiveProgress::insertions, 10);
+}
+
+TEST(SamplerTest, SumsThreads) {
+  thread_stats stats[2]{};
+  Shard shards[2]{};
+  for (int i = 0; i < 2; i++) shards[i].stats = &stats[i];
+
+  ThroughputSampler sampler(shards, 2, std::chrono::milliseconds(1), 0);
+  std::thread workers[2];
+  for (int i = 0; i < 2; i++) {
+    workers[i] = std::thread([&stats, i] {
+      live_progress = &stats[i].live;
+      for (uint64_t n = 1; n <= 1000; n++) {
+        publish_progress(&LiveProgress::insertions, n);
+      }
+      publish_progress(&LiveProgress::finds, 500);
+      publish_progress(&LiveProgress::reprobes, 300);
+      publish_progress(&LiveProgress::fill, 700);
+    });
+  }
+  for (auto &w : workers) w.join();
+  const auto &samples = sampler.stop();
+
+  // the last sample sees all of it
+  ASSERT_FALSE(samples.empty());
+  EXPECT_EQ(samples.back().insertions, 2000u);
+#ifdef CALC_STATS
+  EXPECT_EQ(samples.back().fill, 1400u);
+#else
+  EXPECT_FALSE(samples.back().fill);
+#endif
+  double secs = 0, inserts = 0;
+  for (const auto &s : samples) {
+    EXPECT_GT(s.secs, secs);
+    inserts += s.insert_mops * 1e6 * (s.secs - secs);
+    secs = s.secs;
+  }
+  EXPECT_NEAR(inserts, 2000, 1);
+  EXPECT_EQ(sampler.stop().size(), samples.size());
+}
+
+}  // namespace
+}  // namespace kmercounter
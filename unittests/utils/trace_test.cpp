@@ -0,0 +1,71 @@
+#include "utils/trace.hpp"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace kmercounter {
+namespace {
+
+std::string read_file(const std::string &path) {
+  std::ifstream file(path);
+  std::stringstream text;
+  text << file.rdbuf();
+  return text.str();
+}
+
+size_t count(const std::string &text, const std::string &what) {
+  size_t n = 0;
+  for (auto pos = text.find(what); pos != std::string::npos;
+       pos = text.find(what, pos + 1)) {
+    n++;
+  }
+  return n;
+}
+
+TEST(TraceTest, DisabledRecordsNothing) {
+  trace_enabled = false;
+  const auto rings = trace_rings.size();
+  { const TraceScope insert(TraceEvent::Insert); }
+  trace_phase(TraceEvent::Find, 1, 2);
+  EXPECT_EQ(trace_rings.size(), rings);
+}
+
+TEST(TraceTest, ExportsPhasesOfAllThreads) {
+  trace_enabled = true;
+  auto worker = [](int id) {
+    trace_thread_name("worker " + std::to_string(id));
+    const TraceScope insert(TraceEvent::Insert);
+    { const TraceScope flush(TraceEvent::Flush); }
+  };
+  std::thread a(worker, 0), b(worker, 1);
+  a.join();
+  b.join();
+  trace_enabled = false;
+
+  const std::string path = testing::TempDir() + "trace_test.json";
+  write_chrome_trace(path);
+  const auto trace = read_file(path);
+  EXPECT_EQ(trace.rfind("{\"displayTimeUnit\"", 0), 0u);
+  EXPECT_EQ(count(trace, "\"name\": \"worker "), 2u);
+  EXPECT_EQ(count(trace, "\"name\": \"insert\""), 2u);
+  EXPECT_EQ(count(trace, "\"name\": \"flush\""), 2u);
+  EXPECT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+}
+
+TEST(TraceTest, RingKeepsTheLastPhases) {
+  TraceRing ring;
+  for (uint64_t i = 0; i < TRACE_RING_EVENTS + 3; i++) {
+    ring.push(TraceEvent::Probe, i, i + 1);
+  }
+  EXPECT_EQ(ring.head, TRACE_RING_EVENTS + 3);
+  // the oldest three were overwritten
+  EXPECT_EQ(ring.records[0].begin, TRACE_RING_EVENTS);
+  EXPECT_EQ(ring.records[3].begin, 3u);
+}
+
+}  // namespace
+}  // namespace kmercounter